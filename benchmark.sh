@@ -157,3 +157,13 @@ for test_num in $(seq 0 $(($FLOPS_NUM_TESTS - 1)) ); do
     "${FLOPS_SIZES[$test_num]}" "${FLOPS_ITERS[$test_num]}"
 done
 
+
+#### Conditions
+# the results only hold under the governor, turbo and SMT settings they were
+# measured with. Copy this section into machine-stats.json as well
+if command -v fhv > /dev/null; then
+  fhv --machine-conditions
+else
+  echo "fhv is not in PATH. Run 'fhv --machine-conditions' to record the" \
+    "conditions of this benchmark."
+fi
@@ -60,6 +60,10 @@ int main(int argc, char ** argv){
 
 #ifdef FHV_PERFMON
   fhv_perfmon::init();
+  fhv_perfmon::setParameter("m", m);
+  fhv_perfmon::setParameter("n", n);
+  fhv_perfmon::setParameter("kernel_size", k);
+  fhv_perfmon::setParameter("iterations", nbiter);
 #endif
 
   for (size_t i = 0; i < static_cast<size_t>(nbiter); i++)
@@ -0,0 +1,503 @@
+#include "binary_results.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <fstream>
+#include <map>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "performance_monitor_defines.hpp"
+#include "result_filter.hpp"
+#include "result_stream.hpp"
+#include "utils.hpp"
+
+size_t fhv::binary::columnWidth(column_t column)
+{
+  switch (column)
+  {
+    case column_t::region:
+    case column_t::group:
+    case column_t::result_name:
+      return sizeof(uint32_t);
+    case column_t::thread:
+      return sizeof(int32_t);
+    case column_t::aggregation:
+      return sizeof(int8_t);
+    case column_t::result_type:
+      return sizeof(uint8_t);
+    case column_t::value:
+      return sizeof(double);
+    default:
+      return 0;
+  }
+}
+
+// columns start at multiples of 8 bytes so they can be read in place
+static uint64_t align8(uint64_t offset)
+{
+  return (offset + 7) & ~static_cast<uint64_t>(7);
+}
+
+bool fhv::binary::isBinaryResults(const std::string &filename)
+{
+  std::ifstream i(filename, std::ios::binary);
+  char magic[sizeof(binary_results_magic)];
+  if (!i.read(magic, sizeof(magic))) return false;
+
+  return std::memcmp(magic, binary_results_magic, sizeof(magic)) == 0;
+}
+
+bool fhv::binary::isBinaryExtension(const std::string &filename)
+{
+  return filename.size() > binary_results_extension.size()
+    && filename.compare(filename.size() - binary_results_extension.size(),
+      std::string::npos, binary_results_extension) == 0;
+}
+
+// ===== writing =====
+uint32_t fhv::binary::ResultsWriter::stringIndex(const std::string &text)
+{
+  auto inserted = string_indices.emplace(text,
+    static_cast<uint32_t>(strings.size()));
+  if (inserted.second) strings.push_back(text);
+
+  return inserted.first->second;
+}
+
+void fhv::binary::ResultsWriter::addRow(
+  const std::string &region_name,
+  int32_t thread_num,
+  int8_t aggregation,
+  const std::string &group_name,
+  fhv::types::result_t result_type,
+  const std::string &result_name,
+  double value)
+{
+  regions.push_back(stringIndex(region_name));
+  threads.push_back(thread_num);
+  aggregations.push_back(aggregation);
+  groups.push_back(stringIndex(group_name));
+  result_types.push_back(static_cast<uint8_t>(result_type));
+  result_names.push_back(stringIndex(result_name));
+  values.push_back(value);
+}
+
+void fhv::binary::ResultsWriter::addPerThreadResult(
+  const fhv::types::PerThreadResult &result)
+{
+  addRow(result.region_name, result.thread_num, no_aggregation,
+    result.group_name, result.result_type, result.result_name,
+    result.result_value);
+}
+
+void fhv::binary::ResultsWriter::addAggregateResult(
+  const fhv::types::AggregateResult &result)
+{
+  addRow(result.region_name, no_thread,
+    static_cast<int8_t>(result.aggregation_type), result.group_name,
+    result.result_type, result.result_name, result.result_value);
+}
+
+bool fhv::binary::ResultsWriter::write(
+  const std::string &filename,
+  const json &info)
+{
+  BinaryHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, binary_results_magic, sizeof(header.magic));
+  header.version = binary_results_version;
+  header.info = stringIndex(info.dump());
+  header.num_strings = strings.size();
+  header.num_rows = values.size();
+
+  std::vector<uint64_t> string_offsets = {0};
+  for (const auto &text : strings)
+    string_offsets.push_back(string_offsets.back() + text.size());
+
+  header.string_offsets = align8(sizeof(header));
+  header.string_data = header.string_offsets
+    + string_offsets.size() * sizeof(uint64_t);
+
+  uint64_t offset = header.string_data + string_offsets.back();
+  for (size_t c = 0; c < num_columns; c++)
+  {
+    offset = align8(offset);
+    header.columns[c] = offset;
+    offset += header.num_rows * columnWidth(static_cast<column_t>(c));
+  }
+
+  fhv::utils::create_directories_for_file(filename);
+  std::ofstream o(filename, std::ios::binary);
+
+  uint64_t position = 0;
+  auto write_at = [&](uint64_t at, const void *bytes, size_t num_bytes) {
+    static const char padding[8] = {0};
+    o.write(padding, at - position);
+    o.write(static_cast<const char*>(bytes), num_bytes);
+    position = at + num_bytes;
+  };
+
+  write_at(0, &header, sizeof(header));
+  write_at(header.string_offsets, string_offsets.data(),
+    string_offsets.size() * sizeof(uint64_t));
+  for (const auto &text : strings)
+    write_at(position, text.data(), text.size());
+
+  const void *columns[num_columns] = {regions.data(), threads.data(),
+    aggregations.data(), groups.data(), result_types.data(),
+    result_names.data(), values.data()};
+  for (size_t c = 0; c < num_columns; c++)
+    write_at(header.columns[c], columns[c],
+      header.num_rows * columnWidth(static_cast<column_t>(c)));
+
+  if (!o) {
+    fmt::print(stderr, "ERROR: could not write the results to '{}'\n",
+      filename);
+    return false;
+  }
+
+  return true;
+}
+
+// ===== reading =====
+fhv::binary::MappedResults::MappedResults()
+  : data(nullptr), size(0), header(nullptr), string_offsets(nullptr),
+    string_data(nullptr), num_strings(0), num_rows(0)
+{
+}
+
+fhv::binary::MappedResults::~MappedResults()
+{
+  close();
+}
+
+void fhv::binary::MappedResults::close()
+{
+  if (data != nullptr) munmap(data, size);
+
+  data = nullptr;
+  size = 0;
+  header = nullptr;
+  string_offsets = nullptr;
+  string_data = nullptr;
+  num_strings = 0;
+  num_rows = 0;
+}
+
+bool fhv::binary::MappedResults::open(const std::string &filename)
+{
+  close();
+
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    fmt::print(stderr, "ERROR: '{}' does not exist!\n", filename);
+    return false;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0
+      || static_cast<size_t>(file_stat.st_size) < sizeof(BinaryHeader)) {
+    fmt::print(stderr, "ERROR: '{}' is not a binary results file.\n",
+      filename);
+    ::close(fd);
+    return false;
+  }
+
+  size = file_stat.st_size;
+  data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    data = nullptr;
+    fmt::print(stderr, "ERROR: could not map '{}' into memory.\n", filename);
+    return false;
+  }
+
+  // columns are read front to back
+  madvise(data, size, MADV_SEQUENTIAL);
+
+  const char *bytes = static_cast<const char*>(data);
+  header = reinterpret_cast<const BinaryHeader*>(bytes);
+
+  auto fail = [&](const std::string &reason) {
+    fmt::print(stderr, "ERROR: '{}' is not a valid binary results file: {}\n",
+      filename, reason);
+    close();
+    return false;
+  };
+
+  if (std::memcmp(header->magic, binary_results_magic,
+      sizeof(header->magic)) != 0)
+    return fail("wrong magic number");
+  if (header->version != binary_results_version)
+    return fail(fmt::format("version {} instead of {}", header->version,
+      binary_results_version));
+
+  // every section has to lie inside the file
+  auto fits = [&](uint64_t offset, uint64_t count, uint64_t width) {
+    return offset % 8 == 0 && offset <= size
+      && (width == 0 || count <= (size - offset) / width);
+  };
+
+  if (header->num_strings >= UINT32_MAX
+      || !fits(header->string_offsets, header->num_strings + 1,
+        sizeof(uint64_t)))
+    return fail("string table out of bounds");
+
+  string_offsets = reinterpret_cast<const uint64_t*>(
+    bytes + header->string_offsets);
+  if (header->string_data > size
+      || string_offsets[header->num_strings] > size - header->string_data)
+    return fail("strings out of bounds");
+  for (size_t i = 0; i < header->num_strings; i++)
+    if (string_offsets[i] > string_offsets[i + 1])
+      return fail("string table out of order");
+  string_data = bytes + header->string_data;
+
+  for (size_t c = 0; c < num_columns; c++)
+    if (!fits(header->columns[c], header->num_rows,
+        columnWidth(static_cast<column_t>(c))))
+      return fail("column out of bounds");
+
+  num_strings = header->num_strings;
+  num_rows = header->num_rows;
+  return true;
+}
+
+const void *fhv::binary::MappedResults::column(column_t column) const
+{
+  return static_cast<const char*>(data)
+    + header->columns[static_cast<size_t>(column)];
+}
+
+const uint32_t *fhv::binary::MappedResults::regions() const
+{
+  return static_cast<const uint32_t*>(column(column_t::region));
+}
+
+const int32_t *fhv::binary::MappedResults::threads() const
+{
+  return static_cast<const int32_t*>(column(column_t::thread));
+}
+
+const int8_t *fhv::binary::MappedResults::aggregations() const
+{
+  return static_cast<const int8_t*>(column(column_t::aggregation));
+}
+
+const uint32_t *fhv::binary::MappedResults::groups() const
+{
+  return static_cast<const uint32_t*>(column(column_t::group));
+}
+
+const uint8_t *fhv::binary::MappedResults::resultTypes() const
+{
+  return static_cast<const uint8_t*>(column(column_t::result_type));
+}
+
+const uint32_t *fhv::binary::MappedResults::resultNames() const
+{
+  return static_cast<const uint32_t*>(column(column_t::result_name));
+}
+
+const double *fhv::binary::MappedResults::values() const
+{
+  return static_cast<const double*>(column(column_t::value));
+}
+
+const char *fhv::binary::MappedResults::string(
+  uint32_t index,
+  size_t &size) const
+{
+  if (index >= num_strings) {
+    size = 0;
+    return nullptr;
+  }
+
+  size = string_offsets[index + 1] - string_offsets[index];
+  return string_data + string_offsets[index];
+}
+
+std::string fhv::binary::MappedResults::string(uint32_t index) const
+{
+  size_t size;
+  const char *text = string(index, size);
+  return text == nullptr ? std::string() : std::string(text, size);
+}
+
+json fhv::binary::MappedResults::info() const
+{
+  if (header == nullptr) return json::object();
+
+  try {
+    return json::parse(string(header->info));
+  }
+  catch (json::parse_error &e) {
+    return json::object();
+  }
+}
+
+json fhv::binary::MappedResults::toJson(bool include_threads) const
+{
+  json results;
+  results[json_info_section] = info();
+  results[json_results_section] = json::object();
+  if (num_rows == 0) return results;
+
+  // most rows share a few names, so each string is checked and copied once
+  std::vector<int> is_key_metric(num_strings, -1);
+  std::vector<std::string> names(num_strings);
+  auto name = [&](uint32_t index) -> const std::string& {
+    if (names[index].empty()) names[index] = string(index);
+    return names[index];
+  };
+
+  std::vector<std::string> aggregation_names;
+  for (const auto &aggregation : {fhv::types::aggregation_t::sum,
+      fhv::types::aggregation_t::arithmetic_mean,
+      fhv::types::aggregation_t::geometric_mean,
+      fhv::types::aggregation_t::saturation})
+    aggregation_names.push_back(
+      fhv::types::aggregationTypeToString(aggregation));
+
+  const uint32_t *region_column = regions();
+  const int32_t *thread_column = threads();
+  const int8_t *aggregation_column = aggregations();
+  const uint8_t *type_column = resultTypes();
+  const uint32_t *name_column = resultNames();
+  const double *value_column = values();
+
+  json &region_results = results[json_results_section];
+  for (size_t row = 0; row < num_rows; row++)
+  {
+    bool per_thread = aggregation_column[row] == no_aggregation;
+    if (per_thread && !include_threads) continue;
+    if (type_column[row]
+        != static_cast<uint8_t>(fhv::types::result_t::metric))
+      continue;
+
+    uint32_t result_name = name_column[row];
+    uint32_t region = region_column[row];
+    if (result_name >= num_strings || region >= num_strings) continue;
+
+    // resultsToJson only writes the key metrics
+    if (is_key_metric[result_name] < 0)
+      is_key_metric[result_name] = std::find(fhv_key_metrics.begin(),
+        fhv_key_metrics.end(), name(result_name)) != fhv_key_metrics.end();
+    if (!is_key_metric[result_name]) continue;
+
+    std::string section;
+    if (per_thread)
+      section = json_thread_section_base
+        + std::to_string(thread_column[row]);
+    else if (aggregation_column[row] >= 0 && static_cast<size_t>(
+        aggregation_column[row]) < aggregation_names.size())
+      section = aggregation_names[aggregation_column[row]];
+    else
+      continue;
+
+    // key metrics are written without their group, as resultsToJson does
+    fhv::filter::setJsonResult(region_results[name(region)][section], "",
+      name(result_name), value_column[row]);
+  }
+
+  return results;
+}
+
+// ===== conversion =====
+void fhv::binary::addJsonResults(
+  ResultsWriter &writer,
+  const json &results,
+  size_t &num_skipped)
+{
+  num_skipped = 0;
+  if (!results.contains(json_results_section)) return;
+
+  std::map<std::string, int8_t> aggregations;
+  for (const auto &aggregation : {fhv::types::aggregation_t::sum,
+      fhv::types::aggregation_t::arithmetic_mean,
+      fhv::types::aggregation_t::geometric_mean,
+      fhv::types::aggregation_t::saturation})
+    aggregations[fhv::types::aggregationTypeToString(aggregation)] =
+      static_cast<int8_t>(aggregation);
+
+  for (const auto &region : results[json_results_section].items())
+  {
+    for (const auto &section : region.value().items())
+    {
+      int32_t thread_num = no_thread;
+      int8_t aggregation = no_aggregation;
+
+      auto found = aggregations.find(section.key());
+      if (found != aggregations.end())
+      {
+        aggregation = found->second;
+      }
+      else if (section.key().compare(0, json_thread_section_base.size(),
+          json_thread_section_base) == 0)
+      {
+        try {
+          thread_num = std::stoi(
+            section.key().substr(json_thread_section_base.size()));
+        }
+        catch (std::exception &e) {
+          num_skipped++;
+          continue;
+        }
+      }
+      else
+      {
+        num_skipped++;
+        continue;
+      }
+
+      std::string group, name;
+      for (const auto &result : section.value().items())
+      {
+        if (!result.value().is_number()) continue;
+
+        fhv::filter::splitJsonResultName(result.key(), group, name);
+        writer.addRow(region.key(), thread_num, aggregation, group,
+          fhv::types::result_t::metric, name, result.value().get<double>());
+      }
+    }
+  }
+}
+
+bool fhv::binary::loadResults(
+  const std::string &filename,
+  json &results,
+  bool include_threads)
+{
+  if (fhv::stream::isStream(filename))
+    return fhv::stream::loadStream(filename, results);
+
+  if (isBinaryResults(filename))
+  {
+    MappedResults mapped;
+    if (!mapped.open(filename)) return false;
+
+    results = mapped.toJson(include_threads);
+    return true;
+  }
+
+  std::ifstream i(filename);
+  if (!i) {
+    fmt::print(stderr, "ERROR: The json '{}' does not exist!\n", filename);
+    return false;
+  }
+
+  try {
+    i >> results;
+  }
+  catch (json::parse_error &e) {
+    fmt::print(stderr, "ERROR: could not parse '{}': {}\n", filename,
+      e.what());
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "types.hpp"
+
+using json = nlohmann::json;
+
+/* ---- binary results ----
+ * a compact, columnar alternative to the json written by
+ * fhv_perfmon::resultsToJson, for runs whose json would be too big to write
+ * or parse quickly. A file is:
+ *
+ *  - a BinaryHeader
+ *  - the string table: num_strings + 1 uint64 offsets into the characters
+ *    that follow, so string i is [offsets[i], offsets[i + 1])
+ *  - one array of num_rows values per column (see column_t), each starting
+ *    at a multiple of 8 bytes
+ *
+ * Every result is one row. Names (regions, groups, results) are indices into
+ * the string table, and the info section is stored as json text in it.
+ * Values are little-endian, as written on x86.
+ *
+ * MappedResults maps a file into memory and reads the columns in place, so
+ * opening a file costs nothing no matter its size.
+ */
+namespace fhv {
+  namespace binary {
+    const std::string binary_results_extension = ".fhvb";
+    const char binary_results_magic[8] = {'F', 'H', 'V', 'B', 'I', 'N', '\0',
+      '\0'};
+    // bump when the layout changes. Readers refuse other versions.
+    const uint32_t binary_results_version = 1;
+
+    // the value of aggregation for per-thread results and of thread for
+    // aggregate results
+    const int8_t no_aggregation = -1;
+    const int32_t no_thread = -1;
+
+    enum class column_t {
+      region,       // uint32_t string index
+      thread,       // int32_t, no_thread for aggregate results
+      aggregation,  // int8_t aggregation_t, no_aggregation for per-thread
+      group,        // uint32_t string index
+      result_type,  // uint8_t result_t
+      result_name,  // uint32_t string index
+      value,        // double
+      num_columns
+    };
+    const size_t num_columns = static_cast<size_t>(column_t::num_columns);
+
+    // size in bytes of one value of column
+    size_t columnWidth(column_t column);
+
+    struct BinaryHeader {
+      char magic[8];
+      uint32_t version;
+      // string index of the info section, as json text
+      uint32_t info;
+      uint64_t num_strings;
+      uint64_t num_rows;
+      // file offsets of the string table and its characters
+      uint64_t string_offsets;
+      uint64_t string_data;
+      // file offset of each column, indexed by column_t
+      uint64_t columns[num_columns];
+    };
+
+    // true if filename starts with binary_results_magic
+    bool isBinaryResults(const std::string &filename);
+
+    // true if filename ends in binary_results_extension, so results written
+    // to it are written in the binary format
+    bool isBinaryExtension(const std::string &filename);
+
+    /* ---- results writer ----
+     * collects rows in columns, interning names as they are added, and
+     * writes them in one go
+     */
+    class ResultsWriter {
+      public:
+        void addPerThreadResult(const fhv::types::PerThreadResult &result);
+        void addAggregateResult(const fhv::types::AggregateResult &result);
+
+        void addRow(
+          const std::string &region_name,
+          int32_t thread_num,
+          int8_t aggregation,
+          const std::string &group_name,
+          fhv::types::result_t result_type,
+          const std::string &result_name,
+          double value);
+
+        // writes info and the rows to filename. Returns false and prints
+        // an error if it can't be written.
+        bool write(const std::string &filename, const json &info);
+
+      private:
+        uint32_t stringIndex(const std::string &text);
+
+        std::vector<std::string> strings;
+        std::unordered_map<std::string, uint32_t> string_indices;
+
+        std::vector<uint32_t> regions;
+        std::vector<int32_t> threads;
+        std::vector<int8_t> aggregations;
+        std::vector<uint32_t> groups;
+        std::vector<uint8_t> result_types;
+        std::vector<uint32_t> result_names;
+        std::vector<double> values;
+    };
+
+    /* ---- mapped results ----
+     * a read-only view of a binary results file. Column pointers point
+     * straight into the mapping and stay valid until the object is
+     * destroyed.
+     */
+    class MappedResults {
+      public:
+        MappedResults();
+        ~MappedResults();
+
+        MappedResults(const MappedResults &) = delete;
+        MappedResults &operator=(const MappedResults &) = delete;
+
+        // maps filename and checks its layout. Prints an error and returns
+        // false if it is not a valid binary results file.
+        bool open(const std::string &filename);
+        void close();
+
+        size_t numRows() const { return num_rows; }
+        size_t numStrings() const { return num_strings; }
+
+        const uint32_t *regions() const;
+        const int32_t *threads() const;
+        const int8_t *aggregations() const;
+        const uint32_t *groups() const;
+        const uint8_t *resultTypes() const;
+        const uint32_t *resultNames() const;
+        const double *values() const;
+
+        // string index of the table, without copying. size is set to its
+        // length. nullptr if index is out of range.
+        const char *string(uint32_t index, size_t &size) const;
+        std::string string(uint32_t index) const;
+
+        json info() const;
+
+        /* ---- to json ----
+         * the same json fhv_perfmon::resultsToJson writes for these
+         * results: info, and every metric in fhv_key_metrics by region and
+         * thread or aggregation. Tools that only look at aggregates can
+         * leave out the per-thread sections, which are most of a file.
+         */
+        json toJson(bool include_threads = true) const;
+
+      private:
+        const void *column(column_t column) const;
+
+        void *data;
+        size_t size;
+        const BinaryHeader *header;
+        const uint64_t *string_offsets;
+        const char *string_data;
+        size_t num_strings;
+        size_t num_rows;
+    };
+
+    /* ---- from json ----
+     * rows for a json in the format written by resultsToJson, e.g. to
+     * convert existing results. Sections that are not a thread or an
+     * aggregation (like the statistics of merged results) can't be stored
+     * and are counted in num_skipped.
+     */
+    void addJsonResults(ResultsWriter &writer, const json &results,
+      size_t &num_skipped);
+
+    /* ---- load results ----
+     * loads a json, binary results file or result stream (see fhv::stream),
+     * told apart by their first bytes, as json. include_threads is only
+     * used for binary files.
+     */
+    bool loadResults(const std::string &filename, json &results,
+      bool include_threads = true);
+  };
+};
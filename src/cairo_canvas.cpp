@@ -0,0 +1,239 @@
+#include "cairo_canvas.hpp"
+
+#include <cairo-pdf.h>
+#include <cairo-svg.h>
+#include <cmath>
+#include <fmt/core.h>
+
+#include "render_context.hpp"
+#include "saturation_diagram.hpp"
+
+cairo_canvas::cairo_canvas(
+  render_context &context,
+  const std::string &output_filename,
+  double width,
+  double height,
+  double dpi)
+  : context(context),
+    format(imageFormatFromFilename(output_filename)),
+    output_filename(output_filename),
+    end_page(false),
+    finished(false),
+    written(false)
+{
+  if (format == image_format::png)
+  {
+    // cairo units are points, so scale them to pixels at the requested dpi
+    double pixels_per_point = dpi / 72.0;
+    surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+      static_cast<int>(std::ceil(width * pixels_per_point)),
+      static_cast<int>(std::ceil(height * pixels_per_point)));
+    cr = cairo_create(surface);
+
+    // unlike the vector formats, an empty PNG is transparent black
+    cairo_set_source_rgb(cr, 1, 1, 1);
+    cairo_paint(cr);
+    cairo_scale(cr, pixels_per_point, pixels_per_point);
+  }
+  else if (format == image_format::pdf)
+  {
+    surface = cairo_pdf_surface_create(output_filename.c_str(), width,
+      height);
+    cr = cairo_create(surface);
+  }
+  else
+  {
+    surface = cairo_svg_surface_create(output_filename.c_str(), width,
+      height);
+    cr = cairo_create(surface);
+  }
+}
+
+cairo_canvas::cairo_canvas(render_context &context, cairo_t *cr,
+  bool end_page)
+  : context(context), surface(nullptr), cr(cr), format(image_format::pdf),
+    end_page(end_page), finished(false), written(false)
+{
+}
+
+cairo_canvas::~cairo_canvas()
+{
+  finish();
+}
+
+bool cairo_canvas::finish()
+{
+  if (finished) return written;
+  finished = true;
+
+  // pages of a document are written by the render_context that owns it
+  if (surface == nullptr)
+  {
+    if (end_page) cairo_show_page(cr);
+    written = true;
+    return written;
+  }
+
+  cairo_status_t status;
+  if (format == image_format::png)
+    status = cairo_surface_write_to_png(surface, output_filename.c_str());
+  cairo_destroy(cr);
+
+  // svg and pdf surfaces write the rest of the file when they are finished
+  if (format != image_format::png)
+  {
+    cairo_surface_finish(surface);
+    status = cairo_surface_status(surface);
+  }
+  cairo_surface_destroy(surface);
+
+  written = status == CAIRO_STATUS_SUCCESS;
+  if (!written)
+    fmt::print(stderr, "ERROR: could not write {}: {}\n", output_filename,
+      cairo_status_to_string(status));
+  return written;
+}
+
+PangoAlignment cairo_canvas::pango_alignment(text_alignment alignment)
+{
+  if (alignment == text_alignment::CENTER)
+    return PANGO_ALIGN_CENTER;
+  else if (alignment == text_alignment::RIGHT)
+    return PANGO_ALIGN_RIGHT;
+  else
+    return PANGO_ALIGN_LEFT;
+}
+
+double cairo_canvas::text(
+  double x,
+  double y,
+  double width,
+  const std::string &text,
+  font_role font,
+  text_alignment alignment,
+  bool vertical)
+{
+  return saturation_diagram::pango_cairo_draw_text(cr, x, y, width, text,
+    context.font(font), pango_alignment(alignment), vertical);
+}
+
+double cairo_canvas::label(
+  double x,
+  double y,
+  double width,
+  const std::string &text,
+  font_role font,
+  text_alignment alignment,
+  bool vertical)
+{
+  PangoLayout *layout = context.label_layout(text, context.font(font), width,
+    pango_alignment(alignment));
+  saturation_diagram::pango_cairo_draw_layout(cr, x, y, layout, vertical,
+    false);
+
+  return saturation_diagram::pango_layout_cairo_height(layout);
+}
+
+double cairo_canvas::component(
+  double x,
+  double y,
+  double width,
+  double height,
+  rgb_color fill_color,
+  const std::string &label,
+  font_role font,
+  label_position position,
+  double stroke_width,
+  rgb_color upper_fill_color)
+{
+  return saturation_diagram::cairo_draw_component(cr, x, y, width, height,
+    fill_color,
+    context.component_label_layout(label, context.font(font), width, height,
+      position),
+    position, stroke_width, upper_fill_color);
+}
+
+void cairo_canvas::arrow(
+  double x,
+  double y,
+  double width,
+  double height,
+  rgb_color fill_color,
+  direction arrow_direction,
+  const std::string &label,
+  font_role font,
+  double stroke_width,
+  rgb_color upper_fill_color)
+{
+  saturation_diagram::cairo_draw_arrow(cr, x, y, width, height, fill_color,
+    arrow_direction,
+    context.component_label_layout(label, context.font(font), width, height,
+      label_position::INSIDE),
+    stroke_width, upper_fill_color);
+}
+
+void cairo_canvas::swatch(
+  double x,
+  double y,
+  double width,
+  double height,
+  const std::vector<rgb_color> &colors)
+{
+  if (colors.empty()) return;
+
+  cairo_save(cr);
+
+  double step_size = width / static_cast<double>(colors.size());
+  for (size_t i = 0; i < colors.size(); i++)
+  {
+    cairo_rectangle(cr, x + i * step_size, y, step_size, height);
+    cairo_set_source_rgb(cr,
+      std::get<0>(colors[i]),
+      std::get<1>(colors[i]),
+      std::get<2>(colors[i]));
+    cairo_fill_preserve(cr);
+    cairo_stroke(cr);
+  }
+
+  cairo_restore(cr);
+}
+
+void cairo_canvas::line(
+  const std::vector<std::pair<double, double>> &points,
+  rgb_color color,
+  double line_width,
+  bool dashed)
+{
+  if (points.empty()) return;
+
+  cairo_save(cr);
+  cairo_set_source_rgb(cr, std::get<0>(color), std::get<1>(color),
+    std::get<2>(color));
+  cairo_set_line_width(cr, line_width);
+  if (dashed)
+  {
+    const double dash[] = {dash_length, dash_gap};
+    cairo_set_dash(cr, dash, 2, 0);
+  }
+
+  cairo_move_to(cr, points[0].first, points[0].second);
+  for (size_t i = 1; i < points.size(); i++)
+    cairo_line_to(cr, points[i].first, points[i].second);
+  cairo_stroke(cr);
+
+  cairo_restore(cr);
+}
+
+void cairo_canvas::dot(
+  double x,
+  double y,
+  double radius,
+  rgb_color color)
+{
+  cairo_save(cr);
+  cairo_set_source_rgb(cr, std::get<0>(color), std::get<1>(color),
+    std::get<2>(color));
+  cairo_arc(cr, x, y, radius, 0, 2 * G_PI);
+  cairo_fill(cr);
+  cairo_restore(cr);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cairo.h>
+#include <pango/pangocairo.h>
+#include <string>
+
+#include "diagram_canvas.hpp"
+
+class render_context;
+
+/* ---- cairo canvas ----
+ * draws with the cairo helpers in saturation_diagram. Component labels and
+ * other static text come from the layout cache of a render_context.
+ */
+class cairo_canvas : public diagram_canvas {
+  public:
+    /* draws on a new file. The format comes from the extension of
+     * output_filename (see imageFormatFromFilename). PNGs are rendered at
+     * dpi pixels per inch on a white background; SVG and PDF are vector
+     * formats and ignore it.
+     */
+    cairo_canvas(
+      render_context &context,
+      const std::string &output_filename,
+      double width,
+      double height,
+      double dpi = 96);
+
+    /* draws on an existing cairo context, which stays owned by the caller.
+     * If end_page is true, the page is emitted with cairo_show_page when
+     * the canvas is destroyed, which is how diagrams become pages of a
+     * multi-page document.
+     */
+    cairo_canvas(render_context &context, cairo_t *cr, bool end_page = false);
+
+    ~cairo_canvas();
+
+    cairo_canvas(const cairo_canvas &) = delete;
+    cairo_canvas &operator=(const cairo_canvas &) = delete;
+
+    bool finish() override;
+
+    double text(
+      double x,
+      double y,
+      double width,
+      const std::string &text,
+      font_role font,
+      text_alignment alignment = text_alignment::LEFT,
+      bool vertical = false) override;
+
+    double label(
+      double x,
+      double y,
+      double width,
+      const std::string &text,
+      font_role font,
+      text_alignment alignment = text_alignment::LEFT,
+      bool vertical = false) override;
+
+    double component(
+      double x,
+      double y,
+      double width,
+      double height,
+      rgb_color fill_color,
+      const std::string &label,
+      font_role font,
+      label_position position = label_position::INSIDE,
+      double stroke_width = stroke_thickness_normal,
+      rgb_color upper_fill_color = NO_COLOR) override;
+
+    void arrow(
+      double x,
+      double y,
+      double width,
+      double height,
+      rgb_color fill_color,
+      direction arrow_direction,
+      const std::string &label,
+      font_role font,
+      double stroke_width = stroke_thickness_normal,
+      rgb_color upper_fill_color = NO_COLOR) override;
+
+    void swatch(
+      double x,
+      double y,
+      double width,
+      double height,
+      const std::vector<rgb_color> &colors) override;
+
+    void line(
+      const std::vector<std::pair<double, double>> &points,
+      rgb_color color,
+      double line_width,
+      bool dashed = false) override;
+
+    void dot(
+      double x,
+      double y,
+      double radius,
+      rgb_color color) override;
+
+    static PangoAlignment pango_alignment(text_alignment alignment);
+
+  private:
+    render_context &context;
+    cairo_surface_t *surface;
+    cairo_t *cr;
+    image_format format;
+    std::string output_filename;
+    bool end_page;
+
+    bool finished;
+    // what finish returned
+    bool written;
+};
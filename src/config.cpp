@@ -52,6 +52,8 @@ fhv::config::MachineStats fhv::config::loadMachineStats() {
       bw_rw_l3: j["benchmark_results"]["bw_rw_l3"],
       bw_rw_ram: j["benchmark_results"]["bw_rw_ram"],
     },
+    measurementConditions: j.value(machineStatsConditionsSection,
+      json::object()),
   };
 
   return machineStats;
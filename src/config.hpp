@@ -16,6 +16,9 @@ namespace fhv {
     const std::string machineStatsFileName = "machine-stats.json";
     const std::string machineStatsFileLocation_system = "/etc/fhv";
     const std::string machineStatsFileLocation_userPostfix = ".config/fhv";
+    // optional section with the environment the benchmarks ran in, see
+    // fhv::environment::conditionsOf
+    const std::string machineStatsConditionsSection = "measurement_conditions";
 
     struct Architecture {
       unsigned num_ports_in_core;
@@ -41,6 +44,7 @@ namespace fhv {
     struct MachineStats {
       Architecture architecture;
       BenchmarkResults benchmarkResults;
+      json measurementConditions;
     };
 
     MachineStats loadMachineStats();
@@ -0,0 +1,57 @@
+#include "diagram_canvas.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+double font_size(font_role role)
+{
+  if (role == font_role::TITLE)
+    return 40;
+  else if (role == font_role::DESCRIPTION)
+    return 12;
+  else if (role == font_role::BIG_LABEL)
+    return 40;
+  else
+    return 25;
+}
+
+std::string renderBackendToString(const render_backend &backend)
+{
+  if (backend == render_backend::cairo)
+    return "cairo";
+  else if (backend == render_backend::svg)
+    return "svg";
+  else
+    return "unknown_render_backend";
+}
+
+bool renderBackendFromString(const std::string &name, render_backend &backend)
+{
+  for (const auto &candidate : {render_backend::cairo, render_backend::svg})
+  {
+    if (renderBackendToString(candidate) == name)
+    {
+      backend = candidate;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+image_format imageFormatFromFilename(const std::string &filename)
+{
+  auto dot = filename.find_last_of('.');
+  if (dot == std::string::npos) return image_format::svg;
+
+  std::string extension = filename.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+    [](unsigned char c) { return std::tolower(c); });
+
+  if (extension == "png")
+    return image_format::png;
+  else if (extension == "pdf")
+    return image_format::pdf;
+  else
+    return image_format::svg;
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// ----- simple color type ----- //
+typedef std::tuple<double, double, double> rgb_color;
+
+enum class label_position {
+  INSIDE, BOTTOM, LEFT
+};
+
+enum class direction {
+  UP, RIGHT, DOWN, LEFT
+};
+
+enum class text_alignment {
+  LEFT, CENTER, RIGHT
+};
+
+// fonts are picked by what they are used for, so every backend draws the
+// same diagram with the same sizes
+enum class font_role {
+  TITLE, DESCRIPTION, BIG_LABEL, SMALL_LABEL
+};
+
+// magic numbers
+
+// TODO: should anything else be here?
+const double stroke_thickness_normal = 10.0;
+const double stroke_thickness_thin = 5.0;
+const rgb_color WHITE(1.0, 1.0, 1.0);
+// used to indicate that a component has no second color
+const rgb_color NO_COLOR(-1.0, -1.0, -1.0);
+// dashes of diagram_canvas::line
+const double dash_length = 12.0;
+const double dash_gap = 8.0;
+
+// all diagram fonts are "Sans"
+const std::string diagram_font_family = "Sans";
+
+// size in points of the font used for role
+double font_size(font_role role);
+
+/* ---- render backend ----
+ * what draws the diagrams:
+ *  - cairo: cairo and pango. Handles every output format.
+ *  - svg: writes SVG text directly, with text metrics estimated instead of
+ *    measured. Doesn't touch fontconfig, so it starts much faster, but it
+ *    can only write .svg files.
+ */
+enum class render_backend {
+  cairo, svg
+};
+
+std::string renderBackendToString(const render_backend &backend);
+// returns false if name is not a backend
+bool renderBackendFromString(const std::string &name, render_backend &backend);
+
+// file formats diagrams can be written in, picked by file extension
+enum class image_format {
+  svg, png, pdf
+};
+
+// svg unless filename ends in ".png" or ".pdf" (in any case)
+image_format imageFormatFromFilename(const std::string &filename);
+
+/* ---- diagram canvas ----
+ * the drawing operations saturation diagrams are made of. Coordinates are in
+ * points with the origin at the top-left corner. Everything is drawn in
+ * black except fills, and a canvas writes its file when it is finished or
+ * destroyed.
+ */
+class diagram_canvas {
+  public:
+    virtual ~diagram_canvas() {}
+
+    /* ---- finish ----
+     * writes the file, or ends the page or frame the canvas draws. Prints an
+     * error and returns false if it could not be written. Nothing may be
+     * drawn afterwards. The destructor finishes canvases that weren't.
+     */
+    virtual bool finish() = 0;
+
+    /* ---- text ----
+     * draws text in a box of the given width with its top-left corner at
+     * x, y, wrapping lines as needed, and returns the height taken. If
+     * vertical is true the box is rotated to read bottom to top: width is
+     * then measured upwards from y + width and the horizontal distance taken
+     * is returned.
+     */
+    virtual double text(
+      double x,
+      double y,
+      double width,
+      const std::string &text,
+      font_role font,
+      text_alignment alignment = text_alignment::LEFT,
+      bool vertical = false) = 0;
+
+    // same as text, for text that is the same in every diagram (legend
+    // values, captions). Backends may lay it out once and reuse it.
+    virtual double label(
+      double x,
+      double y,
+      double width,
+      const std::string &text,
+      font_role font,
+      text_alignment alignment = text_alignment::LEFT,
+      bool vertical = false) = 0;
+
+    /* ---- component ----
+     * a labeled box. Same layout and return value as
+     * saturation_diagram::cairo_draw_component. If upper_fill_color is not
+     * NO_COLOR, the right half is filled with it.
+     */
+    virtual double component(
+      double x,
+      double y,
+      double width,
+      double height,
+      rgb_color fill_color,
+      const std::string &label,
+      font_role font,
+      label_position position = label_position::INSIDE,
+      double stroke_width = stroke_thickness_normal,
+      rgb_color upper_fill_color = NO_COLOR) = 0;
+
+    // a labeled arrow. Same layout as saturation_diagram::cairo_draw_arrow
+    virtual void arrow(
+      double x,
+      double y,
+      double width,
+      double height,
+      rgb_color fill_color,
+      direction arrow_direction,
+      const std::string &label,
+      font_role font,
+      double stroke_width = stroke_thickness_normal,
+      rgb_color upper_fill_color = NO_COLOR) = 0;
+
+    // equally wide boxes, one per color, from left to right
+    virtual void swatch(
+      double x,
+      double y,
+      double width,
+      double height,
+      const std::vector<rgb_color> &colors) = 0;
+
+    /* ---- line ----
+     * a line through points (x, y), for charts. Dashed lines alternate
+     * dash_length of line with dash_gap of nothing.
+     */
+    virtual void line(
+      const std::vector<std::pair<double, double>> &points,
+      rgb_color color,
+      double line_width,
+      bool dashed = false) = 0;
+
+    // a filled circle centered on x, y, for the points of charts
+    virtual void dot(
+      double x,
+      double y,
+      double radius,
+      rgb_color color) = 0;
+};
@@ -2,67 +2,898 @@
 //  - benchmark machine
 //  - create visualization from output data
 
+#include <algorithm>
 #include <boost/program_options.hpp>
+#include <chrono>
+#include <cstdio>
 #include <cstdlib>
 #include <ctime>
 #include <fstream>
 #include <immintrin.h>
+#include <iomanip>
 #include <iostream>
 #include <nlohmann/json.hpp>
 #include <omp.h>
 
 #include "types.hpp"
+#include "binary_results.hpp"
+#include "heatmap.hpp"
+#include "html_report.hpp"
 #include "performance_monitor_defines.hpp"
+#include "regression_check.hpp"
+#include "render_cache.hpp"
+#include "result_diff.hpp"
+#include "result_history.hpp"
+#include "result_merge.hpp"
+#include "result_stream.hpp"
+#include "result_summary.hpp"
+#include "render_context.hpp"
+#include "run_environment.hpp"
+#include "scaling_chart.hpp"
+#include "table_export.hpp"
+#include "terminal_diagram.hpp"
+#include "trend_chart.hpp"
 #include "saturation_diagram.hpp"
 #include "likwid.h"
+#include "utils.hpp"
 
 using namespace std;
 using json = nlohmann::json;
 namespace po = boost::program_options;
 
+/* ---- load perfmon json ----
+ * reads a json, binary results file or result stream output by fhv_perfmon
+ * into j. Diagrams only need the aggregates and load fhv::summary instead.
+ * Returns false if the file could not be read.
+ */
+bool load_perfmon_json(
+  std::string perfmon_output_filename,
+  json &j)
+{
+  return fhv::binary::loadResults(perfmon_output_filename, j);
+}
+
+/* ---- convert results ----
+ * writes a binary results file or result stream as json, or a json as a
+ * binary results file
+ */
+int convert_results(std::string input_filename, std::string output_filename)
+{
+  if (fhv::binary::isBinaryResults(input_filename)
+      || fhv::stream::isStream(input_filename))
+  {
+    json results;
+    if (!load_perfmon_json(input_filename, results)) return 1;
+
+    fhv::utils::create_directories_for_file(output_filename);
+    std::ofstream o(output_filename);
+    o << std::setw(4) << results << std::endl;
+    if (!o) {
+      std::cerr << "ERROR: could not write '" << output_filename << "'."
+        << std::endl;
+      return 1;
+    }
+  }
+  else
+  {
+    json results;
+    if (!load_perfmon_json(input_filename, results)) return 1;
+
+    fhv::binary::ResultsWriter writer;
+    size_t num_skipped;
+    fhv::binary::addJsonResults(writer, results, num_skipped);
+    if (num_skipped > 0)
+      std::cerr << "WARN: " << num_skipped << " sections of '"
+        << input_filename << "' are neither a thread nor an aggregation and "
+        << "were left out." << std::endl;
+
+    if (!writer.write(output_filename, results.value(json_info_section,
+        json::object())))
+      return 1;
+  }
+
+  std::cout << "Converted " << input_filename << " to " << output_filename
+    << std::endl;
+  return 0;
+}
+
+/* ---- export table ----
+ * writes every result of input_filenames as one tidy table (see
+ * fhv::table) to each of output_paths: a CSV file if it ends in '.csv',
+ * otherwise a directory of NumPy columns. Inputs may be results files,
+ * whose run id is their name without extension, or sweep indices written by
+ * '--sweep', which add every run they list.
+ */
+int export_table(
+  std::vector<std::string> input_filenames,
+  std::vector<std::string> output_paths)
+{
+  std::string csv_filename, columns_directory;
+  for (const auto &path : output_paths)
+  {
+    const std::string &extension = fhv::table::table_csv_extension;
+    bool csv = path.size() > extension.size() && path.compare(
+      path.size() - extension.size(), std::string::npos, extension) == 0;
+    std::string &target = csv ? csv_filename : columns_directory;
+    if (!target.empty()) {
+      std::cerr << "ERROR: '--table-output' takes at most one CSV file and "
+        << "one directory." << std::endl;
+      return 1;
+    }
+    target = path;
+  }
+
+  // runs as (run id, filename), with sweep indices expanded
+  std::vector<std::pair<std::string, std::string>> runs;
+  for (const auto &filename : input_filenames)
+  {
+    json index;
+    if (!fhv::binary::isBinaryResults(filename)
+        && !fhv::stream::isStream(filename)
+        && fhv::table::runIdOfFilename(filename) + ".json"
+          == fhv::sweep::sweep_index_filename)
+    {
+      if (!fhv::sweep::loadIndex(filename, index)) return 1;
+
+      size_t slash = filename.find_last_of('/');
+      std::string directory = slash == std::string::npos ? ""
+        : filename.substr(0, slash + 1);
+      for (const auto &run : index[fhv::sweep::sweep_runs_key])
+      {
+        std::string run_filename = run.value(fhv::sweep::sweep_file_key, "");
+        if (run_filename.empty()) continue;
+        runs.push_back({fhv::table::runIdOfFilename(run_filename),
+          directory + run_filename});
+      }
+      continue;
+    }
+
+    runs.push_back({fhv::table::runIdOfFilename(filename), filename});
+  }
+
+  fhv::table::TableWriter writer;
+  if (!writer.open(csv_filename, columns_directory)) return 1;
+
+  int rc = 0;
+  for (const auto &run : runs)
+  {
+    size_t num_skipped;
+    if (!writer.addResults(run.first, run.second, num_skipped)) {
+      rc = 1;
+      continue;
+    }
+    if (num_skipped > 0)
+      std::cerr << "WARN: " << num_skipped << " sections of '" << run.second
+        << "' are neither a thread nor an aggregation and were left out."
+        << std::endl;
+  }
+
+  if (!writer.finish()) return 1;
+
+  for (const auto &path : {csv_filename, columns_directory})
+    if (!path.empty())
+      fmt::print("Table of {} rows from {} runs saved to {}\n",
+        writer.numRows(), runs.size(), path);
+
+  return rc;
+}
+
+/* ---- region output filename ----
+ * inserts "_<region name>" before the extension of image_output_filename
+ */
+std::string region_output_filename(
+  std::string image_output_filename,
+  std::string region_name)
+{
+  std::size_t pos = 0;
+  while(image_output_filename.find('.', pos+1) != std::string::npos){
+    pos = image_output_filename.find('.', pos+1);
+  }
+  std::string ext = image_output_filename.substr(pos);
+  return image_output_filename.substr(0, pos) + "_" + region_name + ext;
+}
+
+/* ---- render job ----
+ * one file written by visualize. results and regions point into the
+ * summaries loaded by visualize, which are shared by every worker and only
+ * read while rendering.
+ */
+struct render_job {
+  const fhv::summary::ResultsSummary *results;
+  // a single region, or every region of the json for a multi-page PDF
+  std::vector<const fhv::summary::RegionSummary *> regions;
+  std::string output_filename;
+  double render_time_ms;
+  // see fhv::cache. Empty if the render cache is not used.
+  std::string cache_key;
+  // set once drawn. Outputs that could not be written are not cached
+  bool written;
+};
+
+/* ---- job cache key ----
+ * hash of everything a diagram of regions is drawn from, starting from the
+ * hash of the settings
+ */
+std::string job_cache_key(
+  uint64_t settings_hash,
+  const fhv::summary::ResultsSummary &results,
+  const std::vector<const fhv::summary::RegionSummary *> &regions)
+{
+  uint64_t hash = fhv::cache::hashString(results.info.dump(), settings_hash);
+
+  for (const auto *region : regions)
+  {
+    hash = fhv::cache::hashString(region->name, hash);
+    hash = fhv::cache::hashString(region->sections.dump(), hash);
+  }
+
+  return fhv::cache::hashToString(hash);
+}
+
 /* ---- visualize ----
  * high level function that loads data and creates diagrams for each region
+ * of each file. image_output_filenames[i] is the output filename for
+ * perfmon_output_filenames[i], before the region name is appended. Its
+ * extension picks the format: SVG, PNG (at dpi) or PDF. A PDF holds every
+ * region of a json, one page each, so no region name is appended.
+ *
+ * Files are independent, so they are drawn by num_jobs threads, each with
+ * its own render context. Returns 1 if any file could not be loaded,
+ * created or written.
+ *
+ * If render_cache_filename is not empty, diagrams recorded there as up to
+ * date are not drawn again, and jsons that haven't changed since are not
+ * even loaded. See fhv::cache.
+ */
+int visualize(
+  std::vector<std::string> perfmon_output_filenames,
+  std::vector<std::string> image_output_filenames,
+  std::string color_scale,
+  unsigned num_jobs,
+  render_backend backend,
+  double dpi,
+  std::string render_cache_filename)
+{
+  int rc = 0;
+  size_t num_diagrams = 0;
+
+  // sized up front: render jobs point into this vector. Only what the
+  // diagrams show is loaded, see fhv::summary
+  std::vector<fhv::summary::ResultsSummary> summaries(
+    perfmon_output_filenames.size());
+  std::vector<bool> loaded(perfmon_output_filenames.size(), false);
+  std::vector<render_job> jobs;
+
+  bool use_cache = !render_cache_filename.empty();
+  json cache_index;
+  uint64_t settings_hash = fhv::cache::hash_seed;
+  // hash of each input, and every output drawn from it
+  std::vector<std::string> input_hashes(perfmon_output_filenames.size());
+  std::vector<std::vector<std::string>> input_outputs(
+    perfmon_output_filenames.size());
+  size_t num_unchanged_files = 0;
+  size_t num_cached_diagrams = 0;
+
+  if (use_cache)
+  {
+    cache_index = fhv::cache::loadIndex(render_cache_filename);
+
+    // everything besides the data that changes how a diagram looks
+    settings_hash = fhv::cache::hashString(fmt::format("{}\n{}\n{}\n{:g}\n{}",
+      fhv::cache::renderer_version, color_scale,
+      renderBackendToString(backend), dpi,
+      fhv::config::loadMachineStats().architecture.num_ports_in_core));
+  }
+
+  // input each job was drawn from
+  std::vector<size_t> job_inputs;
+
+  // registers a diagram, unless the cache says it is up to date
+  auto add_job = [&](size_t input, render_job job) {
+    input_outputs[input].push_back(job.output_filename);
+    if (use_cache)
+    {
+      job.cache_key = job_cache_key(settings_hash, *job.results,
+        job.regions);
+      if (fhv::cache::outputUpToDate(cache_index, job.output_filename,
+          job.cache_key))
+      {
+        num_cached_diagrams += job.regions.size();
+        return;
+      }
+    }
+
+    num_diagrams += job.regions.size();
+    jobs.push_back(job);
+    job_inputs.push_back(input);
+  };
+
+  for (size_t i = 0; i < perfmon_output_filenames.size(); i++)
+  {
+    if (use_cache)
+    {
+      // the output filename is part of the hash, so moving the output
+      // draws everything again
+      uint64_t input_hash;
+      if (fhv::cache::hashFile(perfmon_output_filenames[i], input_hash,
+          fhv::cache::hashString(image_output_filenames[i], settings_hash)))
+      {
+        input_hashes[i] = fhv::cache::hashToString(input_hash);
+        if (fhv::cache::inputUpToDate(cache_index,
+            perfmon_output_filenames[i], input_hashes[i]))
+        {
+          num_unchanged_files++;
+          continue;
+        }
+      }
+    }
+
+    if (!fhv::summary::loadSummary(perfmon_output_filenames[i],
+        summaries[i])) {
+      std::cerr << "ERROR: The json specified for visualization could not be "
+        << "loaded!" << std::endl;
+      rc = 1;
+      continue;
+    }
+    loaded[i] = true;
+
+    if (imageFormatFromFilename(image_output_filenames[i])
+        == image_format::pdf)
+    {
+      render_job job = {
+        .results = &summaries[i],
+        .regions = {},
+        .output_filename = image_output_filenames[i],
+        .render_time_ms = 0.0,
+        .cache_key = "",
+        .written = false,
+      };
+      for (const auto &region : summaries[i].regions)
+        job.regions.push_back(&region);
+
+      if (!job.regions.empty()) add_job(i, job);
+      continue;
+    }
+
+    for (const auto &region : summaries[i].regions)
+    {
+      render_job job = {
+        .results = &summaries[i],
+        .regions = {&region},
+        .output_filename = region_output_filename(image_output_filenames[i],
+          region.name),
+        .render_time_ms = 0.0,
+        .cache_key = "",
+        .written = false,
+      };
+      add_job(i, job);
+    }
+  }
+
+  if (num_unchanged_files > 0 || num_cached_diagrams > 0)
+    fmt::print("Skipping {} unchanged files and {} more diagrams that are up "
+      "to date\n", num_unchanged_files, num_cached_diagrams);
+
+  if (jobs.empty())
+  {
+    if (use_cache)
+    {
+      for (size_t i = 0; i < perfmon_output_filenames.size(); i++)
+        if (!input_hashes[i].empty() && loaded[i])
+          fhv::cache::recordInput(cache_index, perfmon_output_filenames[i],
+            input_hashes[i], input_outputs[i]);
+      fhv::cache::saveIndex(render_cache_filename, cache_index);
+    }
+    return rc;
+  }
+
+  std::cout << "Creating " << num_diagrams << " visualizations with "
+    << num_jobs << (num_jobs == 1 ? " job" : " jobs") << std::endl;
+
+  auto start = std::chrono::steady_clock::now();
+
+  #pragma omp parallel num_threads(num_jobs)
+  {
+    // fonts, machine stats and static label layouts are set up once per
+    // worker and reused for every diagram it draws. Pango contexts can't be
+    // shared between threads, hence one context per worker.
+    render_context context(color_scale, backend);
+    context.dpi = dpi;
+
+    // regions differ a lot in how long they take (e.g. number of ports), so
+    // hand out one file at a time
+    #pragma omp for schedule(dynamic, 1)
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+      auto job_start = std::chrono::steady_clock::now();
+
+      // pages of a PDF have to be drawn in order, so one worker draws them
+      // all
+      bool document = imageFormatFromFilename(jobs[i].output_filename)
+        == image_format::pdf;
+      if (document && !context.begin_document(jobs[i].output_filename))
+      {
+        #pragma omp atomic write
+        rc = 1;
+        continue;
+      }
+
+      bool written = true;
+      for (const auto *region : jobs[i].regions)
+        written = saturation_diagram::draw_diagram_overview(context,
+          jobs[i].results->info, region->sections, region->name,
+          jobs[i].output_filename) && written;
+
+      if (document) written = context.end_document() && written;
+
+      std::chrono::duration<double, std::milli> render_time =
+        std::chrono::steady_clock::now() - job_start;
+      jobs[i].render_time_ms = render_time.count();
+      jobs[i].written = written;
+      if (!written)
+      {
+        #pragma omp atomic write
+        rc = 1;
+        continue;
+      }
+
+      // a single call so lines from different workers don't interleave
+      if (document)
+        fmt::print("Visualizations for {} regions saved to {} ({:.1f} ms)\n",
+          jobs[i].regions.size(), jobs[i].output_filename,
+          jobs[i].render_time_ms);
+      else
+        fmt::print("Visualization for region {} saved to {} ({:.1f} ms)\n",
+          jobs[i].regions[0]->name, jobs[i].output_filename,
+          jobs[i].render_time_ms);
+    }
+  }
+
+  std::chrono::duration<double, std::milli> total_time =
+    std::chrono::steady_clock::now() - start;
+
+  if (use_cache)
+  {
+    // inputs with an output that could not be written are drawn again next
+    // time
+    std::vector<bool> inputs_written(perfmon_output_filenames.size(), true);
+    for (size_t j = 0; j < jobs.size(); j++)
+    {
+      if (jobs[j].written)
+        fhv::cache::recordOutput(cache_index, jobs[j].output_filename,
+          jobs[j].cache_key);
+      else
+        inputs_written[job_inputs[j]] = false;
+    }
+    for (size_t i = 0; i < perfmon_output_filenames.size(); i++)
+      if (!input_hashes[i].empty() && loaded[i] && inputs_written[i])
+        fhv::cache::recordInput(cache_index, perfmon_output_filenames[i],
+          input_hashes[i], input_outputs[i]);
+
+    fhv::cache::saveIndex(render_cache_filename, cache_index);
+  }
+
+  if (jobs.size() > 1)
+  {
+    double sum_render_time_ms = 0.0;
+    for (const auto &job : jobs)
+      sum_render_time_ms += job.render_time_ms;
+
+    std::sort(jobs.begin(), jobs.end(),
+      [](const render_job &a, const render_job &b) {
+        return a.render_time_ms > b.render_time_ms;
+      });
+
+    fmt::print("Rendered {} diagrams in {:.1f} ms ({:.1f} ms of rendering, "
+      "{:.1f} ms per diagram on average)\n", num_diagrams, total_time.count(),
+      sum_render_time_ms, sum_render_time_ms / num_diagrams);
+    fmt::print("Slowest files:\n");
+    for (size_t i = 0; i < jobs.size() && i < 3; i++)
+      fmt::print("  {:>10.1f} ms  {}\n", jobs[i].render_time_ms,
+        jobs[i].output_filename);
+  }
+
+  return rc;
+}
+
+/* ---- diff ----
+ * compares two runs of the same program region by region. Prints a table of
+ * differences and creates a difference diagram for each region found in both
+ * files
+ */
+int diff(
+  std::string baseline_filename,
+  std::string candidate_filename,
+  std::string image_output_filename)
+{
+  json baseline, candidate;
+  if(!load_perfmon_json(baseline_filename, baseline)
+     || !load_perfmon_json(candidate_filename, candidate))
+    return 1;
+
+  int rc = 0;
+  auto region_names = fhv::diff::matchRegions(baseline, candidate);
+  auto differences = fhv::diff::compareResults(baseline, candidate,
+    region_names);
+  fhv::diff::printDifferenceTable(differences);
+
+  for (const auto &region_name : region_names)
+  {
+    std::cout << "Creating difference visualization for region "
+      << region_name << std::endl;
+
+    std::string this_image_output_filename =
+      region_output_filename(image_output_filename, region_name);
+
+    if (!saturation_diagram::draw_diagram_difference(baseline, candidate,
+        region_name, this_image_output_filename)) {
+      rc = 1;
+      continue;
+    }
+    std::cout << "Visualization saved to " << this_image_output_filename
+      << std::endl;
+  }
+
+  return rc;
+}
+
+/* ---- visualize terminal ----
+ * prints the diagram of every region of each file to stdout. Returns 1 if
+ * any file could not be loaded.
+ */
+int visualize_terminal(
+  std::vector<std::string> perfmon_output_filenames,
+  std::string color_scale,
+  terminal_colors colors)
+{
+  auto color_lut = saturation_diagram::color_scale_lut(color_scale);
+  if (color_lut == nullptr) {
+    std::cerr << "ERROR: unknown color scale '" << color_scale << "'."
+      << std::endl;
+    return 1;
+  }
+
+  // wide diagrams are hard to read, so don't use all of a wide terminal
+  unsigned width = std::min(terminal_diagram::terminal_width(), 100u);
+
+  int rc = 0;
+  for (const auto &filename : perfmon_output_filenames)
+  {
+    fhv::summary::ResultsSummary summary;
+    if (!fhv::summary::loadSummary(filename, summary)) {
+      rc = 1;
+      continue;
+    }
+
+    for (const auto &region : summary.regions)
+      std::cout << terminal_diagram::render(summary.info, region.sections,
+        region.name, *color_lut, colors, width) << std::endl;
+  }
+
+  return rc;
+}
+
+/* ---- animate ----
+ * draws frame_filenames, jsons output by fhv_perfmon in time order, as one
+ * animation per region of the first json. The extension of output_filename
+ * picks what is written for each region (named like with '--visualize'):
+ *  - .svg: an animated SVG
+ *  - .pdf: one page per frame
+ *  - .png: one image per frame, with the frame number appended
+ *
+ * Frames are streamed: each json is loaded, drawn into every region's
+ * animation and dropped before the next one is loaded. The layout and
+ * description come from the first json; a region missing from a frame is
+ * drawn white. If a frame can't be loaded, the animation stops and is saved
+ * with the frames before it. Returns 1 if a frame could not be loaded or a
+ * file created or written.
+ */
+int animate(
+  std::vector<std::string> frame_filenames,
+  std::string output_filename,
+  std::string color_scale,
+  double frame_duration,
+  double dpi)
+{
+  fhv::summary::ResultsSummary frame_data;
+  if (!fhv::summary::loadSummary(frame_filenames[0], frame_data)) return 1;
+
+  const json info = frame_data.info;
+  std::vector<std::string> region_names;
+  for (const auto &region : frame_data.regions)
+    region_names.push_back(region.name);
+  // later frames only load these
+  const std::set<std::string> region_name_set(region_names.begin(),
+    region_names.end());
+
+  if (region_names.empty()) {
+    std::cerr << "ERROR: '" << frame_filenames[0] << "' has no regions to "
+      << "animate." << std::endl;
+    return 1;
+  }
+
+  image_format format = imageFormatFromFilename(output_filename);
+
+  // every region's animation stays open while the frames stream through,
+  // so each needs its own context
+  std::vector<std::unique_ptr<render_context>> contexts;
+  std::vector<std::string> region_filenames;
+  for (const auto &region_name : region_names)
+  {
+    contexts.emplace_back(new render_context(color_scale,
+      render_backend::svg));
+    contexts.back()->dpi = dpi;
+    region_filenames.push_back(region_output_filename(output_filename,
+      region_name));
+    fhv::utils::create_directories_for_file(region_filenames.back());
+
+    bool opened = true;
+    if (format == image_format::svg)
+      opened = contexts.back()->begin_animation(region_filenames.back(),
+        frame_filenames, frame_duration);
+    else if (format == image_format::pdf)
+      opened = contexts.back()->begin_document(region_filenames.back());
+    if (!opened) {
+      // nothing was drawn into the files opened so far
+      contexts.pop_back();
+      for (size_t r = 0; r < contexts.size(); r++)
+      {
+        contexts[r]->end_animation();
+        contexts[r]->end_document();
+        std::remove(region_filenames[r].c_str());
+      }
+      return 1;
+    }
+  }
+
+  int rc = 0;
+  size_t num_frames = 0;
+  for (size_t i = 0; i < frame_filenames.size(); i++)
+  {
+    if (i > 0 && !fhv::summary::loadSummary(frame_filenames[i], frame_data,
+        region_name_set)) {
+      std::cerr << "ERROR: stopping the animation at frame " << i + 1
+        << "." << std::endl;
+      rc = 1;
+      break;
+    }
+
+    // only colors may change from frame to frame, so everything that ends
+    // up in the text is taken from the first frame
+    const json no_results = json::object();
+    for (size_t r = 0; r < region_names.size(); r++)
+    {
+      const auto *region = frame_data.region(region_names[r]);
+
+      std::string frame_output_filename = format == image_format::png
+        ? region_output_filename(region_filenames[r], fmt::format("{:04}", i))
+        : region_filenames[r];
+      if (!saturation_diagram::draw_diagram_overview(*contexts[r], info,
+          region != nullptr ? region->sections : no_results, region_names[r],
+          frame_output_filename))
+        rc = 1;
+    }
+    num_frames++;
+  }
+
+  for (size_t r = 0; r < region_names.size(); r++)
+  {
+    contexts[r]->end_animation();
+    if (!contexts[r]->end_document()) {
+      rc = 1;
+      continue;
+    }
+    fmt::print("Animation of {} frames for region {} saved to {}\n",
+      num_frames, region_names[r], region_filenames[r]);
+  }
+
+  return rc;
+}
+
+/* ---- draw heatmap ----
+ * draws the thread x region heatmap of metric for a json, or the thread x
+ * metric heatmap of region_name if it is not empty. Returns 1 if the json
+ * could not be loaded, has nothing to draw or the image could not be
+ * written.
  */
-void visualize(
+int draw_heatmap(
   std::string perfmon_output_filename,
-  std::string image_output_filename,
-  std::string color_scale)
+  std::string output_filename,
+  std::string metric,
+  std::string region_name,
+  std::string color_scale,
+  render_backend backend,
+  double dpi)
 {
-  // std::string image_output_filename = "perfmon_output.svg";
+  json fhv_data;
+  if (!load_perfmon_json(perfmon_output_filename, fhv_data)) return 1;
 
-  // read a JSON file
-  std::ifstream i(perfmon_output_filename);
-  if(!i){
-    std::cerr << "ERROR: The json specified for visualization does not exist!"
+  heatmap_data data = region_name.empty()
+    ? heatmap::region_heatmap(fhv_data, metric)
+    : heatmap::metric_heatmap(fhv_data, region_name);
+
+  if (data.row_labels.empty() || data.column_labels.empty()) {
+    if (region_name.empty())
+      std::cerr << "ERROR: no thread in '" << perfmon_output_filename
+        << "' measured '" << metric << "'." << std::endl;
+    else
+      std::cerr << "ERROR: region '" << region_name << "' of '"
+        << perfmon_output_filename << "' has no per-thread results."
+        << std::endl;
+    return 1;
+  }
+
+  render_context context(color_scale, backend);
+  context.dpi = dpi;
+  if (!heatmap::draw_heatmap(context, data, output_filename)) return 1;
+
+  fmt::print("Heatmap of {} rows and {} threads saved to {}\n",
+    data.row_labels.size(), data.column_labels.size(), output_filename);
+  return 0;
+}
+
+/* ---- merge ----
+ * combines repeated runs of the same program into one json with statistics
+ * for every aggregate metric
+ */
+int merge(
+  std::vector<std::string> perfmon_output_filenames,
+  std::string json_output_filename)
+{
+  std::vector<json> runs;
+  for (const auto &filename : perfmon_output_filenames)
+  {
+    json j;
+    if (!load_perfmon_json(filename, j)) return 1;
+    runs.push_back(j);
+  }
+
+  json merged = fhv::merge::mergeRuns(runs, perfmon_output_filenames);
+
+  fhv::utils::create_directories_for_file(json_output_filename);
+  std::ofstream o(json_output_filename);
+  o << std::setw(4) << merged << std::endl;
+  if (!o) {
+    std::cerr << "ERROR: could not write '" << json_output_filename << "'."
       << std::endl;
-    return;
+    return 1;
   }
-  json j;
-  i >> j;
 
-  std::string params = j[json_info_section][json_parameter_key];
+  std::cout << "Merged " << runs.size() << " runs into "
+    << json_output_filename << std::endl;
 
-  std::string region_name;
-  for(auto &saturation_item: j[json_results_section].items())
+  return 0;
+}
+
+/* ---- merge ranks ----
+ * combines the jsons written by every rank of one multi-process job into one
+ * json and creates a cluster diagram for each region
+ */
+int merge_ranks(
+  std::vector<std::string> perfmon_output_filenames,
+  std::string json_output_filename,
+  std::string image_output_filename,
+  std::string color_scale,
+  render_backend backend,
+  double dpi)
+{
+  std::vector<json> ranks;
+  for (const auto &filename : perfmon_output_filenames)
   {
-    region_name = saturation_item.key();
-    std::cout << "Creating visualization for region " << region_name 
+    json j;
+    if (!load_perfmon_json(filename, j)) return 1;
+    ranks.push_back(j);
+  }
+
+  json merged = fhv::merge::mergeRanks(ranks, perfmon_output_filenames);
+
+  fhv::utils::create_directories_for_file(json_output_filename);
+  std::ofstream o(json_output_filename);
+  o << std::setw(4) << merged << std::endl;
+  if (!o) {
+    std::cerr << "ERROR: could not write '" << json_output_filename << "'."
       << std::endl;
+    return 1;
+  }
 
-    std::size_t pos = 0;
-    while(image_output_filename.find('.', pos+1) != std::string::npos){
-      pos = image_output_filename.find('.', pos+1);
-    }
-    std::string ext = image_output_filename.substr(pos);
-    std::string this_image_output_filename = 
-      image_output_filename.substr(0, pos) + "_" + 
-      region_name + ext;
+  std::cout << "Merged " << ranks.size() << " ranks on "
+    << merged[json_info_section][json_num_nodes_key] << " nodes into "
+    << json_output_filename << std::endl;
+
+  render_context context(color_scale, backend);
+  context.dpi = dpi;
+
+  int rc = 0;
+  for (const auto &region : merged[json_results_section].items())
+  {
+    std::cout << "Creating cluster visualization for region "
+      << region.key() << std::endl;
 
-    saturation_diagram::draw_diagram_overview(j, color_scale, region_name,
-                                              this_image_output_filename);
-    std::cout << "Visualization saved to " << this_image_output_filename 
+    std::string this_image_output_filename =
+      region_output_filename(image_output_filename, region.key());
+
+    if (!saturation_diagram::draw_cluster_overview(context, merged,
+        region.key(), this_image_output_filename))
+    {
+      rc = 1;
+      continue;
+    }
+    std::cout << "Visualization saved to " << this_image_output_filename
       << std::endl;
   }
+
+  return rc;
+}
+
+/* ---- sweep ----
+ * runs a parameter sweep described by a configuration file, then draws
+ * scaling charts from the results
+ */
+int sweep(
+  std::string sweep_config_filename,
+  std::string image_output_prefix,
+  std::string color_scale,
+  render_backend backend,
+  double dpi)
+{
+  json index;
+  int rc = fhv::sweep::runSweep(sweep_config_filename, index);
+  if (rc == 2) return rc;
+
+  if (image_output_prefix == "") {
+    fhv::sweep::SweepConfig config;
+    fhv::sweep::loadSweepConfig(sweep_config_filename, config);
+    image_output_prefix = config.output_directory + "/scaling";
+  }
+
+  render_context context(color_scale, backend);
+  context.dpi = dpi;
+  if (!scaling_chart::draw_scaling_charts(context, index,
+      image_output_prefix))
+    return 2;
+
+  return rc;
+}
+
+/* ---- history ----
+ * prints the trend of every region and metric of a history matching the
+ * "key=glob" conditions in where, with their step changes, and draws a trend
+ * chart for each region and setup
+ */
+int history(
+  std::string history_directory,
+  std::vector<std::string> where,
+  double step_threshold,
+  std::string image_output_prefix,
+  std::string color_scale,
+  render_backend backend,
+  double dpi)
+{
+  fhv::history::HistoryQuery query = {
+    .where = {},
+    .default_metrics = fhv_saturation_metric_names,
+    .window = fhv::history::step_window_default,
+    .threshold = step_threshold,
+  };
+  if (!fhv::history::parseWhere(where, query)) return 2;
+
+  std::vector<fhv::history::HistoryRun> runs;
+  fhv::history::trend_series_t series;
+  if (!fhv::history::loadHistory(history_directory, query, runs, series))
+    return 2;
+
+  fhv::history::printTrends(runs, series);
+
+  if (image_output_prefix == "")
+    image_output_prefix = history_directory + "/history";
+
+  render_context context(color_scale, backend);
+  context.dpi = dpi;
+  if (!trend_chart::draw_trend_charts(context, runs, series,
+      image_output_prefix))
+    return 2;
+
+  return 0;
 }
 
 int main(int argc, char *argv[])
@@ -73,8 +904,37 @@ int main(int argc, char *argv[])
     43, 140, 190
   };
   std::string color_scale = "RdPu";
+  std::string renderer_name = renderBackendToString(render_backend::cairo);
+  double dpi = 96;
 
   std::vector<std::string> perfmon_output_filenames;
+  std::vector<std::string> diff_filenames;
+  std::vector<std::string> check_filenames;
+  std::vector<std::string> merge_filenames;
+  std::vector<std::string> merge_ranks_filenames;
+  std::vector<std::string> animate_filenames;
+  double frame_duration = 0.5;
+  std::string sweep_config_filename;
+  std::string report_filename;
+  std::string terminal_colors_name;
+  std::string render_cache_filename;
+  std::string convert_filename;
+  std::vector<std::string> export_table_filenames;
+  std::vector<std::string> table_output_paths;
+  std::string heatmap_filename;
+  std::string heatmap_metric = ram_bandwidth_metric_name;
+  std::string heatmap_region;
+  unsigned num_jobs = 1;
+  std::string sweep_index_filename;
+  std::vector<std::string> history_add_filenames;
+  std::vector<std::string> history_where;
+  std::string history_directory = fhv::history::history_default_directory;
+  std::string run_id;
+  std::string commit;
+  double step_threshold = fhv::history::step_threshold_default;
+  std::string json_output_filename = "perfmon_output_merged.json";
+  std::string thresholds_filename;
+  std::string baseline_filename;
   std::string image_output_filename;
 
 
@@ -91,11 +951,194 @@ int main(int argc, char *argv[])
         "json. More than one file may be supplied, in which case "
         "visualizations will be created for each. If more than one file is "
         "specified, the '--visualization-output' flag will be ignored.")
+    ("animate",
+      po::value<std::vector<std::string>>(&animate_filenames)->multitoken(),
+      "animate the saturation of each region over several jsons output by "
+      "fhv_perfmon, given in time order, e.g. snapshots of a long run. "
+      "Writes an animated SVG per region, or with '--visualization-output' "
+      "ending in '.pdf' one page per frame, or in '.png' one image per "
+      "frame. Defaults to the first json with '_animation.svg' appended. "
+      "Respects '--color-scale' and '--dpi'.")
+    ("frame-duration",
+      po::value<double>(&frame_duration),
+      "seconds each frame of '--animate' is shown. Defaults to 0.5.")
+    ("export-table",
+      po::value<std::vector<std::string>>(&export_table_filenames)->
+        multitoken(),
+      "flatten results files (json, binary or stream) or sweep indices into "
+      "one tidy table with a row per value: run_id, region, thread, group, "
+      "type, metric, aggregation, value. Written to '--table-output'.")
+    ("table-output",
+      po::value<std::vector<std::string>>(&table_output_paths)->multitoken(),
+      "where '--export-table' writes: a path ending in '.csv' for CSV, any "
+      "other path for a directory of typed NumPy (.npy) columns. Both may "
+      "be given. Defaults to 'results_table.csv'.")
+    ("diff,d",
+      po::value<std::vector<std::string>>(&diff_filenames)->multitoken(),
+      "compare two jsons output by fhv_perfmon. Arguments should be the "
+      "baseline json followed by the candidate json. Prints the per-metric "
+      "differences of every region found in both files, sorted by biggest "
+      "regression and improvement, and creates a diagram showing the change "
+      "in saturation for each region. Respects '--visualization-output'.")
+    ("check",
+      po::value<std::vector<std::string>>(&check_filenames)->multitoken(),
+      "check one or more jsons output by fhv_perfmon against the rules in "
+      "the file given by '--thresholds'. Prints a compact report and exits "
+      "with status 1 if any rule is violated, or 2 if a file could not be "
+      "read. Intended for use in CI.")
+    ("thresholds,t",
+      po::value<std::string>(&thresholds_filename),
+      "json file with the rules used by '--check'. See docs/usage.md for "
+      "the format.")
+    ("baseline,b",
+      po::value<std::string>(&baseline_filename),
+      "json output by fhv_perfmon used as the baseline for relative rules "
+      "in '--check'. Optional if every relative rule has its own baseline "
+      "value.")
+    ("merge,m",
+      po::value<std::vector<std::string>>(&merge_filenames)->multitoken(),
+      "combine repeated runs of the same program into one json. Every value "
+      "becomes the mean across runs, and each region gets a 'statistics' "
+      "section with the standard deviation and 95% confidence interval of "
+      "every aggregate metric. The result may be visualized like any other "
+      "json. Output is written to the path given by '--json-output'.")
+    ("merge-ranks",
+      po::value<std::vector<std::string>>(&merge_ranks_filenames)
+        ->multitoken(),
+      "combine the jsons written by each rank of one MPI (or other "
+      "multi-process) job into one json, written to the path given by "
+      "'--json-output'. Values are summed or averaged across ranks, each "
+      "region gets per-node saturation and the imbalance between ranks, and "
+      "a cluster diagram is created for each region. Respects "
+      "'--visualization-output', '--color-scale', '--renderer' and '--dpi'.")
+    ("sweep",
+      po::value<std::string>(&sweep_config_filename),
+      "run an instrumented program over a grid of sizes, thread counts and "
+      "affinity policies described by the given json file, collect every "
+      "result into one indexed dataset, and draw strong or weak scaling "
+      "charts. See docs/usage.md for the file format. Chart filenames start "
+      "with '--visualization-output' if given. Respects '--renderer'. Exits "
+      "with 1 if a run failed and 2 if the configuration could not be read "
+      "or a chart could not be written.")
+    ("scaling-charts",
+      po::value<std::string>(&sweep_index_filename),
+      "redraw the scaling charts of an earlier sweep from its "
+      "'sweep_index.json'. Chart filenames start with "
+      "'--visualization-output' if given. Respects '--renderer'.")
+    ("history-add",
+      po::value<std::vector<std::string>>(&history_add_filenames)->
+        multitoken(),
+      "add results files (json, binary or stream) to the history in "
+      "'--history-dir', keyed by run id, commit, host, cpu and parameters. "
+      "The history keeps a copy of each file and appends a summary of its "
+      "regions to an index, so results can be tracked across builds.")
+    ("history",
+      "print the trend of every region's saturation over the runs of the "
+      "history in '--history-dir', flag step changes, and draw a trend chart "
+      "for each region. Charts are written to '--visualization-output' if "
+      "given, otherwise into the history directory. Respects '--renderer'. "
+      "Exits with 2 if the history could not be read or a chart could not be "
+      "written.")
+    ("history-dir",
+      po::value<std::string>(&history_directory),
+      "directory of the history used by '--history-add' and '--history'. "
+      "Defaults to 'fhv_history'.")
+    ("history-where",
+      po::value<std::vector<std::string>>(&history_where)->multitoken(),
+      "only show the runs, regions and metrics of '--history' matching every "
+      "given 'key=glob', where key is one of id, commit, host, cpu, "
+      "parameters, region, metric or param.<name>, e.g. 'host=node*' "
+      "'metric=*bandwidth*' 'param.n=4000'. Without a metric condition, "
+      "the saturation is shown.")
+    ("step-threshold",
+      po::value<double>(&step_threshold),
+      "relative change of the median of a metric that '--history' flags as "
+      "a step change. Defaults to 0.1.")
+    ("run-id",
+      po::value<std::string>(&run_id),
+      "run id of the file added by '--history-add'. Defaults to the time "
+      "and the filename.")
+    ("commit",
+      po::value<std::string>(&commit),
+      "commit recorded by '--history-add'. Defaults to the commit the "
+      "results were built from, $FHV_COMMIT, or 'git rev-parse HEAD' in the "
+      "current directory.")
+    ("machine-conditions",
+      "print the governor, frequencies, turbo, SMT, huge pages, NUMA policy, "
+      "kernel and likwid version of this machine as a "
+      "'measurement_conditions' section for the machine stats. Run it along "
+      "with benchmark.sh; runs measured under other conditions are warned "
+      "about.")
+    ("report",
+      po::value<std::string>(&report_filename),
+      "create a self-contained HTML report from a json output by "
+      "fhv_perfmon: a sortable table of every region, diagrams and "
+      "per-thread results drawn when a region is clicked, and the hardware "
+      "the run was measured on. Written to '--visualization-output' if "
+      "given, otherwise next to the json with the extension '.html'. "
+      "Respects '--color-scale'.")
+    ("heatmap",
+      po::value<std::string>(&heatmap_filename),
+      "draw a heatmap of the per-thread results of a json output by "
+      "fhv_perfmon, with one column per hardware thread (taken from the "
+      "affinity) and one row per region. Written to "
+      "'--visualization-output' if given, otherwise next to the json with "
+      "'_heatmap.svg' appended. Respects '--color-scale', '--renderer' and "
+      "'--dpi'.")
+    ("heatmap-metric",
+      po::value<std::string>(&heatmap_metric),
+      "metric shown by '--heatmap'. Defaults to "
+      "'Memory bandwidth [MBytes/s]'.")
+    ("heatmap-region",
+      po::value<std::string>(&heatmap_region),
+      "make '--heatmap' show every metric of this region, one per row, "
+      "instead of one metric of every region.")
+    ("convert",
+      po::value<std::string>(&convert_filename),
+      "convert a binary results file written by fhv_perfmon (FHV_OUTPUT "
+      "ending in '.fhvb') or a result stream (FHV_STREAM) to json, or a "
+      "json to a binary results file. Written to '--json-output' if given, "
+      "otherwise next to the input with the other extension. Every other "
+      "option reads all of these formats.")
+    ("json-output,j",
+      po::value<std::string>(&json_output_filename),
+      "Path where json created by '--merge' or '--merge-ranks' should be "
+      "written. Defaults to 'perfmon_output_merged.json'.")
+    ("jobs",
+      po::value<unsigned>(&num_jobs),
+      "number of diagrams drawn in parallel by '--visualize'. 0 uses one "
+      "job per processor. Defaults to 1.")
     ("visualization-output,o", 
       po::value<std::string>(&image_output_filename), 
       "Path where visualization should be output to. Region name will "
       "automatically be appended. If not supplied, the input filename will "
-      "be used to generate a default filename.")
+      "be used to generate a default filename. The extension picks the "
+      "format: '.svg', '.png' or '.pdf'. A '.pdf' holds every region of a "
+      "json, one per page, and gets no region name appended.")
+    ("render-cache",
+      po::value<std::string>(&render_cache_filename)->implicit_value(
+        fhv::cache::render_cache_default_filename),
+      "only draw the diagrams of '--visualize' whose data, color scale or "
+      "renderer changed since they were last drawn, according to the index "
+      "at the given path (by default 'fhv_render_cache.json' in the current "
+      "directory). Jsons that haven't changed are not even loaded.")
+    ("dpi",
+      po::value<double>(&dpi),
+      "resolution of '.png' visualizations in pixels per inch. Defaults to "
+      "96.")
+    ("renderer",
+      po::value<std::string>(&renderer_name),
+      "what draws the diagrams and charts: 'cairo' (default) or 'svg'. "
+      "'svg' writes SVG text directly and skips initializing pango and "
+      "fontconfig, which starts much faster, but text sizes are estimated "
+      "rather than measured. fhv still links cairo and pango, and PNG and PDF "
+      "output is always drawn with cairo.")
+    ("term",
+      po::value<std::string>(&terminal_colors_name)->implicit_value("auto"),
+      "print the diagrams of '--visualize' to the terminal instead of "
+      "writing files, using Unicode boxes and ANSI colors. Optionally "
+      "followed by 'truecolor' or '256' to pick the colors; by default "
+      "truecolor is used if $COLORTERM says the terminal supports it.")
     ("color-scale,c",
       po::value<std::string>(&color_scale),
       "Specify the color scale to be used in the visualization. Must be one of "
@@ -148,6 +1191,20 @@ int main(int argc, char *argv[])
   {
     saturation_diagram::test_discrete_color_scale(1000, 100);
   }
+
+  // shared by everything that draws diagrams
+  render_backend backend;
+  if (!renderBackendFromString(renderer_name, backend)) {
+    std::cerr << "ERROR: unknown renderer '" << renderer_name
+      << "'. Must be 'cairo' or 'svg'." << std::endl;
+    return 1;
+  }
+
+  if (dpi <= 0) {
+    std::cerr << "ERROR: '--dpi' must be positive." << std::endl;
+    return 1;
+  }
+
   if (vm.count("visualize"))
   {
     // give default visualization output name if none provided
@@ -157,19 +1214,234 @@ int main(int argc, char *argv[])
         << "'--visualize'."
         << std::endl;
     }
-    else if (image_output_filename != "" && perfmon_output_filenames.size() == 1) {
-      visualize(perfmon_output_filenames[0], image_output_filename, 
-        color_scale);
-    }
     else {
-      for (auto filename : perfmon_output_filenames) {
-        image_output_filename = filename;
-        image_output_filename.erase(image_output_filename.length() - 5);
-        image_output_filename += ".svg";
+      std::vector<std::string> image_output_filenames;
+      if (image_output_filename != "" && perfmon_output_filenames.size() == 1) {
+        image_output_filenames.push_back(image_output_filename);
+      }
+      else {
+        for (auto filename : perfmon_output_filenames) {
+          filename.erase(filename.length() - 5);
+          image_output_filenames.push_back(filename + ".svg");
+        }
+      }
 
-        visualize(filename, image_output_filename, color_scale);
+      if (vm.count("term")) {
+        terminal_colors colors = terminal_diagram::detect_colors();
+        if (terminal_colors_name != "auto"
+            && !terminalColorsFromString(terminal_colors_name, colors)) {
+          std::cerr << "ERROR: unknown terminal colors '"
+            << terminal_colors_name << "'. Must be 'truecolor' or '256'."
+            << std::endl;
+          return 1;
+        }
+
+        return visualize_terminal(perfmon_output_filenames, color_scale,
+          colors);
       }
+
+      if (num_jobs == 0) num_jobs = omp_get_num_procs();
+
+      int rc = visualize(perfmon_output_filenames, image_output_filenames,
+        color_scale, num_jobs, backend, dpi,
+        vm.count("render-cache") ? render_cache_filename : "");
+      if (rc != 0) return rc;
+    }
+  }
+
+  if (vm.count("convert"))
+  {
+    bool to_json = fhv::binary::isBinaryResults(convert_filename)
+      || fhv::stream::isStream(convert_filename);
+    std::string convert_output_filename = json_output_filename;
+    if (!vm.count("json-output")) {
+      convert_output_filename = convert_filename;
+      auto dot = convert_output_filename.find_last_of('.');
+      if (dot != std::string::npos
+          && convert_output_filename.find('/', dot) == std::string::npos)
+        convert_output_filename.erase(dot);
+      convert_output_filename += to_json ? ".json"
+        : fhv::binary::binary_results_extension;
+    }
+
+    int rc = convert_results(convert_filename, convert_output_filename);
+    if (rc != 0) return rc;
+  }
+
+  if (vm.count("export-table"))
+  {
+    if (table_output_paths.empty())
+      table_output_paths.push_back("results_table.csv");
+
+    int rc = export_table(export_table_filenames, table_output_paths);
+    if (rc != 0) return rc;
+  }
+
+  if (vm.count("animate"))
+  {
+    if (frame_duration <= 0) {
+      std::cerr << "ERROR: '--frame-duration' must be positive." << std::endl;
+      return 1;
+    }
+
+    std::string animation_output_filename = image_output_filename;
+    if (animation_output_filename == "") {
+      animation_output_filename = animate_filenames[0];
+      if (animation_output_filename.size() > 5)
+        animation_output_filename.erase(
+          animation_output_filename.length() - 5);
+      animation_output_filename += "_animation.svg";
+    }
+
+    int rc = animate(animate_filenames, animation_output_filename,
+      color_scale, frame_duration, dpi);
+    if (rc != 0) return rc;
+  }
+
+  if (vm.count("report"))
+  {
+    std::string report_output_filename = image_output_filename;
+    if (report_output_filename == "") {
+      report_output_filename = report_filename;
+      if (report_output_filename.size() > 5)
+        report_output_filename.erase(report_output_filename.length() - 5);
+      report_output_filename += ".html";
+    }
+
+    int rc = fhv::report::writeReport(report_filename, report_output_filename,
+      color_scale);
+    if (rc != 0) return rc;
+  }
+
+  if (vm.count("heatmap"))
+  {
+    std::string heatmap_output_filename = image_output_filename;
+    if (heatmap_output_filename == "") {
+      heatmap_output_filename = heatmap_filename;
+      if (heatmap_output_filename.size() > 5)
+        heatmap_output_filename.erase(heatmap_output_filename.length() - 5);
+      heatmap_output_filename += "_heatmap.svg";
+    }
+
+    int rc = draw_heatmap(heatmap_filename, heatmap_output_filename,
+      heatmap_metric, heatmap_region, color_scale, backend, dpi);
+    if (rc != 0) return rc;
+  }
+
+  if (vm.count("merge"))
+  {
+    if (merge_filenames.size() < 2) {
+      std::cerr << "ERROR: '--merge' requires at least two jsons." 
+        << std::endl;
+      return 1;
+    }
+
+    int rc = merge(merge_filenames, json_output_filename);
+    if (rc != 0) return rc;
+  }
+
+  if (vm.count("merge-ranks"))
+  {
+    if (merge_ranks_filenames.empty()) {
+      std::cerr << "ERROR: '--merge-ranks' requires at least one json." 
+        << std::endl;
+      return 1;
+    }
+
+    std::string cluster_output_filename = image_output_filename;
+    if (cluster_output_filename == "") {
+      cluster_output_filename = json_output_filename;
+      if (cluster_output_filename.size() > 5)
+        cluster_output_filename.erase(cluster_output_filename.length() - 5);
+      cluster_output_filename += "_cluster.svg";
+    }
+
+    int rc = merge_ranks(merge_ranks_filenames, json_output_filename,
+      cluster_output_filename, color_scale, backend, dpi);
+    if (rc != 0) return rc;
+  }
+
+  if (vm.count("sweep"))
+  {
+    int rc = sweep(sweep_config_filename, image_output_filename,
+      color_scale, backend, dpi);
+    if (rc != 0) return rc;
+  }
+
+  if (vm.count("scaling-charts"))
+  {
+    json index;
+    if (!fhv::sweep::loadIndex(sweep_index_filename, index)) return 1;
+
+    std::string prefix = image_output_filename;
+    if (prefix == "") {
+      prefix = sweep_index_filename;
+      std::size_t pos = prefix.find_last_of('/');
+      prefix = (pos == std::string::npos ? "" : prefix.substr(0, pos + 1))
+        + "scaling";
+    }
+
+    render_context context(color_scale, backend);
+    context.dpi = dpi;
+    if (!scaling_chart::draw_scaling_charts(context, index, prefix)) return 1;
+  }
+
+  if (vm.count("history-add"))
+  {
+    if (run_id != "" && history_add_filenames.size() > 1) {
+      std::cerr << "ERROR: '--run-id' can only name one file added with "
+        << "'--history-add'." << std::endl;
+      return 2;
     }
+
+    for (const auto &filename : history_add_filenames)
+      if (!fhv::history::addRun(history_directory, filename, run_id, commit))
+        return 2;
+  }
+
+  if (vm.count("history"))
+  {
+    int rc = history(history_directory, history_where, step_threshold,
+      image_output_filename, color_scale, backend, dpi);
+    if (rc != 0) return rc;
+  }
+
+  if (vm.count("machine-conditions"))
+  {
+    json conditions;
+    conditions[fhv::config::machineStatsConditionsSection] =
+      fhv::environment::conditionsOf(fhv::environment::environmentJson(
+        fhv::environment::allowedCpus()));
+    std::cout << std::setw(2) << conditions << std::endl;
+  }
+
+  if (vm.count("check"))
+  {
+    if (thresholds_filename == "") {
+      std::cerr << "ERROR: '--check' requires a thresholds file. Please "
+        << "specify one with '--thresholds'." << std::endl;
+      return 2;
+    }
+
+    return fhv::check::checkFiles(check_filenames, thresholds_filename,
+      baseline_filename);
+  }
+
+  if (vm.count("diff"))
+  {
+    if (diff_filenames.size() != 2) {
+      std::cerr << "ERROR: '--diff' requires exactly two jsons: a baseline "
+        << "and a candidate." << std::endl;
+      return 1;
+    }
+
+    if (image_output_filename == "") {
+      image_output_filename = diff_filenames[1];
+      image_output_filename.erase(image_output_filename.length() - 5);
+      image_output_filename += "_diff.svg";
+    }
+
+    return diff(diff_filenames[0], diff_filenames[1], image_output_filename);
   }
 
   return 0;
@@ -9,6 +9,17 @@ fhv::types::per_thread_results_t
 
 int fhv_perfmon::num_threads = -1;
 
+std::thread fhv_perfmon::close_thread;
+bool fhv_perfmon::closed = false;
+
+fhv::config::MachineStats fhv_perfmon::machine_stats;
+std::vector<std::string> fhv_perfmon::collected_metrics;
+
+json fhv_perfmon::parameter_values = json::object();
+
+fhv::params::BuildInfo fhv_perfmon::build_info = {"", "", "", false, false,
+  false, "", 0};
+
 
 // ------ perfmon stuff ------ //
 
@@ -52,7 +63,12 @@ fhv_perfmon::registerRegions(
 }
 
 void fhv_perfmon::init(std::string parallel_regions, 
-  std::string sequential_regions)
+  std::string sequential_regions, const fhv::params::BuildInfo &build_info)
+{
+  init(parallel_regions, sequential_regions, "", "", build_info);
+}
+
+std::string fhv_perfmon::defaultEventGroups()
 {
   const std::string EVENT_GROUPS_DEFAULT =
     "FLOPS_DP|FLOPS_SP|L3|L2|PORT_USAGE1|PORT_USAGE2";
@@ -76,12 +92,21 @@ void fhv_perfmon::init(std::string parallel_regions,
       "hardware counters for memory (RAM). RAM will not be measured.\n");
   }
 
-  init(parallel_regions, sequential_regions, event_groups);
+  return event_groups;
 }
 
 void fhv_perfmon::init(std::string parallel_regions,
-                       std::string sequential_regions, std::string event_groups)
+                       std::string sequential_regions, std::string event_groups,
+                       std::string metrics,
+                       const fhv::params::BuildInfo &build_info)
 {
+  fhv_perfmon::build_info = build_info;
+  closed = false;
+
+  if (event_groups == "")
+    event_groups = defaultEventGroups();
+  collected_metrics = fhv::filter::splitPatterns(metrics);
+
   // initialize num_threads
   #pragma omp parallel
   {
@@ -140,16 +165,74 @@ void fhv_perfmon::init(std::string parallel_regions,
       registerRegions(parallel_regions, true);
     }
   }
+
+  if (std::getenv(perfmon_trace_envvar.c_str()) != nullptr)
+    fhv::trace::enable(fhv_perfmon::num_threads);
+
+  if (std::getenv(perfmon_stream_envvar.c_str()) != nullptr)
+    startStream();
+}
+
+void fhv_perfmon::startStream()
+{
+  // only parameters set before init() are known this early
+  json info;
+  setJsonParameterInfo(info, "");
+  setJsonCpuInfo(info, getAffinity());
+  setJsonJobInfo(info);
+
+  std::vector<std::string> group_names;
+  std::vector<std::vector<std::string>> group_event_names;
+  for (int group = 0; group < perfmon_getNumberOfGroups(); group++)
+  {
+    group_names.push_back(perfmon_getGroupName(group));
+    group_event_names.emplace_back();
+    for (int k = 0; k < perfmon_getNumberOfEvents(group); k++)
+      group_event_names.back().push_back(perfmon_getEventName(group, k));
+  }
+
+  fhv::stream::enable(
+    expandOutputFilename(std::getenv(perfmon_stream_envvar.c_str())),
+    fhv_perfmon::num_threads, info[json_info_section], group_names,
+    group_event_names);
 }
 
 void fhv_perfmon::startRegion(const char * tag)
 {
   likwid_markerStartRegion(tag);
+
+  // read after likwid is done so the trace only covers the measured code
+  if (fhv::trace::enabled())
+    fhv::trace::recordBegin(omp_get_thread_num(), tag, fhv::trace::readTsc());
 }
 
 void fhv_perfmon::stopRegion(const char * tag)
 {
+  bool tracing = fhv::trace::enabled();
+  bool streaming = fhv::stream::enabled();
+  if (!tracing && !streaming) {
+    likwid_markerStopRegion(tag);
+    return;
+  }
+
+  uint64_t tsc = fhv::trace::readTsc();
   likwid_markerStopRegion(tag);
+
+  // likwid only keeps totals per region and thread. The trace subtracts the
+  // totals at the previous end to get the counts of this instance
+  double totals[perfmon_trace_max_counters];
+  int num_totals = perfmon_trace_max_counters;
+  double time;
+  int count;
+  likwid_markerGetRegion(tag, &num_totals, totals, &time, &count);
+
+  int thread_num = omp_get_thread_num();
+  int group = perfmon_getIdOfActiveGroup();
+  if (tracing)
+    fhv::trace::recordEnd(thread_num, tag, tsc, group, totals, num_totals);
+  if (streaming)
+    fhv::stream::recordRegion(thread_num, tag, group, totals, num_totals,
+      time, count);
 }
 
 void fhv_perfmon::nextGroup(){
@@ -157,19 +240,112 @@ void fhv_perfmon::nextGroup(){
 #pragma omp single
   {
     likwid_markerNextGroup();
+    fhv::stream::recordGroupSwitch(omp_get_thread_num(),
+      perfmon_getIdOfActiveGroup());
   }
 }
 
 void fhv_perfmon::close(){
+  wait();
+  if (closed) return;
+  closed = true;
+
+  likwid_markerClose();
+
+  load_likwid_data();
+  processResults(traceContext());
+}
+
+void fhv_perfmon::closeAsync(bool write_results, std::string param_info_string)
+{
+  wait();
+  if (closed) {
+    fmt::print(stderr, "WARN: closeAsync: fhv_perfmon is already closed.\n");
+    return;
+  }
+  closed = true;
+
   likwid_markerClose();
 
+  // counters are read on this thread, like the cpu info and the trace
+  // context, which depend on likwid and on the affinity of this thread's
+  // OpenMP team
   load_likwid_data();
+  trace_context_t trace_context = traceContext();
+
+  json info;
+  if (write_results)
+  {
+    std::vector<int> affinity = getAffinity();
+    setJsonParameterInfo(info, param_info_string);
+    setJsonCpuInfo(info, affinity);
+    setJsonEnvironmentInfo(info, affinity);
+    setJsonJobInfo(info);
+  }
+
+  // a program that returns from main without calling wait() still gets its
+  // results, rather than being terminated by the thread's destructor
+  static bool registered_wait = false;
+  if (!registered_wait) {
+    std::atexit(wait);
+    registered_wait = true;
+  }
+
+  close_thread = std::thread([write_results, info, trace_context]() {
+    processResults(trace_context);
+    if (write_results) writeResults(info);
+  });
+}
+
+void fhv_perfmon::wait()
+{
+  if (close_thread.joinable()
+      && close_thread.get_id() != std::this_thread::get_id())
+    close_thread.join();
+}
+
+void fhv_perfmon::processResults(const trace_context_t &trace_context)
+{
   calculate_port_usage_ratios();
   std::sort(per_thread_results.begin(), per_thread_results.end());
 
   perform_result_aggregation();
   calculate_saturation(); 
   std::sort(aggregate_results.begin(), aggregate_results.end());
+
+  if (fhv::trace::enabled()) writeTrace(trace_context);
+  if (fhv::stream::enabled()) fhv::stream::finish(regionResultsJson());
+}
+
+fhv_perfmon::trace_context_t fhv_perfmon::traceContext()
+{
+  trace_context_t trace_context;
+  if (!fhv::trace::enabled()) return trace_context;
+
+  trace_context.affinity = getAffinity();
+  for (const auto &group : fhv::trace::recordedGroups())
+  {
+    trace_context.group_names[group] = perfmon_getGroupName(group);
+    for (int k = 0; k < perfmon_getNumberOfEvents(group); k++)
+      trace_context.group_event_names[group].push_back(
+        perfmon_getEventName(group, k));
+  }
+
+  return trace_context;
+}
+
+void fhv_perfmon::writeTrace(const trace_context_t &trace_context)
+{
+  std::string output_filename =
+    expandOutputFilename(std::getenv(perfmon_trace_envvar.c_str()));
+  int rank = getRank();
+
+  if (fhv::trace::writeChromeTrace(output_filename, trace_context.affinity,
+        trace_context.group_event_names, trace_context.group_names,
+        rank >= 0 ? rank : 0))
+    fmt::print("Region trace saved to {}\n", output_filename);
+
+  fhv::trace::disable();
 }
 
 void fhv_perfmon::validate_and_store_likwid_result(
@@ -254,6 +430,48 @@ void fhv_perfmon::load_likwid_data(){
   checkInit();
 
   perfmon_readMarkerFile(likwidOutputFilepath.c_str());
+  machine_stats = fhv::config::loadMachineStats();
+
+  // only what fhv needs, what init() was asked for and what will be written
+  // is collected. The binary format holds every result that isn't excluded
+  std::vector<std::string> metrics = fhv_default_collected_metrics;
+  metrics.insert(metrics.end(), collected_metrics.begin(),
+    collected_metrics.end());
+  fhv::filter::NameFilter collected(false, metrics, {});
+  fhv::filter::NameFilter exported = fhv::filter::NameFilter::fromEnvironment(
+    fhv::binary::isBinaryExtension(outputFilename()));
+
+  // which events and metrics of each group are collected, decided once per
+  // group instead of once per region, thread and result
+  struct collected_results {
+    std::vector<int> events;
+    std::vector<int> metrics;
+  };
+  std::map<int, collected_results> group_results;
+
+  int num_regions = perfmon_getNumberOfRegions();
+  std::vector<const char *> region_names(num_regions);
+  std::vector<int> region_gids(num_regions);
+  for (int i = 0; i < num_regions; i++)
+  {
+    region_names[i] = perfmon_getTagOfRegion(i);
+    region_gids[i] = perfmon_getGroupOfRegion(i);
+
+    int gid = region_gids[i];
+    if (group_results.count(gid)) continue;
+
+    collected_results &results = group_results[gid];
+    for (int k = 0; k < perfmon_getNumberOfEvents(gid); k++) {
+      std::string event_name = perfmon_getEventName(gid, k);
+      if (collected.accepts(event_name) || exported.accepts(event_name))
+        results.events.push_back(k);
+    }
+    for (int k = 0; k < perfmon_getNumberOfMetrics(gid); k++) {
+      std::string metric_name = perfmon_getMetricName(gid, k);
+      if (collected.accepts(metric_name) || exported.accepts(metric_name))
+        results.metrics.push_back(k);
+    }
+  }
 
   // populate maps
   for (int t = 0; t < num_threads; t++)
@@ -261,13 +479,17 @@ void fhv_perfmon::load_likwid_data(){
     // this loop is not actually regions, it's regions * groups. This is
     // because perfmon_getNumberOfRegions considers each region + group
     // combination as a "region"
-    for (int i = 0; i < perfmon_getNumberOfRegions(); i++)
+    for (int i = 0; i < num_regions; i++)
     {
-      const char * regionName = perfmon_getTagOfRegion(i);
-      int gid = perfmon_getGroupOfRegion(i);
+      const char * regionName = region_names[i];
+      int gid = region_gids[i];
       const char * groupName = perfmon_getGroupName(gid);
+      const collected_results &results = group_results[gid];
+
+      for (int k : results.events){
+        // regions only report the events they counted
+        if (k >= perfmon_getEventsOfRegion(i)) break;
 
-      for (int k = 0; k < perfmon_getEventsOfRegion(i); k++){
         const char * event_name = perfmon_getEventName(gid, k);
         double event_value = perfmon_getResultOfRegionThread(i, k, t);
 
@@ -276,7 +498,7 @@ void fhv_perfmon::load_likwid_data(){
                                          event_name, event_value);
       }
 
-      for (int k = 0; k < perfmon_getNumberOfMetrics(gid); k++){
+      for (int k : results.metrics){
         const char * metric_name = perfmon_getMetricName(gid, k);
         double metric_value = perfmon_getMetricOfRegionThread(i, k, t);
 
@@ -290,8 +512,10 @@ void fhv_perfmon::load_likwid_data(){
 
 void fhv_perfmon::perform_result_aggregation()
 {
+  // runs on the closeAsync thread, so the results are read directly: the
+  // getters wait() for that thread
   std::vector<fhv::types::PerThreadResult> ptr_copy(
-          fhv_perfmon::get_per_thread_results());
+          fhv_perfmon::per_thread_results);
   
   // a stack is used because we add things in ascending position. Therefore, if
   // we remove in descending position we will not offset anything that comes
@@ -361,8 +585,7 @@ void fhv_perfmon::calculate_port_usage_ratios()
 {
   checkInit();
   
-  auto machineStats = fhv::config::loadMachineStats();
-  if (machineStats.architecture.num_ports_in_core == 0) {
+  if (machine_stats.architecture.num_ports_in_core == 0) {
     std::cerr << "ERROR: calculate_port_usage_ratios: no machine stats "
       << "provided. Quitting." 
       << std::endl;
@@ -376,7 +599,7 @@ void fhv_perfmon::calculate_port_usage_ratios()
 
   // instead of using this vector, we could iterate through per_thread_results
   // again. The vector makes things easy, though
-  std::vector<double> uops_executed_port(machineStats.architecture.num_ports_in_core);
+  std::vector<double> uops_executed_port(machine_stats.architecture.num_ports_in_core);
   double total_num_port_ops;
 
   // Some architectures only have "UOPS_DISPATCHED_PORT_PORT_x", while others
@@ -404,7 +627,7 @@ void fhv_perfmon::calculate_port_usage_ratios()
       total_num_port_ops = 0;
 
       // first, sum all UOPS_DISPATCHED_PORT_PORT*
-      for (size_t port_num = 0; port_num < machineStats.architecture.num_ports_in_core; port_num++)
+      for (size_t port_num = 0; port_num < machine_stats.architecture.num_ports_in_core; port_num++)
       {
         for (const auto &ptr : fhv_perfmon::per_thread_results)
         {
@@ -420,7 +643,7 @@ void fhv_perfmon::calculate_port_usage_ratios()
       }
 
       // next, find ratios and create metrics for them
-      for (size_t port_num = 0; port_num < machineStats.architecture.num_ports_in_core; port_num++)
+      for (size_t port_num = 0; port_num < machine_stats.architecture.num_ports_in_core; port_num++)
       {
         fhv::types::PerThreadResult port_usage_metric = {
           .region_name = region_name,
@@ -446,10 +669,8 @@ void fhv_perfmon::calculate_saturation(){
   bool is_saturation_result;
   std::string saturation_result_name;
   double saturation_result_value;
-
-  // load experiential maximum from machineStats file:
-  auto machineStats = fhv::config::loadMachineStats();
-  if (machineStats.benchmarkResults.mflops_dp == 0.0) {
+  // experiential maxima from the machine stats loaded by load_likwid_data
+  if (machine_stats.benchmarkResults.mflops_dp == 0.0) {
     std::cerr << "ERROR: calculate_saturation: no machine stats provided. " 
       << "Aborting." << std::endl;
     return;
@@ -458,17 +679,17 @@ void fhv_perfmon::calculate_saturation(){
   // the order of items in this array must exactly match the order of names in
   // fhv_saturation_metric_names 
   const std::vector<double> fhv_saturation_reference_rates = {
-    machineStats.benchmarkResults.mflops_sp,
-    machineStats.benchmarkResults.mflops_dp,
-    machineStats.benchmarkResults.bw_rw_l2,
-    machineStats.benchmarkResults.bw_w_l2,
-    machineStats.benchmarkResults.bw_r_l2,
-    machineStats.benchmarkResults.bw_rw_l3,
-    machineStats.benchmarkResults.bw_w_l3,
-    machineStats.benchmarkResults.bw_r_l3,
-    machineStats.benchmarkResults.bw_rw_ram,
-    machineStats.benchmarkResults.bw_w_ram,
-    machineStats.benchmarkResults.bw_r_ram,
+    machine_stats.benchmarkResults.mflops_sp,
+    machine_stats.benchmarkResults.mflops_dp,
+    machine_stats.benchmarkResults.bw_rw_l2,
+    machine_stats.benchmarkResults.bw_w_l2,
+    machine_stats.benchmarkResults.bw_r_l2,
+    machine_stats.benchmarkResults.bw_rw_l3,
+    machine_stats.benchmarkResults.bw_w_l3,
+    machine_stats.benchmarkResults.bw_r_l3,
+    machine_stats.benchmarkResults.bw_rw_ram,
+    machine_stats.benchmarkResults.bw_w_ram,
+    machine_stats.benchmarkResults.bw_r_ram,
   };
 
   for (const auto & ar : fhv_perfmon::aggregate_results)
@@ -527,6 +748,8 @@ void fhv_perfmon::checkInit()
 }
 
 void fhv_perfmon::checkResults(){
+  wait();
+
   std::string error_str = "WARNING: there doesn't seem to be any results for "
     "likwid. This commonly \n"
     "happens because fhv_perfmon::close() was not called.\n";
@@ -611,7 +834,7 @@ void fhv_perfmon::printHighlights(){
   }
 }
 
-void fhv_perfmon::setJsonCpuInfo(json &j){
+void fhv_perfmon::setJsonCpuInfo(json &j, const std::vector<int> &affinity){
   topology_init();
   CpuInfo_t cpu_info = get_cpuInfo();
   CpuTopology_t cpu_topology = get_cpuTopology();
@@ -620,15 +843,7 @@ void fhv_perfmon::setJsonCpuInfo(json &j){
   int num_numa_nodes = likwid_getNumberOfNodes();
   numa_finalize();
 
-  int num_threads;
-
-#pragma omp parallel
-    num_threads = omp_get_num_threads();
-
-  std::vector<unsigned> affinity(num_threads);
-
-#pragma omp parallel
-    affinity[omp_get_thread_num()] = sched_getcpu();
+  int num_threads = affinity.size();
 
   std::string affinity_str = "";
   for(size_t i = 0; i < affinity.size(); i++) {
@@ -656,52 +871,212 @@ void fhv_perfmon::setJsonCpuInfo(json &j){
   topology_finalize();
 }
 
-void fhv_perfmon::resultsToJson(std::string param_info_string)
+int fhv_perfmon::getRank()
 {
-  checkInit();
-  checkResults();
-  
-  json results;
-  
-  // set parameter info string
-  results[json_info_section][json_parameter_key] = param_info_string;
+  for (const auto &envvar : perfmon_rank_envvars)
+  {
+    if (const char* env_p = std::getenv(envvar.c_str()))
+    {
+      try {
+        return std::stoi(env_p);
+      }
+      catch (std::logic_error &e) {
+        std::cerr << "WARN: could not read a rank from " << envvar << "=\""
+          << env_p << "\"." << std::endl;
+      }
+    }
+  }
 
-  // set system info
-  setJsonCpuInfo(results);
+  return -1;
+}
+
+void fhv_perfmon::setJsonEnvironmentInfo(json &j,
+  const std::vector<int> &affinity)
+{
+  json environment = fhv::environment::environmentJson(affinity);
+
+  std::vector<std::string> mismatches = fhv::environment::findMismatches(
+    environment, machine_stats.measurementConditions);
+  for (const auto &mismatch : mismatches)
+    fmt::print(stderr, "WARN: {}. Saturation may not be comparable.\n",
+      mismatch);
+  if (!mismatches.empty())
+    environment[json_environment_mismatches_key] = mismatches;
+
+  j[json_info_section][json_environment_section] = environment;
+}
+
+std::string fhv_perfmon::getHostname()
+{
+  char hostname[256];
+  if (gethostname(hostname, sizeof(hostname)) != 0)
+    return "unknown";
+
+  // gethostname does not guarantee termination if the name was truncated
+  hostname[sizeof(hostname) - 1] = '\0';
+  return hostname;
+}
+
+void fhv_perfmon::setJsonJobInfo(json &j){
+  j[json_info_section][json_hostname_key] = getHostname();
+
+  int rank = getRank();
+  if (rank >= 0)
+    j[json_info_section][json_rank_key] = rank;
+}
+
+std::vector<int> fhv_perfmon::getAffinity()
+{
+  int num_threads;
+
+#pragma omp parallel
+    num_threads = omp_get_num_threads();
+
+  std::vector<int> affinity(num_threads);
+
+#pragma omp parallel
+    affinity[omp_get_thread_num()] = sched_getcpu();
+
+  return affinity;
+}
+
+void fhv_perfmon::clearParameters()
+{
+  parameter_values = json::object();
+}
+
+void fhv_perfmon::setJsonParameterInfo(json &j, std::string param_info_string)
+{
+  if (param_info_string == "")
+    param_info_string = fhv::params::parametersToString(parameter_values);
+
+  json &info = j[json_info_section];
+  info[json_parameter_key] = param_info_string;
+  info[json_parameter_values_key] = parameter_values;
+  info[json_build_section] = fhv::params::buildJson(build_info);
+  info[json_openmp_section] = fhv::params::openmpJson();
+}
+
+std::string fhv_perfmon::outputFilename()
+{
+  std::string output_filename = jsonResultOutputDefaultFilepath;
+  if(const char* env_p = std::getenv(perfmon_output_envvar.c_str()))
+    output_filename = env_p;
+
+  return expandOutputFilename(output_filename);
+}
+
+std::string fhv_perfmon::expandOutputFilename(std::string filename)
+{
+  // a process started without MPI is the only rank of its job, like the
+  // trace assumes
+  int rank = getRank();
+  if (rank < 0) rank = 0;
+
+  size_t placeholder_pos;
+  while ((placeholder_pos = filename.find(
+            perfmon_output_rank_placeholder)) != std::string::npos)
+    filename.replace(placeholder_pos,
+      perfmon_output_rank_placeholder.size(), std::to_string(rank));
+  while ((placeholder_pos = filename.find(
+            perfmon_output_hostname_placeholder)) != std::string::npos)
+    filename.replace(placeholder_pos,
+      perfmon_output_hostname_placeholder.size(), getHostname());
+
+  return filename;
+}
+
+json fhv_perfmon::regionResultsJson()
+{
+  fhv::filter::NameFilter filter = fhv::filter::NameFilter::fromEnvironment();
+  json region_results = json::object();
+
+  // results are sorted by region and thread or aggregation, so the section
+  // is only looked up again when it changes
+  json *section = nullptr;
+  const fhv::types::PerThreadResult *section_ptr = nullptr;
 
   // populate json with per_thread_results
   for (const auto & ptr : fhv_perfmon::per_thread_results)
   {
-    for (const auto &key_metric : fhv_key_metrics)
+    if (!filter.accepts(ptr.result_name)) continue;
+
+    if (section_ptr == nullptr || ptr.thread_num != section_ptr->thread_num
+        || ptr.region_name != section_ptr->region_name)
     {
-      if(ptr.result_name == key_metric)
-      {
-        results[json_results_section][ptr.region_name]
-          [json_thread_section_base + std::to_string(ptr.thread_num)]
-          [ptr.result_name] = ptr.result_value;
-      }
+      section = &region_results[ptr.region_name]
+        [json_thread_section_base + std::to_string(ptr.thread_num)];
+      section_ptr = &ptr;
     }
+    fhv::filter::setJsonResult(*section, ptr.group_name, ptr.result_name,
+      ptr.result_value);
   }
 
+  section = nullptr;
+  const fhv::types::AggregateResult *section_ar = nullptr;
+
   // populate json with aggregate results
   for (const auto & ar : fhv_perfmon::aggregate_results)
   {
-    for (const auto &key_metric : fhv_key_metrics)
+    if (!filter.accepts(ar.result_name)) continue;
+
+    if (section_ar == nullptr
+        || ar.aggregation_type != section_ar->aggregation_type
+        || ar.region_name != section_ar->region_name)
     {
-      if(ar.result_name == key_metric)
-      {
-        results[json_results_section][ar.region_name]
-          [aggregationTypeToString(ar.aggregation_type)]
-          [ar.result_name] = ar.result_value;
-      }
+      section = &region_results[ar.region_name]
+        [aggregationTypeToString(ar.aggregation_type)];
+      section_ar = &ar;
     }
+    fhv::filter::setJsonResult(*section, ar.group_name, ar.result_name,
+      ar.result_value);
   }
 
-  // write json to disk
-  std::string output_filename = jsonResultOutputDefaultFilepath;
-  if(const char* env_p = std::getenv(perfmon_output_envvar.c_str()))
-    output_filename = env_p;
+  return region_results;
+}
 
+void fhv_perfmon::resultsToJson(std::string param_info_string)
+{
+  checkInit();
+  checkResults();
+  
+  json results;
+  
+  // set parameter info string, typed parameters and build
+  setJsonParameterInfo(results, param_info_string);
+
+  // set system info
+  std::vector<int> affinity = getAffinity();
+  setJsonCpuInfo(results, affinity);
+  setJsonEnvironmentInfo(results, affinity);
+  setJsonJobInfo(results);
+
+  writeResults(results);
+}
+
+void fhv_perfmon::writeResults(json results)
+{
+  std::string output_filename = outputFilename();
+
+  // the binary format holds every result that isn't excluded, not just the
+  // key metrics
+  if (fhv::binary::isBinaryExtension(output_filename))
+  {
+    fhv::filter::NameFilter filter =
+      fhv::filter::NameFilter::fromEnvironment(true);
+    fhv::binary::ResultsWriter writer;
+    for (const auto &ptr : fhv_perfmon::per_thread_results)
+      if (filter.accepts(ptr.result_name)) writer.addPerThreadResult(ptr);
+    for (const auto &ar : fhv_perfmon::aggregate_results)
+      if (filter.accepts(ar.result_name)) writer.addAggregateResult(ar);
+
+    writer.write(output_filename, results[json_info_section]);
+    return;
+  }
+
+  results[json_results_section] = regionResultsJson();
+
+  // write json to disk
   fhv::utils::create_directories_for_file(output_filename);
 
   std::ofstream o(output_filename);
@@ -711,11 +1086,13 @@ void fhv_perfmon::resultsToJson(std::string param_info_string)
 const fhv::types::aggregate_results_t&
 fhv_perfmon::get_aggregate_results()
 {
+  wait();
 	return aggregate_results;
 }
 
 const fhv::types::per_thread_results_t&
 fhv_perfmon::get_per_thread_results()
 {
+  wait();
   return per_thread_results;
 }
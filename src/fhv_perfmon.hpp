@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdlib>
 #include <fmt/core.h>
 #include <fstream>
 #include <iomanip>
@@ -10,14 +11,22 @@
 #include <nlohmann/json.hpp>
 #include <omp.h>
 #include <sched.h>
+#include <unistd.h>
 #include <set>
 #include <sstream>
 #include <stack>
 #include <string>
+#include <thread>
 
+#include "binary_results.hpp"
 #include "config.hpp"
 #include "likwid_defines.hpp"
 #include "performance_monitor_defines.hpp"
+#include "region_trace.hpp"
+#include "result_filter.hpp"
+#include "result_stream.hpp"
+#include "run_environment.hpp"
+#include "run_parameters.hpp"
 #include "types.hpp"
 #include "utils.hpp"
 
@@ -42,15 +51,27 @@ class fhv_perfmon {
     //   - parallel_regions are regions that will be executed in a parallel block
     //   - sequential_regions are regions that will be executed in sequential
     //      code 
+    //   - an empty event_groups chooses the default groups
+    //   - metrics should be of the format "CPI,Clock*,...": names or globs of
+    //      the events and metrics to collect besides what fhv needs (the key
+    //      metrics and port counters). Nothing else is read from likwid, which
+    //      keeps close() fast and small. Results written by resultsToJson()
+    //      (FHV_EXPORT, FHV_INCLUDE, binary output) are always collected
+    //
+    //   - build_info should be left alone. It records how the calling program
+    //      was built, see fhv::params
     //
     // OMP_NUM_THREADS is respected. Currently, threads will be assigned
     // sequentially from the first.
     // 
     static void init(std::string parallel_regions,
       std::string sequential_regions,
-      std::string event_groups);
+      std::string event_groups,
+      std::string metrics = "",
+      const fhv::params::BuildInfo &build_info = FHV_BUILD_INFO);
     static void init(std::string parallel_regions = "",
-        std::string sequential_regions = "");
+        std::string sequential_regions = "",
+        const fhv::params::BuildInfo &build_info = FHV_BUILD_INFO);
 
     // if parallel is true, will register regions in a parallel block
     static void registerRegions(const std::string regions, bool parallel);
@@ -58,8 +79,27 @@ class fhv_perfmon {
     static void startRegion(const char * tag);
     static void stopRegion(const char * tag);
     static void nextGroup();
+
+    // waits for closeAsync() if it was called, in which case there is
+    // nothing left to close
     static void close();
 
+    // closeAsync()
+    //  - like close() followed by resultsToJson(param_info_string) if
+    //    write_results is true, but only likwid_markerClose(), reading the
+    //    counters and gathering the cpu info happen on the calling thread.
+    //    Port usage ratios, aggregation, saturation, the trace, the stream
+    //    and the output are done by a background thread, so the program can
+    //    free its resources or carry on in the meantime
+    //  - call wait() before exiting. It is also called by everything that
+    //    reads results (print*, resultsToJson, get_*) and when the program
+    //    exits, so the results are never lost or read half done
+    static void closeAsync(bool write_results = true,
+      std::string param_info_string = "");
+
+    // waits for the background thread started by closeAsync(), if any
+    static void wait();
+
     // print everything per core
     static void printDetailedResults();
 
@@ -73,20 +113,64 @@ class fhv_perfmon {
     // static void printCsvHeader();
     // static void printCsvOutput();
 
-    static void setJsonCpuInfo(json &j);
+    // affinity is what getAffinity() returns, passed in so callers that
+    // also set the environment info only read it once
+    static void setJsonCpuInfo(json &j, const std::vector<int> &affinity);
+
+    // records the frequencies, governor, turbo and the rest of
+    // fhv::environment for the hardware threads in affinity, and warns about
+    // differences to the conditions the machine stats were measured under.
+    // The machine stats are the ones loaded by close()
+    static void setJsonEnvironmentInfo(json &j,
+      const std::vector<int> &affinity);
+
+    // hardware thread each OpenMP thread runs on, indexed by thread number
+    static std::vector<int> getAffinity();
+
+    // records the hostname and, if it can be found in the environment, the
+    // rank of this process. Used to merge results of multi-process jobs.
+    static void setJsonJobInfo(json &j);
+
+    // rank of this process as reported by the environment variables in
+    // perfmon_rank_envvars, or -1 if none are set
+    static int getRank();
+    static std::string getHostname();
 
     // resultsToJson
     //  - gets file name from environment variable FHV_OUTPUT. If unset, will
-    //    use a default name
+    //    use a default name. "%r" and "%h" in FHV_OUTPUT are replaced by the
+    //    rank and hostname of this process. Outside of MPI the rank is 0
     //  - param_info_string is entirely arbitrary and left to the user. The
     //    intention is to use it to track parameters used to generate a
     //    visualization. For example, when metering convolution, the user may
     //    set the string to be "n=4000, m=6000, k=7". The visualization will
     //    preface this with the string "Parameters used to generate:"
+    //  - only the key metrics are written, unless FHV_EXPORT=all. FHV_INCLUDE
+    //    and FHV_EXCLUDE add or leave out results by name, see fhv::filter
+    //  - if the file name ends in ".fhvb", every result is written in the
+    //    binary format of fhv::binary instead, which is much smaller and
+    //    faster to write and read for large runs. FHV_EXCLUDE still applies
 
     static void resultsToJson(std::string param_info_string = "");
 
+    // setParameter()
+    //  - records a typed parameter of the run, e.g. setParameter("n", 4000)
+    //    or setParameter("kernel", "gauss"). Numbers, strings and bools are
+    //    written as they are to the "parameter_values" of the info section,
+    //    so tools don't have to parse them out of param_info_string
+    //  - if resultsToJson() gets no param_info_string, one is made from the
+    //    parameters in name order, like "kernel=gauss, n=4000"
+    //  - parameters are kept until clearParameters(). Call both from
+    //    sequential code
+    template<typename T>
+    static void setParameter(const std::string &name, const T &value)
+    {
+      parameter_values[name] = value;
+    }
+    static void clearParameters();
+
     // ------ getters ----- //
+    // for callers outside fhv_perfmon: they wait() for closeAsync first
 
     const static fhv::types::aggregate_results_t& get_aggregate_results();
     const static fhv::types::per_thread_results_t& get_per_thread_results();
@@ -106,7 +190,51 @@ class fhv_perfmon {
     static void checkInit();
     static void checkResults();
 
-    // used to load likwid data
+    // what writeTrace() needs from likwid and from the OpenMP team that
+    // measured. closeAsync() writes the trace on another thread, so it is
+    // gathered before
+    struct trace_context_t {
+      std::vector<int> affinity;
+      std::map<int, std::string> group_names;
+      std::map<int, std::vector<std::string>> group_event_names;
+    };
+
+    // empty if FHV_TRACE isn't set. Must be called after load_likwid_data(),
+    // on the thread that called init()
+    static trace_context_t traceContext();
+
+    // everything close() does after load_likwid_data()
+    static void processResults(const trace_context_t &trace_context);
+
+    // writes results, which already holds the info section, and the
+    // results to the file named by FHV_OUTPUT
+    static void writeResults(json results);
+
+    // the groups fhv needs, with MEM on architectures that support it
+    static std::string defaultEventGroups();
+
+    // the expanded FHV_OUTPUT, or the default output filename
+    static std::string outputFilename();
+
+    // sets the parameter string, the typed parameters, the build and the
+    // OpenMP settings in the info section
+    static void setJsonParameterInfo(json &j, std::string param_info_string);
+
+    // replaces the rank and hostname placeholders in an output filename. The
+    // rank of a process without one (see getRank) is 0.
+    static std::string expandOutputFilename(std::string filename);
+
+    // starts streaming results to the file named by FHV_STREAM. Must be
+    // called after likwid_markerInit(), which sets up the groups
+    static void startStream();
+
+    // the "region_results" section written by resultsToJson
+    static json regionResultsJson();
+
+    // writes the region timeline to the file named by FHV_TRACE
+    static void writeTrace(const trace_context_t &trace_context);
+
+    // used to load likwid data. Also loads machine_stats
     static void load_likwid_data();
 
     // used to aggregate results. Depends on "load_likwid_data" being called
@@ -132,6 +260,22 @@ class fhv_perfmon {
     // --- important numbers
     static int num_threads;
 
+    // runs processResults() after closeAsync()
+    static std::thread close_thread;
+    // set by close() and closeAsync(), so likwid is only closed once
+    static bool closed;
+
+    // loaded once by load_likwid_data() for saturation, port usage and the
+    // environment info
+    static fhv::config::MachineStats machine_stats;
+
+    // metrics passed to init(), collected besides the defaults
+    static std::vector<std::string> collected_metrics;
+
+    // set by setParameter() and init()
+    static json parameter_values;
+    static fhv::params::BuildInfo build_info;
+
     static fhv::types::aggregate_results_t  aggregate_results;
 
     static fhv::types::per_thread_results_t per_thread_results;
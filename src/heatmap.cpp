@@ -0,0 +1,279 @@
+#include "heatmap.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fmt/core.h>
+#include <set>
+#include <sstream>
+#include <tuple>
+
+// ===== data =====
+std::vector<int> heatmap::hardware_thread_ids(const json &fhv_data)
+{
+  std::vector<int> ids;
+  if (!fhv_data.contains(json_info_section)
+      || !fhv_data[json_info_section].contains(json_processor_section))
+    return ids;
+
+  std::string affinity = fhv_data[json_info_section][json_processor_section]
+    .value(json_processor_affinity_key, "");
+
+  std::stringstream affinity_stream(affinity);
+  std::string id;
+  try {
+    while (std::getline(affinity_stream, id, ','))
+      ids.push_back(std::stoi(id));
+  }
+  catch (std::exception &e) {
+    return {};
+  }
+
+  return ids;
+}
+
+std::vector<std::pair<int, std::string>> heatmap::thread_columns(
+  const json &fhv_data,
+  const std::vector<std::string> &region_names)
+{
+  std::set<int> thread_nums;
+  for (const auto &region_name : region_names)
+  {
+    for (const auto &section :
+        fhv_data[json_results_section][region_name].items())
+    {
+      if (section.key().compare(0, json_thread_section_base.size(),
+          json_thread_section_base) != 0)
+        continue;
+
+      try {
+        thread_nums.insert(std::stoi(
+          section.key().substr(json_thread_section_base.size())));
+      }
+      catch (std::exception &e) {
+        continue;
+      }
+    }
+  }
+
+  // threads without a known hardware thread go last, in thread order
+  auto ids = hardware_thread_ids(fhv_data);
+  std::vector<std::tuple<bool, int, int>> order;
+  for (const auto &thread_num : thread_nums)
+  {
+    bool known = thread_num >= 0
+      && static_cast<size_t>(thread_num) < ids.size();
+    order.push_back(std::make_tuple(!known, known ? ids[thread_num] : 0,
+      thread_num));
+  }
+  std::sort(order.begin(), order.end());
+
+  std::vector<std::pair<int, std::string>> columns;
+  for (const auto &column : order)
+  {
+    columns.push_back({std::get<2>(column), std::get<0>(column)
+      ? fmt::format("t{}", std::get<2>(column))
+      : std::to_string(std::get<1>(column))});
+  }
+
+  return columns;
+}
+
+// short processor summary for the description of a heatmap
+static std::string describe_threads(const json &fhv_data)
+{
+  if (!fhv_data.contains(json_info_section)
+      || !fhv_data[json_info_section].contains(json_processor_section))
+    return "Columns are threads.";
+
+  const json &processor = fhv_data[json_info_section][json_processor_section];
+  return fmt::format("Columns are hardware threads of {} ({} sockets, {} NUMA "
+    "nodes, {} hardware threads), in order of their id.",
+    processor.value(json_processor_name_key, "unknown processor"),
+    processor.value(json_processor_num_sockets_key, 0),
+    processor.value(json_processor_num_numa_nodes_key, 0),
+    processor.value(json_processor_num_hw_threads_key, 0));
+}
+
+static double thread_value(
+  const json &region,
+  int thread_num,
+  const std::string &metric)
+{
+  auto section = region.find(json_thread_section_base
+    + std::to_string(thread_num));
+  if (section == region.end()) return NAN;
+
+  auto value = section->find(metric);
+  if (value == section->end() || !value->is_number()) return NAN;
+
+  return value->get<double>();
+}
+
+heatmap_data heatmap::region_heatmap(
+  const json &fhv_data,
+  const std::string &metric)
+{
+  heatmap_data data;
+  data.title = fmt::format("{} per thread", metric);
+  data.description = fmt::format("{} as measured by each thread (columns) in "
+    "each region (rows). {}", metric, describe_threads(fhv_data));
+
+  if (!fhv_data.contains(json_results_section)) return data;
+
+  std::vector<std::string> region_names;
+  for (const auto &region : fhv_data[json_results_section].items())
+    region_names.push_back(region.key());
+
+  auto columns = thread_columns(fhv_data, region_names);
+  for (const auto &column : columns)
+    data.column_labels.push_back(column.second);
+
+  for (const auto &region_name : region_names)
+  {
+    const json &region = fhv_data[json_results_section][region_name];
+    std::vector<double> row;
+    for (const auto &column : columns)
+      row.push_back(thread_value(region, column.first, metric));
+
+    // regions that didn't measure the metric would only be empty rows
+    if (std::all_of(row.begin(), row.end(),
+          [](double value) { return std::isnan(value); }))
+      continue;
+
+    data.row_labels.push_back(region_name);
+    data.values.push_back(row);
+  }
+
+  return data;
+}
+
+heatmap_data heatmap::metric_heatmap(
+  const json &fhv_data,
+  const std::string &region_name)
+{
+  heatmap_data data;
+  data.title = fmt::format("Region \"{}\" per thread", region_name);
+  data.description = fmt::format("Every metric (rows) as measured by each "
+    "thread (columns) in region \"{}\". {}", region_name,
+    describe_threads(fhv_data));
+
+  if (!fhv_data.contains(json_results_section)
+      || !fhv_data[json_results_section].contains(region_name))
+    return data;
+
+  const json &region = fhv_data[json_results_section][region_name];
+  auto columns = thread_columns(fhv_data, {region_name});
+  for (const auto &column : columns)
+    data.column_labels.push_back(column.second);
+
+  std::set<std::string> metrics;
+  for (const auto &column : columns)
+  {
+    for (const auto &result : region[json_thread_section_base
+        + std::to_string(column.first)].items())
+    {
+      if (result.value().is_number()) metrics.insert(result.key());
+    }
+  }
+
+  for (const auto &metric : metrics)
+  {
+    std::vector<double> row;
+    for (const auto &column : columns)
+      row.push_back(thread_value(region, column.first, metric));
+
+    data.row_labels.push_back(metric);
+    data.values.push_back(row);
+  }
+
+  return data;
+}
+
+// ===== drawing =====
+bool heatmap::draw_heatmap(
+  render_context &context,
+  const heatmap_data &data,
+  const std::string &output_filename)
+{
+  const diagram_geometry &geometry = context.geometry;
+
+  const double label_width = 400;
+  const double cell_width = 24;
+  const double cell_height = 24;
+  const double header_height = 60;
+  const double legend_width = geometry.content_width();
+
+  // text is laid out while drawing, so generous space is set aside for it
+  // (long metric names make titles wrap)
+  const double title_height = 150;
+  const double description_height = 100;
+  const double legend_height = 250;
+
+  double grid_width = cell_width * data.column_labels.size();
+  double content_width = std::max(label_width + grid_width, legend_width);
+  double image_width = 2 * geometry.margin_x + content_width;
+  double image_height = 2 * geometry.margin_y + title_height
+    + description_height + header_height + geometry.internal_margin
+    + cell_height * data.row_labels.size() + geometry.large_internal_margin
+    + legend_height;
+
+  fhv::utils::create_directories_for_file(output_filename);
+
+  auto canvas_ptr = context.create_canvas(output_filename, image_width,
+    image_height);
+  diagram_canvas &canvas = *canvas_ptr;
+
+  double y = geometry.margin_y;
+  canvas.text(geometry.margin_x, y, content_width, data.title,
+    font_role::TITLE, text_alignment::CENTER);
+  y += title_height;
+
+  canvas.text(geometry.margin_x, y, content_width, data.description,
+    font_role::DESCRIPTION);
+  y += description_height;
+
+  // --- column headers, read bottom to top --- //
+  double grid_x = geometry.margin_x + label_width;
+  canvas.label(geometry.margin_x, y + header_height / 2,
+    label_width - geometry.internal_margin, "Hardware thread",
+    font_role::DESCRIPTION, text_alignment::RIGHT);
+  for (size_t column = 0; column < data.column_labels.size(); column++)
+  {
+    canvas.label(grid_x + column * cell_width + cell_width / 4, y,
+      header_height, data.column_labels[column], font_role::DESCRIPTION,
+      text_alignment::LEFT, true);
+  }
+  y += header_height + geometry.internal_margin;
+
+  // --- one swatch per row, colored relative to the row's largest value --- //
+  for (size_t row = 0; row < data.row_labels.size(); row++)
+  {
+    const auto &values = data.values[row];
+
+    double row_max = 0.0;
+    for (const auto &value : values)
+      if (!std::isnan(value)) row_max = std::max(row_max, value);
+
+    std::vector<rgb_color> colors;
+    for (const auto &value : values)
+    {
+      if (std::isnan(value))
+        colors.push_back(WHITE);
+      else
+        colors.push_back(context.color(row_max > 0.0
+          ? std::min(std::max(value / row_max, 0.0), 1.0) : 0.0));
+    }
+
+    canvas.text(geometry.margin_x, y + geometry.small_internal_margin / 4,
+      label_width - geometry.internal_margin, data.row_labels[row],
+      font_role::DESCRIPTION, text_alignment::RIGHT);
+    canvas.swatch(grid_x, y, grid_width, cell_height, colors);
+    y += cell_height;
+  }
+  y += geometry.large_internal_margin;
+
+  saturation_diagram::draw_legend(canvas, geometry.margin_x, y, legend_width,
+    context.color_lut, legend_type::FRACTION_OF_MAX);
+
+  return canvas.finish();
+}
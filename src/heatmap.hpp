@@ -0,0 +1,69 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+#include "render_context.hpp"
+#include "saturation_diagram.hpp"
+
+using json = nlohmann::json;
+
+/* ---- heatmap data ----
+ * a grid of values with one column per thread. values[row][column] is NAN
+ * where a thread has no value.
+ */
+struct heatmap_data {
+  std::string title;
+  std::string description;
+  std::vector<std::string> row_labels;
+  std::vector<std::string> column_labels;
+  std::vector<std::vector<double>> values;
+};
+
+class heatmap {
+  public:
+    /* ---- hardware thread ids ----
+     * the hardware thread each thread ran on, indexed by thread number,
+     * parsed from the affinity string of the json. Empty if the json has no
+     * affinity or it can't be parsed.
+     */
+    static std::vector<int> hardware_thread_ids(const json &fhv_data);
+
+    /* ---- region heatmap ----
+     * one row per region and one column per thread, each cell holding metric
+     * as measured by that thread
+     */
+    static heatmap_data region_heatmap(
+      const json &fhv_data,
+      const std::string &metric);
+
+    /* ---- metric heatmap ----
+     * one row per metric measured by the threads of region_name and one
+     * column per thread
+     */
+    static heatmap_data metric_heatmap(
+      const json &fhv_data,
+      const std::string &region_name);
+
+    /* ---- draw heatmap ----
+     * draws data with the context's color scale. Each row is colored by the
+     * fraction of its largest value, so threads falling behind the others
+     * stand out no matter the unit of the row.
+     *
+     * Columns are ordered by hardware thread id, so threads sharing a core,
+     * socket or NUMA node are usually next to each other and show up as
+     * blocks. Returns false if the file could not be written.
+     */
+    static bool draw_heatmap(
+      render_context &context,
+      const heatmap_data &data,
+      const std::string &output_filename);
+
+  private:
+    // thread numbers found in the thread sections of the given regions,
+    // ordered by hardware thread id, with a label for each
+    static std::vector<std::pair<int, std::string>> thread_columns(
+      const json &fhv_data,
+      const std::vector<std::string> &region_names);
+};
@@ -0,0 +1,548 @@
+#include "html_report.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fmt/core.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+#include "binary_results.hpp"
+#include "saturation_diagram.hpp"
+#include "utils.hpp"
+
+// ===== page template =====
+// everything the page needs is in here, so the report works offline and can
+// be attached to an email or a CI artifact as a single file. {{TITLE}} and
+// {{DATA}} are replaced by renderReport.
+static const std::string report_template = R"html(<!DOCTYPE html>
+<html>
+<head>
+<meta charset="utf-8">
+<title>{{TITLE}}</title>
+<style>
+body { font-family: sans-serif; margin: 2em; color: #222; }
+table { border-collapse: collapse; font-size: 13px; }
+th, td { padding: 3px 8px; border-bottom: 1px solid #ddd; text-align: right;
+  white-space: nowrap; }
+th { background: #f4f4f4; position: sticky; top: 0; }
+#regions th { cursor: pointer; }
+th:first-child, td:first-child { text-align: left; }
+#regions tbody tr { cursor: pointer; }
+#regions tbody tr:hover { background: #f4f4ff; }
+#regions tr.selected { background: #ffffe0; }
+.swatch { display: inline-block; width: 0.9em; height: 0.9em;
+  margin-right: 4px; border: 1px solid #888; vertical-align: middle; }
+dl { display: grid; grid-template-columns: max-content auto; gap: 2px 1em; }
+dt { font-weight: bold; }
+dd { margin: 0; }
+#detail { display: flex; gap: 2em; align-items: flex-start; }
+#threads { overflow-x: auto; max-width: 100%; }
+</style>
+</head>
+<body>
+<h1>{{TITLE}}</h1>
+<h2>Hardware</h2>
+<dl id="hardware"></dl>
+<h2>Regions</h2>
+<p>Click a column header to sort by it and a region to see its diagram and
+per-thread results.</p>
+<table id="regions"><thead></thead><tbody></tbody></table>
+<h2 id="detail-title"></h2>
+<div id="detail"><div id="diagram"></div><div id="threads"></div></div>
+<script type="application/json" id="fhv-data">{{DATA}}</script>
+<script>
+(function() {
+"use strict";
+var data = JSON.parse(document.getElementById("fhv-data").textContent);
+var NAME = 0, AGGREGATES = 1, THREADS = 2;
+
+function escapeHtml(text) {
+  return String(text).replace(/[&<>"]/g, function(c) {
+    return {"&": "&amp;", "<": "&lt;", ">": "&gt;", "\"": "&quot;"}[c];
+  });
+}
+
+// values are stored as [metric index, value, metric index, value, ...]
+function lookup(values, metric) {
+  for (var i = 0; i < values.length; i += 2)
+    if (values[i] === metric) return values[i + 1];
+  return null;
+}
+
+function valueOf(region, reference) {
+  if (!reference) return null;
+  return lookup(region[AGGREGATES][reference[0]], reference[1]);
+}
+
+function formatNumber(value) {
+  if (value === null || value === undefined) return "&ndash;";
+  if (Math.abs(value) >= 1000) return value.toFixed(0);
+  return Number(value.toPrecision(4)).toString();
+}
+
+// same mapping as saturation_diagram: a log scale and 9 equally wide bins
+function saturationColor(value) {
+  if (value === null || value === undefined || data.palette.length === 0)
+    return "#ffffff";
+  var t = (Math.log2(Math.min(Math.max(value, 0), 1)) + 7) / 7;
+  t = Math.min(Math.max(t, 0), 1);
+  return data.palette[Math.min(data.palette.length - 1,
+    Math.floor(t * data.palette.length))];
+}
+
+// ---- hardware ----
+function renderHardware() {
+  var html = [];
+  function add(name, value) {
+    if (value !== null && typeof value === "object") {
+      if (Array.isArray(value)) {
+        var text = JSON.stringify(value);
+        if (text.length > 200) text = value.length + " entries";
+        html.push("<dt>" + escapeHtml(name) + "</dt><dd>"
+          + escapeHtml(text) + "</dd>");
+        return;
+      }
+      Object.keys(value).forEach(function(key) {
+        add(name ? name + "." + key : key, value[key]);
+      });
+      return;
+    }
+    html.push("<dt>" + escapeHtml(name) + "</dt><dd>" + escapeHtml(value)
+      + "</dd>");
+  }
+  add("", data.info);
+  document.getElementById("hardware").innerHTML = html.join("");
+}
+
+// ---- region table ----
+var rows = data.regions.map(function(region, index) {
+  return [region[NAME]].concat(data.columns.map(function(column) {
+    return lookup(region[AGGREGATES][column[1]], column[2]);
+  }), [index]);
+});
+var sortColumn = -1, sortDescending = false;
+var isSaturation = data.columns.map(function(column) {
+  return data.sections[column[1]] === "saturation";
+});
+
+function renderHeader() {
+  var labels = ["Region"].concat(data.columns.map(function(column) {
+    return column[0];
+  }));
+  document.querySelector("#regions thead").innerHTML = "<tr>"
+    + labels.map(function(label, i) {
+      var arrow = i === sortColumn ? (sortDescending ? " &darr;" : " &uarr;")
+        : "";
+      return "<th data-column=\"" + i + "\">" + escapeHtml(label) + arrow
+        + "</th>";
+    }).join("") + "</tr>";
+}
+
+function renderRows() {
+  var html = new Array(rows.length);
+  for (var r = 0; r < rows.length; r++) {
+    var row = rows[r];
+    var cells = "<td>" + escapeHtml(row[0]) + "</td>";
+    for (var c = 0; c < data.columns.length; c++) {
+      var value = row[c + 1];
+      var swatch = isSaturation[c] && value !== null
+        ? "<span class=\"swatch\" style=\"background:" + saturationColor(value)
+          + "\"></span>" : "";
+      cells += "<td>" + swatch + formatNumber(value) + "</td>";
+    }
+    html[r] = "<tr data-region=\"" + row[row.length - 1] + "\">" + cells
+      + "</tr>";
+  }
+  document.querySelector("#regions tbody").innerHTML = html.join("");
+}
+
+function sortBy(column) {
+  sortDescending = column === sortColumn ? !sortDescending : column > 0;
+  sortColumn = column;
+  var sign = sortDescending ? -1 : 1;
+  rows.sort(function(a, b) {
+    var x = a[column], y = b[column];
+    // regions without the value always go last
+    if (x === null) return y === null ? 0 : 1;
+    if (y === null) return -1;
+    return (x < y ? -1 : x > y ? 1 : 0) * sign;
+  });
+  renderHeader();
+  renderRows();
+}
+
+// ---- diagram ----
+function svgBox(x, y, width, height, value, label) {
+  return "<rect x=\"" + x + "\" y=\"" + y + "\" width=\"" + width
+    + "\" height=\"" + height + "\" fill=\"" + saturationColor(value)
+    + "\" stroke=\"black\" stroke-width=\"3\"><title>" + escapeHtml(label)
+    + ": " + formatNumber(value) + "</title></rect>"
+    + "<text x=\"" + (x + width / 2) + "\" y=\"" + (y + height / 2 + 6)
+    + "\" text-anchor=\"middle\" font-size=\"16\">" + escapeHtml(label)
+    + "</text>";
+}
+
+function svgArrow(x, y, width, height, value, down, label) {
+  var head = height * 0.4;
+  var points = [[0.25, 0], [0.75, 0], [0.75, 1 - head / height],
+    [1, 1 - head / height], [0.5, 1], [0, 1 - head / height],
+    [0.25, 1 - head / height]];
+  return "<polygon points=\"" + points.map(function(p) {
+    return (x + p[0] * width) + "," + (y + (down ? p[1] : 1 - p[1]) * height);
+  }).join(" ") + "\" fill=\"" + saturationColor(value)
+    + "\" stroke=\"black\" stroke-width=\"2\"><title>" + escapeHtml(label)
+    + ": " + formatNumber(value) + "</title></polygon>";
+}
+
+function renderDiagram(region) {
+  var d = data.diagram, width = 420, y = 10, parts = [];
+  function level(name, key) {
+    parts.push(svgBox(10, y, 400, 50, valueOf(region, d[key]), name));
+    y += 60;
+    if (d[key + "_load"] || d[key + "_store"]) {
+      parts.push(svgArrow(90, y, 80, 50, valueOf(region, d[key + "_load"]),
+        true, name + " load"));
+      parts.push(svgArrow(250, y, 80, 50, valueOf(region, d[key + "_store"]),
+        false, name + " store"));
+      y += 60;
+    }
+  }
+  level("RAM", "ram");
+  level("L3", "l3");
+  level("L2", "l2");
+  parts.push(svgBox(10, y, 400, 50, null, "L1"));
+  y += 70;
+
+  var core = "<rect x=\"10\" y=\"" + y + "\" width=\"400\" height=\"";
+  var coreTop = y;
+  y += 10;
+  parts.push(svgBox(30, y, 170, 50, valueOf(region, d.sp), "SP FLOP/s"));
+  parts.push(svgBox(220, y, 170, 50, valueOf(region, d.dp), "DP FLOP/s"));
+  y += 60;
+  var ports = d.ports || [];
+  var portWidth = ports.length ? 360 / ports.length : 0;
+  ports.forEach(function(reference, i) {
+    parts.push(svgBox(30 + i * portWidth, y, portWidth - 5, 40,
+      valueOf(region, reference), "P" + i));
+  });
+  if (ports.length) y += 50;
+  core += (y - coreTop) + "\" fill=\"none\" stroke=\"black\" "
+    + "stroke-width=\"3\"/>";
+  parts.push(core);
+
+  document.getElementById("diagram").innerHTML = "<svg xmlns="
+    + "\"http://www.w3.org/2000/svg\" width=\"" + width + "\" height=\""
+    + (y + 10) + "\" font-family=\"sans-serif\">" + parts.join("")
+    + "</svg>";
+}
+
+// ---- per-thread results ----
+function renderThreads(region) {
+  var threads = region[THREADS];
+  var aggregates = region[AGGREGATES];
+  var metrics = {};
+  threads.forEach(function(thread) {
+    for (var i = 0; i < thread[1].length; i += 2) metrics[thread[1][i]] = true;
+  });
+  var metricList = Object.keys(metrics).map(Number).sort(function(a, b) {
+    return data.metrics[a] < data.metrics[b] ? -1 : 1;
+  });
+  var summary = ["sum", "arithmetic_mean"].map(function(name) {
+    return data.sections.indexOf(name);
+  });
+
+  var html = ["<table><thead><tr><th>Metric</th>"];
+  threads.forEach(function(thread) {
+    html.push("<th>thread " + thread[0] + "</th>");
+  });
+  summary.forEach(function(section) {
+    html.push("<th>" + escapeHtml(data.sections[section]) + "</th>");
+  });
+  html.push("</tr></thead><tbody>");
+  metricList.forEach(function(metric) {
+    html.push("<tr><td>" + escapeHtml(data.metrics[metric]) + "</td>");
+    threads.forEach(function(thread) {
+      html.push("<td>" + formatNumber(lookup(thread[1], metric)) + "</td>");
+    });
+    summary.forEach(function(section) {
+      html.push("<td>" + formatNumber(lookup(aggregates[section], metric))
+        + "</td>");
+    });
+    html.push("</tr>");
+  });
+  html.push("</tbody></table>");
+  document.getElementById("threads").innerHTML = html.join("");
+}
+
+function selectRegion(index) {
+  var region = data.regions[index];
+  var selected = document.querySelector("#regions tr.selected");
+  if (selected) selected.classList.remove("selected");
+  var row = document.querySelector("#regions tr[data-region=\"" + index
+    + "\"]");
+  if (row) row.classList.add("selected");
+  document.getElementById("detail-title").textContent = region[NAME];
+  renderDiagram(region);
+  renderThreads(region);
+}
+
+document.querySelector("#regions thead").addEventListener("click",
+  function(event) {
+    var th = event.target.closest("th");
+    if (th) sortBy(Number(th.getAttribute("data-column")));
+  });
+document.querySelector("#regions tbody").addEventListener("click",
+  function(event) {
+    var tr = event.target.closest("tr");
+    if (tr) selectRegion(Number(tr.getAttribute("data-region")));
+  });
+
+renderHardware();
+renderHeader();
+renderRows();
+if (data.regions.length === 1) selectRegion(0);
+})();
+</script>
+</body>
+</html>
+)html";
+
+// ===== helpers =====
+std::string fhv::report::htmlEscape(const std::string &text)
+{
+  std::string escaped;
+  escaped.reserve(text.size());
+  for (const auto &c : text)
+  {
+    if (c == '&') escaped += "&amp;";
+    else if (c == '<') escaped += "&lt;";
+    else if (c == '>') escaped += "&gt;";
+    else if (c == '"') escaped += "&quot;";
+    else escaped += c;
+  }
+  return escaped;
+}
+
+double fhv::report::compactNumber(double value)
+{
+  if (!std::isfinite(value)) return value;
+  return std::stod(fmt::format("{:.4g}", value));
+}
+
+static std::string hexColor(const rgb_color &color)
+{
+  auto channel = [](double value) {
+    return static_cast<int>(std::round(
+      std::min(std::max(value, 0.0), 1.0) * 255.0));
+  };
+  return fmt::format("#{:02x}{:02x}{:02x}", channel(std::get<0>(color)),
+    channel(std::get<1>(color)), channel(std::get<2>(color)));
+}
+
+// ===== report =====
+json fhv::report::reportData(
+  const json &results,
+  const std::string &title,
+  const std::string &color_scale)
+{
+  using fhv::types::aggregation_t;
+  const std::vector<aggregation_t> aggregations = {
+    aggregation_t::sum,
+    aggregation_t::arithmetic_mean,
+    aggregation_t::geometric_mean,
+    aggregation_t::saturation,
+  };
+
+  json data;
+  data[report_version_key] = report_data_version;
+  data[report_title_key] = title;
+  data[report_info_key] = results.contains(json_info_section)
+    ? results[json_info_section] : json::object();
+
+  json palette = json::array();
+  auto color_lut = saturation_diagram::color_scale_lut(color_scale);
+  if (color_lut == nullptr)
+    fmt::print(stderr, "WARN: unknown color scale '{}', the report will have "
+      "no colors\n", color_scale);
+  else
+    for (const auto &color : *color_lut)
+      palette.push_back(hexColor(color));
+  data[report_palette_key] = palette;
+
+  json sections = json::array();
+  for (const auto &aggregation : aggregations)
+    sections.push_back(fhv::types::aggregationTypeToString(aggregation));
+  data[report_sections_key] = sections;
+
+  // metric names are by far the longest strings, so they are stored once
+  json metrics = json::array();
+  std::map<std::string, size_t> metric_indices;
+  auto compactValues = [&](const json &section) {
+    json values = json::array();
+    for (const auto &item : section.items())
+    {
+      if (!item.value().is_number()) continue;
+
+      auto inserted = metric_indices.emplace(item.key(), metrics.size());
+      if (inserted.second) metrics.push_back(item.key());
+
+      values.push_back(inserted.first->second);
+      values.push_back(compactNumber(item.value().get<double>()));
+    }
+    return values;
+  };
+
+  json regions = json::array();
+  if (results.contains(json_results_section))
+  {
+    for (const auto &region : results[json_results_section].items())
+    {
+      json aggregates = json::array();
+      for (const auto &aggregation : aggregations)
+      {
+        auto section = fhv::types::aggregationTypeToString(aggregation);
+        aggregates.push_back(region.value().contains(section)
+          ? compactValues(region.value()[section]) : json::array());
+      }
+
+      // keys sort as strings ("thread_10" < "thread_2"), threads by number
+      std::map<int, json> threads_by_num;
+      for (const auto &section : region.value().items())
+      {
+        if (section.key().compare(0, json_thread_section_base.size(),
+            json_thread_section_base) != 0)
+          continue;
+
+        try {
+          int thread_num = std::stoi(
+            section.key().substr(json_thread_section_base.size()));
+          threads_by_num[thread_num] = compactValues(section.value());
+        }
+        catch (std::exception &e) {
+          continue;
+        }
+      }
+
+      json threads = json::array();
+      for (const auto &thread : threads_by_num)
+        threads.push_back(json::array({thread.first, thread.second}));
+
+      regions.push_back(json::array({region.key(), aggregates, threads}));
+    }
+  }
+  data[report_metrics_key] = metrics;
+  data[report_regions_key] = regions;
+
+  // only what was measured gets a column or a diagram component
+  auto reference = [&](aggregation_t aggregation, const std::string &metric) {
+    auto metric_index = metric_indices.find(metric);
+    if (metric_index == metric_indices.end()) return json();
+
+    size_t section_index = 0;
+    while (aggregations[section_index] != aggregation) section_index++;
+    return json::array({section_index, metric_index->second});
+  };
+
+  json columns = json::array();
+  for (const auto &column : reportColumns)
+  {
+    json column_reference = reference(column.aggregation, column.metric);
+    if (column_reference.is_null()) continue;
+
+    columns.push_back(json::array({column.label, column_reference[0],
+      column_reference[1]}));
+  }
+  data[report_columns_key] = columns;
+
+  json diagram = json::object();
+  const std::vector<std::pair<std::string, std::string>> components = {
+    {"ram", fhv_mem_rw_saturation_metric_name},
+    {"ram_load", fhv_mem_r_saturation_metric_name},
+    {"ram_store", fhv_mem_w_saturation_metric_name},
+    {"l3", fhv_l3_rw_saturation_metric_name},
+    {"l3_load", fhv_l3_r_saturation_metric_name},
+    {"l3_store", fhv_l3_w_saturation_metric_name},
+    {"l2", fhv_l2_rw_saturation_metric_name},
+    {"l2_load", fhv_l2_r_saturation_metric_name},
+    {"l2_store", fhv_l2_w_saturation_metric_name},
+    {"sp", fhv_flops_sp_saturation_metric_name},
+    {"dp", fhv_flops_dp_saturation_metric_name},
+  };
+  for (const auto &component : components)
+  {
+    json component_reference =
+      reference(aggregation_t::saturation, component.second);
+    if (!component_reference.is_null())
+      diagram[component.first] = component_reference;
+  }
+
+  json ports = json::array();
+  for (const auto &port_metric : fhv_port_usage_metrics)
+  {
+    json port_reference =
+      reference(aggregation_t::geometric_mean, port_metric);
+    if (!port_reference.is_null()) ports.push_back(port_reference);
+  }
+  diagram["ports"] = ports;
+  data[report_diagram_key] = diagram;
+
+  return data;
+}
+
+std::string fhv::report::renderReport(const json &data)
+{
+  // "</script>" in a region name must not end the data block early
+  std::string embedded = data.dump(-1, ' ', false,
+    json::error_handler_t::replace);
+  std::string escaped_data;
+  escaped_data.reserve(embedded.size());
+  for (size_t i = 0; i < embedded.size(); i++)
+  {
+    if (embedded[i] == '<' && i + 1 < embedded.size() && embedded[i + 1] == '/')
+      escaped_data += "<\\";
+    else
+      escaped_data += embedded[i];
+  }
+
+  std::string title = data.value(report_title_key, std::string());
+  std::string page = report_template;
+  for (const auto &placeholder : {
+      std::make_pair(std::string("{{TITLE}}"), htmlEscape(title)),
+      std::make_pair(std::string("{{DATA}}"), escaped_data)})
+  {
+    size_t position = 0;
+    while ((position = page.find(placeholder.first, position))
+        != std::string::npos)
+    {
+      page.replace(position, placeholder.first.size(), placeholder.second);
+      position += placeholder.second.size();
+    }
+  }
+
+  return page;
+}
+
+int fhv::report::writeReport(
+  const std::string &input_filename,
+  const std::string &output_filename,
+  const std::string &color_scale)
+{
+  json results;
+  if (!fhv::binary::loadResults(input_filename, results)) return 1;
+
+  json data = reportData(results, input_filename, color_scale);
+
+  fhv::utils::create_directories_for_file(output_filename);
+  std::ofstream o(output_filename);
+  o << renderReport(data);
+  if (!o) {
+    fmt::print(stderr, "ERROR: could not write the report to '{}'\n",
+      output_filename);
+    return 2;
+  }
+
+  fmt::print("Report with {} regions saved to {}\n",
+    data[report_regions_key].size(), output_filename);
+  return 0;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+#include "likwid_defines.hpp"
+#include "performance_monitor_defines.hpp"
+#include "types.hpp"
+
+using json = nlohmann::json;
+
+namespace fhv {
+  namespace report {
+    // bumped whenever the layout of the embedded data changes
+    const unsigned report_data_version = 1;
+
+    // keys of the data embedded in the report
+    const std::string report_version_key = "version";
+    const std::string report_title_key = "title";
+    const std::string report_info_key = "info";
+    const std::string report_palette_key = "palette";
+    const std::string report_metrics_key = "metrics";
+    const std::string report_sections_key = "sections";
+    const std::string report_columns_key = "columns";
+    const std::string report_diagram_key = "diagram";
+    const std::string report_regions_key = "regions";
+
+    // a column of the region table: label, aggregation and metric
+    struct ReportColumn {
+      std::string label;
+      fhv::types::aggregation_t aggregation;
+      std::string metric;
+    };
+
+    const std::vector<ReportColumn> reportColumns = {
+      // the longest runtime of any group, see fhv::filter::setJsonResult
+      {"Time [s]", fhv::types::aggregation_t::arithmetic_mean,
+        runtime_metric_name},
+      {"SP MFLOP/s", fhv::types::aggregation_t::sum, mflops_sp_metric_name},
+      {"DP MFLOP/s", fhv::types::aggregation_t::sum, mflops_dp_metric_name},
+      {"Memory MB/s", fhv::types::aggregation_t::sum,
+        ram_bandwidth_metric_name},
+      {"L3 MB/s", fhv::types::aggregation_t::sum, l3_bandwidth_metric_name},
+      {"L2 MB/s", fhv::types::aggregation_t::sum, l2_bandwidth_metric_name},
+      {"Memory sat.", fhv::types::aggregation_t::saturation,
+        fhv_mem_rw_saturation_metric_name},
+      {"L3 sat.", fhv::types::aggregation_t::saturation,
+        fhv_l3_rw_saturation_metric_name},
+      {"L2 sat.", fhv::types::aggregation_t::saturation,
+        fhv_l2_rw_saturation_metric_name},
+      {"SP FLOP/s sat.", fhv::types::aggregation_t::saturation,
+        fhv_flops_sp_saturation_metric_name},
+      {"DP FLOP/s sat.", fhv::types::aggregation_t::saturation,
+        fhv_flops_dp_saturation_metric_name},
+    };
+
+    // text with the characters that are special in HTML escaped
+    std::string htmlEscape(const std::string &text);
+
+    /* ---- compact number ----
+     * value rounded to 4 significant digits, which is all the report shows,
+     * so it serializes to a short string
+     */
+    double compactNumber(double value);
+
+    /* ---- report data ----
+     * the compact form of a json output by fhv_perfmon that is embedded in
+     * the report:
+     *  - "metrics": every metric name, once. Everything else refers to
+     *    metrics by index into this table.
+     *  - "sections": the aggregation sections, referred to by index
+     *  - "regions": one entry per region of the form
+     *      [name, [section 0 values, section 1 values, ...],
+     *       [[thread num, values], ...]]
+     *    where "values" is a flat [metric index, value, metric index,
+     *    value, ...] list of the numbers present
+     *  - "columns": [label, section index, metric index] of each table
+     *    column whose metric was measured
+     *  - "diagram": [section index, metric index] of each diagram component,
+     *    "ports" holds one per port
+     *  - "palette": the bins of color_scale as "#rrggbb"
+     *  - "info": the info section of the json, unchanged
+     */
+    json reportData(
+      const json &results,
+      const std::string &title,
+      const std::string &color_scale);
+
+    // the report page with data embedded in it
+    std::string renderReport(const json &data);
+
+    /* ---- write report ----
+     * loads a json output by fhv_perfmon and writes a self-contained HTML
+     * report for it to output_filename. Returns 0 on success, 1 if the json
+     * could not be loaded and 2 if the report could not be written.
+     */
+    int writeReport(
+      const std::string &input_filename,
+      const std::string &output_filename,
+      const std::string &color_scale);
+  };
+};
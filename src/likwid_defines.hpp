@@ -25,6 +25,9 @@ const std::string dp_scalar_flops_event_name = "FP_ARITH_INST_RETIRED_SCALAR_DOU
 const std::string dp_avx_128_flops_event_name = "FP_ARITH_INST_RETIRED_128B_PACKED_DOUBLE";
 const std::string dp_avx_256_flops_event_name = "FP_ARITH_INST_RETIRED_256B_PACKED_DOUBLE";
 
+// timing. Every likwid group reports this metric
+const std::string runtime_metric_name = "Runtime (RDTSC) [s]";
+
 // flop rates
 const std::string mflops_metric_name = "SP [MFLOP/s]";
 const std::string mflops_sp_metric_name = mflops_metric_name;
@@ -0,0 +1,470 @@
+#include "parameter_sweep.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sys/wait.h>
+#include <tuple>
+#include <unistd.h>
+
+#include "regression_check.hpp"
+#include "result_merge.hpp"
+#include "utils.hpp"
+
+// ===== scaling_t things =====
+std::string fhv::sweep::scalingTypeToString(const scaling_t &scaling_type)
+{
+  if (scaling_type == scaling_t::strong)
+    return "strong";
+  else if (scaling_type == scaling_t::weak)
+    return "weak";
+  else
+    return "unknown_scaling_type";
+}
+
+// ===== SweepPoint function definitions =====
+long long fhv::sweep::SweepPoint::problemSize(const scaling_t &scaling) const
+{
+  if (scaling == scaling_t::weak)
+    return this->size * static_cast<long long>(this->threads);
+  return this->size;
+}
+
+std::string fhv::sweep::SweepPoint::filename() const
+{
+  return fmt::format("run_{:05}.json", this->id);
+}
+
+// ===== ScalingSeries function definitions =====
+std::string fhv::sweep::ScalingSeries::label() const
+{
+  std::string label = fhv::params::parametersToString(this->parameter_values);
+  if (label.empty()) label = fmt::format("size {}", this->size);
+  if (!this->affinity.empty())
+    label += ", " + sweep_affinity_envvar + "=" + this->affinity;
+  return label;
+}
+
+// ===== loading =====
+bool fhv::sweep::loadSweepConfig(
+    const std::string &filename,
+    SweepConfig &config)
+{
+  std::ifstream i(filename);
+  if (!i) {
+    fmt::print(stderr, "ERROR: the sweep configuration '{}' does not exist!\n",
+      filename);
+    return false;
+  }
+
+  try {
+    json j;
+    i >> j;
+
+    config.command = j.at(sweep_command_key).get<std::string>();
+    config.threads =
+      j.value(sweep_threads_key, std::vector<unsigned>{1});
+    config.sizes = j.value(sweep_sizes_key, std::vector<long long>{});
+    config.affinities =
+      j.value(sweep_affinity_key, std::vector<std::string>{""});
+    config.repetitions = j.value(sweep_repetitions_key, 1u);
+    config.output_directory = j.value(sweep_output_directory_key, "sweep");
+    config.environment = j.value(sweep_environment_key,
+      std::map<std::string, std::string>{});
+
+    std::string scaling = j.value(sweep_scaling_key,
+      scalingTypeToString(scaling_t::strong));
+    if (scaling == scalingTypeToString(scaling_t::strong))
+      config.scaling = scaling_t::strong;
+    else if (scaling == scalingTypeToString(scaling_t::weak))
+      config.scaling = scaling_t::weak;
+    else {
+      fmt::print(stderr, "ERROR: '{}' in '{}' must be '{}' or '{}', not "
+        "'{}'.\n", sweep_scaling_key, filename,
+        scalingTypeToString(scaling_t::strong),
+        scalingTypeToString(scaling_t::weak), scaling);
+      return false;
+    }
+  }
+  catch (json::exception &e) {
+    fmt::print(stderr, "ERROR: could not read sweep configuration from '{}': "
+      "{}\n", filename, e.what());
+    return false;
+  }
+
+  if (config.sizes.empty())
+  {
+    if (config.command.find(sweep_size_placeholder) != std::string::npos) {
+      fmt::print(stderr, "ERROR: the command in '{}' uses '{}' but no '{}' "
+        "are given.\n", filename, sweep_size_placeholder, sweep_sizes_key);
+      return false;
+    }
+    // one size that is never substituted keeps the grid non-empty
+    config.sizes.push_back(0);
+  }
+
+  if (config.threads.empty() || config.affinities.empty()
+      || config.repetitions == 0) {
+    fmt::print(stderr, "ERROR: '{}' describes an empty sweep.\n", filename);
+    return false;
+  }
+
+  return true;
+}
+
+bool fhv::sweep::loadIndex(const std::string &filename, json &index)
+{
+  std::ifstream i(filename);
+  if (!i) {
+    fmt::print(stderr, "ERROR: the sweep index '{}' does not exist!\n",
+      filename);
+    return false;
+  }
+
+  try {
+    i >> index;
+  }
+  catch (json::parse_error &e) {
+    fmt::print(stderr, "ERROR: could not parse '{}': {}\n", filename,
+      e.what());
+    return false;
+  }
+
+  if (!index.contains(sweep_runs_key)) {
+    fmt::print(stderr, "ERROR: '{}' is not a sweep index.\n", filename);
+    return false;
+  }
+
+  return true;
+}
+
+// ===== running =====
+fhv::sweep::sweep_points_t fhv::sweep::expandGrid(const SweepConfig &config)
+{
+  sweep_points_t points;
+  unsigned id = 0;
+
+  // repetitions innermost so that a sweep cut short still covers as many
+  // configurations as possible
+  for (const auto &size : config.sizes)
+    for (const auto &affinity : config.affinities)
+      for (const auto &threads : config.threads)
+        for (unsigned repetition = 0; repetition < config.repetitions;
+             repetition++)
+        {
+          SweepPoint point = {
+            .id = id++,
+            .size = size,
+            .threads = threads,
+            .affinity = affinity,
+            .repetition = repetition,
+          };
+          points.push_back(point);
+        }
+
+  return points;
+}
+
+static void replaceAll(
+    std::string &s,
+    const std::string &placeholder,
+    const std::string &value)
+{
+  size_t pos = 0;
+  while ((pos = s.find(placeholder, pos)) != std::string::npos)
+  {
+    s.replace(pos, placeholder.size(), value);
+    pos += value.size();
+  }
+}
+
+std::string fhv::sweep::buildCommand(
+    const SweepConfig &config,
+    const SweepPoint &point)
+{
+  std::string command = config.command;
+  replaceAll(command, sweep_size_placeholder,
+    std::to_string(point.problemSize(config.scaling)));
+  replaceAll(command, sweep_threads_placeholder,
+    std::to_string(point.threads));
+  replaceAll(command, sweep_affinity_placeholder, point.affinity);
+  replaceAll(command, sweep_repetition_placeholder,
+    std::to_string(point.repetition));
+  return command;
+}
+
+json fhv::sweep::summarizeRegions(const json &results, double wall_time)
+{
+  json summary = json::object();
+
+  const std::string arithmetic_mean_section =
+    fhv::types::aggregationTypeToString(
+      fhv::types::aggregation_t::arithmetic_mean);
+  const std::string saturation_section = fhv::types::aggregationTypeToString(
+      fhv::types::aggregation_t::saturation);
+
+  auto regions = results.find(json_results_section);
+  if (regions == results.end()) return summary;
+
+  for (const auto &region : regions->items())
+  {
+    const json &region_data = region.value();
+    json &region_summary = summary[region.key()];
+
+    // threads run a region concurrently, so the mean thread runtime is the
+    // closest thing to the region's wall time. Of the runtimes of the groups,
+    // the json holds the longest (see fhv::filter::setJsonResult).
+    region_summary[sweep_region_time_key] = wall_time;
+    auto mean = region_data.find(arithmetic_mean_section);
+    if (mean != region_data.end() && mean->contains(runtime_metric_name)
+        && mean->at(runtime_metric_name).is_number())
+      region_summary[sweep_region_time_key] = mean->at(runtime_metric_name);
+
+    region_summary[saturation_section] = json::object();
+    auto saturation = region_data.find(saturation_section);
+    if (saturation == region_data.end()) continue;
+    for (const auto &metric : saturation->items())
+    {
+      if (metric.value().is_number())
+        region_summary[saturation_section][metric.key()] = metric.value();
+    }
+  }
+
+  return summary;
+}
+
+json fhv::sweep::runPoint(const SweepConfig &config, const SweepPoint &point)
+{
+  std::string command = buildCommand(config, point);
+  std::string output_filename =
+    config.output_directory + "/" + point.filename();
+
+  // a stale file from an earlier sweep would otherwise be mistaken for the
+  // output of a run that failed before writing anything
+  std::remove(output_filename.c_str());
+
+  auto start = std::chrono::steady_clock::now();
+
+  int status = -1;
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    for (const auto &variable : config.environment)
+      setenv(variable.first.c_str(), variable.second.c_str(), 1);
+    setenv(perfmon_output_envvar.c_str(), output_filename.c_str(), 1);
+    setenv("OMP_NUM_THREADS", std::to_string(point.threads).c_str(), 1);
+    if (!point.affinity.empty())
+      setenv(sweep_affinity_envvar.c_str(), point.affinity.c_str(), 1);
+
+    execl("/bin/sh", "sh", "-c", command.c_str(), static_cast<char*>(nullptr));
+    _exit(127);
+  }
+  else if (pid < 0)
+    fmt::print(stderr, "ERROR: could not start '{}'.\n", command);
+  else
+    waitpid(pid, &status, 0);
+
+  std::chrono::duration<double> wall_time =
+    std::chrono::steady_clock::now() - start;
+
+  int exit_status = -1;
+  if (pid > 0 && WIFEXITED(status))
+    exit_status = WEXITSTATUS(status);
+  else if (pid > 0 && WIFSIGNALED(status))
+    exit_status = 128 + WTERMSIG(status);
+
+  json entry;
+  entry[sweep_run_id_key] = point.id;
+  entry[sweep_size_key] = point.size;
+  entry[sweep_problem_size_key] = point.problemSize(config.scaling);
+  entry[sweep_num_threads_key] = point.threads;
+  entry[sweep_affinity_key] = point.affinity;
+  entry[sweep_repetition_key] = point.repetition;
+  entry[sweep_command_key] = command;
+  entry[sweep_file_key] = point.filename();
+  entry[sweep_exit_status_key] = exit_status;
+  entry[sweep_wall_time_key] = wall_time.count();
+
+  if (exit_status != 0)
+  {
+    fmt::print(stderr, "WARN: '{}' exited with status {}.\n", command,
+      exit_status);
+    return entry;
+  }
+
+  json results;
+  if (fhv::check::loadResults(output_filename, results))
+  {
+    auto info = results.find(json_info_section);
+    if (info != results.end() && info->contains(json_parameter_values_key))
+      entry[sweep_parameter_values_key] = info->at(json_parameter_values_key);
+    entry[sweep_regions_key] = summarizeRegions(results, wall_time.count());
+  }
+  else
+    fmt::print(stderr, "WARN: '{}' did not write a json to '{}'. Was it "
+      "built with fhv_perfmon?\n", command, output_filename);
+
+  return entry;
+}
+
+int fhv::sweep::runSweep(const std::string &config_filename, json &index)
+{
+  SweepConfig config;
+  if (!loadSweepConfig(config_filename, config)) return 2;
+
+  std::ifstream config_file(config_filename);
+  json config_json;
+  config_file >> config_json;
+
+  auto points = expandGrid(config);
+  fhv::utils::create_directories_for_file(
+    config.output_directory + "/" + sweep_index_filename);
+
+  index = json::object();
+  index[sweep_command_key] = config.command;
+  index[sweep_scaling_key] = scalingTypeToString(config.scaling);
+  index[sweep_configuration_key] = config_json;
+  index[sweep_runs_key] = json::array();
+
+  int return_code = 0;
+  for (const auto &point : points)
+  {
+    fmt::print("[{}/{}] size {}, {} threads{}, repetition {}\n",
+      point.id + 1, points.size(), point.problemSize(config.scaling),
+      point.threads,
+      point.affinity.empty() ? "" : ", " + sweep_affinity_envvar + "="
+        + point.affinity,
+      point.repetition);
+
+    json entry = runPoint(config, point);
+    if (!entry.contains(sweep_regions_key)) return_code = 1;
+    index[sweep_runs_key].push_back(entry);
+  }
+
+  // written once at the end; the result jsons of an interrupted sweep are
+  // still on disk
+  std::string index_filename =
+    config.output_directory + "/" + sweep_index_filename;
+  std::ofstream o(index_filename);
+  o << std::setw(4) << index << std::endl;
+  fmt::print("Sweep index saved to {}\n", index_filename);
+
+  return return_code;
+}
+
+// ===== analysis =====
+fhv::sweep::scaling_series_t fhv::sweep::scalingSeries(const json &index)
+{
+  const std::string saturation_section = fhv::types::aggregationTypeToString(
+      fhv::types::aggregation_t::saturation);
+  bool weak = index.value(sweep_scaling_key, "")
+    == scalingTypeToString(scaling_t::weak);
+
+  typedef std::tuple<std::string, long long, std::string> series_key_t;
+  // (region, size, affinity) -> threads -> one summary per repetition
+  std::map<series_key_t, std::map<unsigned, std::vector<const json*>>>
+    grouped;
+  // (region, size, affinity) -> the runs in it
+  std::map<series_key_t, std::vector<const json*>> grouped_runs;
+
+  for (const auto &run : index.at(sweep_runs_key))
+  {
+    auto regions = run.find(sweep_regions_key);
+    if (regions == run.end()) continue;
+
+    for (const auto &region : regions->items())
+    {
+      auto key = std::make_tuple(region.key(),
+        run.at(sweep_size_key).get<long long>(),
+        run.at(sweep_affinity_key).get<std::string>());
+      grouped[key][run.at(sweep_num_threads_key).get<unsigned>()]
+        .push_back(&region.value());
+      grouped_runs[key].push_back(&run);
+    }
+  }
+
+  scaling_series_t all_series;
+  for (const auto &group : grouped)
+  {
+    ScalingSeries series = {
+      .region_name = std::get<0>(group.first),
+      .size = std::get<1>(group.first),
+      .affinity = std::get<2>(group.first),
+      .parameter_values = json::object(),
+      .points = {},
+    };
+
+    // the index entries hold the typed parameters like an info section
+    const auto &runs = grouped_runs[group.first];
+    const json *first_values =
+      runs.front()->contains(sweep_parameter_values_key)
+        ? &runs.front()->at(sweep_parameter_values_key) : nullptr;
+    if (first_values != nullptr && first_values->is_object())
+    {
+      for (const auto &parameter : first_values->items())
+      {
+        bool shared = std::all_of(runs.begin(), runs.end(),
+          [&](const json *run) {
+            const json *value =
+              fhv::params::findParameter(*run, parameter.key());
+            return value != nullptr && *value == parameter.value();
+          });
+        if (shared)
+          series.parameter_values[parameter.key()] = parameter.value();
+      }
+    }
+
+    // std::map keeps thread counts sorted
+    for (const auto &threads : group.second)
+    {
+      std::vector<double> times;
+      std::map<std::string, std::vector<double>> saturations;
+      for (const auto *summary : threads.second)
+      {
+        times.push_back(summary->at(sweep_region_time_key).get<double>());
+        for (const auto &metric : summary->at(saturation_section).items())
+          saturations[metric.key()].push_back(metric.value().get<double>());
+      }
+
+      ScalingPoint point = {
+        .threads = threads.first,
+        .time = fhv::merge::calculateStatistics(times).mean,
+        .speedup = NAN,
+        .efficiency = NAN,
+        .saturation = {},
+        .num_samples = static_cast<unsigned>(times.size()),
+      };
+      for (const auto &metric : saturations)
+        point.saturation[metric.first] =
+          fhv::merge::calculateStatistics(metric.second).mean;
+
+      series.points.push_back(point);
+    }
+
+    const ScalingPoint &base = series.points.front();
+    for (auto &point : series.points)
+    {
+      if (point.time <= 0.0) continue;
+
+      if (weak)
+        point.efficiency = base.time / point.time;
+      else
+        point.efficiency = (base.time * base.threads)
+          / (point.time * point.threads);
+      point.speedup = point.efficiency * point.threads;
+    }
+
+    all_series.push_back(series);
+  }
+
+  // json compares numbers by value, so n=900 comes before n=4000
+  std::stable_sort(all_series.begin(), all_series.end(),
+    [](const ScalingSeries &a, const ScalingSeries &b) {
+      return std::tie(a.region_name, a.parameter_values)
+        < std::tie(b.region_name, b.parameter_values);
+    });
+
+  return all_series;
+}
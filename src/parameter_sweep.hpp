@@ -0,0 +1,178 @@
+#pragma once
+
+#include <fmt/core.h>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+#include "performance_monitor_defines.hpp"
+#include "run_parameters.hpp"
+#include "types.hpp"
+
+using json = nlohmann::json;
+
+namespace fhv {
+  namespace sweep {
+    // keys used in the sweep configuration file. See docs/usage.md for the
+    // format.
+    const std::string sweep_command_key = "command";
+    const std::string sweep_sizes_key = "sizes";
+    const std::string sweep_threads_key = "threads";
+    const std::string sweep_affinity_key = "affinity";
+    const std::string sweep_scaling_key = "scaling";
+    const std::string sweep_repetitions_key = "repetitions";
+    const std::string sweep_output_directory_key = "output_directory";
+    const std::string sweep_environment_key = "environment";
+
+    // keys used in the index written next to the results
+    const std::string sweep_index_filename = "sweep_index.json";
+    const std::string sweep_configuration_key = "configuration";
+    const std::string sweep_runs_key = "runs";
+    const std::string sweep_run_id_key = "id";
+    const std::string sweep_size_key = "size";
+    const std::string sweep_problem_size_key = "problem_size";
+    const std::string sweep_num_threads_key = "threads";
+    const std::string sweep_repetition_key = "repetition";
+    const std::string sweep_file_key = "file";
+    const std::string sweep_exit_status_key = "exit_status";
+    const std::string sweep_wall_time_key = "wall_time";
+    // the typed parameters the program recorded with setParameter(), under
+    // the key of the info section so fhv::params::findParameter reads both
+    const std::string sweep_parameter_values_key = json_parameter_values_key;
+    const std::string sweep_regions_key = "regions";
+    const std::string sweep_region_time_key = "time";
+
+    // replaced in "command" before each run
+    const std::string sweep_size_placeholder = "{size}";
+    const std::string sweep_threads_placeholder = "{threads}";
+    const std::string sweep_affinity_placeholder = "{affinity}";
+    const std::string sweep_repetition_placeholder = "{repetition}";
+
+    // the affinity policy is passed to the program through this variable
+    const std::string sweep_affinity_envvar = "OMP_PROC_BIND";
+
+    enum class scaling_t {
+      // problem size is fixed, work per thread shrinks with more threads
+      strong,
+      // problem size grows with the number of threads
+      weak
+    };
+
+    std::string scalingTypeToString(const scaling_t &scaling_type);
+
+    struct SweepConfig {
+      // shell command, may contain the placeholders above
+      std::string command;
+      // for weak scaling, these are sizes per thread
+      std::vector<long long> sizes;
+      std::vector<unsigned> threads;
+      // values for OMP_PROC_BIND. Empty string means leave it unset.
+      std::vector<std::string> affinities;
+      scaling_t scaling;
+      unsigned repetitions;
+      std::string output_directory;
+      // extra environment variables set for every run
+      std::map<std::string, std::string> environment;
+    };
+
+    // one point of the parameter grid
+    struct SweepPoint {
+      unsigned id;
+      long long size;
+      unsigned threads;
+      std::string affinity;
+      unsigned repetition;
+
+      // the size passed to the program: size * threads for weak scaling
+      long long problemSize(const scaling_t &scaling) const;
+      // path of the json this point writes, relative to the output directory
+      std::string filename() const;
+    };
+
+    typedef std::vector<SweepPoint> sweep_points_t;
+
+    // returns false and prints the problem if the file could not be read or
+    // is malformed
+    bool loadSweepConfig(const std::string &filename, SweepConfig &config);
+
+    // every combination of size, threads, affinity and repetition, in the
+    // order they will be run
+    sweep_points_t expandGrid(const SweepConfig &config);
+
+    // replaces the placeholders in config.command for one point
+    std::string buildCommand(
+        const SweepConfig &config,
+        const SweepPoint &point);
+
+    /* ---- run point ----
+     * runs the command for one point through /bin/sh with FHV_OUTPUT,
+     * OMP_NUM_THREADS and (if set) OMP_PROC_BIND pointing at this point, and
+     * returns its index entry. The entry records the exit status and wall
+     * time even if the program failed.
+     */
+    json runPoint(const SweepConfig &config, const SweepPoint &point);
+
+    /* ---- summarize regions ----
+     * the part of one result json that the scaling charts need, per region:
+     * the runtime and the saturation section. Region runtime comes from the
+     * "Runtime (RDTSC) [s]" metric if it was measured, otherwise the wall
+     * time of the whole run is used.
+     */
+    json summarizeRegions(const json &results, double wall_time);
+
+    /* ---- run sweep ----
+     * runs every point of the grid, then writes the index to
+     * <output_directory>/sweep_index.json. Each entry of "runs" in the index
+     * holds the parameters of one run, the json it wrote and a summary of its
+     * regions, so the index alone is enough to plot scaling charts.
+     *
+     * Returns 0 if every run succeeded, 1 if any run failed and 2 if the
+     * configuration could not be read.
+     */
+    int runSweep(const std::string &config_filename, json &index);
+
+    // loads an index written by runSweep. Returns false on failure.
+    bool loadIndex(const std::string &filename, json &index);
+
+    // one thread count of a scaling series, averaged over repetitions
+    struct ScalingPoint {
+      unsigned threads;
+      double time;
+      // relative to the smallest thread count in the series, which is
+      // assumed to scale perfectly: speedup = threads * efficiency
+      double speedup;
+      double efficiency;
+      // saturation metric name -> mean saturation
+      std::map<std::string, double> saturation;
+      unsigned num_samples;
+    };
+
+    // how one region scales for one size and affinity policy
+    struct ScalingSeries {
+      std::string region_name;
+      long long size;
+      std::string affinity;
+      // the typed parameters every run of the series recorded with the same
+      // value, e.g. the problem size the program derived from {size}
+      json parameter_values;
+      // sorted by thread count
+      std::vector<ScalingPoint> points;
+
+      // the shared typed parameters if there are any, otherwise the size
+      std::string label() const;
+    };
+
+    typedef std::vector<ScalingSeries> scaling_series_t;
+
+    /* ---- scaling series ----
+     * groups the successful runs of an index by region, size and affinity
+     * and calculates speedup and efficiency for each. Series are ordered by
+     * region, then by the values of their typed parameters (numbers compare
+     * as numbers), then by size and affinity. For strong scaling,
+     * efficiency is T(p0) * p0 / (T(p) * p); for weak scaling it is
+     * T(p0) / T(p), where p0 is the smallest thread count in the series.
+     */
+    scaling_series_t scalingSeries(const json &index);
+  };
+};
@@ -32,6 +32,46 @@ const std::string jsonResultOutputDefaultFilepath = "./perfmon_output.json";
 const std::string perfmon_output_envvar = "FHV_OUTPUT";
 const std::string perfmon_keep_large_values_envvar = "FHV_KEEP_LARGE_VALUES";
 
+// if set, region begin and end times are recorded and written to this path
+// as a Chrome Trace Event json. Placeholders are the same as in FHV_OUTPUT
+const std::string perfmon_trace_envvar = "FHV_TRACE";
+
+// if set, results are streamed to this path as newline-delimited json while
+// the program runs (see fhv::stream). Placeholders are the same as in
+// FHV_OUTPUT
+const std::string perfmon_stream_envvar = "FHV_STREAM";
+
+// which results resultsToJson writes: "key_metrics" (the default) or "all",
+// plus globs of result names to add or leave out. See fhv::filter
+const std::string perfmon_export_envvar = "FHV_EXPORT";
+const std::string perfmon_include_envvar = "FHV_INCLUDE";
+const std::string perfmon_exclude_envvar = "FHV_EXCLUDE";
+
+// git commit recorded with the results, if it wasn't compiled in with
+// FHV_GIT_HASH. See fhv::params
+const std::string perfmon_commit_envvar = "FHV_COMMIT";
+
+// most counter values stored per region instance in a trace. likwid groups
+// have far fewer events than this
+const int perfmon_trace_max_counters = 64;
+
+// in FHV_OUTPUT, these are replaced with the rank and hostname of the process
+// so that every rank of an MPI job can write its own file
+const std::string perfmon_output_rank_placeholder = "%r";
+const std::string perfmon_output_hostname_placeholder = "%h";
+
+// environment variables that hold the rank of this process, in order of
+// preference. FHV_RANK may be set manually; the others are set by common MPI
+// launchers and schedulers
+const std::vector<std::string> perfmon_rank_envvars = {
+  "FHV_RANK",
+  "OMPI_COMM_WORLD_RANK",
+  "PMIX_RANK",
+  "PMI_RANK",
+  "MV2_COMM_WORLD_RANK",
+  "SLURM_PROCID",
+};
+
 // const std::string fhv_port_usage_group = "FHV Port usage ratios";
 const std::string fhv_port_usage_ratio_start = "Port";
 const std::string fhv_port_usage_ratio_end = " usage ratio";
@@ -56,6 +96,38 @@ const std::string fhv_port7_usage_ratio = fhv_port_usage_ratio_start
 // JSON keywords
 const std::string json_info_section = "info";
 const std::string json_parameter_key = "parameters";
+// typed parameters set with fhv_perfmon::setParameter, by name
+const std::string json_parameter_values_key = "parameter_values";
+// how the program was built and the OpenMP settings it ran with
+const std::string json_build_section = "build";
+const std::string json_build_compiler_key = "compiler";
+const std::string json_build_flags_key = "flags";
+const std::string json_build_git_commit_key = "git_commit";
+const std::string json_build_optimized_key = "optimized";
+const std::string json_build_fast_math_key = "fast_math";
+const std::string json_build_assertions_key = "assertions";
+const std::string json_build_vector_isa_key = "vector_isa";
+const std::string json_build_openmp_version_key = "openmp_version";
+const std::string json_openmp_section = "openmp";
+const std::string json_openmp_max_threads_key = "max_threads";
+const std::string json_openmp_proc_bind_key = "proc_bind";
+const std::string json_openmp_places_key = "places";
+const std::string json_openmp_schedule_key = "schedule";
+const std::string json_openmp_dynamic_key = "dynamic";
+// the state of the machine that affects performance, see fhv::environment
+const std::string json_environment_section = "environment";
+const std::string json_environment_kernel_key = "kernel";
+const std::string json_environment_likwid_version_key = "likwid_version";
+const std::string json_environment_turbo_key = "turbo";
+const std::string json_environment_smt_key = "smt";
+const std::string json_environment_thp_key = "transparent_hugepages";
+const std::string json_environment_numa_policy_key = "numa_policy";
+const std::string json_environment_cpus_key = "cpus";
+const std::string json_environment_cpu_key = "cpu";
+const std::string json_environment_governor_key = "governor";
+const std::string json_environment_min_mhz_key = "min_mhz";
+const std::string json_environment_max_mhz_key = "max_mhz";
+const std::string json_environment_mismatches_key = "mismatches";
 const std::string json_processor_section = "processor";
 const std::string json_processor_name_key = "name";
 const std::string json_processor_num_sockets_key = "num_sockets";
@@ -63,10 +135,34 @@ const std::string json_processor_num_numa_nodes_key = "num_numa_nodes";
 const std::string json_processor_num_hw_threads_key = "num_hw_threads";
 const std::string json_processor_num_threads_in_use_key = "num_threads_in_use";
 const std::string json_processor_affinity_key = "affinity";
+const std::string json_hostname_key = "hostname";
+const std::string json_rank_key = "rank";
 
 const std::string json_results_section = "region_results";
 const std::string json_thread_section_base = "thread_";
 
+// used by "fhv --merge" to describe the spread of a metric across runs
+const std::string json_merged_from_key = "merged_from";
+const std::string json_statistics_section = "statistics";
+const std::string json_statistics_mean_key = "mean";
+const std::string json_statistics_stddev_key = "stddev";
+const std::string json_statistics_ci95_low_key = "ci95_low";
+const std::string json_statistics_ci95_high_key = "ci95_high";
+const std::string json_statistics_num_samples_key = "n";
+
+// used by "fhv --merge-ranks" to describe a job made of many processes
+const std::string json_ranks_key = "ranks";
+const std::string json_rank_file_key = "file";
+const std::string json_num_ranks_key = "num_ranks";
+const std::string json_num_nodes_key = "num_nodes";
+const std::string json_nodes_section = "nodes";
+const std::string json_imbalance_section = "rank_imbalance";
+const std::string json_imbalance_min_key = "min";
+const std::string json_imbalance_max_key = "max";
+const std::string json_imbalance_min_rank_key = "min_rank";
+const std::string json_imbalance_max_rank_key = "max_rank";
+const std::string json_imbalance_ratio_key = "max_over_mean";
+
 // port usage ratio names
 const std::string fhv_performance_monitor_group = "FHV_PERFORMANCE_MONITOR";
 
@@ -95,6 +191,14 @@ const std::vector<std::string> fhv_saturation_source_metrics = {
   ram_load_bandwidth_name,
 };
 
+// what load_likwid_data keeps by default besides fhv_key_metrics, which
+// already hold the metrics saturation is calculated from: the port counters
+// the port usage ratios are calculated from. Names or globs, see fhv::filter
+const std::vector<std::string> fhv_default_collected_metrics = {
+  uops_dispatched_port_base_name + "*",
+  uops_executed_port_base_name + "*",
+};
+
 // saturation keywords
 const std::string fhv_flops_sp_saturation_metric_name = "Saturation FLOPS SP";
 const std::string fhv_flops_dp_saturation_metric_name = "Saturation FLOPS DP";
@@ -138,6 +242,7 @@ const std::vector<std::string> fhv_other_diagram_metrics = {
 // - these all get printed with "printHighlights"
 // - get output to the json for later use
 const std::vector<std::string> fhv_key_metrics = {
+  runtime_metric_name,
   mflops_metric_name,
   mflops_dp_metric_name,
   l2_bandwidth_metric_name,
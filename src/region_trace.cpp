@@ -0,0 +1,261 @@
+#include "region_trace.hpp"
+
+#include <algorithm>
+#include <fmt/core.h>
+#include <fstream>
+#include <set>
+#include <tuple>
+
+#include "utils.hpp"
+
+// one buffer per thread, each allocated separately so threads recording at
+// the same time don't write to the same cache lines
+static std::vector<std::unique_ptr<fhv::trace::ThreadTrace>> thread_traces;
+static bool trace_enabled = false;
+
+// reference points used to convert TSC ticks to time
+static uint64_t start_tsc = 0;
+static std::chrono::steady_clock::time_point start_time;
+
+// ===== recording =====
+uint32_t fhv::trace::ThreadTrace::regionIndex(const char *region_name)
+{
+  auto inserted = region_indices.emplace(region_name,
+    static_cast<uint32_t>(region_names.size()));
+  if (inserted.second) region_names.push_back(region_name);
+
+  return inserted.first->second;
+}
+
+void fhv::trace::enable(int num_threads)
+{
+  thread_traces.clear();
+  for (int t = 0; t < num_threads; t++)
+  {
+    thread_traces.emplace_back(new ThreadTrace());
+    thread_traces.back()->records.reserve(initial_records_per_thread);
+  }
+
+  start_time = std::chrono::steady_clock::now();
+  start_tsc = readTsc();
+  trace_enabled = true;
+}
+
+bool fhv::trace::enabled()
+{
+  return trace_enabled;
+}
+
+void fhv::trace::disable()
+{
+  trace_enabled = false;
+  thread_traces.clear();
+}
+
+void fhv::trace::recordBegin(
+  int thread_num,
+  const char *region_name,
+  uint64_t tsc)
+{
+  if (!trace_enabled || thread_num < 0
+      || static_cast<size_t>(thread_num) >= thread_traces.size())
+    return;
+
+  ThreadTrace &trace = *thread_traces[thread_num];
+  trace.records.push_back({
+    .tsc = tsc,
+    .region = trace.regionIndex(region_name),
+    .phase = phase_t::begin,
+    .group = -1,
+    .first_counter = 0,
+    .num_counters = 0,
+  });
+}
+
+void fhv::trace::recordEnd(
+  int thread_num,
+  const char *region_name,
+  uint64_t tsc,
+  int group,
+  const double *totals,
+  int num_totals)
+{
+  if (!trace_enabled || thread_num < 0
+      || static_cast<size_t>(thread_num) >= thread_traces.size())
+    return;
+
+  ThreadTrace &trace = *thread_traces[thread_num];
+  TraceRecord record = {
+    .tsc = tsc,
+    .region = trace.regionIndex(region_name),
+    .phase = phase_t::end,
+    .group = group,
+    .first_counter = static_cast<uint32_t>(trace.counters.size()),
+    .num_counters = 0,
+  };
+
+  if (totals != nullptr && num_totals > 0)
+  {
+    auto &last = trace.last_totals[{record.region, group}];
+    last.resize(num_totals, 0.0);
+    for (int i = 0; i < num_totals; i++)
+    {
+      trace.counters.push_back(totals[i] - last[i]);
+      last[i] = totals[i];
+    }
+    record.num_counters = static_cast<uint32_t>(num_totals);
+  }
+
+  trace.records.push_back(record);
+}
+
+// ===== export =====
+double fhv::trace::tscTicksPerMicrosecond()
+{
+  std::chrono::duration<double, std::micro> elapsed =
+    std::chrono::steady_clock::now() - start_time;
+  uint64_t ticks = readTsc() - start_tsc;
+
+  if (elapsed.count() <= 0.0 || ticks == 0) return 1.0;
+  return static_cast<double>(ticks) / elapsed.count();
+}
+
+std::vector<int> fhv::trace::recordedGroups()
+{
+  std::set<int> groups;
+  for (const auto &trace : thread_traces)
+    for (const auto &record : trace->records)
+      if (record.phase == phase_t::end && record.group >= 0)
+        groups.insert(record.group);
+
+  return std::vector<int>(groups.begin(), groups.end());
+}
+
+json fhv::trace::toChromeTrace(
+  const std::vector<int> &hardware_thread_ids,
+  const std::map<int, std::vector<std::string>> &group_event_names,
+  const std::map<int, std::string> &group_names,
+  int pid)
+{
+  double ticks_per_us = tscTicksPerMicrosecond();
+  auto timestamp = [&](uint64_t tsc) {
+    return static_cast<double>(static_cast<int64_t>(tsc - start_tsc))
+      / ticks_per_us;
+  };
+
+  json events = json::array();
+  for (size_t t = 0; t < thread_traces.size(); t++)
+  {
+    const ThreadTrace &trace = *thread_traces[t];
+    if (trace.records.empty()) continue;
+
+    // tracks are named after the hardware thread and ordered by it, so
+    // neighbouring cores end up next to each other
+    int hardware_thread = t < hardware_thread_ids.size()
+      ? hardware_thread_ids[t] : static_cast<int>(t);
+    events.push_back({
+      {"name", "thread_name"}, {"ph", "M"}, {"pid", pid}, {"tid", t},
+      {"args", {{"name", fmt::format("thread {} (hardware thread {})", t,
+        hardware_thread)}}},
+    });
+    events.push_back({
+      {"name", "thread_sort_index"}, {"ph", "M"}, {"pid", pid}, {"tid", t},
+      {"args", {{"sort_index", hardware_thread}}},
+    });
+
+    // (region, begin timestamp) of the instances still running
+    std::vector<std::pair<uint32_t, double>> open_instances;
+
+    for (const auto &record : trace.records)
+    {
+      const std::string &region_name = trace.region_names[record.region];
+      double ts = timestamp(record.tsc);
+
+      json event = {
+        {"name", region_name},
+        {"ph", record.phase == phase_t::begin ? "B" : "E"},
+        {"ts", ts},
+        {"pid", pid},
+        {"tid", t},
+      };
+
+      if (record.phase == phase_t::begin)
+      {
+        open_instances.push_back({record.region, ts});
+        events.push_back(event);
+        continue;
+      }
+
+      double begin_ts = ts;
+      for (auto it = open_instances.rbegin(); it != open_instances.rend(); ++it)
+      {
+        if (it->first != record.region) continue;
+        begin_ts = it->second;
+        open_instances.erase(std::next(it).base());
+        break;
+      }
+
+      auto event_names = group_event_names.find(record.group);
+      if (record.num_counters > 0 && event_names != group_event_names.end())
+      {
+        json args = json::object();
+        auto group_name = group_names.find(record.group);
+        if (group_name != group_names.end())
+          args["group"] = group_name->second;
+
+        for (uint32_t i = 0; i < record.num_counters
+            && i < event_names->second.size(); i++)
+        {
+          const std::string &event_name = event_names->second[i];
+          double value = trace.counters[record.first_counter + i];
+          args[event_name] = value;
+
+          // the counter tracks hold the value of the instance while it runs
+          std::string track = fmt::format("{} (thread {})", event_name, t);
+          events.push_back({
+            {"name", track}, {"ph", "C"}, {"ts", begin_ts}, {"pid", pid},
+            {"args", {{region_name, value}}},
+          });
+          events.push_back({
+            {"name", track}, {"ph", "C"}, {"ts", ts}, {"pid", pid},
+            {"args", {{region_name, 0}}},
+          });
+        }
+        event["args"] = args;
+      }
+
+      events.push_back(event);
+    }
+  }
+
+  json trace_json;
+  trace_json[chrome_trace_events_key] = events;
+  trace_json[chrome_trace_time_unit_key] = "ns";
+  trace_json[chrome_trace_other_data_key] = {
+    {"clock", "TSC"},
+    {"tsc_ticks_per_us", ticks_per_us},
+  };
+
+  return trace_json;
+}
+
+bool fhv::trace::writeChromeTrace(
+  const std::string &filename,
+  const std::vector<int> &hardware_thread_ids,
+  const std::map<int, std::vector<std::string>> &group_event_names,
+  const std::map<int, std::string> &group_names,
+  int pid)
+{
+  fhv::utils::create_directories_for_file(filename);
+
+  std::ofstream o(filename);
+  o << toChromeTrace(hardware_thread_ids, group_event_names, group_names, pid)
+    << std::endl;
+  if (!o) {
+    fmt::print(stderr, "ERROR: could not write the trace to '{}'\n",
+      filename);
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <x86intrin.h>
+
+using json = nlohmann::json;
+
+/* ---- region trace ----
+ * records when each thread enters and leaves each region, so the timeline of
+ * a run can be exported in the Chrome Trace Event format and opened in
+ * Perfetto or chrome://tracing.
+ *
+ * Every thread appends to its own buffer, so recording takes no locks: a
+ * timestamp counter read and a push_back. Region names are interned per
+ * thread and counter values go to a flat array, so the buffers only allocate
+ * when they grow.
+ */
+namespace fhv {
+  namespace trace {
+    // keys of the Chrome Trace Event format
+    const std::string chrome_trace_events_key = "traceEvents";
+    const std::string chrome_trace_time_unit_key = "displayTimeUnit";
+    const std::string chrome_trace_other_data_key = "otherData";
+
+    // records reserved per thread up front
+    const size_t initial_records_per_thread = 1 << 14;
+
+    enum class phase_t { begin, end };
+
+    // one region begin or end on one thread
+    struct TraceRecord {
+      uint64_t tsc;
+      // index into ThreadTrace::region_names
+      uint32_t region;
+      phase_t phase;
+      // likwid group measured by the region instance, -1 if unknown
+      int group;
+      // the counter values of the instance ending here are
+      // ThreadTrace::counters[first_counter, first_counter + num_counters)
+      uint32_t first_counter;
+      uint32_t num_counters;
+    };
+
+    struct ThreadTrace {
+      std::vector<std::string> region_names;
+      std::unordered_map<std::string, uint32_t> region_indices;
+      std::vector<TraceRecord> records;
+      std::vector<double> counters;
+      // counters are reported as totals since the start of the run, so the
+      // totals at the last end of each (region, group) are kept to get the
+      // values of a single instance
+      std::map<std::pair<uint32_t, int>, std::vector<double>> last_totals;
+
+      uint32_t regionIndex(const char *region_name);
+    };
+
+    // the timestamp counter of the calling core. Modern x86 processors have
+    // an invariant TSC that ticks at a constant rate and is synchronized
+    // across cores.
+    inline uint64_t readTsc() { return __rdtsc(); }
+
+    /* ---- enable ----
+     * starts recording for num_threads threads. Recording functions do
+     * nothing until this is called.
+     */
+    void enable(int num_threads);
+    bool enabled();
+
+    // drops every record and stops recording
+    void disable();
+
+    // tsc is passed in so callers can read it as close as possible to the
+    // start or end of the measured code
+    void recordBegin(int thread_num, const char *region_name, uint64_t tsc);
+
+    /* ---- record end ----
+     * num_totals counter values may be given with the totals accumulated by
+     * this region on this thread in group so far. The values of just this
+     * instance are stored with the record.
+     */
+    void recordEnd(
+      int thread_num,
+      const char *region_name,
+      uint64_t tsc,
+      int group = -1,
+      const double *totals = nullptr,
+      int num_totals = 0);
+
+    // TSC ticks per microsecond, measured from when recording was enabled
+    // until now
+    double tscTicksPerMicrosecond();
+
+    /* ---- to chrome trace ----
+     * the recorded timeline as a Chrome Trace Event json:
+     *  - a "B"/"E" pair per region instance, on one track per thread. Tracks
+     *    are named after the hardware thread in hardware_thread_ids (indexed
+     *    by thread number) and sorted by it.
+     *  - end events carry the counter values of the instance as arguments,
+     *    named by group_event_names[group]
+     *  - one counter ("C") track per thread and event, with a series per
+     *    region that holds the value of the running instance
+     *
+     * pid is used as the process id, e.g. the rank of an MPI process.
+     */
+    json toChromeTrace(
+      const std::vector<int> &hardware_thread_ids,
+      const std::map<int, std::vector<std::string>> &group_event_names,
+      const std::map<int, std::string> &group_names,
+      int pid = 0);
+
+    // group ids of every recorded instance
+    std::vector<int> recordedGroups();
+
+    // writes toChromeTrace to filename. Returns false if it can't be written
+    bool writeChromeTrace(
+      const std::string &filename,
+      const std::vector<int> &hardware_thread_ids,
+      const std::map<int, std::vector<std::string>> &group_event_names,
+      const std::map<int, std::string> &group_names,
+      int pid = 0);
+  };
+};
@@ -0,0 +1,351 @@
+#include "regression_check.hpp"
+
+#include <cmath>
+#include <fnmatch.h>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+#include "binary_results.hpp"
+#include "result_stream.hpp"
+#include "result_summary.hpp"
+
+// ===== rule_t things =====
+std::string fhv::check::ruleTypeToString(const rule_t &rule_type)
+{
+  if (rule_type == rule_t::floor)
+    return thresholds_min_key;
+  else if (rule_type == rule_t::ratio_to_baseline)
+    return thresholds_min_ratio_key;
+  else if (rule_type == rule_t::noise_band)
+    return thresholds_tolerance_key;
+  else
+    return "unknown_rule_type";
+}
+
+// ===== ThresholdRule function definitions =====
+bool fhv::check::ThresholdRule::matchesRegion(
+    const std::string &region_name) const
+{
+  return fnmatch(this->region_pattern.c_str(), region_name.c_str(), 0) == 0;
+}
+
+std::string fhv::check::ThresholdRule::toString() const
+{
+  return fmt::format("{}/{}/{} {} {}", this->region_pattern,
+    this->aggregation_name, this->result_name,
+    ruleTypeToString(this->rule_type), this->threshold);
+}
+
+// ===== CheckResult function definitions =====
+std::string fhv::check::CheckResult::toString() const
+{
+  std::string status = this->passed ? "PASS" : "FAIL";
+
+  if (!this->message.empty())
+    return fmt::format("{} {} [{}]: {}", status, this->rule->toString(),
+      this->region_name, this->message);
+
+  if (this->rule->rule_type == rule_t::floor)
+    return fmt::format("{} {} [{}]: value {:.4g}", status,
+      this->rule->toString(), this->region_name, this->value);
+
+  return fmt::format("{} {} [{}]: value {:.4g}, baseline {:.4g}, ratio {:.4f}",
+    status, this->rule->toString(), this->region_name, this->value,
+    this->baseline_value, this->value / this->baseline_value);
+}
+
+// ===== loading =====
+bool fhv::check::loadThresholds(
+    const std::string &filename,
+    threshold_rules_t &rules)
+{
+  std::ifstream i(filename);
+  if (!i) {
+    fmt::print(stderr, "ERROR: the thresholds file '{}' does not exist!\n",
+      filename);
+    return false;
+  }
+
+  json j;
+  try {
+    i >> j;
+
+    for (const auto &rule_json : j.at(thresholds_rules_key))
+    {
+      ThresholdRule rule;
+      rule.region_pattern = rule_json.value(thresholds_region_key, "*");
+      rule.result_name = rule_json.at(thresholds_metric_key).get<std::string>();
+
+      // saturation metrics only exist in the saturation section, so that is
+      // the natural default for them
+      std::string default_aggregation = fhv::types::aggregationTypeToString(
+          fhv::types::aggregation_t::sum);
+      for (const auto &saturation_metric : fhv_saturation_metric_names)
+      {
+        if (rule.result_name == saturation_metric)
+          default_aggregation = fhv::types::aggregationTypeToString(
+              fhv::types::aggregation_t::saturation);
+      }
+      rule.aggregation_name =
+        rule_json.value(thresholds_aggregation_key, default_aggregation);
+      rule.baseline_value = rule_json.value(thresholds_baseline_key,
+        std::numeric_limits<double>::quiet_NaN());
+
+      bool has_condition = false;
+      for (const auto &rule_type :
+           {rule_t::floor, rule_t::ratio_to_baseline, rule_t::noise_band})
+      {
+        auto threshold = rule_json.find(ruleTypeToString(rule_type));
+        if (threshold == rule_json.end()) continue;
+
+        rule.rule_type = rule_type;
+        rule.threshold = threshold->get<double>();
+        rules.push_back(rule);
+        has_condition = true;
+      }
+
+      if (!has_condition)
+        fmt::print(stderr, "WARN: rule for metric '{}' in '{}' has none of "
+          "'{}', '{}' or '{}' and will be ignored.\n", rule.result_name,
+          filename, thresholds_min_key, thresholds_min_ratio_key,
+          thresholds_tolerance_key);
+    }
+  }
+  catch (json::exception &e) {
+    fmt::print(stderr, "ERROR: could not read thresholds from '{}': {}\n",
+      filename, e.what());
+    return false;
+  }
+
+  return true;
+}
+
+bool fhv::check::loadResults(const std::string &filename, json &results)
+{
+  if (fhv::stream::isStream(filename))
+    return fhv::binary::loadResults(filename, results, false);
+
+  // binary files are read from their columns, like for the diagrams
+  if (fhv::binary::isBinaryResults(filename))
+  {
+    fhv::summary::ResultsSummary summary;
+    if (!fhv::summary::loadSummary(filename, summary)) return false;
+
+    results[json_info_section] = std::move(summary.info);
+    results[json_results_section] = json::object();
+    for (auto &region : summary.regions)
+      results[json_results_section][region.name] = std::move(region.sections);
+    return true;
+  }
+
+  std::ifstream i(filename);
+  if (!i) {
+    fmt::print(stderr, "ERROR: the json '{}' does not exist!\n", filename);
+    return false;
+  }
+
+  // per-thread sections make up most of a perfmon json on machines with many
+  // threads, and no rule looks at them. Region sections are keys at depth 3:
+  // top level -> region_results -> region -> section
+  json::parser_callback_t skip_thread_sections =
+    [](int depth, json::parse_event_t event, json &parsed) {
+      if (event == json::parse_event_t::key && depth == 3)
+      {
+        const auto &key = parsed.get_ref<const std::string&>();
+        return key.compare(0, json_thread_section_base.size(),
+                           json_thread_section_base) != 0;
+      }
+      return true;
+    };
+
+  try {
+    results = json::parse(i, skip_thread_sections);
+  }
+  catch (json::parse_error &e) {
+    fmt::print(stderr, "ERROR: could not parse '{}': {}\n", filename,
+      e.what());
+    return false;
+  }
+
+  return true;
+}
+
+// ===== evaluating =====
+
+// finds region_data[aggregation_name][result_name] if it is a number
+static bool findValue(
+    const json &region_data,
+    const std::string &aggregation_name,
+    const std::string &result_name,
+    double &value)
+{
+  auto section = region_data.find(aggregation_name);
+  if (section == region_data.end()) return false;
+
+  auto result = section->find(result_name);
+  if (result == section->end() || !result->is_number()) return false;
+
+  value = result->get<double>();
+  return true;
+}
+
+fhv::check::check_results_t fhv::check::evaluateRules(
+    const threshold_rules_t &rules,
+    const json &results,
+    const json *baseline_data)
+{
+  check_results_t check_results;
+
+  auto regions = results.find(json_results_section);
+  if (regions == results.end()) return check_results;
+
+  for (const auto &rule : rules)
+  {
+    bool matched_any_region = false;
+
+    for (const auto &region : regions->items())
+    {
+      if (!rule.matchesRegion(region.key())) continue;
+      matched_any_region = true;
+
+      CheckResult check_result = {
+        .rule = &rule,
+        .region_name = region.key(),
+        .value = NAN,
+        .baseline_value = rule.baseline_value,
+        .passed = false,
+        .message = "",
+      };
+
+      if (!findValue(region.value(), rule.aggregation_name, rule.result_name,
+                     check_result.value))
+      {
+        check_result.message = "metric missing from results";
+        check_results.push_back(check_result);
+        continue;
+      }
+
+      if (rule.rule_type == rule_t::floor)
+      {
+        check_result.passed = check_result.value >= rule.threshold;
+        check_results.push_back(check_result);
+        continue;
+      }
+
+      // remaining rules are relative to a baseline
+      if (std::isnan(check_result.baseline_value))
+      {
+        bool found_baseline = false;
+        if (baseline_data != nullptr)
+        {
+          auto baseline_regions = baseline_data->find(json_results_section);
+          if (baseline_regions != baseline_data->end()
+              && baseline_regions->contains(region.key()))
+          {
+            found_baseline = findValue(baseline_regions->at(region.key()),
+              rule.aggregation_name, rule.result_name,
+              check_result.baseline_value);
+          }
+        }
+
+        if (!found_baseline)
+        {
+          check_result.message = "no baseline value for this metric";
+          check_results.push_back(check_result);
+          continue;
+        }
+      }
+
+      if (rule.rule_type == rule_t::ratio_to_baseline)
+      {
+        check_result.passed =
+          check_result.value >= rule.threshold * check_result.baseline_value;
+      }
+      else if (rule.rule_type == rule_t::noise_band)
+      {
+        check_result.passed = std::abs(check_result.value
+          - check_result.baseline_value)
+          <= rule.threshold * std::abs(check_result.baseline_value);
+      }
+
+      check_results.push_back(check_result);
+    }
+
+    // a rule that checks nothing is almost always a typo or a region that
+    // stopped being measured, both of which a CI gate should catch
+    if (!matched_any_region)
+    {
+      CheckResult check_result = {
+        .rule = &rule,
+        .region_name = rule.region_pattern,
+        .value = NAN,
+        .baseline_value = NAN,
+        .passed = false,
+        .message = "no region matches this rule",
+      };
+      check_results.push_back(check_result);
+    }
+  }
+
+  return check_results;
+}
+
+int fhv::check::checkFiles(
+    const std::vector<std::string> &result_filenames,
+    const std::string &thresholds_filename,
+    const std::string &baseline_filename)
+{
+  threshold_rules_t rules;
+  if (!loadThresholds(thresholds_filename, rules)) return 2;
+
+  json baseline;
+  const json *baseline_ptr = nullptr;
+  if (!baseline_filename.empty())
+  {
+    if (!loadResults(baseline_filename, baseline)) return 2;
+    baseline_ptr = &baseline;
+  }
+
+  int return_code = 0;
+  size_t num_failed_files = 0;
+
+  for (const auto &filename : result_filenames)
+  {
+    json results;
+    if (!loadResults(filename, results))
+    {
+      return_code = 2;
+      num_failed_files++;
+      continue;
+    }
+
+    auto check_results = evaluateRules(rules, results, baseline_ptr);
+
+    size_t num_violations = 0;
+    for (const auto &check_result : check_results)
+      if (!check_result.passed) num_violations++;
+
+    // passing files get one line; failing files also list what failed
+    fmt::print("{} {}: {} of {} checks passed\n",
+      num_violations == 0 ? "PASS" : "FAIL", filename,
+      check_results.size() - num_violations, check_results.size());
+
+    for (const auto &check_result : check_results)
+    {
+      if (!check_result.passed)
+        fmt::print("  {}\n", check_result.toString());
+    }
+
+    if (num_violations > 0)
+    {
+      num_failed_files++;
+      if (return_code == 0) return_code = 1;
+    }
+  }
+
+  fmt::print("{} of {} files passed\n",
+    result_filenames.size() - num_failed_files, result_filenames.size());
+
+  return return_code;
+}
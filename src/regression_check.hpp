@@ -0,0 +1,94 @@
+#pragma once
+
+#include <fmt/core.h>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+#include "performance_monitor_defines.hpp"
+#include "types.hpp"
+
+using json = nlohmann::json;
+
+namespace fhv {
+  namespace check {
+    // keys used in the thresholds file. See docs/usage.md for the format.
+    const std::string thresholds_rules_key = "rules";
+    const std::string thresholds_region_key = "region";
+    const std::string thresholds_aggregation_key = "aggregation";
+    const std::string thresholds_metric_key = "metric";
+    const std::string thresholds_baseline_key = "baseline";
+    const std::string thresholds_min_key = "min";
+    const std::string thresholds_min_ratio_key = "min_ratio";
+    const std::string thresholds_tolerance_key = "tolerance";
+
+    enum class rule_t {
+      // value >= threshold
+      floor,
+      // value >= threshold * baseline
+      ratio_to_baseline,
+      // |value / baseline - 1| <= threshold
+      noise_band
+    };
+
+    std::string ruleTypeToString(const rule_t &rule_type);
+
+    // a single condition from the thresholds file. A rule object in the file
+    // with more than one of "min", "min_ratio" and "tolerance" becomes more
+    // than one ThresholdRule.
+    struct ThresholdRule {
+      // may contain shell-style wildcards, e.g. "*" or "poly_*"
+      std::string region_pattern;
+      std::string aggregation_name;
+      std::string result_name;
+      rule_t rule_type;
+      double threshold;
+
+      // NAN if the baseline should come from a baseline json instead
+      double baseline_value;
+
+      bool matchesRegion(const std::string &region_name) const;
+      std::string toString() const;
+    };
+
+    typedef std::vector<ThresholdRule> threshold_rules_t;
+
+    // the outcome of applying one rule to one region of one file
+    struct CheckResult {
+      const ThresholdRule *rule;
+      std::string region_name;
+      double value;
+      double baseline_value;
+      bool passed;
+      // explains failures, e.g. missing data
+      std::string message;
+
+      std::string toString() const;
+    };
+
+    typedef std::vector<CheckResult> check_results_t;
+
+    // returns false and prints the problem if the file could not be read or
+    // is malformed
+    bool loadThresholds(const std::string &filename, threshold_rules_t &rules);
+
+    // loads a json or binary results file output by fhv_perfmon, skipping
+    // per-thread sections since rules only apply to aggregate results.
+    // Returns false on failure.
+    bool loadResults(const std::string &filename, json &results);
+
+    // baseline_data may be null if every rule that needs a baseline has a
+    // "baseline" value in the thresholds file
+    check_results_t evaluateRules(
+        const threshold_rules_t &rules,
+        const json &results,
+        const json *baseline_data);
+
+    // checks every file and prints a compact report. Returns 0 if every rule
+    // passed, 1 if any rule was violated and 2 if a file could not be read.
+    int checkFiles(
+        const std::vector<std::string> &result_filenames,
+        const std::string &thresholds_filename,
+        const std::string &baseline_filename = "");
+  };
+};
@@ -0,0 +1,201 @@
+#include "render_cache.hpp"
+
+#include <cstdio>
+#include <fmt/core.h>
+#include <fstream>
+#include <sys/stat.h>
+
+#include "utils.hpp"
+
+// ===== hashing =====
+uint64_t fhv::cache::hashBytes(const char *data, size_t size, uint64_t hash)
+{
+  const uint64_t prime = 0x100000001b3ULL;
+  for (size_t i = 0; i < size; i++)
+  {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= prime;
+  }
+
+  return hash;
+}
+
+uint64_t fhv::cache::hashString(const std::string &text, uint64_t hash)
+{
+  return hashBytes(text.data(), text.size(), hash);
+}
+
+bool fhv::cache::hashFile(
+  const std::string &filename,
+  uint64_t &hash,
+  uint64_t seed)
+{
+  std::ifstream i(filename, std::ios::binary);
+  if (!i) return false;
+
+  hash = seed;
+  char buffer[1 << 16];
+  while (i)
+  {
+    i.read(buffer, sizeof(buffer));
+    hash = hashBytes(buffer, static_cast<size_t>(i.gcount()), hash);
+  }
+
+  return i.eof();
+}
+
+std::string fhv::cache::hashToString(uint64_t hash)
+{
+  return fmt::format("{:016x}", hash);
+}
+
+json fhv::cache::fileStamp(const std::string &filename)
+{
+  struct stat file_stat;
+  if (stat(filename.c_str(), &file_stat) != 0) return nullptr;
+
+  long long modified = static_cast<long long>(file_stat.st_mtim.tv_sec)
+    * 1000000000LL + file_stat.st_mtim.tv_nsec;
+
+  return {
+    {render_cache_size_key, static_cast<long long>(file_stat.st_size)},
+    {render_cache_modified_key, modified},
+  };
+}
+
+// ===== index =====
+static json emptyIndex()
+{
+  return {
+    {fhv::cache::render_cache_version_key, fhv::cache::renderer_version},
+    {fhv::cache::render_cache_outputs_key, json::object()},
+    {fhv::cache::render_cache_inputs_key, json::object()},
+  };
+}
+
+json fhv::cache::loadIndex(const std::string &filename)
+{
+  std::ifstream i(filename);
+  if (!i) return emptyIndex();
+
+  json index;
+  try {
+    i >> index;
+  }
+  catch (json::parse_error &e) {
+    fmt::print(stderr, "WARN: could not parse the render cache '{}', every "
+      "diagram will be drawn: {}\n", filename, e.what());
+    return emptyIndex();
+  }
+
+  if (!index.is_object()
+      || index.value(render_cache_version_key, 0u) != renderer_version
+      || !index.contains(render_cache_outputs_key)
+      || !index.contains(render_cache_inputs_key))
+    return emptyIndex();
+
+  return index;
+}
+
+bool fhv::cache::saveIndex(const std::string &filename, json &index)
+{
+  json &outputs = index[render_cache_outputs_key];
+  for (auto it = outputs.begin(); it != outputs.end();)
+  {
+    if (fileStamp(it.key()).is_null())
+      it = outputs.erase(it);
+    else
+      ++it;
+  }
+
+  fhv::utils::create_directories_for_file(filename);
+
+  std::string temporary_filename = filename + ".tmp";
+  {
+    std::ofstream o(temporary_filename);
+    o << index << std::endl;
+    if (!o) {
+      fmt::print(stderr, "ERROR: could not write the render cache '{}'\n",
+        temporary_filename);
+      return false;
+    }
+  }
+
+  if (std::rename(temporary_filename.c_str(), filename.c_str()) != 0) {
+    fmt::print(stderr, "ERROR: could not write the render cache '{}'\n",
+      filename);
+    return false;
+  }
+
+  return true;
+}
+
+bool fhv::cache::outputUpToDate(
+  const json &index,
+  const std::string &output_filename,
+  const std::string &hash)
+{
+  const json &outputs = index.at(render_cache_outputs_key);
+  auto entry = outputs.find(output_filename);
+  if (entry == outputs.end()
+      || entry->value(render_cache_hash_key, "") != hash)
+    return false;
+
+  json stamp = fileStamp(output_filename);
+  return !stamp.is_null()
+    && stamp[render_cache_size_key] == entry->value(render_cache_size_key, -1LL)
+    && stamp[render_cache_modified_key]
+      == entry->value(render_cache_modified_key, -1LL);
+}
+
+void fhv::cache::recordOutput(
+  json &index,
+  const std::string &output_filename,
+  const std::string &hash)
+{
+  json stamp = fileStamp(output_filename);
+  if (stamp.is_null()) {
+    index[render_cache_outputs_key].erase(output_filename);
+    return;
+  }
+
+  stamp[render_cache_hash_key] = hash;
+  index[render_cache_outputs_key][output_filename] = stamp;
+}
+
+bool fhv::cache::inputUpToDate(
+  const json &index,
+  const std::string &input_filename,
+  const std::string &hash)
+{
+  const json &inputs = index.at(render_cache_inputs_key);
+  auto entry = inputs.find(input_filename);
+  if (entry == inputs.end()
+      || entry->value(render_cache_hash_key, "") != hash
+      || !entry->contains(render_cache_outputs_key))
+    return false;
+
+  const json &outputs = index.at(render_cache_outputs_key);
+  for (const auto &output : entry->at(render_cache_outputs_key))
+  {
+    auto output_entry = outputs.find(output.get<std::string>());
+    if (output_entry == outputs.end()
+        || !outputUpToDate(index, output,
+          output_entry->value(render_cache_hash_key, "")))
+      return false;
+  }
+
+  return true;
+}
+
+void fhv::cache::recordInput(
+  json &index,
+  const std::string &input_filename,
+  const std::string &hash,
+  const std::vector<std::string> &output_filenames)
+{
+  index[render_cache_inputs_key][input_filename] = {
+    {render_cache_hash_key, hash},
+    {render_cache_outputs_key, output_filenames},
+  };
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+/* ---- render cache ----
+ * lets '--visualize' skip diagrams that are already up to date. Every
+ * diagram is keyed by a hash of everything it is drawn from: the region's
+ * results, the info section shown in its description, the color scale, the
+ * renderer and its settings, and renderer_version. The key and a stamp
+ * (size and modification time) of each output file are kept in a json
+ * index, so a diagram is only redrawn if its key changed or its file was
+ * deleted or modified since it was drawn.
+ *
+ * Inputs are also recorded with a hash of their contents and the outputs
+ * drawn from them, so unchanged jsons don't even have to be parsed.
+ */
+namespace fhv {
+  namespace cache {
+    const std::string render_cache_default_filename = "fhv_render_cache.json";
+
+    // bump whenever a change to the drawing code changes how diagrams look,
+    // so every cached diagram is drawn again
+    const unsigned renderer_version = 1;
+
+    // keys of the index
+    const std::string render_cache_version_key = "renderer_version";
+    const std::string render_cache_outputs_key = "outputs";
+    const std::string render_cache_inputs_key = "inputs";
+    const std::string render_cache_hash_key = "hash";
+    const std::string render_cache_size_key = "size";
+    const std::string render_cache_modified_key = "modified";
+
+    // 64-bit FNV-1a. Fast, and collisions don't matter for a cache of a few
+    // thousand files.
+    const uint64_t hash_seed = 0xcbf29ce484222325ULL;
+    uint64_t hashBytes(const char *data, size_t size,
+      uint64_t hash = hash_seed);
+    uint64_t hashString(const std::string &text, uint64_t hash = hash_seed);
+
+    // hash of the contents of filename. Returns false if it can't be read.
+    bool hashFile(const std::string &filename, uint64_t &hash,
+      uint64_t seed = hash_seed);
+
+    // 16 hex digits
+    std::string hashToString(uint64_t hash);
+
+    /* ---- file stamp ----
+     * size and modification time (in nanoseconds) of a file, as json, or
+     * null if it doesn't exist
+     */
+    json fileStamp(const std::string &filename);
+
+    /* ---- load index ----
+     * an empty index if filename doesn't exist, can't be parsed or was
+     * written by another renderer_version
+     */
+    json loadIndex(const std::string &filename);
+
+    /* ---- save index ----
+     * drops the outputs that no longer exist and writes the index. It is
+     * written to a temporary file first, so an interrupted run never leaves
+     * a broken index behind.
+     */
+    bool saveIndex(const std::string &filename, json &index);
+
+    // true if output was drawn with key hash and hasn't changed since
+    bool outputUpToDate(
+      const json &index,
+      const std::string &output_filename,
+      const std::string &hash);
+
+    // stores hash and the stamp of output_filename, if it exists
+    void recordOutput(
+      json &index,
+      const std::string &output_filename,
+      const std::string &hash);
+
+    // true if input had the same hash when outputs were last drawn from it
+    // and every one of them is still up to date
+    bool inputUpToDate(
+      const json &index,
+      const std::string &input_filename,
+      const std::string &hash);
+
+    void recordInput(
+      json &index,
+      const std::string &input_filename,
+      const std::string &hash,
+      const std::vector<std::string> &output_filenames);
+  };
+};
@@ -0,0 +1,247 @@
+#include "render_context.hpp"
+
+#include <cairo-pdf.h>
+#include <fmt/core.h>
+
+#include "cairo_canvas.hpp"
+#include "svg_canvas.hpp"
+
+namespace {
+  // color_lut of a context with an unknown color scale
+  const std::vector<rgb_color> no_colors;
+
+  const std::vector<rgb_color> &find_color_lut(const std::string &name)
+  {
+    auto color_lut = saturation_diagram::color_scale_lut(name);
+    if (color_lut == nullptr) {
+      fmt::print(stderr, "render_context: Bad colorscale specified!\n");
+      return no_colors;
+    }
+
+    return *color_lut;
+  }
+}
+
+render_context::render_context(
+  std::string color_scale,
+  render_backend backend)
+  : color_scale(color_scale),
+    backend(backend),
+    color_lut(find_color_lut(color_scale)),
+    machine_stats(fhv::config::loadMachineStats()),
+    pango_context(nullptr),
+    document_surface(nullptr),
+    document_cr(nullptr)
+{
+  auto make_font = [](font_role role) {
+    return pango_font_description_from_string(fmt::format("{} {:g}",
+      diagram_font_family, font_size(role)).c_str());
+  };
+
+  title_font = make_font(font_role::TITLE);
+  description_font = make_font(font_role::DESCRIPTION);
+  big_label_font = make_font(font_role::BIG_LABEL);
+  small_label_font = make_font(font_role::SMALL_LABEL);
+}
+
+render_context::~render_context()
+{
+  end_document();
+  end_animation();
+
+  for (auto &cached : layout_cache)
+    g_object_unref(cached.second);
+
+  if (pango_context != nullptr)
+    g_object_unref(pango_context);
+
+  pango_font_description_free(title_font);
+  pango_font_description_free(description_font);
+  pango_font_description_free(big_label_font);
+  pango_font_description_free(small_label_font);
+}
+
+rgb_color render_context::color(double t) const
+{
+  return saturation_diagram::discrete_color(color_lut, t);
+}
+
+std::unique_ptr<diagram_canvas> render_context::create_canvas(
+  const std::string &output_filename,
+  double width,
+  double height)
+{
+  if (document_cr != nullptr)
+  {
+    cairo_pdf_surface_set_size(document_surface, width, height);
+    return std::unique_ptr<diagram_canvas>(
+      new cairo_canvas(*this, document_cr, true));
+  }
+
+  if (animation != nullptr)
+    return std::unique_ptr<diagram_canvas>(
+      new svg_canvas(*animation, width, height));
+
+  if (draws_svg(output_filename))
+    return std::unique_ptr<diagram_canvas>(
+      new svg_canvas(output_filename, width, height));
+
+  return std::unique_ptr<diagram_canvas>(
+    new cairo_canvas(*this, output_filename, width, height, dpi));
+}
+
+bool render_context::draws_svg(const std::string &output_filename) const
+{
+  if (document_cr != nullptr) return false;
+  if (animation != nullptr) return true;
+
+  return backend == render_backend::svg
+    && imageFormatFromFilename(output_filename) == image_format::svg;
+}
+
+double render_context::text_height(
+  const std::string &output_filename,
+  const std::string &text,
+  font_role font,
+  double width)
+{
+  if (draws_svg(output_filename))
+    return svg_text_metrics::text_height(text, width, font);
+
+  // laid out like pango_cairo_draw_text, but not cached: this text is only
+  // measured once
+  PangoLayout *layout = pango_layout_new(get_pango_context());
+  saturation_diagram::pango_cairo_make_text_layout(layout, this->font(font),
+    text, width);
+  double height = saturation_diagram::pango_layout_cairo_height(layout);
+  g_object_unref(layout);
+
+  return height;
+}
+
+bool render_context::begin_document(const std::string &output_filename)
+{
+  end_document();
+
+  // every page sets its own size before anything is drawn on it
+  document_surface = cairo_pdf_surface_create(output_filename.c_str(),
+    geometry.image_width, geometry.image_height);
+  if (cairo_surface_status(document_surface) != CAIRO_STATUS_SUCCESS)
+  {
+    fmt::print(stderr, "ERROR: could not create {}: {}\n", output_filename,
+      cairo_status_to_string(cairo_surface_status(document_surface)));
+    cairo_surface_destroy(document_surface);
+    document_surface = nullptr;
+    return false;
+  }
+
+  document_cr = cairo_create(document_surface);
+  document_filename = output_filename;
+  return true;
+}
+
+bool render_context::end_document()
+{
+  if (document_surface == nullptr) return true;
+
+  // writes the rest of the file
+  cairo_destroy(document_cr);
+  cairo_surface_finish(document_surface);
+  cairo_status_t status = cairo_surface_status(document_surface);
+  cairo_surface_destroy(document_surface);
+  document_cr = nullptr;
+  document_surface = nullptr;
+
+  if (status != CAIRO_STATUS_SUCCESS) {
+    fmt::print(stderr, "ERROR: could not write {}: {}\n", document_filename,
+      cairo_status_to_string(status));
+    return false;
+  }
+  return true;
+}
+
+bool render_context::begin_animation(
+  const std::string &output_filename,
+  const std::vector<std::string> &frame_labels,
+  double frame_duration)
+{
+  end_animation();
+
+  // captions go in the top margin, above the title
+  animation.reset(new svg_animation(output_filename, frame_labels,
+    frame_duration, geometry.margin_x, geometry.margin_y / 4));
+  if (!animation->good())
+  {
+    fmt::print(stderr, "ERROR: could not create {}\n", output_filename);
+    animation.reset();
+    return false;
+  }
+
+  return true;
+}
+
+void render_context::end_animation()
+{
+  // writes the rest of the file
+  animation.reset();
+}
+
+PangoFontDescription *render_context::font(font_role role)
+{
+  if (role == font_role::TITLE)
+    return title_font;
+  else if (role == font_role::DESCRIPTION)
+    return description_font;
+  else if (role == font_role::BIG_LABEL)
+    return big_label_font;
+  else
+    return small_label_font;
+}
+
+PangoLayout *render_context::label_layout(
+  const std::string &text,
+  PangoFontDescription *font_desc,
+  int width,
+  PangoAlignment alignment,
+  int height)
+{
+  auto key = std::make_tuple(text, font_desc, width,
+    static_cast<int>(alignment), height);
+
+  auto cached = layout_cache.find(key);
+  if (cached != layout_cache.end()) return cached->second;
+
+  PangoLayout *layout = pango_layout_new(get_pango_context());
+  saturation_diagram::pango_cairo_make_text_layout(layout, font_desc, text,
+    width, alignment, height);
+  layout_cache[key] = layout;
+
+  return layout;
+}
+
+PangoContext *render_context::get_pango_context()
+{
+  // layouts made from this context are not tied to a cairo surface, so they
+  // can be drawn on every diagram
+  if (pango_context == nullptr)
+    pango_context = pango_font_map_create_context(
+      pango_cairo_font_map_get_default());
+
+  return pango_context;
+}
+
+PangoLayout *render_context::component_label_layout(
+  const std::string &label,
+  PangoFontDescription *font_desc,
+  double width,
+  double height,
+  label_position position)
+{
+  // same layouts as the font version of cairo_draw_component
+  if (position == label_position::LEFT)
+    return label_layout(label, font_desc, height, PANGO_ALIGN_CENTER);
+  if (position == label_position::BOTTOM)
+    return label_layout(label, font_desc, width, PANGO_ALIGN_CENTER);
+
+  return label_layout(label, font_desc, width, PANGO_ALIGN_CENTER, height);
+}
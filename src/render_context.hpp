@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cairo.h>
+#include <map>
+#include <memory>
+#include <pango/pangocairo.h>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "config.hpp"
+#include "diagram_canvas.hpp"
+#include "saturation_diagram.hpp"
+
+// defined in svg_canvas.hpp
+class svg_animation;
+
+/* ---- diagram geometry ----
+ * sizes used to lay out a saturation diagram. These used to be constants in
+ * draw_diagram; they are kept together so every diagram drawn with one
+ * render_context shares them.
+ *
+ * TODO: someday, move these to a config file
+ */
+struct diagram_geometry {
+  double image_width = 1200;
+  double image_height = 2400;
+
+  double margin_x = 50;
+  double margin_y = 50;
+
+  double small_internal_margin = 12;
+  double internal_margin = 25;
+  double large_internal_margin = 50;
+
+  double swatch_height = 50;
+
+  // memory/cache things
+  double ram_height = 200;
+  double transfer_arrow_height = 150;
+  double cache_height = 100;
+
+  double core_height = 500;
+
+  double content_width() const { return image_width - 2 * margin_x; }
+};
+
+/* ---- render context ----
+ * everything needed to draw saturation diagrams that does not depend on the
+ * data being drawn: fonts, the colors of the color scale, machine stats,
+ * geometry and the layouts of labels that appear in every diagram ("RAM",
+ * "L3 Cache", legend values, ...). Creating one context and drawing many
+ * diagrams with it means fonts are parsed, machine stats are read and
+ * static labels are laid out only once.
+ *
+ * Pango contexts are not thread-safe, so each thread drawing diagrams needs
+ * its own render_context. The pango context is only created when a layout
+ * is first needed, so the svg backend never starts fontconfig.
+ */
+class render_context {
+  public:
+    explicit render_context(
+      std::string color_scale,
+      render_backend backend = render_backend::cairo);
+    ~render_context();
+
+    // owns pango objects, so copying would free them twice
+    render_context(const render_context &) = delete;
+    render_context &operator=(const render_context &) = delete;
+
+    // color of a value already scaled to [0.0, 1.0]. Same bins as
+    // saturation_diagram::discrete_color_scale, without looking up the scale
+    // by name every time.
+    rgb_color color(double t) const;
+
+    /* ---- create canvas ----
+     * a canvas that draws a width x height diagram into output_filename
+     * with this context's backend. The file is written when the canvas is
+     * destroyed. The format comes from the extension of output_filename;
+     * the svg backend only writes SVG, so PNG and PDF always use cairo.
+     *
+     * While a document or animation is open, output_filename is ignored and
+     * the canvas draws the next page or frame of it instead.
+     */
+    std::unique_ptr<diagram_canvas> create_canvas(
+      const std::string &output_filename,
+      double width,
+      double height);
+
+    /* ---- text height ----
+     * the height canvas.text would return for text drawn with font in a box
+     * of the given width, on the canvas create_canvas makes for
+     * output_filename. Diagrams whose text differs from run to run use it to
+     * size their canvas before creating it.
+     */
+    double text_height(
+      const std::string &output_filename,
+      const std::string &text,
+      font_role font,
+      double width);
+
+    PangoFontDescription *font(font_role role);
+
+    /* ---- documents ----
+     * begin_document opens a multi-page PDF. Until end_document is called,
+     * every diagram drawn with this context becomes one page of it, sized
+     * to fit that diagram. cairo writes each page to the file as soon as it
+     * is finished, so pages are never all held in memory.
+     *
+     * begin_document returns false if the file could not be created,
+     * end_document if the rest of it could not be written.
+     */
+    bool begin_document(const std::string &output_filename);
+    bool end_document();
+
+    /* ---- animations ----
+     * begin_animation opens an animated SVG (see svg_animation). Until
+     * end_animation is called, every diagram drawn with this context is
+     * the next frame of it, shown for frame_duration seconds with the
+     * caption of the same index in frame_labels. Frames are written as they
+     * are drawn.
+     *
+     * Returns false if the file could not be created.
+     */
+    bool begin_animation(
+      const std::string &output_filename,
+      const std::vector<std::string> &frame_labels,
+      double frame_duration);
+    void end_animation();
+
+    /* ---- label layout ----
+     * returns a layout for text that looks the same in every diagram. It is
+     * laid out the first time it is requested and reused afterwards. The
+     * context keeps ownership of the layout.
+     *
+     * Arguments are the same as saturation_diagram::pango_cairo_make_text_layout
+     */
+    PangoLayout *label_layout(
+      const std::string &text,
+      PangoFontDescription *font_desc,
+      int width,
+      PangoAlignment alignment = PangoAlignment::PANGO_ALIGN_LEFT,
+      int height = -1);
+
+    // layout for the label of a component drawn with cairo_draw_component
+    PangoLayout *component_label_layout(
+      const std::string &label,
+      PangoFontDescription *font_desc,
+      double width,
+      double height,
+      label_position position);
+
+    std::string color_scale;
+    render_backend backend;
+    // the bins of color_scale. Empty if the scale does not exist.
+    const std::vector<rgb_color> &color_lut;
+
+    fhv::config::MachineStats machine_stats;
+    diagram_geometry geometry;
+    // resolution of PNG output
+    double dpi = 96;
+
+    PangoFontDescription *title_font;
+    PangoFontDescription *description_font;
+    PangoFontDescription *big_label_font;
+    PangoFontDescription *small_label_font;
+
+  private:
+    // true if create_canvas(output_filename, ...) makes an svg_canvas
+    bool draws_svg(const std::string &output_filename) const;
+
+    // created on first use, see label_layout
+    PangoContext *get_pango_context();
+
+    PangoContext *pango_context;
+
+    // open document, nullptr if there is none
+    cairo_surface_t *document_surface;
+    cairo_t *document_cr;
+    std::string document_filename;
+
+    // open animation, nullptr if there is none
+    std::unique_ptr<svg_animation> animation;
+
+    // (text, font, width, alignment, height) -> layout
+    std::map<std::tuple<std::string, PangoFontDescription*, int, int, int>,
+      PangoLayout*> layout_cache;
+};
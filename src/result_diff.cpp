@@ -0,0 +1,206 @@
+#include "result_diff.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+// ===== MetricDifference function definitions =====
+double fhv::diff::MetricDifference::relativeChange() const
+{
+  if (std::isnan(this->ratio))
+  {
+    // baseline was zero: any increase is an infinitely large change
+    if (this->delta > 0) return std::numeric_limits<double>::infinity();
+    if (this->delta < 0) return -std::numeric_limits<double>::infinity();
+    return 0.0;
+  }
+
+  return this->ratio - 1.0;
+}
+
+std::string fhv::diff::MetricDifference::toString(std::string delim) const
+{
+  std::stringstream ss;
+  ss << std::left << "region " << std::setw(20) << this->region_name << delim
+     << std::setw(15) << this->aggregation_name << delim
+     << std::setw(40) << this->result_name << delim
+     << std::setprecision(4) << std::fixed << std::right
+     << std::setw(16) << this->baseline_value << delim
+     << std::setw(16) << this->candidate_value << delim
+     << std::showpos << std::setw(16) << this->delta << delim
+     << std::setw(9) << std::setprecision(1)
+     << this->relativeChange() * 100.0 << "%"
+     << std::endl;
+  return ss.str();
+}
+
+// ===== matching and comparing =====
+std::vector<std::string> fhv::diff::matchRegions(
+    const json &baseline_data,
+    const json &candidate_data)
+{
+  std::vector<std::string> matched_regions;
+
+  const json &baseline_regions = baseline_data.at(json_results_section);
+  const json &candidate_regions = candidate_data.at(json_results_section);
+
+  // two single-region files are compared even if the region was renamed
+  // between builds, like "poly" and "poly_block" in the polynomial example
+  if (baseline_regions.size() == 1 && candidate_regions.size() == 1
+      && !candidate_regions.contains(baseline_regions.begin().key()))
+  {
+    fmt::print(stderr, "WARN: comparing region '{}' with region '{}' because "
+      "each file contains only one region.\n",
+      baseline_regions.begin().key(), candidate_regions.begin().key());
+    matched_regions.push_back(baseline_regions.begin().key());
+    return matched_regions;
+  }
+
+  for (const auto &region : baseline_regions.items())
+  {
+    if (candidate_regions.contains(region.key()))
+      matched_regions.push_back(region.key());
+    else
+      fmt::print(stderr, "WARN: region '{}' only exists in the baseline and "
+        "will not be compared.\n", region.key());
+  }
+
+  for (const auto &region : candidate_regions.items())
+  {
+    if (!baseline_regions.contains(region.key()))
+      fmt::print(stderr, "WARN: region '{}' only exists in the candidate and "
+        "will not be compared.\n", region.key());
+  }
+
+  return matched_regions;
+}
+
+const json &fhv::diff::candidateRegion(
+    const json &candidate_data,
+    const std::string &region_name)
+{
+  const json &candidate_regions = candidate_data.at(json_results_section);
+  if (candidate_regions.size() == 1 && !candidate_regions.contains(region_name))
+    return candidate_regions.begin().value();
+
+  return candidate_regions.at(region_name);
+}
+
+fhv::diff::metric_differences_t fhv::diff::compareResults(
+    const json &baseline_data,
+    const json &candidate_data,
+    const std::vector<std::string> &region_names)
+{
+  metric_differences_t differences;
+
+  const std::string saturation_section =
+    fhv::types::aggregationTypeToString(fhv::types::aggregation_t::saturation);
+
+  for (const auto &region_name : region_names)
+  {
+    const json &baseline_region =
+      baseline_data.at(json_results_section).at(region_name);
+    const json &candidate_region =
+      candidateRegion(candidate_data, region_name);
+
+    for (const auto &section : baseline_region.items())
+    {
+      // only aggregate sections are compared; thread numbering is not
+      // guaranteed to mean the same thing across runs
+      if (section.key().compare(0, json_thread_section_base.size(),
+            json_thread_section_base) == 0)
+        continue;
+
+      auto candidate_section = candidate_region.find(section.key());
+      if (candidate_section == candidate_region.end()) continue;
+
+      for (const auto &metric : section.value().items())
+      {
+        auto candidate_value = candidate_section->find(metric.key());
+        if (candidate_value == candidate_section->end()
+            || !metric.value().is_number() || !candidate_value->is_number())
+          continue;
+
+        MetricDifference difference = {
+          .region_name = region_name,
+          .aggregation_name = section.key(),
+          .result_name = metric.key(),
+          .baseline_value = metric.value().get<double>(),
+          .candidate_value = candidate_value->get<double>(),
+          .delta = 0.0,
+          .ratio = NAN,
+          .higher_is_better = section.key() == saturation_section
+            || metric.key().find("/s]") != std::string::npos,
+        };
+
+        difference.delta =
+          difference.candidate_value - difference.baseline_value;
+        if (difference.baseline_value != 0.0)
+          difference.ratio =
+            difference.candidate_value / difference.baseline_value;
+
+        differences.push_back(difference);
+      }
+    }
+  }
+
+  return differences;
+}
+
+void fhv::diff::printDifferenceTable(
+    const metric_differences_t &differences,
+    size_t max_rows)
+{
+  std::cout << std::endl
+    << "----- FHV diff: all compared metrics ----- "
+    << std::endl;
+  std::cout << std::left << std::setw(27) << "region" << " | "
+    << std::setw(15) << "aggregation" << " | "
+    << std::setw(40) << "metric" << " | "
+    << std::right << std::setw(16) << "baseline" << " | "
+    << std::setw(16) << "candidate" << " | "
+    << std::setw(16) << "delta" << " | "
+    << std::setw(10) << "change" << std::endl;
+
+  for (const auto &difference : differences)
+    std::cout << difference.toString();
+
+  // only metrics where direction means something can regress or improve
+  std::vector<const MetricDifference*> regressions;
+  std::vector<const MetricDifference*> improvements;
+  for (const auto &difference : differences)
+  {
+    if (!difference.higher_is_better) continue;
+
+    if (difference.relativeChange() < 0)
+      regressions.push_back(&difference);
+    else if (difference.relativeChange() > 0)
+      improvements.push_back(&difference);
+  }
+
+  std::sort(regressions.begin(), regressions.end(),
+    [](const MetricDifference *a, const MetricDifference *b) {
+      return a->relativeChange() < b->relativeChange();
+    });
+  std::sort(improvements.begin(), improvements.end(),
+    [](const MetricDifference *a, const MetricDifference *b) {
+      return a->relativeChange() > b->relativeChange();
+    });
+
+  std::cout << std::endl
+    << "----- FHV diff: biggest regressions ----- "
+    << std::endl;
+  if (regressions.empty()) std::cout << "(none)" << std::endl;
+  for (size_t i = 0; i < regressions.size() && i < max_rows; i++)
+    std::cout << regressions[i]->toString();
+
+  std::cout << std::endl
+    << "----- FHV diff: biggest improvements ----- "
+    << std::endl;
+  if (improvements.empty()) std::cout << "(none)" << std::endl;
+  for (size_t i = 0; i < improvements.size() && i < max_rows; i++)
+    std::cout << improvements[i]->toString();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <fmt/core.h>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+#include "performance_monitor_defines.hpp"
+#include "types.hpp"
+
+using json = nlohmann::json;
+
+namespace fhv {
+  namespace diff {
+    // the change in a single aggregate metric of a single region between a
+    // baseline run and a candidate run
+    struct MetricDifference {
+      std::string region_name;
+      std::string aggregation_name;
+      std::string result_name;
+      double baseline_value;
+      double candidate_value;
+
+      // candidate_value - baseline_value
+      double delta;
+
+      // candidate_value / baseline_value. NAN if the baseline is zero
+      double ratio;
+
+      // true for saturation and rate metrics, where a bigger value means more
+      // of the hardware is being used. Data volumes and the like are still
+      // compared, but are neither regressions nor improvements.
+      bool higher_is_better;
+
+      // relative change used to rank regressions and improvements
+      double relativeChange() const;
+      std::string toString(std::string delim = " | ") const;
+    };
+
+    typedef std::vector<MetricDifference> metric_differences_t;
+
+    // returns the names of regions present in both files. Regions present in
+    // only one of the files are reported on stderr. If each file has exactly
+    // one region, those are matched even if their names differ.
+    std::vector<std::string> matchRegions(
+        const json &baseline_data,
+        const json &candidate_data);
+
+    // looks up the candidate region matched to region_name by matchRegions
+    const json &candidateRegion(
+        const json &candidate_data,
+        const std::string &region_name);
+
+    // compares every aggregate section (sum, means, saturation) of the given
+    // regions, which should come from matchRegions. Per-thread sections are
+    // not compared.
+    metric_differences_t compareResults(
+        const json &baseline_data,
+        const json &candidate_data,
+        const std::vector<std::string> &region_names);
+
+    // prints every difference, then the biggest regressions and improvements
+    // sorted by relative change. At most max_rows rows are printed for each
+    // of the two sorted tables.
+    void printDifferenceTable(
+        const metric_differences_t &differences,
+        size_t max_rows = 10);
+  };
+};
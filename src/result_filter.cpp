@@ -0,0 +1,134 @@
+#include "result_filter.hpp"
+
+#include <cstdlib>
+#include <fmt/core.h>
+#include <fnmatch.h>
+
+#include "performance_monitor_defines.hpp"
+
+std::vector<std::string> fhv::filter::splitPatterns(
+  const std::string &patterns)
+{
+  std::vector<std::string> split;
+  size_t start = 0;
+  while (start <= patterns.size())
+  {
+    size_t end = patterns.find(pattern_separator, start);
+    if (end == std::string::npos) end = patterns.size();
+    if (end > start) split.push_back(patterns.substr(start, end - start));
+    start = end + 1;
+  }
+
+  return split;
+}
+
+std::string fhv::filter::jsonResultName(
+  const std::string &group_name,
+  const std::string &result_name)
+{
+  static const std::unordered_set<std::string> key_metrics(
+    fhv_key_metrics.begin(), fhv_key_metrics.end());
+
+  if (group_name.empty() || group_name == fhv_performance_monitor_group
+      || key_metrics.count(result_name))
+    return result_name;
+  return group_name + group_separator + result_name;
+}
+
+void fhv::filter::setJsonResult(
+  json &section,
+  const std::string &group_name,
+  const std::string &result_name,
+  double value)
+{
+  json &result = section[jsonResultName(group_name, result_name)];
+  if (result_name == runtime_metric_name && result.is_number()
+      && result.get<double>() >= value)
+    return;
+
+  result = value;
+}
+
+void fhv::filter::splitJsonResultName(
+  const std::string &json_name,
+  std::string &group_name,
+  std::string &result_name)
+{
+  // group names never contain the separator, result names might
+  size_t separator = json_name.find(group_separator);
+  if (separator == std::string::npos) {
+    group_name.clear();
+    result_name = json_name;
+    return;
+  }
+
+  group_name = json_name.substr(0, separator);
+  result_name = json_name.substr(separator + group_separator.size());
+}
+
+fhv::filter::NameFilter::NameFilter(
+  bool all,
+  const std::vector<std::string> &included,
+  const std::vector<std::string> &excluded)
+  : all(all), included(included), excluded(excluded),
+    key_metrics(fhv_key_metrics.begin(), fhv_key_metrics.end())
+{
+}
+
+fhv::filter::NameFilter fhv::filter::NameFilter::fromEnvironment(bool all)
+{
+  if (const char *mode = std::getenv(perfmon_export_envvar.c_str()))
+  {
+    if (mode == export_all)
+      all = true;
+    else if (mode != export_key_metrics)
+      fmt::print(stderr, "WARN: unknown {} '{}', expected '{}' or '{}'. Only "
+        "the key metrics are written.\n", perfmon_export_envvar, mode,
+        export_key_metrics, export_all);
+  }
+
+  std::vector<std::string> included, excluded;
+  if (const char *patterns = std::getenv(perfmon_include_envvar.c_str()))
+    included = splitPatterns(patterns);
+  if (const char *patterns = std::getenv(perfmon_exclude_envvar.c_str()))
+    excluded = splitPatterns(patterns);
+
+  return NameFilter(all, included, excluded);
+}
+
+bool fhv::filter::NameFilter::accepts(const std::string &name)
+{
+  if (acceptsAll()) return true;
+
+  auto decision = decisions.find(name);
+  if (decision != decisions.end()) return decision->second;
+
+  bool accepted = match(name);
+  decisions.emplace(name, accepted);
+  return accepted;
+}
+
+bool fhv::filter::NameFilter::acceptsAll() const
+{
+  return all && excluded.empty();
+}
+
+// names are compared as they are first, since metric names like
+// "Clock [MHz]" are not globs that match themselves
+static bool matchPattern(const std::string &pattern, const std::string &name)
+{
+  return pattern == name || fnmatch(pattern.c_str(), name.c_str(), 0) == 0;
+}
+
+bool fhv::filter::NameFilter::match(const std::string &name) const
+{
+  for (const auto &pattern : excluded)
+    if (matchPattern(pattern, name)) return false;
+
+  if (all || key_metrics.count(name)) return true;
+
+  for (const auto &pattern : included)
+    if (matchPattern(pattern, name)) return true;
+
+  return false;
+}
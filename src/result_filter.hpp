@@ -0,0 +1,94 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using json = nlohmann::json;
+
+/* ---- result filter ----
+ * decides which results are written by fhv_perfmon::resultsToJson. By
+ * default only fhv_key_metrics are; FHV_EXPORT=all writes every event and
+ * metric likwid measured. FHV_INCLUDE adds results whose name matches one of
+ * its globs, and FHV_EXCLUDE removes those that match one of its globs, e.g.
+ * FHV_INCLUDE="CPI,Clock*" or FHV_EXPORT=all FHV_EXCLUDE="*_ANY".
+ *
+ * There are only a few distinct names among many results, so each name is
+ * matched against the globs once and the answer is kept in a hash map. Every
+ * later lookup of the name is a single hash lookup.
+ */
+namespace fhv {
+  namespace filter {
+    const std::string export_key_metrics = "key_metrics";
+    const std::string export_all = "all";
+    // separates the globs of FHV_INCLUDE and FHV_EXCLUDE
+    const char pattern_separator = ',';
+    // separates the group from the name in jsonResultName
+    const std::string group_separator = ":";
+
+    // splits a list of globs at pattern_separator, skipping empty ones
+    std::vector<std::string> splitPatterns(const std::string &patterns);
+
+    /* ---- json result name ----
+     * the key a result is written under in a section of the json. Groups
+     * often measure events and metrics of the same name (INSTR_RETIRED_ANY,
+     * CPU_CLK_UNHALTED_CORE, CPI), which would overwrite each other, so
+     * those are written as "<group>:<name>". Key metrics and fhv's own
+     * results keep their name, since every tool looks them up by it.
+     * Filters always match the name without the group.
+     */
+    std::string jsonResultName(
+      const std::string &group_name,
+      const std::string &result_name);
+
+    /* ---- set json result ----
+     * writes value to section under jsonResultName(group_name, result_name).
+     * Every group measures the runtime of a region, and key metrics keep
+     * their name, so the runtimes of all groups would overwrite each other.
+     * The longest of them is kept instead: groups measure the same code, and
+     * the slowest measurement is the one the region can't beat.
+     */
+    void setJsonResult(
+      json &section,
+      const std::string &group_name,
+      const std::string &result_name,
+      double value);
+
+    // the reverse of jsonResultName. group_name is empty for names written
+    // without a group.
+    void splitJsonResultName(
+      const std::string &json_name,
+      std::string &group_name,
+      std::string &result_name);
+
+    class NameFilter {
+      public:
+        // keeps only the key metrics and names matching included, unless
+        // all is true. Names matching excluded are always left out.
+        NameFilter(
+          bool all,
+          const std::vector<std::string> &included,
+          const std::vector<std::string> &excluded);
+
+        // FHV_EXPORT, FHV_INCLUDE and FHV_EXCLUDE. all forces FHV_EXPORT=all,
+        // as for the binary format. Warns about unknown FHV_EXPORT values.
+        static NameFilter fromEnvironment(bool all = false);
+
+        bool accepts(const std::string &name);
+
+        // true if every name is accepted, so callers can skip the lookups
+        bool acceptsAll() const;
+
+      private:
+        bool match(const std::string &name) const;
+
+        bool all;
+        std::vector<std::string> included;
+        std::vector<std::string> excluded;
+        std::unordered_set<std::string> key_metrics;
+        std::unordered_map<std::string, bool> decisions;
+    };
+  };
+};
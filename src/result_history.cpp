@@ -0,0 +1,791 @@
+#include "result_history.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fnmatch.h>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <tuple>
+#include <unordered_map>
+
+#include "result_summary.hpp"
+#include "table_export.hpp"
+#include "utils.hpp"
+
+// ===== adding runs =====
+// FHV_COMMIT, or the HEAD of the git repository in the current directory
+static std::string currentCommit()
+{
+  if (const char *commit = std::getenv(perfmon_commit_envvar.c_str()))
+    return commit;
+
+  std::string commit;
+  FILE *git = popen("git rev-parse HEAD 2>/dev/null", "r");
+  if (git == nullptr) return commit;
+
+  char buffer[128];
+  while (fgets(buffer, sizeof(buffer), git) != nullptr)
+    commit += buffer;
+  pclose(git);
+
+  while (!commit.empty() && std::isspace(commit.back()))
+    commit.pop_back();
+  return commit;
+}
+
+// the saturation of each region and the arithmetic mean of its key metrics
+static json summarizeRegions(const fhv::summary::ResultsSummary &summary)
+{
+  const std::string saturation_section = fhv::types::aggregationTypeToString(
+    fhv::types::aggregation_t::saturation);
+  const std::string arithmetic_mean_section =
+    fhv::types::aggregationTypeToString(
+      fhv::types::aggregation_t::arithmetic_mean);
+
+  json regions = json::object();
+  for (const auto &region : summary.regions)
+  {
+    json &region_summary = regions[region.name];
+    region_summary = json::object();
+
+    auto saturation = region.sections.find(saturation_section);
+    if (saturation != region.sections.end())
+      for (const auto &metric : saturation->items())
+        if (metric.value().is_number())
+          region_summary[metric.key()] = metric.value();
+
+    auto mean = region.sections.find(arithmetic_mean_section);
+    if (mean == region.sections.end()) continue;
+    for (const auto &metric_name : fhv_key_metrics)
+    {
+      auto metric = mean->find(metric_name);
+      if (metric != mean->end() && metric->is_number()
+          && !region_summary.contains(metric_name))
+        region_summary[metric_name] = *metric;
+    }
+  }
+
+  return regions;
+}
+
+bool fhv::history::addRun(
+  const std::string &directory,
+  const std::string &results_filename,
+  std::string run_id,
+  std::string commit)
+{
+  fhv::summary::ResultsSummary summary;
+  if (!fhv::summary::loadSummary(results_filename, summary)) return false;
+
+  std::time_t now = std::time(nullptr);
+  bool generated_id = run_id.empty();
+  if (generated_id)
+  {
+    char timestamp[32];
+    std::strftime(timestamp, sizeof(timestamp), "%Y%m%dT%H%M%S",
+      std::localtime(&now));
+    run_id = std::string(timestamp) + "_"
+      + fhv::table::runIdOfFilename(results_filename);
+  }
+
+  // each run gets its own directory. Creating it claims the run id, even
+  // against other processes adding runs at the same time
+  const std::string runs_directory =
+    directory + "/" + history_runs_directory + "/";
+  fhv::utils::create_directories_for_file(runs_directory);
+  std::string base_id = run_id;
+  for (unsigned n = 2; mkdir((runs_directory + run_id).c_str(), 0755) != 0;
+       n++)
+  {
+    if (errno != EEXIST || !generated_id) {
+      fmt::print(stderr, "ERROR: could not add run '{}' to '{}': {}\n",
+        run_id, directory, errno == EEXIST ? "the run id is taken"
+          : std::strerror(errno));
+      return false;
+    }
+    run_id = fmt::format("{}_{}", base_id, n);
+  }
+
+  size_t slash = results_filename.find_last_of('/');
+  std::string run_file = history_runs_directory + "/" + run_id + "/"
+    + (slash == std::string::npos ? results_filename
+        : results_filename.substr(slash + 1));
+  {
+    std::ifstream in(results_filename, std::ios::binary);
+    std::ofstream out(directory + "/" + run_file, std::ios::binary);
+    out << in.rdbuf();
+    if (!out) {
+      fmt::print(stderr, "ERROR: could not copy '{}' to '{}'\n",
+        results_filename, directory + "/" + run_file);
+      return false;
+    }
+  }
+
+  const json &info = summary.info;
+  auto build = info.find(json_build_section);
+  if (commit.empty() && build != info.end() && build->is_object())
+    commit = build->value(json_build_git_commit_key, "");
+  if (commit.empty()) commit = currentCommit();
+
+  std::string cpu;
+  auto processor = info.find(json_processor_section);
+  if (processor != info.end() && processor->is_object())
+    cpu = processor->value(json_processor_name_key, "");
+
+  json parameter_values = json::object();
+  auto parameters = info.find(json_parameter_values_key);
+  if (parameters != info.end() && parameters->is_object())
+    parameter_values = *parameters;
+
+  json entry = {
+    {history_run_id_key, run_id},
+    {history_time_key, static_cast<long long>(now)},
+    {history_commit_key, commit},
+    {history_host_key, info.value(json_hostname_key, "")},
+    {history_cpu_key, cpu},
+    {history_parameters_key, info.value(json_parameter_key, "")},
+    {history_parameter_values_key, parameter_values},
+    {history_file_key, run_file},
+    {history_regions_key, summarizeRegions(summary)},
+  };
+
+  // one write per entry, so entries appended by several processes don't
+  // interleave
+  std::string line = entry.dump() + "\n";
+  std::string index_filename = directory + "/" + history_index_filename;
+  std::ofstream index(index_filename, std::ios::app | std::ios::binary);
+  index.write(line.data(), line.size());
+  index.flush();
+  if (!index) {
+    fmt::print(stderr, "ERROR: could not append to '{}'\n", index_filename);
+    return false;
+  }
+
+  fmt::print("Run '{}' added to {}\n", run_id, directory);
+  return true;
+}
+
+// ===== index cache =====
+/* the index parsed into columns, so queries only parse the lines appended
+ * since the last query. A cache file is:
+ *
+ *  - a history_cache_header
+ *  - num_strings + 1 uint64 offsets into the characters that follow, like
+ *    the string table of fhv::binary
+ *  - the run columns: one uint32 string index per run for each run_field_t,
+ *    then the int64 times. Typed parameters are stored as their json dump
+ *  - the value columns: uint32 run, uint32 region and uint32 metric string
+ *    indices, then the double values
+ *
+ * index_size is the number of bytes of the index the cache holds. Lines
+ * after it are parsed and added before the cache is written again.
+ */
+struct history_cache_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t index_size;
+  uint64_t num_strings;
+  uint64_t num_runs;
+  uint64_t num_values;
+};
+
+const char history_cache_magic[8] = {'F', 'H', 'V', 'H', 'I', 'S', 'T',
+  '\0'};
+// bump when the layout changes. Caches of other versions are rebuilt
+const uint32_t history_cache_version = 2;
+
+enum run_field_t { run_id, run_commit, run_host, run_cpu, run_parameters,
+  run_parameter_values, run_file, num_run_fields };
+
+// the entry key of each run_field_t
+static const std::vector<std::string> &runFieldKeys()
+{
+  static const std::vector<std::string> keys = {
+    fhv::history::history_run_id_key,
+    fhv::history::history_commit_key,
+    fhv::history::history_host_key,
+    fhv::history::history_cpu_key,
+    fhv::history::history_parameters_key,
+    fhv::history::history_parameter_values_key,
+    fhv::history::history_file_key,
+  };
+  return keys;
+}
+
+class history_store {
+  public:
+    history_store() : index_size(0) {}
+
+    uint32_t stringIndex(const std::string &text)
+    {
+      auto inserted = string_indices.emplace(text,
+        static_cast<uint32_t>(strings.size()));
+      if (inserted.second) strings.push_back(text);
+      return inserted.first->second;
+    }
+
+    // adds the run of one index line
+    void addEntry(const json &entry)
+    {
+      uint32_t run = static_cast<uint32_t>(times.size());
+      for (size_t f = 0; f < num_run_fields; f++)
+      {
+        auto field = entry.find(runFieldKeys()[f]);
+        if (field == entry.end())
+          run_fields[f].push_back(stringIndex(f == run_parameter_values
+            ? "{}" : ""));
+        else
+          run_fields[f].push_back(stringIndex(field->is_string()
+            ? field->get<std::string>() : field->dump()));
+      }
+      times.push_back(entry.value(fhv::history::history_time_key, 0LL));
+
+      auto regions = entry.find(fhv::history::history_regions_key);
+      if (regions == entry.end() || !regions->is_object()) return;
+
+      for (const auto &region : regions->items())
+      {
+        if (!region.value().is_object()) continue;
+
+        uint32_t region_index = stringIndex(region.key());
+        for (const auto &metric : region.value().items())
+        {
+          if (!metric.value().is_number()) continue;
+
+          value_runs.push_back(run);
+          value_regions.push_back(region_index);
+          value_metrics.push_back(stringIndex(metric.key()));
+          values.push_back(metric.value().get<double>());
+        }
+      }
+    }
+
+    // false if there is no valid cache, which leaves the store empty
+    bool read(const std::string &filename)
+    {
+      FILE *file = std::fopen(filename.c_str(), "rb");
+      if (file == nullptr) return false;
+
+      bool ok = readFrom(file);
+      std::fclose(file);
+      if (!ok) *this = history_store();
+      return ok;
+    }
+
+    // written to a temporary file first, so readers never see half a cache.
+    // Its name holds the pid, so queries running at the same time each
+    // write their own and the last rename wins
+    bool write(const std::string &filename) const
+    {
+      std::string temporary_filename = filename + ".tmp."
+        + std::to_string(getpid());
+      FILE *file = std::fopen(temporary_filename.c_str(), "wb");
+      if (file == nullptr) return false;
+
+      bool ok = writeTo(file);
+      ok = std::fclose(file) == 0 && ok;
+      ok = ok && std::rename(temporary_filename.c_str(),
+        filename.c_str()) == 0;
+      if (!ok) std::remove(temporary_filename.c_str());
+      return ok;
+    }
+
+    uint64_t index_size;
+
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, uint32_t> string_indices;
+
+    // per run
+    std::vector<uint32_t> run_fields[num_run_fields];
+    std::vector<int64_t> times;
+
+    // per value
+    std::vector<uint32_t> value_runs;
+    std::vector<uint32_t> value_regions;
+    std::vector<uint32_t> value_metrics;
+    std::vector<double> values;
+
+  private:
+    template<typename T>
+    static bool readColumn(FILE *file, std::vector<T> &column, uint64_t size)
+    {
+      column.resize(size);
+      return std::fread(column.data(), sizeof(T), size, file) == size;
+    }
+
+    template<typename T>
+    static bool writeColumn(FILE *file, const std::vector<T> &column)
+    {
+      return std::fwrite(column.data(), sizeof(T), column.size(), file)
+        == column.size();
+    }
+
+    bool readFrom(FILE *file)
+    {
+      history_cache_header header;
+      if (std::fread(&header, sizeof(header), 1, file) != 1
+          || std::memcmp(header.magic, history_cache_magic,
+            sizeof(header.magic)) != 0
+          || header.version != history_cache_version)
+        return false;
+
+      std::vector<uint64_t> string_offsets;
+      if (!readColumn(file, string_offsets, header.num_strings + 1))
+        return false;
+      std::string characters;
+      characters.resize(string_offsets.back());
+      if (std::fread(&characters[0], 1, characters.size(), file)
+          != characters.size())
+        return false;
+      for (uint64_t s = 0; s < header.num_strings; s++)
+        stringIndex(characters.substr(string_offsets[s],
+          string_offsets[s + 1] - string_offsets[s]));
+      if (strings.size() != header.num_strings) return false;
+
+      for (size_t f = 0; f < num_run_fields; f++)
+        if (!readColumn(file, run_fields[f], header.num_runs)) return false;
+      if (!readColumn(file, times, header.num_runs)
+          || !readColumn(file, value_runs, header.num_values)
+          || !readColumn(file, value_regions, header.num_values)
+          || !readColumn(file, value_metrics, header.num_values)
+          || !readColumn(file, values, header.num_values))
+        return false;
+
+      index_size = header.index_size;
+      return true;
+    }
+
+    bool writeTo(FILE *file) const
+    {
+      history_cache_header header;
+      std::memset(&header, 0, sizeof(header));
+      std::memcpy(header.magic, history_cache_magic, sizeof(header.magic));
+      header.version = history_cache_version;
+      header.index_size = index_size;
+      header.num_strings = strings.size();
+      header.num_runs = times.size();
+      header.num_values = values.size();
+
+      std::vector<uint64_t> string_offsets = {0};
+      std::string characters;
+      for (const auto &text : strings) {
+        characters += text;
+        string_offsets.push_back(characters.size());
+      }
+
+      bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+        && writeColumn(file, string_offsets)
+        && std::fwrite(characters.data(), 1, characters.size(), file)
+          == characters.size();
+      for (size_t f = 0; f < num_run_fields; f++)
+        ok = ok && writeColumn(file, run_fields[f]);
+      return ok && writeColumn(file, times) && writeColumn(file, value_runs)
+        && writeColumn(file, value_regions) && writeColumn(file, value_metrics)
+        && writeColumn(file, values);
+    }
+};
+
+// loads the cache of a history and adds the lines appended to its index
+// since. Writes the cache again if there were any
+static bool loadStore(const std::string &directory, history_store &store)
+{
+  std::string index_filename =
+    directory + "/" + fhv::history::history_index_filename;
+  std::string cache_filename =
+    directory + "/" + fhv::history::history_cache_filename;
+
+  std::ifstream index(index_filename, std::ios::binary);
+  if (!index) {
+    fmt::print(stderr, "ERROR: there is no history index at '{}'. Runs are "
+      "added with '--history-add'.\n", index_filename);
+    return false;
+  }
+
+  index.seekg(0, std::ios::end);
+  uint64_t index_size = static_cast<uint64_t>(index.tellg());
+  if (!store.read(cache_filename) || store.index_size > index_size)
+    store = history_store();
+  index.seekg(store.index_size);
+
+  std::string line;
+  size_t num_lines = 0, num_skipped = 0;
+  // a line without its newline is still being appended, and is left for
+  // the next query
+  while (std::getline(index, line) && !index.eof())
+  {
+    store.index_size += line.size() + 1;
+    if (line.empty()) continue;
+    num_lines++;
+
+    json entry;
+    try {
+      entry = json::parse(line);
+    }
+    catch (json::exception &e) {
+      if (num_skipped++ == 0)
+        fmt::print(stderr, "WARN: skipping a line of '{}': {}\n",
+          index_filename, e.what());
+      continue;
+    }
+    if (entry.is_object()) store.addEntry(entry);
+  }
+
+  if (num_skipped > 1)
+    fmt::print(stderr, "WARN: skipped {} lines of '{}' that could not be "
+      "parsed\n", num_skipped, index_filename);
+
+  if (num_lines > 0 && !store.write(cache_filename))
+    fmt::print(stderr, "WARN: could not write the history cache '{}'. The "
+      "next query will parse the whole index again.\n", cache_filename);
+
+  return true;
+}
+
+// ===== queries =====
+std::string fhv::history::HistoryRun::label() const
+{
+  const size_t short_commit_length = 8;
+  if (!commit.empty()) return commit.substr(0, short_commit_length);
+  return id;
+}
+
+std::string fhv::history::TrendSeries::setupLabel() const
+{
+  std::string label;
+  for (const auto &part : {host, cpu,
+         parameters.empty() ? "" : "\"" + parameters + "\""})
+  {
+    if (part.empty()) continue;
+    if (!label.empty()) label += ", ";
+    label += part;
+  }
+  return label.empty() ? "unknown setup" : label;
+}
+
+bool fhv::history::parseWhere(
+  const std::vector<std::string> &conditions,
+  HistoryQuery &query)
+{
+  const std::vector<std::string> keys = {history_run_id_key,
+    history_commit_key, history_host_key, history_cpu_key,
+    history_parameters_key, history_region_key, history_metric_key};
+
+  for (const auto &condition : conditions)
+  {
+    size_t equals = condition.find('=');
+    std::string key = condition.substr(0, equals);
+    bool parameter_key = key.size() > history_parameter_prefix.size()
+      && key.compare(0, history_parameter_prefix.size(),
+        history_parameter_prefix) == 0;
+    if (equals == std::string::npos || (!parameter_key
+        && std::find(keys.begin(), keys.end(), key) == keys.end()))
+    {
+      fmt::print(stderr, "ERROR: '{}' is not a history condition. Expected "
+        "'<key>=<glob>' with one of the keys id, commit, host, cpu, "
+        "parameters, region, metric or param.<name>.\n", condition);
+      return false;
+    }
+    query.where.push_back({key, condition.substr(equals + 1)});
+  }
+
+  return true;
+}
+
+// true if value matches every glob given for key
+static bool matchesWhere(
+  const fhv::history::HistoryQuery &query,
+  const std::string &key,
+  const std::string &value)
+{
+  for (const auto &condition : query.where)
+  {
+    if (condition.first != key) continue;
+    if (condition.second != value
+        && fnmatch(condition.second.c_str(), value.c_str(), 0) != 0)
+      return false;
+  }
+  return true;
+}
+
+// true if the typed parameters match every "param.<name>" glob
+static bool matchesParameters(
+  const fhv::history::HistoryQuery &query,
+  const json &parameter_values)
+{
+  const std::string &prefix = fhv::history::history_parameter_prefix;
+  for (const auto &condition : query.where)
+  {
+    if (condition.first.compare(0, prefix.size(), prefix) != 0) continue;
+
+    if (!parameter_values.is_object()) return false;
+    auto value = parameter_values.find(condition.first.substr(prefix.size()));
+    if (value == parameter_values.end()) return false;
+
+    std::string text = value->is_string() ? value->get<std::string>()
+      : value->dump();
+    if (condition.second != text
+        && fnmatch(condition.second.c_str(), text.c_str(), 0) != 0)
+      return false;
+  }
+  return true;
+}
+
+bool fhv::history::loadHistory(
+  const std::string &directory,
+  const HistoryQuery &query,
+  std::vector<HistoryRun> &runs,
+  trend_series_t &series)
+{
+  runs.clear();
+  series.clear();
+
+  history_store store;
+  if (!loadStore(directory, store)) return false;
+
+  bool metrics_selected = std::any_of(query.where.begin(), query.where.end(),
+    [](const std::pair<std::string, std::string> &condition) {
+      return condition.first == history_metric_key;
+    });
+
+  // typed parameters are parsed once per distinct set. Null means not
+  // parsed yet
+  std::vector<json> parsed_parameters(store.strings.size());
+  auto parameterValues = [&](uint32_t string_index) -> const json & {
+    json &parameter_values = parsed_parameters[string_index];
+    if (parameter_values.is_null())
+    {
+      parameter_values = json::parse(store.strings[string_index], nullptr,
+        false);
+      if (!parameter_values.is_object()) parameter_values = json::object();
+    }
+    return parameter_values;
+  };
+
+  // every string is matched against the globs of a key at most once. -1
+  // means not decided yet
+  auto matches = [&](std::vector<int8_t> &decisions, const std::string &key,
+      uint32_t string_index) {
+    int8_t &decision = decisions[string_index];
+    if (decision < 0)
+    {
+      const std::string &text = store.strings[string_index];
+      if (key == history_parameter_values_key)
+        decision = matchesParameters(query, parameterValues(string_index));
+      else if (key == history_metric_key && !metrics_selected)
+        decision = std::find(query.default_metrics.begin(),
+          query.default_metrics.end(), text) != query.default_metrics.end();
+      else
+        decision = matchesWhere(query, key, text);
+    }
+    return decision == 1;
+  };
+  std::vector<std::vector<int8_t>> field_decisions(num_run_fields,
+    std::vector<int8_t>(store.strings.size(), -1));
+  std::vector<int8_t> region_decisions(store.strings.size(), -1);
+  std::vector<int8_t> metric_decisions(store.strings.size(), -1);
+
+  // index of each stored run in runs, or -1 if it doesn't match
+  std::vector<int64_t> run_indices(store.times.size(), -1);
+  const auto &keys = runFieldKeys();
+  for (size_t r = 0; r < store.times.size(); r++)
+  {
+    bool run_matches = true;
+    for (size_t f = 0; f < num_run_fields && run_matches; f++)
+      run_matches = f == run_file
+        || matches(field_decisions[f], keys[f], store.run_fields[f][r]);
+    if (!run_matches) continue;
+
+    run_indices[r] = runs.size();
+    runs.push_back({
+      .id = store.strings[store.run_fields[run_id][r]],
+      .time = store.times[r],
+      .commit = store.strings[store.run_fields[run_commit][r]],
+      .host = store.strings[store.run_fields[run_host][r]],
+      .cpu = store.strings[store.run_fields[run_cpu][r]],
+      .parameters = store.strings[store.run_fields[run_parameters][r]],
+      .parameter_values = parameterValues(
+        store.run_fields[run_parameter_values][r]),
+      .file = store.strings[store.run_fields[run_file][r]],
+    });
+  }
+
+  typedef std::tuple<uint32_t, uint32_t, uint32_t, uint32_t, uint32_t>
+    series_key_t;
+  std::map<series_key_t, size_t> series_indices;
+
+  for (size_t v = 0; v < store.values.size(); v++)
+  {
+    uint32_t run = store.value_runs[v];
+    if (run_indices[run] < 0
+        || !matches(region_decisions, history_region_key,
+          store.value_regions[v])
+        || !matches(metric_decisions, history_metric_key,
+          store.value_metrics[v]))
+      continue;
+
+    series_key_t key(store.run_fields[run_host][run],
+      store.run_fields[run_cpu][run], store.run_fields[run_parameters][run],
+      store.value_regions[v], store.value_metrics[v]);
+    auto inserted = series_indices.emplace(key, series.size());
+    if (inserted.second)
+      series.push_back({
+        .region_name = store.strings[store.value_regions[v]],
+        .metric_name = store.strings[store.value_metrics[v]],
+        .host = store.strings[store.run_fields[run_host][run]],
+        .cpu = store.strings[store.run_fields[run_cpu][run]],
+        .parameters = store.strings[store.run_fields[run_parameters][run]],
+        .points = {},
+        .steps = {},
+      });
+
+    series[inserted.first->second].points.push_back(
+      {static_cast<size_t>(run_indices[run]), store.values[v]});
+  }
+
+  for (auto &trend : series)
+  {
+    std::vector<double> values;
+    values.reserve(trend.points.size());
+    for (const auto &point : trend.points)
+      values.push_back(point.value);
+    trend.steps = findStepChanges(values, query.window, query.threshold);
+  }
+
+  std::sort(series.begin(), series.end(),
+    [](const TrendSeries &a, const TrendSeries &b) {
+      return std::tie(a.region_name, a.host, a.cpu, a.parameters,
+          a.metric_name)
+        < std::tie(b.region_name, b.host, b.cpu, b.parameters,
+          b.metric_name);
+    });
+
+  return true;
+}
+
+// ===== step changes =====
+// reorders values
+static double median(std::vector<double> &values)
+{
+  size_t middle = values.size() / 2;
+  std::nth_element(values.begin(), values.begin() + middle, values.end());
+  double upper = values[middle];
+  if (values.size() % 2 == 1) return upper;
+
+  double lower = *std::max_element(values.begin(), values.begin() + middle);
+  return (lower + upper) / 2.0;
+}
+
+static double mean(std::vector<double>::const_iterator begin,
+  std::vector<double>::const_iterator end)
+{
+  double sum = 0.0;
+  for (auto value = begin; value != end; ++value)
+    sum += *value;
+  return sum / static_cast<double>(end - begin);
+}
+
+std::vector<fhv::history::StepChange> fhv::history::findStepChanges(
+  const std::vector<double> &values,
+  size_t window,
+  double threshold)
+{
+  std::vector<StepChange> steps;
+  if (window == 0) return steps;
+
+  const size_t min_runs = std::min(window, step_min_runs);
+  const size_t n = values.size();
+  double kept_mean_change = 0.0;
+
+  // reused for every point, since this runs for every point of every series
+  std::vector<double> before, after, deviations;
+
+  for (size_t i = min_runs; i + min_runs <= n; i++)
+  {
+    auto before_begin = values.begin() + (i - std::min(window, i));
+    auto after_end = values.begin() + (i + std::min(window, n - i));
+    before.assign(before_begin, values.begin() + i);
+    after.assign(values.begin() + i, after_end);
+
+    double before_median = median(before);
+    double after_median = median(after);
+    if (!(before_median > 0.0)) continue;
+
+    double relative_change = after_median / before_median - 1.0;
+    if (std::fabs(relative_change) < threshold) continue;
+
+    // the median absolute deviation needs a few values to mean anything
+    if (before.size() >= 3)
+    {
+      deviations.clear();
+      for (double value : before)
+        deviations.push_back(std::fabs(value - before_median));
+      double stddev = 1.4826 * median(deviations);
+      if (std::fabs(after_median - before_median)
+          <= step_noise_factor * stddev)
+        continue;
+    }
+
+    // medians change at several points around a step, the means change
+    // most at the step itself
+    StepChange step = {i, before_median, after_median, relative_change};
+    double mean_change = std::fabs(mean(values.begin() + i, after_end)
+      - mean(before_begin, values.begin() + i));
+    if (!steps.empty() && i - steps.back().point < window)
+    {
+      if (mean_change > kept_mean_change) {
+        steps.back() = step;
+        kept_mean_change = mean_change;
+      }
+      continue;
+    }
+
+    steps.push_back(step);
+    kept_mean_change = mean_change;
+  }
+
+  return steps;
+}
+
+// ===== report =====
+void fhv::history::printTrends(
+  const std::vector<HistoryRun> &runs,
+  const trend_series_t &series)
+{
+  fmt::print("{} series over {} runs\n", series.size(), runs.size());
+
+  size_t num_steps = 0;
+  const TrendSeries *previous = nullptr;
+  for (const auto &trend : series)
+  {
+    if (trend.points.empty()) continue;
+
+    if (previous == nullptr || trend.region_name != previous->region_name
+        || trend.setupLabel() != previous->setupLabel())
+      fmt::print("\nregion \"{}\" on {}\n", trend.region_name,
+        trend.setupLabel());
+    previous = &trend;
+
+    const HistoryRun &latest = runs[trend.points.back().run];
+    fmt::print("  {:<45} {:>6} runs, latest {:.4g} ({})\n", trend.metric_name,
+      trend.points.size(), trend.points.back().value, latest.label());
+
+    for (const auto &step : trend.steps)
+    {
+      const HistoryRun &run = runs[trend.points[step.point].run];
+      fmt::print("    step at {} (run {}): {:.4g} -> {:.4g} ({:+.1f}%)\n",
+        run.label(), run.id, step.before, step.after,
+        step.relative_change * 100.0);
+      num_steps++;
+    }
+  }
+
+  fmt::print("\n{} step changes found\n", num_steps);
+}
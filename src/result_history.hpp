@@ -0,0 +1,184 @@
+#pragma once
+
+#include <fmt/core.h>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "performance_monitor_defines.hpp"
+#include "run_parameters.hpp"
+#include "types.hpp"
+
+using json = nlohmann::json;
+
+/* ---- result history ----
+ * a local store that tracks results over months of commits. A history is a
+ * directory holding a copy of every run under "runs/" and an index with one
+ * json line per run, appended as runs are added:
+ *
+ *   {"id": ..., "time": ..., "commit": ..., "host": ..., "cpu": ...,
+ *    "parameters": ..., "parameter_values": {...},
+ *    "file": "runs/<id>/<results file>",
+ *    "regions": {"<region>": {"<metric>": value, ...}, ...}}
+ *
+ * "regions" holds the saturation and the arithmetic mean of the key metrics
+ * of each region, so queries only read the index, never the runs. Adding a
+ * run never rewrites the index.
+ *
+ * Parsing json is the slow part of reading tens of thousands of runs, so
+ * queries keep the parsed index in a binary cache next to it. Each query only
+ * parses the lines appended since the last one.
+ */
+namespace fhv {
+  namespace history {
+    const std::string history_default_directory = "fhv_history";
+    const std::string history_index_filename = "history_index.ndjson";
+    const std::string history_cache_filename = "history_cache.bin";
+    const std::string history_runs_directory = "runs";
+
+    // keys of an index entry
+    const std::string history_run_id_key = "id";
+    const std::string history_time_key = "time";
+    const std::string history_commit_key = "commit";
+    const std::string history_host_key = "host";
+    const std::string history_cpu_key = "cpu";
+    const std::string history_parameters_key = "parameters";
+    const std::string history_parameter_values_key = "parameter_values";
+    const std::string history_file_key = "file";
+    const std::string history_regions_key = "regions";
+    // besides the entry keys above, queries may filter on these
+    const std::string history_region_key = "region";
+    const std::string history_metric_key = "metric";
+    // "param.<name>" filters on a typed parameter
+    const std::string history_parameter_prefix = "param.";
+
+    // runs on each side of a possible step change that are compared
+    const size_t step_window_default = 5;
+    // relative change of the median that is flagged
+    const double step_threshold_default = 0.1;
+    // changes must also be this many standard deviations of the runs before
+    const double step_noise_factor = 3.0;
+    // runs that must show a new level before it is flagged
+    const size_t step_min_runs = 2;
+
+    /* ---- add run ----
+     * copies a results file (json, binary or stream) into the history and
+     * appends its entry to the index. An empty run_id is made from the time
+     * and the filename. An empty commit is taken from the build the results
+     * recorded, or else from FHV_COMMIT or "git rev-parse HEAD" in the
+     * current directory. Host, cpu and parameters come from the info section
+     * of the results.
+     *
+     * Prints the problem and returns false if the file can't be read or the
+     * run id is taken.
+     */
+    bool addRun(
+      const std::string &directory,
+      const std::string &results_filename,
+      std::string run_id,
+      std::string commit);
+
+    // the index entry of one run, without its results
+    struct HistoryRun {
+      std::string id;
+      long long time;
+      std::string commit;
+      std::string host;
+      std::string cpu;
+      std::string parameters;
+      // set with fhv_perfmon::setParameter(), an empty object for older runs
+      json parameter_values;
+      std::string file;
+
+      // commit, or the run id if there is none, short enough for labels
+      std::string label() const;
+    };
+
+    // a shift in the level of a series. point is the first point at the new
+    // level
+    struct StepChange {
+      size_t point;
+      double before;
+      double after;
+      double relative_change;
+    };
+
+    struct TrendPoint {
+      // index into the runs loaded with the series
+      size_t run;
+      double value;
+    };
+
+    // one metric of one region, on one host and cpu with one parameter string,
+    // in the order the runs were added
+    struct TrendSeries {
+      std::string region_name;
+      std::string metric_name;
+      std::string host;
+      std::string cpu;
+      std::string parameters;
+      std::vector<TrendPoint> points;
+      std::vector<StepChange> steps;
+
+      // host, cpu and parameters, which tell apart series of one metric
+      std::string setupLabel() const;
+    };
+
+    typedef std::vector<TrendSeries> trend_series_t;
+
+    struct HistoryQuery {
+      // (key, glob) pairs that must all match, e.g. ("host", "node*"). Keys
+      // are the entry keys, "region", "metric" and "param.<name>". Typed
+      // parameters that aren't strings are matched in their json form, so
+      // ("param.n", "4000") matches the number 4000
+      std::vector<std::pair<std::string, std::string>> where;
+      // metrics shown if "where" doesn't select any
+      std::vector<std::string> default_metrics;
+      size_t window;
+      double threshold;
+    };
+
+    /* ---- parse where ----
+     * parses "key=glob" conditions into query.where. Prints the problem and
+     * returns false for unknown keys or conditions without '='. Any
+     * "param.<name>" is accepted, runs without the parameter don't match.
+     */
+    bool parseWhere(
+      const std::vector<std::string> &conditions,
+      HistoryQuery &query);
+
+    /* ---- load history ----
+     * reads the index of a history and returns the runs matching the query
+     * and a series for every matching region and metric, with its step
+     * changes. Lines of the index that can't be parsed, like one cut off by
+     * a crash, are skipped with a warning.
+     *
+     * Returns false if the index can't be read.
+     */
+    bool loadHistory(
+      const std::string &directory,
+      const HistoryQuery &query,
+      std::vector<HistoryRun> &runs,
+      trend_series_t &series);
+
+    /* ---- find step changes ----
+     * compares the median of up to window values before each point with the
+     * median of up to window values from it on. A point starts a step if the
+     * medians differ by more than threshold, relative to the one before, and
+     * by more than step_noise_factor standard deviations of the values
+     * before (estimated from their median absolute deviation). Of the points
+     * around one step, the one where the means differ most is kept.
+     */
+    std::vector<StepChange> findStepChanges(
+      const std::vector<double> &values,
+      size_t window,
+      double threshold);
+
+    // prints every series with its latest value and step changes
+    void printTrends(
+      const std::vector<HistoryRun> &runs,
+      const trend_series_t &series);
+  };
+};
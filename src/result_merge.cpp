@@ -0,0 +1,341 @@
+#include "result_merge.hpp"
+
+#include <cmath>
+#include <map>
+#include <set>
+
+// ===== statistics =====
+double fhv::merge::tCriticalValue95(size_t degrees_of_freedom)
+{
+  // two-sided 95% critical values for 1 through 30 degrees of freedom
+  const std::vector<double> t_table = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+  };
+
+  if (degrees_of_freedom == 0) return NAN;
+  if (degrees_of_freedom <= t_table.size())
+    return t_table[degrees_of_freedom - 1];
+
+  // close enough to the normal distribution from here on
+  return 1.960;
+}
+
+fhv::merge::SampleStatistics fhv::merge::calculateStatistics(
+    const std::vector<double> &samples)
+{
+  SampleStatistics statistics = {
+    .mean = 0.0,
+    .stddev = 0.0,
+    .ci95_low = 0.0,
+    .ci95_high = 0.0,
+    .num_samples = samples.size(),
+  };
+
+  if (samples.empty()) return statistics;
+
+  for (const auto &sample : samples)
+    statistics.mean += sample;
+  statistics.mean /= static_cast<double>(samples.size());
+
+  statistics.ci95_low = statistics.mean;
+  statistics.ci95_high = statistics.mean;
+
+  // a single run has no spread
+  if (samples.size() < 2) return statistics;
+
+  double sum_of_squares = 0.0;
+  for (const auto &sample : samples)
+    sum_of_squares += (sample - statistics.mean) * (sample - statistics.mean);
+
+  statistics.stddev =
+    sqrt(sum_of_squares / static_cast<double>(samples.size() - 1));
+
+  double half_width = tCriticalValue95(samples.size() - 1)
+    * statistics.stddev / sqrt(static_cast<double>(samples.size()));
+  statistics.ci95_low = statistics.mean - half_width;
+  statistics.ci95_high = statistics.mean + half_width;
+
+  return statistics;
+}
+
+json fhv::merge::SampleStatistics::toJson() const
+{
+  json j;
+  j[json_statistics_mean_key] = this->mean;
+  j[json_statistics_stddev_key] = this->stddev;
+  j[json_statistics_ci95_low_key] = this->ci95_low;
+  j[json_statistics_ci95_high_key] = this->ci95_high;
+  j[json_statistics_num_samples_key] = this->num_samples;
+  return j;
+}
+
+// ===== merging =====
+json fhv::merge::mergeRuns(
+    const std::vector<json> &runs,
+    const std::vector<std::string> &filenames)
+{
+  json merged;
+  if (runs.empty()) return merged;
+
+  // region -> section -> metric -> one sample per run that has it
+  std::map<std::string,
+    std::map<std::string, std::map<std::string, std::vector<double>>>>
+    samples;
+
+  for (size_t i = 0; i < runs.size(); i++)
+  {
+    const auto &run = runs[i];
+
+    if (run.at(json_info_section).value(json_parameter_key, "")
+        != runs[0].at(json_info_section).value(json_parameter_key, ""))
+    {
+      fmt::print(stderr, "WARN: '{}' was run with different parameters than "
+        "'{}'. Merging anyway.\n", filenames[i], filenames[0]);
+    }
+
+    for (const auto &region : run.at(json_results_section).items())
+    {
+      for (const auto &section : region.value().items())
+      {
+        // merging a merged file would otherwise pick up its statistics
+        if (section.key() == json_statistics_section) continue;
+
+        for (const auto &metric : section.value().items())
+        {
+          if (!metric.value().is_number()) continue;
+
+          samples[region.key()][section.key()][metric.key()].push_back(
+            metric.value().get<double>());
+        }
+      }
+    }
+  }
+
+  merged[json_info_section] = runs[0].at(json_info_section);
+  merged[json_info_section][json_merged_from_key] = filenames;
+
+  for (const auto &region : samples)
+  {
+    json &merged_region = merged[json_results_section][region.first];
+
+    for (const auto &section : region.second)
+    {
+      bool is_thread_section = section.first.compare(0,
+        json_thread_section_base.size(), json_thread_section_base) == 0;
+
+      for (const auto &metric : section.second)
+      {
+        if (metric.second.size() != runs.size())
+          fmt::print(stderr, "WARN: region '{}' metric '{}' ({}) is only "
+            "present in {} of {} runs.\n", region.first, metric.first,
+            section.first, metric.second.size(), runs.size());
+
+        auto statistics = calculateStatistics(metric.second);
+        merged_region[section.first][metric.first] = statistics.mean;
+
+        // statistics for every thread would multiply the file size for
+        // little benefit, so only aggregates get them
+        if (!is_thread_section)
+          merged_region[json_statistics_section][section.first][metric.first]
+            = statistics.toJson();
+      }
+    }
+  }
+
+  return merged;
+}
+
+json fhv::merge::mergeRanks(
+    const std::vector<json> &ranks,
+    const std::vector<std::string> &filenames)
+{
+  json merged;
+  if (ranks.empty()) return merged;
+
+  const std::string sum_section = fhv::types::aggregationTypeToString(
+      fhv::types::aggregation_t::sum);
+  const std::string arithmetic_mean_section =
+    fhv::types::aggregationTypeToString(
+      fhv::types::aggregation_t::arithmetic_mean);
+  const std::string geometric_mean_section =
+    fhv::types::aggregationTypeToString(
+      fhv::types::aggregation_t::geometric_mean);
+  const std::string saturation_section = fhv::types::aggregationTypeToString(
+      fhv::types::aggregation_t::saturation);
+
+  // --- identify ranks
+  std::vector<int> rank_ids(ranks.size());
+  std::vector<std::string> hostnames(ranks.size());
+  std::vector<double> num_threads(ranks.size());
+  std::map<int, size_t> seen_ranks;
+  double total_num_threads = 0.0;
+
+  merged[json_info_section] = ranks[0].at(json_info_section);
+  merged[json_info_section].erase(json_rank_key);
+  merged[json_info_section].erase(json_hostname_key);
+  merged[json_info_section][json_ranks_key] = json::array();
+
+  for (size_t i = 0; i < ranks.size(); i++)
+  {
+    const json &info = ranks[i].at(json_info_section);
+
+    rank_ids[i] = info.value(json_rank_key, -1);
+    if (rank_ids[i] < 0)
+    {
+      fmt::print(stderr, "WARN: '{}' does not record a rank. Using its "
+        "position on the command line ({}) instead.\n", filenames[i], i);
+      rank_ids[i] = static_cast<int>(i);
+    }
+    if (seen_ranks.count(rank_ids[i]))
+      fmt::print(stderr, "WARN: '{}' and '{}' both claim to be rank {}.\n",
+        filenames[seen_ranks[rank_ids[i]]], filenames[i], rank_ids[i]);
+    seen_ranks[rank_ids[i]] = i;
+
+    hostnames[i] = info.value(json_hostname_key, "unknown");
+    num_threads[i] = info.at(json_processor_section)
+      .value(json_processor_num_threads_in_use_key, 1.0);
+    total_num_threads += num_threads[i];
+
+    json rank_info;
+    rank_info[json_rank_key] = rank_ids[i];
+    rank_info[json_hostname_key] = hostnames[i];
+    rank_info[json_rank_file_key] = filenames[i];
+    rank_info[json_processor_num_threads_in_use_key] =
+      static_cast<unsigned>(num_threads[i]);
+    rank_info[json_processor_affinity_key] = info.at(json_processor_section)
+      .value(json_processor_affinity_key, "");
+    merged[json_info_section][json_ranks_key].push_back(rank_info);
+  }
+
+  std::set<std::string> nodes(hostnames.begin(), hostnames.end());
+  merged[json_info_section][json_num_ranks_key] = ranks.size();
+  merged[json_info_section][json_num_nodes_key] = nodes.size();
+  merged[json_info_section][json_processor_section]
+    [json_processor_num_threads_in_use_key] =
+      static_cast<unsigned>(total_num_threads);
+  merged[json_info_section][json_processor_section]
+    [json_processor_affinity_key] = "per rank, see info.ranks";
+
+  // --- gather per-rank values
+  // region -> section -> metric -> (rank index, value)
+  std::map<std::string, std::map<std::string, std::map<std::string,
+    std::vector<std::pair<size_t, double>>>>> values;
+
+  for (size_t i = 0; i < ranks.size(); i++)
+  {
+    for (const auto &region : ranks[i].at(json_results_section).items())
+    {
+      for (const auto &section : region.value().items())
+      {
+        if (section.key() != sum_section
+            && section.key() != arithmetic_mean_section
+            && section.key() != geometric_mean_section
+            && section.key() != saturation_section)
+          continue;
+
+        for (const auto &metric : section.value().items())
+        {
+          if (!metric.value().is_number()) continue;
+          values[region.key()][section.key()][metric.key()].push_back(
+            {i, metric.value().get<double>()});
+        }
+      }
+    }
+  }
+
+  // --- combine
+  for (const auto &region : values)
+  {
+    json &merged_region = merged[json_results_section][region.first];
+
+    for (const auto &section : region.second)
+    {
+      for (const auto &metric : section.second)
+      {
+        const auto &rank_values = metric.second;
+
+        if (section.first == sum_section)
+        {
+          double sum = 0.0;
+          for (const auto &rank_value : rank_values)
+            sum += rank_value.second;
+          merged_region[section.first][metric.first] = sum;
+        }
+        else if (section.first == arithmetic_mean_section)
+        {
+          double weighted_sum = 0.0, weight = 0.0;
+          for (const auto &rank_value : rank_values)
+          {
+            weighted_sum += rank_value.second * num_threads[rank_value.first];
+            weight += num_threads[rank_value.first];
+          }
+          merged_region[section.first][metric.first] = weighted_sum / weight;
+        }
+        else if (section.first == geometric_mean_section)
+        {
+          double weighted_log_sum = 0.0, weight = 0.0;
+          for (const auto &rank_value : rank_values)
+          {
+            weighted_log_sum +=
+              log(rank_value.second) * num_threads[rank_value.first];
+            weight += num_threads[rank_value.first];
+          }
+          merged_region[section.first][metric.first] =
+            exp(weighted_log_sum / weight);
+        }
+        else if (section.first == saturation_section)
+        {
+          std::map<std::string, double> node_saturation;
+          for (const auto &rank_value : rank_values)
+            node_saturation[hostnames[rank_value.first]] += rank_value.second;
+
+          double saturation = 0.0;
+          for (const auto &node : node_saturation)
+          {
+            merged_region[json_nodes_section][node.first][metric.first] =
+              node.second;
+            saturation += node.second;
+          }
+          merged_region[section.first][metric.first] =
+            saturation / static_cast<double>(node_saturation.size());
+        }
+
+        // means are already balanced by definition, so imbalance is only
+        // interesting for totals and saturation
+        if (section.first != sum_section && section.first != saturation_section)
+          continue;
+
+        std::vector<double> samples;
+        size_t min_index = 0, max_index = 0;
+        for (size_t k = 0; k < rank_values.size(); k++)
+        {
+          samples.push_back(rank_values[k].second);
+          if (rank_values[k].second < rank_values[min_index].second)
+            min_index = k;
+          if (rank_values[k].second > rank_values[max_index].second)
+            max_index = k;
+        }
+        auto statistics = calculateStatistics(samples);
+
+        json imbalance;
+        imbalance[json_statistics_mean_key] = statistics.mean;
+        imbalance[json_statistics_stddev_key] = statistics.stddev;
+        imbalance[json_imbalance_min_key] = rank_values[min_index].second;
+        imbalance[json_imbalance_max_key] = rank_values[max_index].second;
+        imbalance[json_imbalance_min_rank_key] =
+          rank_ids[rank_values[min_index].first];
+        imbalance[json_imbalance_max_rank_key] =
+          rank_ids[rank_values[max_index].first];
+        imbalance[json_imbalance_ratio_key] = statistics.mean != 0.0
+          ? rank_values[max_index].second / statistics.mean
+          : 1.0;
+        merged_region[json_imbalance_section][section.first][metric.first] =
+          imbalance;
+      }
+    }
+  }
+
+  return merged;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <fmt/core.h>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+#include "performance_monitor_defines.hpp"
+#include "types.hpp"
+
+using json = nlohmann::json;
+
+namespace fhv {
+  namespace merge {
+    // summary of one metric across repeated runs
+    struct SampleStatistics {
+      double mean;
+      double stddev;
+      double ci95_low;
+      double ci95_high;
+      size_t num_samples;
+
+      json toJson() const;
+    };
+
+    // mean, sample standard deviation and 95% confidence interval of the
+    // mean (using Student's t distribution, since runs are usually few)
+    SampleStatistics calculateStatistics(const std::vector<double> &samples);
+
+    // two-sided 95% critical value of Student's t distribution
+    double tCriticalValue95(size_t degrees_of_freedom);
+
+    /* ---- merge runs ----
+     * combines repeated runs of the same program into one json with the same
+     * layout as a json output by fhv_perfmon, so it can be visualized as
+     * usual. Every value is replaced by its mean across runs. Aggregate
+     * sections additionally get a "statistics" section per region holding
+     * the mean, standard deviation and 95% confidence interval per metric.
+     *
+     * filenames are only used to record where the data came from
+     */
+    json mergeRuns(
+        const std::vector<json> &runs,
+        const std::vector<std::string> &filenames);
+
+    /* ---- merge ranks ----
+     * combines the jsons written by each rank of one multi-process job into
+     * a single job-wide json. Ranks are identified by the "rank" and
+     * "hostname" keys in their info section (see fhv_perfmon::setJsonJobInfo).
+     *
+     * In the result, each region has:
+     *  - "sum": summed across ranks
+     *  - "arithmetic_mean" and "geometric_mean": means across all threads of
+     *    all ranks, assuming each rank's means cover its own threads
+     *  - "nodes": per-node saturation, which is the sum of the saturation of
+     *    every rank on that node, since machine stats describe one node
+     *  - "saturation": the mean of the per-node saturations
+     *  - "rank_imbalance": for each metric in "sum" and "saturation", the
+     *    spread of the per-rank values
+     *
+     * Per-thread sections are not carried over.
+     */
+    json mergeRanks(
+        const std::vector<json> &ranks,
+        const std::vector<std::string> &filenames);
+  };
+};
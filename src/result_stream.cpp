@@ -0,0 +1,410 @@
+#include "result_stream.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fmt/core.h>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <set>
+#include <thread>
+
+#include "likwid_defines.hpp"
+#include "performance_monitor_defines.hpp"
+#include "result_filter.hpp"
+#include "types.hpp"
+#include "utils.hpp"
+
+// one ring per thread, each allocated separately so their indices don't
+// share cache lines
+static std::vector<std::unique_ptr<fhv::stream::RecordRing>> rings;
+static std::atomic<bool> stream_enabled(false);
+static std::atomic<bool> writer_running(false);
+static std::thread writer_thread;
+static FILE *stream_file = nullptr;
+static std::chrono::steady_clock::time_point start_time;
+
+static std::vector<std::string> stream_group_names;
+static std::vector<std::vector<std::string>> stream_group_event_names;
+
+// ===== record ring =====
+fhv::stream::RecordRing::RecordRing()
+  : dropped(0), records(records_per_ring), head(0), tail(0)
+{
+}
+
+bool fhv::stream::RecordRing::push(const StreamRecord &record)
+{
+  uint64_t current_head = head.load(std::memory_order_relaxed);
+  if (current_head - tail.load(std::memory_order_acquire) >= records.size())
+  {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  records[current_head & (records.size() - 1)] = record;
+  head.store(current_head + 1, std::memory_order_release);
+  return true;
+}
+
+bool fhv::stream::RecordRing::pop(StreamRecord &record)
+{
+  uint64_t current_tail = tail.load(std::memory_order_relaxed);
+  if (current_tail == head.load(std::memory_order_acquire)) return false;
+
+  record = records[current_tail & (records.size() - 1)];
+  tail.store(current_tail + 1, std::memory_order_release);
+  return true;
+}
+
+// ===== writing =====
+static std::string groupName(int group)
+{
+  if (group < 0 || static_cast<size_t>(group) >= stream_group_names.size())
+    return std::to_string(group);
+  return stream_group_names[group];
+}
+
+static void writeLine(const json &record)
+{
+  std::string line = record.dump();
+  line += '\n';
+  std::fwrite(line.data(), 1, line.size(), stream_file);
+}
+
+static json toJson(const fhv::stream::StreamRecord &record)
+{
+  using namespace fhv::stream;
+
+  json line = {
+    {stream_thread_key, record.thread_num},
+    {stream_group_key, groupName(record.group)},
+    {stream_elapsed_key, record.elapsed},
+  };
+
+  if (record.type == record_t::group)
+  {
+    line[stream_record_key] = stream_group_record;
+    return line;
+  }
+
+  line[stream_record_key] = stream_region_record;
+  line[stream_region_key] = record.region_name;
+  line[stream_count_key] = record.count;
+  line[stream_time_key] = record.time;
+
+  json events = json::object();
+  for (int i = 0; i < record.num_events; i++)
+  {
+    bool named = record.group >= 0
+      && static_cast<size_t>(record.group) < stream_group_event_names.size()
+      && static_cast<size_t>(i) < stream_group_event_names[record.group].size();
+    events[named ? stream_group_event_names[record.group][i]
+      : std::to_string(i)] = record.events[i];
+  }
+  line[stream_events_key] = events;
+
+  return line;
+}
+
+// writes every queued record. Returns how many there were.
+static size_t drain()
+{
+  size_t num_written = 0;
+  fhv::stream::StreamRecord record;
+  for (auto &ring : rings)
+  {
+    while (ring->pop(record))
+    {
+      writeLine(toJson(record));
+      num_written++;
+    }
+  }
+
+  // flushed after every batch, so a killed run loses at most one interval
+  if (num_written > 0) std::fflush(stream_file);
+  return num_written;
+}
+
+static void writerLoop()
+{
+  while (writer_running.load(std::memory_order_acquire))
+  {
+    if (drain() == 0)
+      std::this_thread::sleep_for(
+        std::chrono::milliseconds(fhv::stream::writer_interval_ms));
+  }
+}
+
+static double elapsedSeconds()
+{
+  return std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start_time).count();
+}
+
+bool fhv::stream::enable(
+  const std::string &filename,
+  int num_threads,
+  const json &info,
+  const std::vector<std::string> &group_names,
+  const std::vector<std::vector<std::string>> &group_event_names)
+{
+  if (stream_enabled) finish(json::object());
+
+  fhv::utils::create_directories_for_file(filename);
+  stream_file = std::fopen(filename.c_str(), "w");
+  if (stream_file == nullptr) {
+    fmt::print(stderr, "ERROR: could not open the result stream '{}'\n",
+      filename);
+    return false;
+  }
+
+  rings.clear();
+  for (int t = 0; t < num_threads; t++)
+    rings.emplace_back(new RecordRing());
+
+  stream_group_names = group_names;
+  stream_group_event_names = group_event_names;
+  start_time = std::chrono::steady_clock::now();
+
+  json groups = json::array();
+  for (size_t g = 0; g < group_names.size(); g++)
+    groups.push_back({
+      {stream_group_key, group_names[g]},
+      {stream_events_key, g < group_event_names.size()
+        ? group_event_names[g] : std::vector<std::string>{}},
+    });
+
+  writeLine({
+    {stream_version_key, stream_format_version},
+    {stream_record_key, stream_start_record},
+    {stream_info_key, info},
+    {stream_groups_key, groups},
+  });
+  std::fflush(stream_file);
+
+  writer_running = true;
+  writer_thread = std::thread(writerLoop);
+  stream_enabled = true;
+  return true;
+}
+
+bool fhv::stream::enabled()
+{
+  return stream_enabled.load(std::memory_order_relaxed);
+}
+
+void fhv::stream::recordRegion(
+  int thread_num,
+  const char *region_name,
+  int group,
+  const double *events,
+  int num_events,
+  double time,
+  int count)
+{
+  if (!enabled() || thread_num < 0
+      || static_cast<size_t>(thread_num) >= rings.size())
+    return;
+
+  StreamRecord record;
+  record.type = record_t::region;
+  record.thread_num = thread_num;
+  record.group = group;
+  record.count = count;
+  record.num_events = std::min(std::max(num_events, 0),
+    max_events_per_record);
+  record.elapsed = elapsedSeconds();
+  record.time = time;
+  std::memcpy(record.events, events, record.num_events * sizeof(double));
+  std::strncpy(record.region_name, region_name, max_region_name_length);
+  record.region_name[max_region_name_length] = '\0';
+
+  rings[thread_num]->push(record);
+}
+
+void fhv::stream::recordGroupSwitch(int thread_num, int group)
+{
+  if (!enabled() || thread_num < 0
+      || static_cast<size_t>(thread_num) >= rings.size())
+    return;
+
+  StreamRecord record;
+  record.type = record_t::group;
+  record.thread_num = thread_num;
+  record.group = group;
+  record.count = 0;
+  record.num_events = 0;
+  record.elapsed = elapsedSeconds();
+  record.time = 0.0;
+  record.region_name[0] = '\0';
+
+  rings[thread_num]->push(record);
+}
+
+void fhv::stream::finish(const json &region_results)
+{
+  if (!stream_enabled) return;
+  stream_enabled = false;
+
+  writer_running = false;
+  if (writer_thread.joinable()) writer_thread.join();
+  drain();
+
+  for (const auto &region : region_results.items())
+    writeLine({
+      {stream_record_key, stream_results_record},
+      {stream_region_key, region.key()},
+      {stream_sections_key, region.value()},
+    });
+
+  uint64_t dropped = 0;
+  for (const auto &ring : rings)
+    dropped += ring->dropped.load();
+
+  writeLine({
+    {stream_record_key, stream_end_record},
+    {stream_elapsed_key, elapsedSeconds()},
+    {stream_dropped_key, dropped},
+  });
+
+  if (dropped > 0)
+    fmt::print(stderr, "WARN: {} records of the result stream were dropped "
+      "because it could not be written fast enough.\n", dropped);
+
+  std::fclose(stream_file);
+  stream_file = nullptr;
+  rings.clear();
+}
+
+// ===== reading =====
+bool fhv::stream::isStream(const std::string &filename)
+{
+  std::ifstream i(filename);
+  std::string prefix = "{\"" + stream_version_key + "\":";
+  std::string start(prefix.size(), '\0');
+  if (!i.read(&start[0], start.size())) return false;
+
+  return start == prefix;
+}
+
+bool fhv::stream::loadStream(const std::string &filename, json &results)
+{
+  std::ifstream i(filename);
+  if (!i) {
+    fmt::print(stderr, "ERROR: '{}' does not exist!\n", filename);
+    return false;
+  }
+
+  results = json::object();
+  results[json_results_section] = json::object();
+  json &region_results = results[json_results_section];
+
+  // regions whose final results were written
+  std::set<std::string> finished_regions;
+  bool started = false;
+  bool ended = false;
+  size_t line_num = 0;
+  std::string line;
+  while (std::getline(i, line))
+  {
+    line_num++;
+    if (line.empty()) continue;
+
+    json record;
+    try {
+      record = json::parse(line);
+    }
+    catch (json::parse_error &e) {
+      // the last line of a killed run may be cut off
+      fmt::print(stderr, "WARN: '{}' ends with an incomplete record on line "
+        "{}; the rest is ignored.\n", filename, line_num);
+      break;
+    }
+
+    std::string type = record.value(stream_record_key, "");
+    if (!started)
+    {
+      if (type != stream_start_record || !record.contains(stream_version_key))
+      {
+        fmt::print(stderr, "ERROR: '{}' is not a result stream.\n", filename);
+        return false;
+      }
+      results[json_info_section] = record.value(stream_info_key,
+        json::object());
+      started = true;
+      continue;
+    }
+
+    if (type == stream_region_record)
+    {
+      std::string region_name = record.value(stream_region_key, "");
+      if (finished_regions.count(region_name)) continue;
+
+      // groups share events like INSTR_RETIRED_ANY, so each is kept under
+      // its group, like resultsToJson does
+      std::string group_name = record.value(stream_group_key, "");
+      json &thread_section = region_results[region_name][
+        json_thread_section_base
+        + std::to_string(record.value(stream_thread_key, 0))];
+      for (const auto &event : record[stream_events_key].items())
+        thread_section[fhv::filter::jsonResultName(group_name, event.key())] =
+          event.value();
+      fhv::filter::setJsonResult(thread_section, group_name,
+        runtime_metric_name, record.value(stream_time_key, 0.0));
+    }
+    else if (type == stream_results_record)
+    {
+      std::string region_name = record.value(stream_region_key, "");
+      region_results[region_name] = record.value(stream_sections_key,
+        json::object());
+      finished_regions.insert(region_name);
+    }
+    else if (type == stream_end_record)
+    {
+      ended = true;
+    }
+  }
+
+  if (!started) {
+    fmt::print(stderr, "ERROR: '{}' is not a result stream.\n", filename);
+    return false;
+  }
+
+  if (!ended)
+    fmt::print(stderr, "WARN: '{}' has no end record, so the run did not "
+      "finish. Regions without final results show the totals of each "
+      "thread's events so far.\n", filename);
+
+  // regions that never got their final results are summed and averaged
+  // across threads, so tools that look at aggregates have something to go by
+  const std::string sum_section = fhv::types::aggregationTypeToString(
+    fhv::types::aggregation_t::sum);
+  const std::string mean_section = fhv::types::aggregationTypeToString(
+    fhv::types::aggregation_t::arithmetic_mean);
+  for (auto &region : region_results.items())
+  {
+    if (finished_regions.count(region.key())) continue;
+
+    std::map<std::string, std::pair<double, size_t>> totals;
+    for (const auto &section : region.value().items())
+      for (const auto &event : section.value().items())
+        if (event.value().is_number())
+        {
+          auto &total = totals[event.key()];
+          total.first += event.value().get<double>();
+          total.second++;
+        }
+
+    for (const auto &total : totals)
+    {
+      region.value()[sum_section][total.first] = total.second.first;
+      region.value()[mean_section][total.first] =
+        total.second.first / total.second.second;
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+/* ---- result stream ----
+ * writes newline-delimited json records while the program runs, so a run
+ * that crashes or is killed still leaves its results behind. Each line is
+ * one record; the "record" key says which:
+ *
+ *  - start: the first line, with the info section and the name and events
+ *    of every group. Also has the key "fhv_stream" (the format version),
+ *    which is how stream files are recognized.
+ *  - region: the totals of a region on a thread after one of its instances
+ *    ended: group, call count, time and the value of every event of the
+ *    group. Totals are cumulative, so the last record of a region, thread
+ *    and group holds everything measured so far.
+ *  - group: the active group switched
+ *  - results: written by close(), the results of a region exactly as in the
+ *    "region_results" of the json written by resultsToJson
+ *  - end: the run finished. Has the number of records that were dropped.
+ *
+ * Instrumented threads never wait for the file: each pushes its records to
+ * its own single-producer, single-consumer ring, and a background thread
+ * drains every ring and writes and flushes the lines. If a ring is full the
+ * record is dropped and counted rather than blocking the thread.
+ */
+namespace fhv {
+  namespace stream {
+    const int stream_format_version = 1;
+
+    // keys of the records
+    const std::string stream_version_key = "fhv_stream";
+    const std::string stream_record_key = "record";
+    const std::string stream_start_record = "start";
+    const std::string stream_region_record = "region";
+    const std::string stream_group_record = "group";
+    const std::string stream_results_record = "results";
+    const std::string stream_end_record = "end";
+    const std::string stream_info_key = "info";
+    const std::string stream_groups_key = "groups";
+    const std::string stream_events_key = "events";
+    const std::string stream_thread_key = "thread";
+    const std::string stream_region_key = "region";
+    const std::string stream_group_key = "group";
+    const std::string stream_count_key = "count";
+    const std::string stream_time_key = "time";
+    const std::string stream_elapsed_key = "elapsed";
+    const std::string stream_sections_key = "sections";
+    const std::string stream_dropped_key = "dropped";
+
+    // per-thread ring size. Must be a power of two.
+    const size_t records_per_ring = 1024;
+    // most events and region name characters kept per record
+    const int max_events_per_record = 32;
+    const size_t max_region_name_length = 127;
+    // how long the writer sleeps when every ring is empty
+    const unsigned writer_interval_ms = 10;
+
+    enum class record_t { region, group };
+
+    struct StreamRecord {
+      record_t type;
+      int thread_num;
+      int group;
+      int count;
+      int num_events;
+      // seconds since the stream was started
+      double elapsed;
+      // time spent in the region so far, in seconds
+      double time;
+      double events[max_events_per_record];
+      char region_name[max_region_name_length + 1];
+    };
+
+    /* ---- record ring ----
+     * a fixed-size single-producer, single-consumer queue. head is only
+     * written by the producer and tail only by the consumer; they are kept
+     * on separate cache lines so the two don't slow each other down.
+     */
+    class RecordRing {
+      public:
+        RecordRing();
+
+        // producer side. Returns false if the ring is full.
+        bool push(const StreamRecord &record);
+        // consumer side. Returns false if the ring is empty.
+        bool pop(StreamRecord &record);
+
+        std::atomic<uint64_t> dropped;
+
+      private:
+        std::vector<StreamRecord> records;
+        char padding_head[64];
+        std::atomic<uint64_t> head;
+        char padding_tail[64];
+        std::atomic<uint64_t> tail;
+    };
+
+    /* ---- enable ----
+     * truncates filename, writes the start record and starts the writer
+     * thread. group_names and group_event_names are indexed by likwid group
+     * id. Returns false if the file can't be opened.
+     */
+    bool enable(
+      const std::string &filename,
+      int num_threads,
+      const json &info,
+      const std::vector<std::string> &group_names,
+      const std::vector<std::vector<std::string>> &group_event_names);
+    bool enabled();
+
+    // called by the instrumented threads. thread_num picks the ring, so a
+    // thread must always pass its own number.
+    void recordRegion(
+      int thread_num,
+      const char *region_name,
+      int group,
+      const double *events,
+      int num_events,
+      double time,
+      int count);
+    void recordGroupSwitch(int thread_num, int group);
+
+    /* ---- finish ----
+     * stops the writer after it wrote every queued record, then writes a
+     * results record per region of region_results and the end record
+     */
+    void finish(const json &region_results);
+
+    // true if filename starts like a stream file
+    bool isStream(const std::string &filename);
+
+    /* ---- load stream ----
+     * results in the format written by resultsToJson from a stream file,
+     * even one that ends early. Regions with a results record are taken
+     * from it. For the others, each thread gets the latest totals of every
+     * event it measured, named by fhv::filter::jsonResultName, and the
+     * runtime. Returns false if the file can't be read or doesn't start with
+     * a start record.
+     */
+    bool loadStream(const std::string &filename, json &results);
+  };
+};
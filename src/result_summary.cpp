@@ -0,0 +1,368 @@
+#include "result_summary.hpp"
+
+#include <algorithm>
+#include <fmt/core.h>
+#include <fstream>
+
+#include "binary_results.hpp"
+#include "performance_monitor_defines.hpp"
+#include "result_stream.hpp"
+
+// ===== sax handler =====
+/* walks the results json, building only the info section and the
+ * non-thread sections of the selected regions. Everything else is skipped
+ * without being stored.
+ *
+ * Until a kept section starts, depth tracks where the parser is: 1 in the
+ * top level object, 2 in region_results and 3 in a region. Inside a kept
+ * section, values are added to the innermost container on build_stack.
+ */
+class summary_sax : public nlohmann::json_sax<json> {
+  public:
+    summary_sax(
+      fhv::summary::ResultsSummary &summary,
+      const std::set<std::string> &region_names)
+      : summary(summary), region_names(region_names), depth(0),
+        skip_depth(0), next(action::skip), target(nullptr)
+    {
+    }
+
+    bool null() override { return add(nullptr); }
+    bool boolean(bool val) override { return add(val); }
+    bool number_integer(number_integer_t val) override { return add(val); }
+    bool number_unsigned(number_unsigned_t val) override { return add(val); }
+    bool number_float(number_float_t val, const string_t &) override
+    {
+      return add(val);
+    }
+    bool string(string_t &val) override { return add(val); }
+
+    bool start_object(std::size_t) override
+    {
+      if (skip_depth > 0) {
+        skip_depth++;
+        return true;
+      }
+
+      if (!build_stack.empty()) {
+        build_stack.push_back(&add_to_container(json::object()));
+        return true;
+      }
+
+      if (depth == 0) {
+        depth = 1;
+        return true;
+      }
+
+      switch (next)
+      {
+        case action::enter:
+          depth++;
+          break;
+        case action::build:
+          *target = json::object();
+          build_stack.push_back(target);
+          break;
+        case action::skip:
+          skip_depth = 1;
+          break;
+      }
+      next = action::skip;
+      return true;
+    }
+
+    bool end_object() override
+    {
+      if (skip_depth > 0)
+        skip_depth--;
+      else if (!build_stack.empty())
+        build_stack.pop_back();
+      else
+        depth--;
+      return true;
+    }
+
+    bool start_array(std::size_t) override
+    {
+      if (skip_depth > 0) {
+        skip_depth++;
+        return true;
+      }
+
+      if (!build_stack.empty()) {
+        build_stack.push_back(&add_to_container(json::array()));
+        return true;
+      }
+
+      // only kept sections may be arrays
+      if (next == action::build) {
+        *target = json::array();
+        build_stack.push_back(target);
+      }
+      else
+        skip_depth = 1;
+
+      next = action::skip;
+      return true;
+    }
+
+    bool end_array() override
+    {
+      if (skip_depth > 0)
+        skip_depth--;
+      else
+        build_stack.pop_back();
+      return true;
+    }
+
+    bool key(string_t &val) override
+    {
+      if (skip_depth > 0) return true;
+
+      if (!build_stack.empty()) {
+        last_key = val;
+        return true;
+      }
+
+      next = action::skip;
+      if (depth == 1)
+      {
+        if (val == json_info_section) {
+          next = action::build;
+          target = &summary.info;
+        }
+        else if (val == json_results_section)
+          next = action::enter;
+      }
+      else if (depth == 2)
+      {
+        if (region_names.empty() || region_names.count(val)) {
+          summary.regions.push_back({val, json::object()});
+          next = action::enter;
+        }
+      }
+      else if (depth == 3)
+      {
+        if (val.compare(0, json_thread_section_base.size(),
+            json_thread_section_base) != 0) {
+          next = action::build;
+          target = &summary.regions.back().sections[val];
+        }
+      }
+
+      return true;
+    }
+
+    bool parse_error(
+      std::size_t,
+      const std::string &,
+      const nlohmann::detail::exception &ex) override
+    {
+      error = ex.what();
+      return false;
+    }
+
+    std::string error;
+
+  private:
+    enum class action { skip, enter, build };
+
+    template<typename T>
+    bool add(T &&val)
+    {
+      if (skip_depth > 0) return true;
+
+      if (!build_stack.empty())
+        add_to_container(json(std::forward<T>(val)));
+      else if (next == action::build)
+        *target = json(std::forward<T>(val));
+
+      next = action::skip;
+      return true;
+    }
+
+    json &add_to_container(json &&val)
+    {
+      json &container = *build_stack.back();
+      if (container.is_array()) {
+        container.push_back(std::move(val));
+        return container.back();
+      }
+
+      json &member = container[last_key];
+      member = std::move(val);
+      return member;
+    }
+
+    fhv::summary::ResultsSummary &summary;
+    const std::set<std::string> &region_names;
+
+    int depth;
+    size_t skip_depth;
+    // what to do with the value of the key that was just read
+    action next;
+    json *target;
+
+    std::vector<json *> build_stack;
+    std::string last_key;
+};
+
+// ===== loading =====
+const fhv::summary::RegionSummary *fhv::summary::ResultsSummary::region(
+  const std::string &region_name) const
+{
+  auto region = std::lower_bound(regions.begin(), regions.end(), region_name,
+    [](const RegionSummary &a, const std::string &name) {
+      return a.name < name;
+    });
+  if (region == regions.end() || region->name != region_name) return nullptr;
+  return &*region;
+}
+
+/* reads the aggregate rows of a binary file straight from its columns. Keeps
+ * the same rows MappedResults::toJson does, but never builds the per-thread
+ * sections or the json of the whole file.
+ */
+static bool loadSummaryFromBinary(
+  const std::string &filename,
+  fhv::summary::ResultsSummary &summary,
+  const std::set<std::string> &region_names)
+{
+  fhv::binary::MappedResults mapped;
+  if (!mapped.open(filename)) return false;
+
+  summary.info = mapped.info();
+
+  std::vector<std::string> aggregation_names;
+  for (const auto &aggregation : {fhv::types::aggregation_t::sum,
+      fhv::types::aggregation_t::arithmetic_mean,
+      fhv::types::aggregation_t::geometric_mean,
+      fhv::types::aggregation_t::saturation})
+    aggregation_names.push_back(
+      fhv::types::aggregationTypeToString(aggregation));
+
+  // most rows share a few strings, so each one is looked at once. -1 means
+  // not decided yet
+  const size_t num_strings = mapped.numStrings();
+  std::vector<int> is_key_metric(num_strings, -1);
+  std::vector<std::string> metric_names(num_strings);
+  // index into summary.regions, -1 if not decided yet, -2 if left out
+  std::vector<long> region_index(num_strings, -1);
+
+  const uint32_t *region_column = mapped.regions();
+  const int8_t *aggregation_column = mapped.aggregations();
+  const uint8_t *type_column = mapped.resultTypes();
+  const uint32_t *name_column = mapped.resultNames();
+  const double *value_column = mapped.values();
+
+  for (size_t row = 0; row < mapped.numRows(); row++)
+  {
+    int8_t aggregation = aggregation_column[row];
+    if (aggregation < 0
+        || static_cast<size_t>(aggregation) >= aggregation_names.size())
+      continue;
+    if (type_column[row]
+        != static_cast<uint8_t>(fhv::types::result_t::metric))
+      continue;
+
+    uint32_t result_name = name_column[row];
+    uint32_t region = region_column[row];
+    if (result_name >= num_strings || region >= num_strings) continue;
+
+    if (is_key_metric[result_name] < 0) {
+      metric_names[result_name] = mapped.string(result_name);
+      is_key_metric[result_name] = std::find(fhv_key_metrics.begin(),
+        fhv_key_metrics.end(), metric_names[result_name])
+        != fhv_key_metrics.end();
+    }
+    if (!is_key_metric[result_name]) continue;
+
+    if (region_index[region] == -1) {
+      std::string region_name = mapped.string(region);
+      if (!region_names.empty() && !region_names.count(region_name))
+        region_index[region] = -2;
+      else {
+        region_index[region] = static_cast<long>(summary.regions.size());
+        summary.regions.push_back({
+          .name = region_name,
+          .sections = json::object(),
+        });
+      }
+    }
+    if (region_index[region] < 0) continue;
+
+    summary.regions[region_index[region]].sections[
+      aggregation_names[aggregation]][metric_names[result_name]] =
+      value_column[row];
+  }
+
+  return true;
+}
+
+// for result streams, which are loaded as a whole by fhv::binary::loadResults
+static bool loadSummaryFromJson(
+  const std::string &filename,
+  fhv::summary::ResultsSummary &summary,
+  const std::set<std::string> &region_names)
+{
+  json results;
+  if (!fhv::binary::loadResults(filename, results, false)) return false;
+
+  summary.info = results.value(json_info_section, json::object());
+  if (!results.contains(json_results_section)) return true;
+
+  for (auto &region : results[json_results_section].items())
+  {
+    if (!region_names.empty() && !region_names.count(region.key())) continue;
+
+    fhv::summary::RegionSummary region_summary = {
+      .name = region.key(),
+      .sections = json::object(),
+    };
+    for (auto &section : region.value().items())
+      if (section.key().compare(0, json_thread_section_base.size(),
+          json_thread_section_base) != 0)
+        region_summary.sections[section.key()] = std::move(section.value());
+
+    summary.regions.push_back(std::move(region_summary));
+  }
+
+  return true;
+}
+
+bool fhv::summary::loadSummary(
+  const std::string &filename,
+  ResultsSummary &summary,
+  const std::set<std::string> &region_names)
+{
+  summary.info = json::object();
+  summary.regions.clear();
+
+  if (fhv::stream::isStream(filename))
+    return loadSummaryFromJson(filename, summary, region_names);
+
+  if (fhv::binary::isBinaryResults(filename)) {
+    if (!loadSummaryFromBinary(filename, summary, region_names)) return false;
+  }
+  else {
+    std::ifstream i(filename);
+    if (!i) {
+      fmt::print(stderr, "ERROR: The json '{}' does not exist!\n", filename);
+      return false;
+    }
+
+    summary_sax handler(summary, region_names);
+    if (!json::sax_parse(i, &handler)) {
+      fmt::print(stderr, "ERROR: could not parse '{}': {}\n", filename,
+        handler.error);
+      return false;
+    }
+  }
+
+  std::sort(summary.regions.begin(), summary.regions.end(),
+    [](const RegionSummary &a, const RegionSummary &b) {
+      return a.name < b.name;
+    });
+
+  return true;
+}
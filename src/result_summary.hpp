@@ -0,0 +1,50 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <set>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+/* ---- result summary ----
+ * the parts of a results file that diagrams are drawn from: the info section
+ * and the aggregate sections (and statistics, for merged results) of each
+ * region. Per-thread sections, which make up most of a file with many
+ * threads, are never loaded.
+ *
+ * jsons are read with a SAX parser that builds only the parts that are kept
+ * and skips everything else as it goes, so neither memory nor time depends
+ * on how many threads were measured. Binary files are mapped and their
+ * aggregate rows read straight from the columns. Result streams are loaded
+ * with fhv::binary::loadResults.
+ */
+namespace fhv {
+  namespace summary {
+    struct RegionSummary {
+      std::string name;
+      // section name -> metric -> value, like region_results[name] without
+      // the thread sections
+      json sections;
+    };
+
+    struct ResultsSummary {
+      json info;
+      // sorted by name, like the regions of a json object
+      std::vector<RegionSummary> regions;
+
+      // nullptr if there is no region with that name
+      const RegionSummary *region(const std::string &region_name) const;
+    };
+
+    /* ---- load summary ----
+     * loads filename into summary. If region_names is not empty, only these
+     * regions are kept. Prints an error and returns false if the file can't
+     * be read or parsed.
+     */
+    bool loadSummary(
+      const std::string &filename,
+      ResultsSummary &summary,
+      const std::set<std::string> &region_names = {});
+  };
+};
@@ -0,0 +1,339 @@
+#include "run_environment.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fmt/core.h>
+#include <fstream>
+#include <likwid.h>
+#include <map>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include "performance_monitor_defines.hpp"
+
+// ===== reading the environment =====
+const std::string sysfs_cpu_directory = "/sys/devices/system/cpu/";
+
+// first line of a sysfs or procfs file, false if it can't be read
+static bool readLine(const std::string &filename, std::string &line)
+{
+  std::ifstream file(filename);
+  return static_cast<bool>(std::getline(file, line));
+}
+
+// a sysfs file holding "0" or "1"
+static bool readFlag(const std::string &filename, bool &flag)
+{
+  std::string line;
+  if (!readLine(filename, line) || (line != "0" && line != "1")) return false;
+  flag = line == "1";
+  return true;
+}
+
+static std::string likwidVersion()
+{
+#if defined(LIKWID_MAJOR_VERSION) && defined(LIKWID_RELEASE_VERSION) \
+  && defined(LIKWID_MINOR_VERSION)
+  return fmt::format("{}.{}.{}", LIKWID_MAJOR_VERSION, LIKWID_RELEASE_VERSION,
+    LIKWID_MINOR_VERSION);
+#elif defined(LIKWID_VERSION)
+  return LIKWID_VERSION;
+#else
+  return "";
+#endif
+}
+
+// intel_pstate has a switch to turn turbo off, acpi-cpufreq and amd-pstate
+// one to turn it on
+static bool readTurbo(bool &turbo)
+{
+  bool no_turbo;
+  if (readFlag(sysfs_cpu_directory + "intel_pstate/no_turbo", no_turbo)) {
+    turbo = !no_turbo;
+    return true;
+  }
+  return readFlag(sysfs_cpu_directory + "cpufreq/boost", turbo);
+}
+
+// the selected mode is in brackets: "always [madvise] never"
+static bool readTransparentHugepages(std::string &mode)
+{
+  std::string line;
+  if (!readLine("/sys/kernel/mm/transparent_hugepage/enabled", line))
+    return false;
+
+  size_t open = line.find('[');
+  size_t close = line.find(']', open);
+  if (open == std::string::npos || close == std::string::npos) return false;
+  mode = line.substr(open + 1, close - open - 1);
+  return true;
+}
+
+// the memory policy of the calling thread. get_mempolicy is called directly
+// rather than through libnuma, which fhv doesn't link otherwise
+static bool readNumaPolicy(std::string &policy)
+{
+  const unsigned long max_nodes = 1024;
+  const unsigned long bits_per_word = 8 * sizeof(unsigned long);
+  unsigned long nodemask[max_nodes / bits_per_word] = {};
+  int mode;
+  if (syscall(SYS_get_mempolicy, &mode, nodemask, max_nodes, nullptr, 0) != 0)
+    return false;
+
+  // the modes of linux/mempolicy.h. Bits 13 and up are mode flags
+  const char *mode_names[] = {"default", "preferred", "bind", "interleave",
+    "local", "preferred_many", "weighted_interleave"};
+  mode &= (1 << 13) - 1;
+  if (mode < 0 || mode >= static_cast<int>(sizeof(mode_names)
+        / sizeof(mode_names[0])))
+    return false;
+
+  policy = mode_names[mode];
+  std::vector<int> nodes;
+  for (unsigned long node = 0; node < max_nodes; node++)
+    if (nodemask[node / bits_per_word] & (1ul << (node % bits_per_word)))
+      nodes.push_back(static_cast<int>(node));
+  if (!nodes.empty())
+    policy += ":" + fhv::environment::cpuListToString(nodes);
+  return true;
+}
+
+// governor and frequency limits of one hardware thread. The current
+// frequency is left out: results are written after the measured code ran,
+// when it says nothing about the frequency the code ran at
+static json cpuJson(int cpu)
+{
+  const std::string cpufreq_directory =
+    sysfs_cpu_directory + "cpu" + std::to_string(cpu) + "/cpufreq/";
+  const double khz_to_mhz = 1e-3;
+
+  json cpu_json = {{json_environment_cpu_key, cpu}};
+
+  std::string governor;
+  if (readLine(cpufreq_directory + "scaling_governor", governor))
+    cpu_json[json_environment_governor_key] = governor;
+
+  const std::vector<std::pair<std::string, std::string>> frequency_files = {
+    {json_environment_min_mhz_key, "scaling_min_freq"},
+    {json_environment_max_mhz_key, "scaling_max_freq"},
+  };
+  for (const auto &frequency_file : frequency_files)
+  {
+    std::string line;
+    if (!readLine(cpufreq_directory + frequency_file.second, line)) continue;
+    try {
+      cpu_json[frequency_file.first] = std::stod(line) * khz_to_mhz;
+    } catch (const std::exception &) {
+    }
+  }
+
+  return cpu_json;
+}
+
+json fhv::environment::environmentJson(const std::vector<int> &cpus)
+{
+  json environment = json::object();
+
+  struct utsname system_name;
+  if (uname(&system_name) == 0)
+    environment[json_environment_kernel_key] = system_name.release;
+
+  std::string likwid_version = likwidVersion();
+  if (!likwid_version.empty())
+    environment[json_environment_likwid_version_key] = likwid_version;
+
+  bool turbo;
+  if (readTurbo(turbo)) environment[json_environment_turbo_key] = turbo;
+
+  bool smt;
+  if (readFlag(sysfs_cpu_directory + "smt/active", smt))
+    environment[json_environment_smt_key] = smt;
+
+  std::string thp_mode;
+  if (readTransparentHugepages(thp_mode))
+    environment[json_environment_thp_key] = thp_mode;
+
+  std::string numa_policy;
+  if (readNumaPolicy(numa_policy))
+    environment[json_environment_numa_policy_key] = numa_policy;
+
+  // each hardware thread once, even if several threads share one
+  std::vector<int> unique_cpus = cpus;
+  std::sort(unique_cpus.begin(), unique_cpus.end());
+  unique_cpus.erase(std::unique(unique_cpus.begin(), unique_cpus.end()),
+    unique_cpus.end());
+
+  json &cpu_list = environment[json_environment_cpus_key] = json::array();
+  for (int cpu : unique_cpus)
+    cpu_list.push_back(cpuJson(cpu));
+
+  return environment;
+}
+
+std::vector<int> fhv::environment::allowedCpus()
+{
+  std::vector<int> cpus;
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) != 0) return cpus;
+
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    if (CPU_ISSET(cpu, &cpu_set)) cpus.push_back(cpu);
+  return cpus;
+}
+
+std::string fhv::environment::cpuListToString(std::vector<int> cpus)
+{
+  std::sort(cpus.begin(), cpus.end());
+
+  std::string list;
+  for (size_t start = 0; start < cpus.size();)
+  {
+    size_t end = start;
+    while (end + 1 < cpus.size() && cpus[end + 1] == cpus[end] + 1) end++;
+
+    if (!list.empty()) list += ",";
+    list += std::to_string(cpus[start]);
+    if (end > start) list += "-" + std::to_string(cpus[end]);
+    start = end + 1;
+  }
+  return list;
+}
+
+// ===== comparing to the measurement conditions =====
+// values of the environment itself, and their names in sentences
+static const std::vector<std::pair<std::string, std::string>> &
+  machineConditions()
+{
+  static const std::vector<std::pair<std::string, std::string>> conditions = {
+    {json_environment_kernel_key, "the kernel"},
+    {json_environment_likwid_version_key, "likwid"},
+    {json_environment_turbo_key, "turbo"},
+    {json_environment_smt_key, "SMT"},
+    {json_environment_thp_key, "transparent huge pages"},
+    {json_environment_numa_policy_key, "the NUMA policy"},
+  };
+  return conditions;
+}
+
+// values of each cpu, and their names in sentences
+static const std::vector<std::pair<std::string, std::string>> &
+  cpuConditions()
+{
+  static const std::vector<std::pair<std::string, std::string>> conditions = {
+    {json_environment_governor_key, "the governor"},
+    {json_environment_min_mhz_key, "the min frequency"},
+    {json_environment_max_mhz_key, "the max frequency"},
+  };
+  return conditions;
+}
+
+static std::string valueToString(const json &value, const std::string &key)
+{
+  if (value.is_boolean()) return value.get<bool>() ? "on" : "off";
+  if (value.is_string()) return value.get<std::string>();
+  if (value.is_number() && (key == json_environment_min_mhz_key
+        || key == json_environment_max_mhz_key))
+    return fmt::format("{:.0f} MHz", value.get<double>());
+  return value.dump();
+}
+
+static bool sameValue(const json &value, const json &condition,
+  const std::string &key)
+{
+  if (value.is_number() && condition.is_number()
+      && (key == json_environment_min_mhz_key
+        || key == json_environment_max_mhz_key))
+  {
+    double expected = condition.get<double>();
+    return std::fabs(value.get<double>() - expected)
+      <= fhv::environment::frequency_tolerance * std::fabs(expected);
+  }
+  return value == condition;
+}
+
+json fhv::environment::conditionsOf(const json &environment)
+{
+  json conditions = json::object();
+  for (const auto &condition : machineConditions())
+  {
+    auto value = environment.find(condition.first);
+    if (value != environment.end()) conditions[condition.first] = *value;
+  }
+
+  auto cpus = environment.find(json_environment_cpus_key);
+  if (cpus == environment.end() || !cpus->is_array() || cpus->empty())
+    return conditions;
+
+  for (const auto &condition : cpuConditions())
+  {
+    const json *shared = nullptr;
+    bool same_everywhere = true;
+    for (const auto &cpu : *cpus)
+    {
+      auto value = cpu.find(condition.first);
+      if (value == cpu.end() || (shared != nullptr && *value != *shared)) {
+        same_everywhere = false;
+        break;
+      }
+      shared = &*value;
+    }
+    if (same_everywhere) conditions[condition.first] = *shared;
+  }
+
+  return conditions;
+}
+
+std::vector<std::string> fhv::environment::findMismatches(
+  const json &environment,
+  const json &conditions)
+{
+  std::vector<std::string> mismatches;
+  if (!conditions.is_object()) return mismatches;
+
+  const std::string measured = "when the machine stats were measured";
+
+  for (const auto &condition : machineConditions())
+  {
+    auto value = environment.find(condition.first);
+    auto expected = conditions.find(condition.first);
+    if (value == environment.end() || expected == conditions.end()
+        || sameValue(*value, *expected, condition.first))
+      continue;
+
+    mismatches.push_back(fmt::format("{} is {}, but was {} {}",
+      condition.second, valueToString(*value, condition.first),
+      valueToString(*expected, condition.first), measured));
+  }
+
+  auto cpus = environment.find(json_environment_cpus_key);
+  if (cpus == environment.end() || !cpus->is_array()) return mismatches;
+
+  for (const auto &condition : cpuConditions())
+  {
+    auto expected = conditions.find(condition.first);
+    if (expected == conditions.end()) continue;
+
+    // cpus grouped by their value, so a whole socket makes one sentence
+    std::map<std::string, std::vector<int>> differing_cpus;
+    for (const auto &cpu : *cpus)
+    {
+      auto value = cpu.find(condition.first);
+      if (value == cpu.end() || sameValue(*value, *expected, condition.first))
+        continue;
+      differing_cpus[valueToString(*value, condition.first)].push_back(
+        cpu.value(json_environment_cpu_key, -1));
+    }
+
+    for (const auto &differing : differing_cpus)
+      mismatches.push_back(fmt::format("{} is {} on {} {}, but was {} {}",
+        condition.second, differing.first,
+        differing.second.size() == 1 ? "cpu" : "cpus",
+        cpuListToString(differing.second),
+        valueToString(*expected, condition.first), measured));
+  }
+
+  return mismatches;
+}
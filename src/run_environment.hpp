@@ -0,0 +1,63 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+/* ---- run environment ----
+ * the state of the machine a run was measured in. Saturation compares
+ * results to the machine stats, which only hold if the machine runs like it
+ * did when they were measured: a node in powersave, or with turbo off, reaches
+ * a fraction of the benchmarked bandwidth and flop/s. The "environment"
+ * section of the info records:
+ *
+ *  - "kernel": the kernel release
+ *  - "likwid_version": the likwid headers fhv was built with
+ *  - "turbo", "smt": true or false
+ *  - "transparent_hugepages": "always", "madvise" or "never"
+ *  - "numa_policy": the memory policy of the process, like numactl prints
+ *    it: "default", "bind:0-1", "interleave:0,2", "preferred:1", "local"
+ *  - "cpus": the governor and the min and max frequency in MHz of each
+ *    hardware thread in use
+ *
+ * Values are read from sysfs, uname and get_mempolicy. Those that can't be
+ * read, e.g. in a container without cpufreq, are left out.
+ *
+ * The machine stats may hold the conditions they were measured under (made
+ * by conditionsOf, see fhv::config). Values of the environment that differ
+ * from them are listed in "mismatches".
+ */
+namespace fhv {
+  namespace environment {
+    // min and max frequencies may differ this much, relative to the
+    // conditions, before they are flagged
+    const double frequency_tolerance = 0.01;
+
+    // the environment section for the given hardware threads
+    json environmentJson(const std::vector<int> &cpus);
+
+    // the hardware threads this process may run on
+    std::vector<int> allowedCpus();
+
+    /* ---- conditions of ----
+     * the values of an environment that conditions are compared on. The
+     * governor and the min and max frequency are only kept if they are the
+     * same on every cpu.
+     */
+    json conditionsOf(const json &environment);
+
+    /* ---- find mismatches ----
+     * a sentence for every value of conditions the environment differs in,
+     * e.g. "turbo is off, but was on when the machine stats were measured".
+     * Values missing from either side are not compared.
+     */
+    std::vector<std::string> findMismatches(
+      const json &environment,
+      const json &conditions);
+
+    // "0-3,8,10-11"
+    std::string cpuListToString(std::vector<int> cpus);
+  };
+};
@@ -0,0 +1,101 @@
+#include "run_parameters.hpp"
+
+#include <cstdlib>
+#include <omp.h>
+
+#include "performance_monitor_defines.hpp"
+
+json fhv::params::buildJson(const BuildInfo &build_info)
+{
+  json build = json::object();
+  auto set_string = [&](const std::string &key, const char *value) {
+    if (value != nullptr && value[0] != '\0') build[key] = value;
+  };
+
+  set_string(json_build_compiler_key, build_info.compiler);
+  set_string(json_build_flags_key, build_info.flags);
+  set_string(json_build_vector_isa_key, build_info.vector_isa);
+  build[json_build_optimized_key] = build_info.optimized;
+  build[json_build_fast_math_key] = build_info.fast_math;
+  build[json_build_assertions_key] = build_info.assertions;
+  if (build_info.openmp_version != 0)
+    build[json_build_openmp_version_key] = build_info.openmp_version;
+
+  if (build_info.git_commit != nullptr && build_info.git_commit[0] != '\0')
+    build[json_build_git_commit_key] = build_info.git_commit;
+  else if (const char *commit = std::getenv(perfmon_commit_envvar.c_str()))
+    build[json_build_git_commit_key] = commit;
+
+  return build;
+}
+
+json fhv::params::openmpJson()
+{
+  json openmp = json::object();
+  openmp[json_openmp_max_threads_key] = omp_get_max_threads();
+  openmp[json_openmp_dynamic_key] = omp_get_dynamic() != 0;
+
+  const char *proc_bind = nullptr;
+  switch (omp_get_proc_bind())
+  {
+    case omp_proc_bind_false: proc_bind = "false"; break;
+    case omp_proc_bind_true: proc_bind = "true"; break;
+    case omp_proc_bind_master: proc_bind = "master"; break;
+    case omp_proc_bind_close: proc_bind = "close"; break;
+    case omp_proc_bind_spread: proc_bind = "spread"; break;
+    default: break;
+  }
+  if (proc_bind != nullptr) openmp[json_openmp_proc_bind_key] = proc_bind;
+
+  omp_sched_t kind;
+  int chunk_size;
+  omp_get_schedule(&kind, &chunk_size);
+  // the top bit is the monotonic modifier
+  std::string schedule;
+  switch (static_cast<omp_sched_t>(static_cast<unsigned>(kind) & 0x7fffffffu))
+  {
+    case omp_sched_static: schedule = "static"; break;
+    case omp_sched_dynamic: schedule = "dynamic"; break;
+    case omp_sched_guided: schedule = "guided"; break;
+    case omp_sched_auto: schedule = "auto"; break;
+    default: break;
+  }
+  if (!schedule.empty())
+    openmp[json_openmp_schedule_key] = chunk_size > 0
+      ? schedule + "," + std::to_string(chunk_size) : schedule;
+
+  // the runtime has no portable way to tell the places apart, so the
+  // setting is recorded as given
+  if (const char *places = std::getenv("OMP_PLACES"))
+    openmp[json_openmp_places_key] = places;
+
+  return openmp;
+}
+
+std::string fhv::params::parametersToString(const json &parameter_values)
+{
+  std::string parameters;
+  if (!parameter_values.is_object()) return parameters;
+
+  for (const auto &parameter : parameter_values.items())
+  {
+    if (!parameters.empty()) parameters += ", ";
+    parameters += parameter.key() + "=";
+    parameters += parameter.value().is_string()
+      ? parameter.value().get<std::string>() : parameter.value().dump();
+  }
+
+  return parameters;
+}
+
+const json *fhv::params::findParameter(
+  const json &info,
+  const std::string &name)
+{
+  auto parameter_values = info.find(json_parameter_values_key);
+  if (parameter_values == info.end() || !parameter_values->is_object())
+    return nullptr;
+
+  auto value = parameter_values->find(name);
+  return value == parameter_values->end() ? nullptr : &*value;
+}
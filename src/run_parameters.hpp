@@ -0,0 +1,117 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <string>
+
+using json = nlohmann::json;
+
+/* ---- run parameters ----
+ * typed metadata written to the info section next to the free-form
+ * parameter string, so tools can group and plot runs by real values:
+ *
+ *  - "parameter_values": name -> number, string or bool, set with
+ *    fhv_perfmon::setParameter
+ *  - "build": how the measured program was built (BuildInfo) and its git
+ *    commit
+ *  - "openmp": the OpenMP settings the program ran with
+ *
+ * BuildInfo is filled by FHV_BUILD_INFO, a default argument of
+ * fhv_perfmon::init(). Default arguments are expanded where the function is
+ * called, so the predefined macros describe the program's translation unit,
+ * not libfhv_perfmon. Compilers don't predefine the command line, so the
+ * program may pass it (and its git commit) in:
+ *
+ *   g++ -DFHV_COMPILE_FLAGS='"-O3 -march=native"' -DFHV_GIT_HASH='"..."'
+ */
+#ifndef FHV_COMPILE_FLAGS
+#define FHV_COMPILE_FLAGS ""
+#endif
+
+#ifndef FHV_GIT_HASH
+#define FHV_GIT_HASH ""
+#endif
+
+#ifdef __VERSION__
+#define FHV_COMPILER_VERSION __VERSION__
+#else
+#define FHV_COMPILER_VERSION ""
+#endif
+
+#ifdef __OPTIMIZE__
+#define FHV_OPTIMIZED true
+#else
+#define FHV_OPTIMIZED false
+#endif
+
+#ifdef __FAST_MATH__
+#define FHV_FAST_MATH true
+#else
+#define FHV_FAST_MATH false
+#endif
+
+#ifdef NDEBUG
+#define FHV_ASSERTIONS false
+#else
+#define FHV_ASSERTIONS true
+#endif
+
+// the widest vector instructions the compiler was allowed to use
+#if defined(__AVX512F__)
+#define FHV_VECTOR_ISA "avx512f"
+#elif defined(__AVX2__)
+#define FHV_VECTOR_ISA "avx2"
+#elif defined(__AVX__)
+#define FHV_VECTOR_ISA "avx"
+#elif defined(__SSE4_2__)
+#define FHV_VECTOR_ISA "sse4.2"
+#elif defined(__SSE2__)
+#define FHV_VECTOR_ISA "sse2"
+#else
+#define FHV_VECTOR_ISA ""
+#endif
+
+#ifdef _OPENMP
+#define FHV_OPENMP_VERSION _OPENMP
+#else
+#define FHV_OPENMP_VERSION 0
+#endif
+
+namespace fhv {
+  namespace params {
+    struct BuildInfo {
+      const char *compiler;
+      const char *flags;
+      const char *git_commit;
+      bool optimized;
+      bool fast_math;
+      bool assertions;
+      const char *vector_isa;
+      // _OPENMP, the date of the supported specification, or 0
+      long openmp_version;
+    };
+
+    /* ---- build json ----
+     * the "build" section. If no git commit was compiled in, it is taken
+     * from FHV_COMMIT. git itself isn't asked: the measured program may run
+     * anywhere, and forking a shell in an MPI job is asking for trouble.
+     * Empty strings are left out.
+     */
+    json buildJson(const BuildInfo &build_info);
+
+    // the "openmp" section: the runtime's settings and the OMP_PLACES the
+    // program was started with
+    json openmpJson();
+
+    // "n=4000, m=6000, kernel=gauss", for the free-form parameter string
+    std::string parametersToString(const json &parameter_values);
+
+    // value of a typed parameter in an info section, or nullptr if it isn't
+    // there
+    const json *findParameter(const json &info, const std::string &name);
+  };
+};
+
+// the build of the translation unit this is expanded in
+#define FHV_BUILD_INFO (fhv::params::BuildInfo{FHV_COMPILER_VERSION, \
+  FHV_COMPILE_FLAGS, FHV_GIT_HASH, FHV_OPTIMIZED, FHV_FAST_MATH, \
+  FHV_ASSERTIONS, FHV_VECTOR_ISA, FHV_OPENMP_VERSION})
@@ -1,5 +1,9 @@
 #include "saturation_diagram.hpp"
 
+#include <algorithm>
+
+#include "render_context.hpp"
+
 /*
  * Interpolates two colors by a factor t. The smaller the t, the closer the
  * result is to min_color and vice versa
@@ -17,35 +21,58 @@ saturation_diagram::color_lerp(
   );
 }
 
-rgb_color
-saturation_diagram::discrete_color_scale(
-  const std::string &scale_name,
-  const double &t)
+const std::vector<rgb_color> *
+saturation_diagram::color_scale_lut(const std::string &scale_name)
 {
-  std::vector<rgb_color> scale;
-  const unsigned NUM_BINS = 9;
-  const double INTERVAL_SIZE = 1.0 / static_cast<double>(NUM_BINS);
-
   if (scale_name.compare(colorScaleName_RdPu) == 0){
-    scale = colorScale_RdPu;
+    return &colorScale_RdPu;
   }
   else if (scale_name.compare(colorScaleName_YlGnBu) == 0){
-    scale = colorScale_YlGnBu;
+    return &colorScale_YlGnBu;
   }
   else if (scale_name.compare(colorScaleName_PuBu) == 0){
-    scale = colorScale_PuBu;
+    return &colorScale_PuBu;
   }
   else if (scale_name.compare(colorScaleName_YlGn) == 0){
-    scale = colorScale_YlGn;
+    return &colorScale_YlGn;
   }
   else if (scale_name.compare(colorScaleName_Greys) == 0){
-    scale = colorScale_Greys;
+    return &colorScale_Greys;
+  }
+  else if (scale_name.compare(colorScaleName_RdBu) == 0){
+    return &colorScale_RdBu;
   }
-  else {
+
+  return nullptr;
+}
+
+rgb_color
+saturation_diagram::discrete_color_scale(
+  const std::string &scale_name,
+  const double &t)
+{
+  auto scale = color_scale_lut(scale_name);
+  if (scale == nullptr) {
     fmt::print(stderr, "discrete_color_scale: Bad colorscale specified!\n");
     return rgb_color();
   }
 
+  return discrete_color(*scale, t);
+}
+
+rgb_color
+saturation_diagram::discrete_color(
+  const std::vector<rgb_color> &scale,
+  const double &t)
+{
+  const unsigned NUM_BINS = 9;
+  const double INTERVAL_SIZE = 1.0 / static_cast<double>(NUM_BINS);
+
+  if (scale.size() != NUM_BINS) {
+    fmt::print(stderr, "discrete_color: Bad colorscale specified!\n");
+    return rgb_color();
+  }
+
   // intervals are [min, max) until final bin, which is [min, max]
   for (unsigned i = 0; i < NUM_BINS - 1; i++){
     double min = INTERVAL_SIZE * static_cast<double>(i);
@@ -77,10 +104,34 @@ double saturation_diagram::scale(const double value){
   return (log2(value) + c)/c;
 }
 
+/*
+ * maps [-1.0, 1.0] to [0.0, 1.0] with 0.0 landing in the middle. Magnitudes
+ * use the same log scale as saturation values so small changes stay visible
+ */
+double saturation_diagram::signed_scale(const double value){
+  double magnitude = clamp(scale(clamp(std::abs(value), 0.0, 1.0)), 0.0, 1.0);
+  if (value < 0) magnitude = -magnitude;
+
+  return 0.5 + 0.5 * magnitude;
+}
+
 // ---- calculate saturation colors ----- // 
 rgb_color saturation_diagram::calculate_single_color(
   const double &value,
   const std::string &color_scale)
+{
+  auto color_lut = color_scale_lut(color_scale);
+  if (color_lut == nullptr) {
+    fmt::print(stderr, "calculate_single_color: Bad colorscale specified!\n");
+    return rgb_color();
+  }
+
+  return calculate_single_color(value, *color_lut);
+}
+
+rgb_color saturation_diagram::calculate_single_color(
+  const double &value,
+  const std::vector<rgb_color> &color_lut)
 {
   double scaled_saturation = value;
   // clamp values to [0.0,1.0]
@@ -90,7 +141,7 @@ rgb_color saturation_diagram::calculate_single_color(
   // clamp again because scale can give negative values for very small input
   scaled_saturation = clamp(scaled_saturation, 0.0, 1.0);
 
-  return discrete_color_scale(color_scale, scaled_saturation);
+  return discrete_color(color_lut, scaled_saturation);
 }
 
 json
@@ -100,6 +151,14 @@ saturation_diagram::calculate_saturation_colors(
 {
   json saturation_colors;
 
+  // looked up once instead of once per component
+  auto color_lut = color_scale_lut(color_scale);
+  if (color_lut == nullptr) {
+    fmt::print(stderr,
+      "calculate_saturation_colors: Bad colorscale specified!\n");
+    return saturation_colors;
+  }
+
   for (const auto &region_section: region_data.items())
   {
     // TODO: combine the two for loops (and if statements) below to make a
@@ -130,7 +189,7 @@ saturation_diagram::calculate_saturation_colors(
           {
             saturation_colors[region_section.key()][metric.key()] 
               = saturation_diagram::calculate_single_color(metric.value(), 
-              color_scale);
+              *color_lut);
           }
         }
       }
@@ -157,7 +216,7 @@ saturation_diagram::calculate_saturation_colors(
             // if we have limited profiling info.
             saturation_colors[region_section.key()][metric.key()] 
               = saturation_diagram::calculate_single_color(metric.value(), 
-              color_scale);
+              *color_lut);
           }
         }
       }
@@ -167,6 +226,131 @@ saturation_diagram::calculate_saturation_colors(
   return saturation_colors;
 }
 
+json
+saturation_diagram::calculate_uncertainty_colors(
+  const json &region_data,
+  const std::string &color_scale)
+{
+  json uncertainty_colors;
+
+  auto color_lut = color_scale_lut(color_scale);
+  if (color_lut == nullptr) return uncertainty_colors;
+
+  auto statistics = region_data.find(json_statistics_section);
+  if (statistics == region_data.end()) return uncertainty_colors;
+
+  const std::vector<std::pair<std::string, std::vector<std::string>>>
+    diagram_sections = {
+      {fhv::types::aggregationTypeToString(
+         fhv::types::aggregation_t::saturation),
+       fhv_saturation_metric_names},
+      {fhv::types::aggregationTypeToString(
+         fhv::types::aggregation_t::geometric_mean),
+       fhv_other_diagram_metrics},
+    };
+
+  for (const auto &section : diagram_sections)
+  {
+    auto section_statistics = statistics->find(section.first);
+    if (section_statistics == statistics->end()) continue;
+
+    for (const auto &metric : section.second)
+    {
+      auto metric_statistics = section_statistics->find(metric);
+      if (metric_statistics == section_statistics->end()) continue;
+
+      auto low_color = calculate_single_color(
+        metric_statistics->value(json_statistics_ci95_low_key, 0.0),
+        *color_lut);
+      auto high_color = calculate_single_color(
+        metric_statistics->value(json_statistics_ci95_high_key, 0.0),
+        *color_lut);
+
+      // only components whose interval spans more than one color bin are
+      // uncertain enough to be worth drawing differently
+      if (low_color != high_color)
+        uncertainty_colors[section.first][metric] = {low_color, high_color};
+    }
+  }
+
+  return uncertainty_colors;
+}
+
+rgb_color saturation_diagram::component_color(
+  json &region_colors,
+  const std::string &section,
+  const std::string &metric,
+  rgb_color &upper_color)
+{
+  auto color = WHITE;
+  upper_color = NO_COLOR;
+
+  auto color_json = region_colors[section][metric];
+  if (!color_json.is_null()) { color = color_json; }
+
+  auto uncertainty_json = region_colors[json_statistics_section][section][metric];
+  if (!uncertainty_json.is_null()) {
+    color = uncertainty_json[0];
+    upper_color = uncertainty_json[1];
+  }
+
+  return color;
+}
+
+rgb_color saturation_diagram::calculate_difference_color(
+  const double &difference)
+{
+  return discrete_color_scale(colorScaleName_RdBu, signed_scale(difference));
+}
+
+json
+saturation_diagram::calculate_difference_colors(
+  const json &baseline_region_data,
+  const json &candidate_region_data)
+{
+  json difference_colors;
+
+  // same sections and metrics as calculate_saturation_colors: saturation
+  // metrics from 'saturation' and 'fhv_other_diagram_metrics' from
+  // 'geometric_mean'
+  const std::vector<std::pair<std::string, std::vector<std::string>>>
+    diagram_sections = {
+      {fhv::types::aggregationTypeToString(
+         fhv::types::aggregation_t::saturation),
+       fhv_saturation_metric_names},
+      {fhv::types::aggregationTypeToString(
+         fhv::types::aggregation_t::geometric_mean),
+       fhv_other_diagram_metrics},
+    };
+
+  for (const auto &section : diagram_sections)
+  {
+    auto baseline_section = baseline_region_data.find(section.first);
+    auto candidate_section = candidate_region_data.find(section.first);
+    if (baseline_section == baseline_region_data.end()
+        || candidate_section == candidate_region_data.end())
+      continue;
+
+    for (const auto &metric : section.second)
+    {
+      auto baseline_value = baseline_section->find(metric);
+      auto candidate_value = candidate_section->find(metric);
+
+      // skip metrics that are missing or null in either run
+      if (baseline_value == baseline_section->end()
+          || candidate_value == candidate_section->end()
+          || !baseline_value->is_number() || !candidate_value->is_number())
+        continue;
+
+      difference_colors[section.first][metric] =
+        saturation_diagram::calculate_difference_color(
+          candidate_value->get<double>() - baseline_value->get<double>());
+    }
+  }
+
+  return difference_colors;
+}
+
 void saturation_diagram::cairo_draw_swatch(
   cairo_t *cr,
   rgb_color min_color, 
@@ -216,6 +400,13 @@ void saturation_diagram::cairo_draw_discrete_swatch(
   unsigned width,
   unsigned height)
 {
+  auto color_lut = color_scale_lut(color_scale_name);
+  if (color_lut == nullptr) {
+    fmt::print(stderr,
+      "cairo_draw_discrete_swatch: Bad colorscale specified!\n");
+    return;
+  }
+
   cairo_save(cr);
 
   const unsigned NUM_STEPS = 9;
@@ -226,7 +417,7 @@ void saturation_diagram::cairo_draw_discrete_swatch(
     cairo_rectangle(cr, x + i * step_size, y, step_size, height);
 
     // fill
-    auto color = discrete_color_scale(color_scale_name, 
+    auto color = discrete_color(*color_lut,
       static_cast<double>(i)/static_cast<double>(NUM_STEPS));
 
     cairo_set_source_rgb(cr, 
@@ -358,7 +549,8 @@ void saturation_diagram::pango_cairo_draw_layout(
   double x,
   double y,
   PangoLayout *layout,
-  bool vertical)
+  bool vertical,
+  bool update_layout)
 {
   cairo_save(cr);
 
@@ -373,7 +565,8 @@ void saturation_diagram::pango_cairo_draw_layout(
     cairo_rotate(cr, -G_PI/2);
   }
 
-  pango_cairo_update_layout(cr, layout);
+  if (update_layout)
+    pango_cairo_update_layout(cr, layout);
   pango_cairo_show_layout(cr, layout);
 
   cairo_restore(cr);
@@ -408,6 +601,50 @@ double saturation_diagram::pango_cairo_draw_text(
   return cairo_height;
 }
 
+double saturation_diagram::pango_layout_cairo_height(PangoLayout *layout)
+{
+  int height;
+  pango_layout_get_size(layout, NULL, &height);
+
+  return static_cast<double>(height) / PANGO_SCALE;
+}
+
+void saturation_diagram::cairo_fill_split(
+  cairo_t *cr,
+  rgb_color fill_color,
+  rgb_color upper_fill_color)
+{
+  cairo_set_source_rgb(
+    cr,
+    std::get<0>(fill_color),
+    std::get<1>(fill_color),
+    std::get<2>(fill_color));
+  cairo_fill_preserve(cr);
+
+  if (upper_fill_color == NO_COLOR) return;
+
+  // paint the right half of the path's bounding box over the fill, clipped
+  // to the path itself. Clipping consumes the path, so it is copied first
+  // and put back afterwards for the caller to stroke.
+  double x1, y1, x2, y2;
+  cairo_fill_extents(cr, &x1, &y1, &x2, &y2);
+  cairo_path_t *path = cairo_copy_path(cr);
+
+  cairo_save(cr);
+  cairo_clip(cr);
+  cairo_rectangle(cr, (x1 + x2) / 2.0, y1, (x2 - x1) / 2.0, y2 - y1);
+  cairo_set_source_rgb(
+    cr,
+    std::get<0>(upper_fill_color),
+    std::get<1>(upper_fill_color),
+    std::get<2>(upper_fill_color));
+  cairo_fill(cr);
+  cairo_restore(cr);
+
+  cairo_append_path(cr, path);
+  cairo_path_destroy(path);
+}
+
 double saturation_diagram::cairo_draw_component(
   cairo_t *cr,
   double x,
@@ -418,7 +655,40 @@ double saturation_diagram::cairo_draw_component(
   std::string label,
   PangoFontDescription * font_desc,
   label_position position,
-  double stroke_width)
+  double stroke_width,
+  rgb_color upper_fill_color)
+{
+  PangoLayout *layout = pango_cairo_create_layout(cr);
+
+  if(position == label_position::INSIDE)
+    pango_cairo_make_text_layout(layout, font_desc, label, width,
+      PANGO_ALIGN_CENTER, height);
+  else if(position == label_position::LEFT)
+    pango_cairo_make_text_layout(layout, font_desc, label, height, 
+      PANGO_ALIGN_CENTER);
+  else if(position == label_position::BOTTOM)
+    pango_cairo_make_text_layout(layout, font_desc, label, width, 
+      PANGO_ALIGN_CENTER);
+
+  double cairo_text_height = cairo_draw_component(cr, x, y, width, height,
+    fill_color, layout, position, stroke_width, upper_fill_color);
+
+  g_object_unref(layout);
+
+  return cairo_text_height;
+}
+
+double saturation_diagram::cairo_draw_component(
+  cairo_t *cr,
+  double x,
+  double y,
+  double width,
+  double height,
+  rgb_color fill_color,
+  PangoLayout *label_layout,
+  label_position position,
+  double stroke_width,
+  rgb_color upper_fill_color)
 {
   cairo_save(cr);
 
@@ -428,29 +698,17 @@ double saturation_diagram::cairo_draw_component(
   const double PADDING_RATIO_BOTTOM = 1.0/3.0;
 
   // height in vertical dimension relative to text
-  int text_height; // pango units
-  double cairo_text_height = 0; // cairo units
+  double cairo_text_height = pango_layout_cairo_height(label_layout);
 
   cairo_set_line_width(cr, stroke_width);
 
-  PangoLayout *layout = pango_cairo_create_layout(cr);
-
   if(position == label_position::INSIDE)
   {
-    pango_cairo_make_text_layout(layout, font_desc, label, width,
-      PANGO_ALIGN_CENTER, height);
-    pango_layout_get_size(layout, NULL, &text_height);
-    cairo_text_height = static_cast<double>(text_height) / PANGO_SCALE;
-
     cairo_rectangle(cr, x, y, width, height);
   }
   else if(position == label_position::LEFT)
   {
-    pango_cairo_make_text_layout(layout, font_desc, label, height, 
-      PANGO_ALIGN_CENTER);
-    pango_layout_get_size(layout, NULL, &text_height);
-    cairo_text_height = static_cast<double>(text_height) / PANGO_SCALE;
-    pango_cairo_draw_layout(cr, x, y, layout, true);
+    pango_cairo_draw_layout(cr, x, y, label_layout, true, false);
 
     // there's not a lot of distance between the text and box with larger
     // fonts, so let's add a small margin:
@@ -458,15 +716,11 @@ double saturation_diagram::cairo_draw_component(
     
     cairo_rectangle(cr, x + cairo_text_height, y, width - cairo_text_height,
       height);
-    // cairo_rectangle(cr, x, y, width, height);
   }
   else if(position == label_position::BOTTOM)
   {
-    pango_cairo_make_text_layout(layout, font_desc, label, width, 
-      PANGO_ALIGN_CENTER);
-    pango_layout_get_size(layout, NULL, &text_height);
-    cairo_text_height = static_cast<double>(text_height) / PANGO_SCALE;
-    pango_cairo_draw_layout(cr, x, y + height - cairo_text_height, layout);
+    pango_cairo_draw_layout(cr, x, y + height - cairo_text_height,
+      label_layout, false, false);
 
     // there's not a lot of distance between the text and box with larger
     // fonts, so let's add a small margin:
@@ -475,12 +729,7 @@ double saturation_diagram::cairo_draw_component(
     cairo_rectangle(cr, x, y, width, height - cairo_text_height);
   }
 
-  cairo_set_source_rgb(
-    cr,
-    std::get<0>(fill_color),
-    std::get<1>(fill_color),
-    std::get<2>(fill_color));
-  cairo_fill_preserve(cr);
+  cairo_fill_split(cr, fill_color, upper_fill_color);
 
   cairo_set_source_rgb(cr, 0, 0, 0);
   cairo_stroke(cr);
@@ -489,14 +738,14 @@ double saturation_diagram::cairo_draw_component(
   {
     // because text is on top of rectangle, have to draw it AFTER fill and
     // stroke happen
-    pango_cairo_draw_layout(cr, x, y + height/2 - cairo_text_height/2, layout); 
+    pango_cairo_draw_layout(cr, x, y + height/2 - cairo_text_height/2,
+      label_layout, false, false); 
     
     // set to zero because 0 offset is needed to reach rectangle
     cairo_text_height = 0;
   }
 
   cairo_restore(cr);
-  g_object_unref(layout);
 
   return cairo_text_height;
 }
@@ -511,7 +760,31 @@ void saturation_diagram::cairo_draw_arrow(
   direction arrow_direction,
   std::string label,
   PangoFontDescription * font_desc,
-  double stroke_width
+  double stroke_width,
+  rgb_color upper_fill_color
+)
+{
+  PangoLayout *layout = pango_cairo_create_layout(cr);
+  pango_cairo_make_text_layout(layout, font_desc, label, width,
+    PANGO_ALIGN_CENTER, height);
+
+  cairo_draw_arrow(cr, x, y, width, height, fill_color, arrow_direction,
+    layout, stroke_width, upper_fill_color);
+
+  g_object_unref(layout);
+}
+
+void saturation_diagram::cairo_draw_arrow(
+  cairo_t *cr,
+  double x,
+  double y,
+  double width,
+  double height,
+  rgb_color fill_color,
+  direction arrow_direction,
+  PangoLayout *label_layout,
+  double stroke_width,
+  rgb_color upper_fill_color
 )
 {
   cairo_save(cr);
@@ -582,12 +855,7 @@ void saturation_diagram::cairo_draw_arrow(
   }
   cairo_restore(cr); // done with rotated things
 
-  cairo_set_source_rgb(
-    cr,
-    std::get<0>(fill_color),
-    std::get<1>(fill_color),
-    std::get<2>(fill_color));
-  cairo_fill_preserve(cr);
+  cairo_fill_split(cr, fill_color, upper_fill_color);
 
   cairo_set_source_rgb(cr, 0, 0, 0);
   cairo_stroke(cr);
@@ -596,123 +864,134 @@ void saturation_diagram::cairo_draw_arrow(
   // stroke happen
 
   // height in vertical dimension relative to text
-  int text_height; // pango units
-  double cairo_text_height; // cairo units
-
-  PangoLayout *layout = pango_cairo_create_layout(cr);
-
-  pango_cairo_make_text_layout(layout, font_desc, label, width,
-    PANGO_ALIGN_CENTER, height);
-  pango_layout_get_size(layout, NULL, &text_height);
-  cairo_text_height = static_cast<double>(text_height) / PANGO_SCALE;
+  double cairo_text_height = pango_layout_cairo_height(label_layout);
 
-  pango_cairo_draw_layout(cr, x, y + height/2 - cairo_text_height/2, layout); 
+  pango_cairo_draw_layout(cr, x, y + height/2 - cairo_text_height/2,
+    label_layout, false, false); 
 
   // cleanup
   cairo_restore(cr);
-  g_object_unref(layout);
 }
 
-// fhv_data is the data loaded straight from the JSON
-void saturation_diagram::draw_diagram_overview(
-  json fhv_data,
-  std::string color_scale,
-  std::string region_name,
-  std::string output_filename
+double saturation_diagram::draw_legend(
+  diagram_canvas &canvas,
+  double x,
+  double y,
+  double width,
+  const std::vector<rgb_color> &color_lut,
+  legend_type legend
 )
 {
-  // --- isolate the data we want --- //
-  auto meta_info = fhv_data[json_info_section];
-  auto proc_info = meta_info[json_processor_section];
-  auto region_data = fhv_data[json_results_section][region_name];
-  auto region_colors = saturation_diagram::calculate_saturation_colors(
-      region_data, color_scale);
-
-
-  // --- initialize cairo --- //
-  // variables for cairo
-  PangoFontDescription *title_font = pango_font_description_from_string ("Sans 40");
-  PangoFontDescription *description_font = pango_font_description_from_string ("Sans 12");
-  PangoFontDescription *big_label_font = pango_font_description_from_string ("Sans 40");
-  PangoFontDescription *small_label_font = pango_font_description_from_string ("Sans 25");
-
-  // TODO: NO LONGER USED. Will this be used eventually? Remove??
-  // TODO: should be in architecture, perhaps derived from likwid's
-  // L*_CACHE_GROUPS 
-
-  // const unsigned num_attached_caches = 2;
+  const double swatch_height = 50;
+  const double small_internal_margin = 12;
 
-  /* ----- drawing constants ----- 
-   *
-   * these may be changed to configure the drawing. 
-   * 
-   * TODO: someday, move these to a config file
-   */
-  const double image_width = 1200;
-  const double image_height = 2400;
+  double text_height = 0.0;
 
-  const double margin_x = 50;
-  const double margin_y = 50;
+  canvas.swatch(x, y, width, swatch_height, color_lut);
 
-  const double small_internal_margin = 12;
-  const double internal_margin = 25;
-  const double large_internal_margin = 50;
+  double swatch_legend_x = x;
+  double swatch_legend_y = y + swatch_height + small_internal_margin;
 
-  // size of different diagram components
-  const double content_width = image_width - 2 * margin_x;
+  // not sure how to do this without hard-coding. However, since we are
+  // aligning right, it can be very large
+  double single_legend_item_width = 100;
 
-  const double swatch_width = content_width;
-  const double swatch_height = 50;
+  double legend_offset = -10;
+  double scaled_value;
 
-  // memory/cache things
-  const double ram_width = content_width;
-  const double ram_height = 200;
-  const double transfer_arrow_height = 150;
-  const double l3_width = ram_width;
-  const double l3_height = 100;
-  const double l2_width = l3_width;
-  const double l2_height = l3_height;
-  const double l1_width = l2_width;
-  const double l1_height = l2_height;
-  // TODO: NO LONGER USED. Will this be used eventually? Remove??
+  // value labels and the caption are the same in every diagram
+  if (legend == legend_type::SATURATION)
+  {
+    const double num_steps = 9;
+    for (unsigned i = 0; i < static_cast<unsigned>(num_steps) + 1; i++)
+    {
+      scaled_value = clamp(scale(static_cast<double>(i)/num_steps), 0.0, 1.0);
+      std::stringstream value_text;
+      value_text << std::setprecision(1) << std::fixed
+        << static_cast<double>(i)/num_steps;
+      text_height = canvas.label(
+        swatch_legend_x + legend_offset + scaled_value * width,
+        swatch_legend_y, single_legend_item_width, value_text.str(),
+        font_role::DESCRIPTION, text_alignment::RIGHT, true);
+    }
 
-  // const double core_cache_height = 50;
+  }
+  else if (legend == legend_type::DIFFERENCE)
+  {
+    // differences are scaled symmetrically around zero, so labels are placed
+    // at a few representative magnitudes instead of evenly spaced values
+    const std::vector<double> legend_values = {
+      -1.0, -0.2, -0.05, 0.0, 0.05, 0.2, 1.0
+    };
+    for (const auto &value : legend_values)
+    {
+      scaled_value = signed_scale(value);
+      std::stringstream value_text;
+      value_text << std::showpos << std::setprecision(2) << std::fixed
+        << value;
+      text_height = canvas.label(
+        swatch_legend_x + legend_offset + scaled_value * width,
+        swatch_legend_y, single_legend_item_width, value_text.str(),
+        font_role::DESCRIPTION, text_alignment::RIGHT, true);
+    }
 
-  const double core_width = content_width ;
-  const double core_height = 500;
+  }
+  else if (legend == legend_type::FRACTION_OF_MAX)
+  {
+    // heatmaps color values linearly, without the saturation log scale
+    const double num_steps = 9;
+    for (unsigned i = 0; i < static_cast<unsigned>(num_steps) + 1; i++)
+    {
+      scaled_value = static_cast<double>(i)/num_steps;
+      std::stringstream value_text;
+      value_text << std::setprecision(2) << std::fixed << scaled_value;
+      text_height = canvas.label(
+        swatch_legend_x + legend_offset + scaled_value * width,
+        swatch_legend_y, single_legend_item_width, value_text.str(),
+        font_role::DESCRIPTION, text_alignment::RIGHT, true);
+    }
 
-  double text_height;
+  }
 
-  fhv::utils::create_directories_for_file(output_filename);
+  double swatch_label_y = swatch_legend_y + text_height + small_internal_margin;
+  text_height = canvas.label(x, swatch_label_y, width, legend_caption(legend),
+    font_role::DESCRIPTION, text_alignment::CENTER);
 
-  cairo_surface_t *surface = cairo_svg_surface_create(
-    output_filename.c_str(),
-    image_width,
-    image_height
-  );
-  cairo_t *cr = cairo_create(surface);
+  return swatch_label_y + text_height - y;
+}
 
-  // --- title and description text --- //
-  double title_x = margin_x;
-  double title_y = margin_y;
+std::string saturation_diagram::legend_caption(legend_type legend)
+{
+  if (legend == legend_type::SATURATION)
+    return "Saturation level (higher is usually better)";
+  if (legend == legend_type::DIFFERENCE)
+    return "Change in saturation, candidate minus baseline "
+      "(red is a regression, blue is an improvement)";
+  return "Fraction of the largest value in the row";
+}
 
-  text_height = pango_cairo_draw_text(cr, title_x, title_y, content_width,
-    "Saturation diagram for region\n\"" + region_name + "\"", 
-    title_font, PANGO_ALIGN_CENTER);
-  
-  double description_x = title_x;
-  double description_y = title_y + text_height + large_internal_margin;
+double saturation_diagram::legend_height(
+  render_context &context,
+  const std::string &output_filename,
+  double width,
+  legend_type legend)
+{
+  // same sizes as draw_legend. Every value label is a single line.
+  const double swatch_height = 50;
+  const double small_internal_margin = 12;
+  const double single_legend_item_width = 100;
+
+  return swatch_height + small_internal_margin
+    + context.text_height(output_filename, "0.0", font_role::DESCRIPTION,
+        single_legend_item_width)
+    + small_internal_margin
+    + context.text_height(output_filename, legend_caption(legend),
+        font_role::DESCRIPTION, width);
+}
 
+std::string saturation_diagram::describe_processor(const json &proc_info)
+{
   std::string description;
-  // TODO: implicit conversions like the one below are not recommended by
-  //  nlohmann. Instead, use
-  //  `auto parameters = meta_info[json_parameter_key].get<std::string>();`
-
-  // TODO: Disable implicit conversions by defining
-  //  `JSON_USE_IMPLICIT_CONVERSIONS` to 0 in the json header.
-  std::string parameters = meta_info[json_parameter_key];
-  if (!parameters.empty())
-    description += parameters + "\n\n";
 
   description += fmt::format(
       "Processor:\t\t\t\t\t\t\t\t\t\t{}\n",
@@ -741,62 +1020,418 @@ void saturation_diagram::draw_diagram_overview(
       "Affinity (which threads are being used):\t\t\t\t{}\n",
       proc_info[json_processor_affinity_key].get<std::string>()
   );
-  description += "\n";
 
-  // l1 cache note
-  description +=
-    "Note: L1 cache is currently not measured and therefore will appear "
-    "white. This is not an indication of L1 cache saturation.";
+  return description;
+}
 
-  text_height = pango_cairo_draw_text(cr, description_x, description_y,
-    content_width, description, description_font);
+bool saturation_diagram::draw_diagram_overview(
+  const json &fhv_data,
+  std::string color_scale,
+  std::string region_name,
+  std::string output_filename
+)
+{
+  render_context context(color_scale);
+  return draw_diagram_overview(context, fhv_data, region_name,
+    output_filename);
+}
 
-  // --- draw legend --- //
-  // TODO : make drawing legend own function
-  double swatch_x = description_x;
-  double swatch_y = description_y + text_height + internal_margin;
-  const double num_steps = 9;
-  cairo_draw_discrete_swatch(cr, color_scale, swatch_x, swatch_y,
-    swatch_width, swatch_height);
+// fhv_data is the data loaded straight from the JSON. It is only read, so
+// one json may be shared by several threads drawing different regions.
+bool saturation_diagram::draw_diagram_overview(
+  render_context &context,
+  const json &fhv_data,
+  std::string region_name,
+  std::string output_filename
+)
+{
+  return draw_diagram_overview(context, fhv_data.at(json_info_section),
+    fhv_data.at(json_results_section).at(region_name), region_name,
+    output_filename);
+}
 
-  double swatch_legend_x = swatch_x;
-  double swatch_legend_y = swatch_y + swatch_height + small_internal_margin;
+bool saturation_diagram::draw_diagram_overview(
+  render_context &context,
+  const json &meta_info,
+  const json &region_data,
+  std::string region_name,
+  std::string output_filename
+)
+{
+  const std::string &color_scale = context.color_scale;
 
-  // not sure how to do this without hard-coding. However, since we are
-  // aligning right, it can be very large
-  double single_legend_item_width = 100;
+  // --- isolate the data we want --- //
+  const json &proc_info = meta_info.at(json_processor_section);
+  auto region_colors = saturation_diagram::calculate_saturation_colors(
+      region_data, color_scale);
+  auto uncertainty_colors = saturation_diagram::calculate_uncertainty_colors(
+      region_data, color_scale);
+  if (!uncertainty_colors.is_null())
+    region_colors[json_statistics_section] = uncertainty_colors;
 
-  double legend_offset = -10;
-  double scaled_value;
-  for (unsigned i = 0; i < static_cast<unsigned>(num_steps) + 1; i++)
+  std::string description;
+  std::string parameters = meta_info.value(json_parameter_key, "");
+  if (!parameters.empty())
+    description += parameters + "\n\n";
+
+  description += describe_processor(proc_info);
+
+  if (region_data.contains(json_statistics_section))
   {
-    scaled_value = clamp(scale(static_cast<double>(i)/num_steps), 0.0, 1.0);
-    std::stringstream value_text;
-    value_text << std::setprecision(1) << std::fixed
-      << static_cast<double>(i)/num_steps;
-    text_height = pango_cairo_draw_text(cr, 
-      swatch_legend_x + legend_offset + scaled_value * content_width,
-      swatch_legend_y, single_legend_item_width, value_text.str(),
-      description_font, PANGO_ALIGN_RIGHT, true);
+    // merged_from may have been dropped by an edit or another tool, so the
+    // number of samples behind the statistics is the fallback
+    size_t num_runs = 0;
+    auto merged_from = meta_info.find(json_merged_from_key);
+    if (merged_from != meta_info.end() && merged_from->is_array())
+      num_runs = merged_from->size();
+    else
+    {
+      for (const auto &section : region_data.at(json_statistics_section))
+        for (const auto &metric : section)
+          if (metric.is_object())
+            num_runs = std::max(num_runs, metric.value(
+              json_statistics_num_samples_key, static_cast<size_t>(0)));
+    }
+
+    description += fmt::format("\nMerged from {} runs. Components split in "
+      "two have a 95% confidence interval that crosses a color boundary: the "
+      "left half shows the lower bound and the right half the upper bound.\n",
+      num_runs > 0 ? std::to_string(num_runs) : "several");
   }
 
-  double swatch_label_x = swatch_x;
-  double swatch_label_y = swatch_legend_y + text_height + small_internal_margin;
-  text_height = pango_cairo_draw_text(cr, swatch_label_x, swatch_label_y, 
-    content_width, "Saturation level (higher is usually better)",
-    description_font, PANGO_ALIGN_CENTER);
+  return draw_diagram(context, region_colors,
+    "Saturation diagram for region\n\"" + region_name + "\"",
+    description, legend_type::SATURATION, output_filename);
+}
+
+bool saturation_diagram::draw_diagram_difference(
+  const json &baseline_data,
+  const json &candidate_data,
+  std::string region_name,
+  std::string output_filename
+)
+{
+  const json &baseline_region =
+    baseline_data.at(json_results_section).at(region_name);
+  const json &candidate_region =
+    fhv::diff::candidateRegion(candidate_data, region_name);
+  auto region_colors = saturation_diagram::calculate_difference_colors(
+      baseline_region, candidate_region);
+
+  const json &baseline_info = baseline_data.at(json_info_section);
+  const json &candidate_info = candidate_data.at(json_info_section);
+
+  std::string description;
+  description += fmt::format("Baseline parameters:\t\t\t\t\t\t\t{}\n",
+    baseline_info.value(json_parameter_key, ""));
+  description += fmt::format("Candidate parameters:\t\t\t\t\t\t\t{}\n\n",
+    candidate_info.value(json_parameter_key, ""));
+  description += describe_processor(candidate_info.at(json_processor_section));
+
+  render_context context(colorScaleName_RdBu);
+  return draw_diagram(context, region_colors,
+    "Saturation difference for region\n\"" + region_name + "\"",
+    description, legend_type::DIFFERENCE, output_filename);
+}
+
+bool saturation_diagram::draw_cluster_overview(
+  render_context &context,
+  const json &job_data,
+  std::string region_name,
+  std::string output_filename
+)
+{
+  const json &meta_info = job_data.at(json_info_section);
+  const json &region_data = job_data.at(json_results_section).at(region_name);
+
+  const std::string saturation_section = fhv::types::aggregationTypeToString(
+    fhv::types::aggregation_t::saturation);
+
+  // one row per component, top to bottom in the same order as the overview
+  const std::vector<std::pair<std::string, std::string>> rows = {
+    {"RAM", fhv_mem_rw_saturation_metric_name},
+    {"RAM load", fhv_mem_r_saturation_metric_name},
+    {"RAM store", fhv_mem_w_saturation_metric_name},
+    {"L3 Cache", fhv_l3_rw_saturation_metric_name},
+    {"L3 load", fhv_l3_r_saturation_metric_name},
+    {"L3 store", fhv_l3_w_saturation_metric_name},
+    {"L2 Cache", fhv_l2_rw_saturation_metric_name},
+    {"L2 load", fhv_l2_r_saturation_metric_name},
+    {"L2 store", fhv_l2_w_saturation_metric_name},
+    {"SP FLOP/s", fhv_flops_sp_saturation_metric_name},
+    {"DP FLOP/s", fhv_flops_dp_saturation_metric_name},
+  };
+
+  // first column is the whole job, the rest are nodes. Each column gets its
+  // own region json so calculate_saturation_colors can be reused as is.
+  std::vector<std::string> column_names = {"whole job"};
+  std::vector<json> column_data = {json()};
+  if (region_data.contains(saturation_section))
+    column_data[0][saturation_section] = region_data.at(saturation_section);
+
+  if (region_data.contains(json_nodes_section))
+  {
+    for (const auto &node : region_data.at(json_nodes_section).items())
+    {
+      column_names.push_back(node.key());
+      json node_data;
+      node_data[saturation_section] = node.value();
+      column_data.push_back(node_data);
+    }
+  }
+
+  // ranks furthest from the mean, only for metrics that differ noticeably
+  std::string imbalance_text;
+  if (region_data.contains(json_imbalance_section))
+  {
+    const json &imbalance = region_data.at(json_imbalance_section);
+    for (const auto &section : imbalance.items())
+    {
+      for (const auto &metric : section.value().items())
+      {
+        const json &spread = metric.value();
+        double ratio = spread.value(json_imbalance_ratio_key, 1.0);
+        // 5% is roughly run-to-run noise on a single node
+        if (ratio < 1.05) continue;
+
+        imbalance_text += fmt::format(
+          "{} ({}):\t\tmax/mean {:.2f}, highest on rank {} ({:.4g}), lowest "
+          "on rank {} ({:.4g})\n", metric.key(), section.key(), ratio,
+          spread.value(json_imbalance_max_rank_key, -1),
+          spread.value(json_imbalance_max_key, 0.0),
+          spread.value(json_imbalance_min_rank_key, -1),
+          spread.value(json_imbalance_min_key, 0.0));
+      }
+    }
+  }
+  if (imbalance_text.empty())
+    imbalance_text = "No metric differs by more than 5% between ranks.\n";
+
+  std::string description;
+  std::string parameters = meta_info.value(json_parameter_key, "");
+  if (!parameters.empty())
+    description += parameters + "\n\n";
+
+  description += fmt::format("Num nodes:\t\t\t\t\t\t\t\t\t\t{}\n",
+    meta_info.value(json_num_nodes_key, 1));
+  description += fmt::format("Num ranks:\t\t\t\t\t\t\t\t\t\t{}\n",
+    meta_info.value(json_num_ranks_key, 1));
+  description += describe_processor(meta_info.at(json_processor_section));
+  description += "\nEach node is colored by the sum of the saturation of its "
+    "ranks, since a node's bandwidth and FLOP/s are shared by all of them. "
+    "The whole job is the mean over all nodes.";
+
+  const std::string title =
+    "Cluster saturation for region\n\"" + region_name + "\"";
+  const std::string imbalance_title = "Imbalance between ranks";
+
+  /* ----- drawing constants ----- */
+  const diagram_geometry &geometry = context.geometry;
+  const double margin_x = geometry.margin_x;
+  const double margin_y = geometry.margin_y;
+
+  const double internal_margin = geometry.internal_margin;
+  const double large_internal_margin = geometry.large_internal_margin;
+
+  const double row_label_width = 200;
+  const double column_width = 120;
+  const double column_header_height = 200;
+  const double row_height = 70;
+
+  const double image_width = std::max(geometry.image_width, 2 * margin_x
+    + row_label_width
+    + column_width * static_cast<double>(column_names.size()));
+  const double content_width = image_width - 2 * margin_x;
+
+  // the title, description and imbalance differ from job to job, so they
+  // are measured to size the canvas before anything is drawn
+  const double title_height = context.text_height(output_filename, title,
+    font_role::TITLE, content_width);
+  const double description_height = context.text_height(output_filename,
+    description, font_role::DESCRIPTION, content_width);
+  const double legend_height = saturation_diagram::legend_height(context,
+    output_filename, content_width, legend_type::SATURATION);
+  const double imbalance_title_height = context.text_height(output_filename,
+    imbalance_title, font_role::SMALL_LABEL, content_width);
+  const double imbalance_height = context.text_height(output_filename,
+    imbalance_text, font_role::DESCRIPTION, content_width);
+
+  const double image_height = 2 * margin_y + title_height
+    + large_internal_margin + description_height + internal_margin
+    + legend_height + large_internal_margin + column_header_height
+    + internal_margin + row_height * static_cast<double>(rows.size())
+    + large_internal_margin + imbalance_title_height + internal_margin
+    + imbalance_height;
+
+  fhv::utils::create_directories_for_file(output_filename);
+
+  auto canvas_ptr = context.create_canvas(output_filename, image_width,
+    image_height);
+  diagram_canvas &canvas = *canvas_ptr;
+
+  // --- title, description and legend --- //
+  double y = margin_y;
+  canvas.text(margin_x, y, content_width, title, font_role::TITLE,
+    text_alignment::CENTER);
+  y += title_height + large_internal_margin;
+
+  canvas.text(margin_x, y, content_width, description,
+    font_role::DESCRIPTION);
+  y += description_height + internal_margin;
+
+  draw_legend(canvas, margin_x, y, content_width, context.color_lut,
+    legend_type::SATURATION);
+  y += legend_height + large_internal_margin;
+
+  // --- column headers, read bottom to top --- //
+  double grid_x = margin_x + row_label_width;
+  for (size_t column = 0; column < column_names.size(); column++)
+  {
+    canvas.text(grid_x + column * column_width + column_width / 3, y,
+      column_header_height, column_names[column], font_role::SMALL_LABEL,
+      text_alignment::RIGHT, true);
+  }
+  y += column_header_height + internal_margin;
+
+  // --- grid --- //
+  std::vector<json> column_colors;
+  for (const auto &data : column_data)
+    column_colors.push_back(
+      calculate_saturation_colors(data, context.color_scale));
+
+  for (size_t row = 0; row < rows.size(); row++)
+  {
+    double row_y = y + row * row_height;
+    canvas.label(margin_x, row_y + row_height / 3,
+      row_label_width - internal_margin, rows[row].first,
+      font_role::SMALL_LABEL, text_alignment::RIGHT);
+
+    for (size_t column = 0; column < column_names.size(); column++)
+    {
+      rgb_color upper_color;
+      auto color = component_color(column_colors[column], saturation_section,
+        rows[row].second, upper_color);
+
+      std::string value_text;
+      auto section = column_data[column].find(saturation_section);
+      if (section != column_data[column].end()
+          && section->contains(rows[row].second)
+          && section->at(rows[row].second).is_number())
+      {
+        value_text = fmt::format("{:.2f}",
+          section->at(rows[row].second).get<double>());
+      }
+
+      canvas.component(grid_x + column * column_width, row_y, column_width,
+        row_height, color, value_text, font_role::SMALL_LABEL,
+        label_position::INSIDE, stroke_thickness_thin, upper_color);
+    }
+  }
+  y += row_height * rows.size() + large_internal_margin;
+
+  // --- imbalance --- //
+  canvas.label(margin_x, y, content_width, imbalance_title,
+    font_role::SMALL_LABEL);
+  y += imbalance_title_height + internal_margin;
+  canvas.text(margin_x, y, content_width, imbalance_text,
+    font_role::DESCRIPTION);
+
+  return canvas.finish();
+}
+
+bool saturation_diagram::draw_diagram(
+  render_context &context,
+  json region_colors,
+  std::string title,
+  std::string description,
+  legend_type legend,
+  std::string output_filename
+)
+{
+  // geometry and machine stats are shared by every diagram drawn with this
+  // context
+  const diagram_geometry &geometry = context.geometry;
+
+  const double margin_x = geometry.margin_x;
+  const double margin_y = geometry.margin_y;
+
+  const double internal_margin = geometry.internal_margin;
+  const double large_internal_margin = geometry.large_internal_margin;
+
+  // size of different diagram components
+  const double content_width = geometry.content_width();
+
+  // memory/cache things
+  const double ram_width = content_width;
+  const double ram_height = geometry.ram_height;
+  const double transfer_arrow_height = geometry.transfer_arrow_height;
+  const double l3_width = ram_width;
+  const double l3_height = geometry.cache_height;
+  const double l2_width = l3_width;
+  const double l2_height = l3_height;
+  const double l1_width = l2_width;
+  const double l1_height = l2_height;
+
+  const double core_width = content_width ;
+  const double core_height = geometry.core_height;
+
+  const auto &machineStats = context.machine_stats;
+  if (machineStats.architecture.num_ports_in_core == 0) {
+    std::cerr << "ERROR: draw_diagram_overview: no machine stats "
+      << "provided. Quitting." 
+      << std::endl;
+      return false;
+  }
+
+  double text_height;
+
+  fhv::utils::create_directories_for_file(output_filename);
+
+  auto canvas_ptr = context.create_canvas(output_filename,
+    geometry.image_width, geometry.image_height);
+  diagram_canvas &canvas = *canvas_ptr;
+
+  // --- title and description text --- //
+  double title_x = margin_x;
+  double title_y = margin_y;
+
+  text_height = canvas.text(title_x, title_y, content_width, title,
+    font_role::TITLE, text_alignment::CENTER);
+  
+  double description_x = title_x;
+  double description_y = title_y + text_height + large_internal_margin;
+
+  description += "\n";
+
+  // l1 cache note
+  description +=
+    "Note: L1 cache is currently not measured and therefore will appear "
+    "white. This is not an indication of L1 cache saturation.";
+
+  double description_height = canvas.text(description_x, description_y,
+    content_width, description, font_role::DESCRIPTION);
+
+  // --- draw legend --- //
+  double legend_y = description_y + description_height + internal_margin;
+  double legend_height = draw_legend(canvas, description_x, legend_y,
+    content_width, context.color_lut, legend);
 
   // --- draw RAM --- //
+  const std::string saturation_section = fhv::types::aggregationTypeToString(
+    fhv::types::aggregation_t::saturation);
+  const std::string geometric_mean_section =
+    fhv::types::aggregationTypeToString(
+      fhv::types::aggregation_t::geometric_mean);
+
   double ram_x = margin_x;
-  double ram_y = swatch_label_y + text_height + internal_margin;
-  auto ram_color = WHITE;
-  auto ram_color_json = region_colors[fhv::types::aggregationTypeToString(
-    fhv::types::aggregation_t::saturation)]
-      [fhv_mem_rw_saturation_metric_name];
-  if (!ram_color_json.is_null()) { ram_color = ram_color_json; }
+  double ram_y = legend_y + legend_height + internal_margin;
+  rgb_color ram_upper_color;
+  auto ram_color = component_color(region_colors, saturation_section,
+    fhv_mem_rw_saturation_metric_name, ram_upper_color);
 
-  cairo_draw_component(cr, ram_x, ram_y, ram_width, ram_height, ram_color, 
-    "RAM", big_label_font, label_position::INSIDE);
+  canvas.component(ram_x, ram_y, ram_width, ram_height, ram_color, 
+    "RAM", font_role::BIG_LABEL,
+    label_position::INSIDE, stroke_thickness_normal, ram_upper_color);
 
 
   // --- Load/store arrows from RAM to L3 cache --- //
@@ -805,36 +1440,34 @@ void saturation_diagram::draw_diagram_overview(
   double ram_l3_arrow_y = ram_y + ram_height;
   double ram_l3_arrow_width = ram_width / 5.0;
 
-  auto ram_load_color = WHITE;
-  auto ram_load_color_json = region_colors[fhv::types::aggregationTypeToString(
-    fhv::types::aggregation_t::saturation)][fhv_mem_r_saturation_metric_name];
-  if (!ram_load_color_json.is_null()) { ram_load_color = ram_load_color_json; }
+  rgb_color ram_load_upper_color;
+  auto ram_load_color = component_color(region_colors, saturation_section,
+    fhv_mem_r_saturation_metric_name, ram_load_upper_color);
 
-  cairo_draw_arrow(cr, ram_l3_load_x, ram_l3_arrow_y, ram_l3_arrow_width,
-    transfer_arrow_height, ram_load_color, direction::DOWN, "load", 
-    small_label_font, stroke_thickness_thin);
+  canvas.arrow(ram_l3_load_x, ram_l3_arrow_y, ram_l3_arrow_width,
+    transfer_arrow_height, ram_load_color, direction::DOWN,
+    "load", font_role::SMALL_LABEL,
+    stroke_thickness_thin, ram_load_upper_color);
 
-  auto ram_store_color = WHITE;
-  auto ram_store_color_json = region_colors[fhv::types::aggregationTypeToString(
-    fhv::types::aggregation_t::saturation)][fhv_mem_w_saturation_metric_name];
-  if (!ram_store_color_json.is_null()) { 
-    ram_store_color = ram_store_color_json; 
-  }
+  rgb_color ram_store_upper_color;
+  auto ram_store_color = component_color(region_colors, saturation_section,
+    fhv_mem_w_saturation_metric_name, ram_store_upper_color);
 
-  cairo_draw_arrow(cr, ram_l3_store_x, ram_l3_arrow_y, ram_l3_arrow_width,
-    transfer_arrow_height, ram_store_color, direction::UP, "store", 
-    small_label_font, stroke_thickness_thin);
+  canvas.arrow(ram_l3_store_x, ram_l3_arrow_y, ram_l3_arrow_width,
+    transfer_arrow_height, ram_store_color, direction::UP,
+    "store", font_role::SMALL_LABEL,
+    stroke_thickness_thin, ram_store_upper_color);
 
   // --- draw L3 cache --- //
   double l3_x = ram_x;
   double l3_y = ram_l3_arrow_y + transfer_arrow_height;
-  auto l3_color = WHITE;
-  auto l3_color_json = region_colors[fhv::types::aggregationTypeToString(
-    fhv::types::aggregation_t::saturation)][fhv_l3_rw_saturation_metric_name];
-  if (!l3_color_json.is_null()) { l3_color = l3_color_json; }
+  rgb_color l3_upper_color;
+  auto l3_color = component_color(region_colors, saturation_section,
+    fhv_l3_rw_saturation_metric_name, l3_upper_color);
 
-  cairo_draw_component(cr, l3_x, l3_y, l3_width, l3_height,
-      l3_color, "L3 Cache", big_label_font);
+  canvas.component(l3_x, l3_y, l3_width, l3_height,
+      l3_color, "L3 Cache", font_role::BIG_LABEL,
+      label_position::INSIDE, stroke_thickness_normal, l3_upper_color);
 
   // --- Load/store arrows from L3 to L2 cache --- //
   double l3_l2_load_x = ram_l3_load_x;
@@ -842,34 +1475,34 @@ void saturation_diagram::draw_diagram_overview(
   double l3_l2_arrow_y = l3_y + l3_height;
   double l3_l2_arrow_width = l3_width / 5.0;
 
-  auto l3_load_color = WHITE;
-  auto l3_load_color_json = region_colors[fhv::types::aggregationTypeToString(
-    fhv::types::aggregation_t::saturation)][fhv_l3_r_saturation_metric_name];
-  if (!l3_load_color_json.is_null()) { l3_load_color = l3_load_color_json; }
+  rgb_color l3_load_upper_color;
+  auto l3_load_color = component_color(region_colors, saturation_section,
+    fhv_l3_r_saturation_metric_name, l3_load_upper_color);
 
-  cairo_draw_arrow(cr, l3_l2_load_x, l3_l2_arrow_y, l3_l2_arrow_width,
-    transfer_arrow_height, l3_load_color, direction::DOWN, "load", 
-    small_label_font, stroke_thickness_thin);
+  canvas.arrow(l3_l2_load_x, l3_l2_arrow_y, l3_l2_arrow_width,
+    transfer_arrow_height, l3_load_color, direction::DOWN,
+    "load", font_role::SMALL_LABEL,
+    stroke_thickness_thin, l3_load_upper_color);
 
-  auto l3_store_color = WHITE;
-  auto l3_store_color_json = region_colors[fhv::types::aggregationTypeToString(
-    fhv::types::aggregation_t::saturation)][fhv_l3_w_saturation_metric_name];
-  if (!l3_store_color_json.is_null()) { l3_store_color = l3_store_color_json; }
+  rgb_color l3_store_upper_color;
+  auto l3_store_color = component_color(region_colors, saturation_section,
+    fhv_l3_w_saturation_metric_name, l3_store_upper_color);
 
-  cairo_draw_arrow(cr, l3_l2_store_x, l3_l2_arrow_y, l3_l2_arrow_width,
-    transfer_arrow_height, l3_store_color, direction::UP, "store", 
-    small_label_font, stroke_thickness_thin);
+  canvas.arrow(l3_l2_store_x, l3_l2_arrow_y, l3_l2_arrow_width,
+    transfer_arrow_height, l3_store_color, direction::UP,
+    "store", font_role::SMALL_LABEL,
+    stroke_thickness_thin, l3_store_upper_color);
 
   // --- draw L2 cache --- //
   double l2_x = l3_x;
   double l2_y = l3_l2_arrow_y + transfer_arrow_height;
-  auto l2_color = WHITE;
-  auto l2_color_json = region_colors[fhv::types::aggregationTypeToString(
-    fhv::types::aggregation_t::saturation)][fhv_l2_rw_saturation_metric_name];
-  if (!l2_color_json.is_null()) { l2_color = l2_color_json; }
+  rgb_color l2_upper_color;
+  auto l2_color = component_color(region_colors, saturation_section,
+    fhv_l2_rw_saturation_metric_name, l2_upper_color);
 
-  cairo_draw_component(cr, l2_x, l2_y, l2_width, l2_height, l2_color,
-    "L2 Cache", big_label_font);
+  canvas.component(l2_x, l2_y, l2_width, l2_height, l2_color,
+    "L2 Cache", font_role::BIG_LABEL,
+    label_position::INSIDE, stroke_thickness_normal, l2_upper_color);
 
   // --- Load/store arrows from L2 to L1 cache --- //
   double l2_l1_load_x = l3_l2_load_x;
@@ -877,33 +1510,34 @@ void saturation_diagram::draw_diagram_overview(
   double l2_l1_arrow_y = l2_y + l2_height;
   double l2_l1_arrow_width = l2_width / 5.0;
 
-  auto l2_load_color = WHITE;
-  auto l2_load_color_json = region_colors[fhv::types::aggregationTypeToString(
-    fhv::types::aggregation_t::saturation)][fhv_l2_r_saturation_metric_name];
-  if (!l2_load_color_json.is_null()) { l2_load_color = l2_load_color_json; }
-  cairo_draw_arrow(cr, l2_l1_load_x, l2_l1_arrow_y, l2_l1_arrow_width,
-    transfer_arrow_height, l2_load_color, direction::DOWN, "load", 
-    small_label_font, stroke_thickness_thin);
-
-  auto l2_store_color = WHITE;
-  auto l2_store_color_json = region_colors[fhv::types::aggregationTypeToString(
-    fhv::types::aggregation_t::saturation)][fhv_l2_w_saturation_metric_name];
-  if (!l2_store_color_json.is_null()) { l2_store_color = l2_store_color_json; }
-  cairo_draw_arrow(cr, l2_l1_store_x, l2_l1_arrow_y, l2_l1_arrow_width,
-    transfer_arrow_height, l2_store_color, direction::UP, "store", 
-    small_label_font, stroke_thickness_thin);
+  rgb_color l2_load_upper_color;
+  auto l2_load_color = component_color(region_colors, saturation_section,
+    fhv_l2_r_saturation_metric_name, l2_load_upper_color);
+  canvas.arrow(l2_l1_load_x, l2_l1_arrow_y, l2_l1_arrow_width,
+    transfer_arrow_height, l2_load_color, direction::DOWN,
+    "load", font_role::SMALL_LABEL,
+    stroke_thickness_thin, l2_load_upper_color);
+
+  rgb_color l2_store_upper_color;
+  auto l2_store_color = component_color(region_colors, saturation_section,
+    fhv_l2_w_saturation_metric_name, l2_store_upper_color);
+  canvas.arrow(l2_l1_store_x, l2_l1_arrow_y, l2_l1_arrow_width,
+    transfer_arrow_height, l2_store_color, direction::UP,
+    "store", font_role::SMALL_LABEL,
+    stroke_thickness_thin, l2_store_upper_color);
 
   // --- draw L1 cache --- //
   double l1_x = l2_x; 
   double l1_y = l2_l1_arrow_y + transfer_arrow_height;
-  cairo_draw_component(cr, l1_x, l1_y, l1_width, l1_height, 
-    rgb_color(1,1,1), "L1 Cache", big_label_font);
+  canvas.component(l1_x, l1_y, l1_width, l1_height, 
+    rgb_color(1,1,1), "L1 Cache", font_role::BIG_LABEL);
 
   // --- draw core container block --- //
   double core_x = margin_x;
   double core_y = l1_y + l1_height;
-  cairo_draw_component(cr, core_x, core_y, core_width, 
-    core_height, rgb_color(1, 1, 1), "", big_label_font, 
+  canvas.component(core_x, core_y, core_width, 
+    core_height, rgb_color(1, 1, 1),
+    "", font_role::BIG_LABEL,
     label_position::INSIDE);
   
   // --- draw block with "in-core performance" label --- //
@@ -911,8 +1545,9 @@ void saturation_diagram::draw_diagram_overview(
   double in_core_y = core_y + internal_margin;
   double in_core_height = core_height - 2 * internal_margin;
   double in_core_width = core_width - 2 * internal_margin;
-  text_height = cairo_draw_component(cr, in_core_x, in_core_y, in_core_width, 
-    in_core_height, rgb_color(1, 1, 1), "In-core performance", big_label_font, 
+  text_height = canvas.component(in_core_x, in_core_y, in_core_width, 
+    in_core_height, rgb_color(1, 1, 1),
+    "In-core performance", font_role::BIG_LABEL,
     label_position::LEFT);
 
   // --- draw FLOPs saturations
@@ -924,38 +1559,28 @@ void saturation_diagram::draw_diagram_overview(
   // single precision
   double single_p_x = in_core_x + text_height;
   double single_p_y = in_core_y;
-  auto flops_sp_color = WHITE;
-  auto flops_sp_color_json = region_colors[fhv::types::aggregationTypeToString(
-    fhv::types::aggregation_t::saturation)]
-      [fhv_flops_sp_saturation_metric_name];
-  if(!flops_sp_color_json.is_null()) { flops_sp_color = flops_sp_color_json; }
+  rgb_color flops_sp_upper_color;
+  auto flops_sp_color = component_color(region_colors, saturation_section,
+    fhv_flops_sp_saturation_metric_name, flops_sp_upper_color);
 
-  cairo_draw_component(cr, single_p_x, single_p_y, flops_width, flops_height, 
-    flops_sp_color, "Single-precision FLOP/s", big_label_font, 
-      label_position::INSIDE);
+  canvas.component(single_p_x, single_p_y, flops_width, flops_height, 
+    flops_sp_color,
+    "Single-precision FLOP/s", font_role::BIG_LABEL,
+    label_position::INSIDE, stroke_thickness_normal, flops_sp_upper_color);
 
   // double precision
   double double_p_x = single_p_x + flops_width;
   double double_p_y = single_p_y;
-  auto flops_dp_color = WHITE;
-  auto flops_dp_color_json = region_colors[fhv::types::aggregationTypeToString(
-    fhv::types::aggregation_t::saturation)]
-      [fhv_flops_dp_saturation_metric_name];
-  if(!flops_dp_color_json.is_null()) { flops_dp_color = flops_dp_color_json; }
-
-  cairo_draw_component(cr, double_p_x, double_p_y, flops_width, flops_height, 
-    flops_dp_color, "Double-precision FLOP/s", big_label_font, 
-    label_position::INSIDE);
+  rgb_color flops_dp_upper_color;
+  auto flops_dp_color = component_color(region_colors, saturation_section,
+    fhv_flops_dp_saturation_metric_name, flops_dp_upper_color);
+
+  canvas.component(double_p_x, double_p_y, flops_width, flops_height, 
+    flops_dp_color,
+    "Double-precision FLOP/s", font_role::BIG_LABEL,
+    label_position::INSIDE, stroke_thickness_normal, flops_dp_upper_color);
   
   // --- draw ports in core
-  auto machineStats = fhv::config::loadMachineStats();
-  if (machineStats.architecture.num_ports_in_core == 0) {
-    std::cerr << "ERROR: draw_diagram_overview: no machine stats "
-      << "provided. Quitting." 
-      << std::endl;
-      return;
-  }
-
   double port_width = (in_core_width - text_height) * 
     (1.0/static_cast<double>(machineStats.architecture.num_ports_in_core));
   double port_height = in_core_height - flops_height;
@@ -966,25 +1591,17 @@ void saturation_diagram::draw_diagram_overview(
   {
     port_x = in_core_x + text_height + port_num * port_width;
 
-    auto port_color = WHITE;
-    auto port_color_json = region_colors[fhv::types::aggregationTypeToString(
-      fhv::types::aggregation_t::geometric_mean)] [fhv_port_usage_ratio_start 
-        + std::to_string(port_num) + fhv_port_usage_ratio_end];
-    if(!port_color_json.is_null()) { port_color = port_color_json; }
+    rgb_color port_upper_color;
+    auto port_color = component_color(region_colors, geometric_mean_section,
+      fhv_port_usage_ratio_start + std::to_string(port_num)
+        + fhv_port_usage_ratio_end, port_upper_color);
 
-    cairo_draw_component(cr, port_x, port_y, port_width, port_height,
-      port_color, "Port " + std::to_string(port_num), small_label_font, 
-      label_position::INSIDE, stroke_thickness_thin);
+    canvas.component(port_x, port_y, port_width, port_height,
+      port_color,
+      "Port " + std::to_string(port_num), font_role::SMALL_LABEL,
+      label_position::INSIDE, stroke_thickness_thin, port_upper_color);
   }
 
-  // --- done drawing things, clean up
-  pango_font_description_free(title_font);
-  pango_font_description_free(description_font);
-  pango_font_description_free(big_label_font);
-  pango_font_description_free(small_label_font);
-
-  // svg file automatically gets written to disk
-  cairo_destroy(cr);
-  cairo_surface_destroy(surface);
+  // --- done drawing things
+  return canvas.finish();
 }
-
@@ -13,31 +13,22 @@
 #include <string>
 #include <type_traits>
 
+#include "diagram_canvas.hpp"
 #include "likwid_defines.hpp"
 // needed for "aggregationTypeToString"
 #include "fhv_perfmon.hpp"
 #include "utils.hpp"
 #include "performance_monitor_defines.hpp"
+#include "result_diff.hpp"
 
 using json = nlohmann::json;
 
-// ----- simple color type ----- //
-typedef std::tuple<double, double, double> rgb_color;
-
-enum class label_position {
-  INSIDE, BOTTOM, LEFT
-};
-
-enum class direction {
-  UP, RIGHT, DOWN, LEFT
+enum class legend_type {
+  SATURATION, DIFFERENCE, FRACTION_OF_MAX
 };
 
-// magic numbers
-
-// TODO: should anything else be here?
-const double stroke_thickness_normal = 10.0;
-const double stroke_thickness_thin = 5.0;
-const rgb_color WHITE(1.0, 1.0, 1.0);
+// defined in render_context.hpp
+class render_context;
 
 class saturation_diagram {
   public:
@@ -64,6 +55,11 @@ class saturation_diagram {
       const double &value,
       const std::string &color_scale);
 
+    // same as above with a color scale from color_scale_lut
+    static rgb_color calculate_single_color(
+      const double &value,
+      const std::vector<rgb_color> &color_lut);
+
     /* ---- calculate saturation colors ----- 
      * The return value of this function is intended to be passed to
      * draw_diagram. 
@@ -75,14 +71,83 @@ class saturation_diagram {
 
     /* ---- draw diagram ----
      * Draws an overview of the architecture that displays RAM, cores, and
-     * caches 
+     * caches. Safe to call from several threads at once as long as each
+     * writes a different output file. Returns false if the diagram could not
+     * be drawn or written.
      */
-    static void draw_diagram_overview(
-      json fhv_data,
+    static bool draw_diagram_overview(
+      const json &fhv_data,
       std::string color_scale,
       std::string region_name,
       std::string output_filename);
 
+    // same as above, reusing the fonts, color scale and label layouts of a
+    // context. Use this when drawing many diagrams.
+    static bool draw_diagram_overview(
+      render_context &context,
+      const json &fhv_data,
+      std::string region_name,
+      std::string output_filename);
+
+    // same as above for the info section and region_results[region_name]
+    // of a json, e.g. from fhv::summary
+    static bool draw_diagram_overview(
+      render_context &context,
+      const json &info,
+      const json &region_data,
+      std::string region_name,
+      std::string output_filename);
+
+    /* ---- calculate difference colors -----
+     * Same shape as the return value of calculate_saturation_colors, but each
+     * color represents the change in saturation from the baseline region to
+     * the candidate region on a diverging color scale. Metrics missing from
+     * either region are left out and will be drawn white.
+     */
+    static json
+    calculate_difference_colors(
+      const json &baseline_region_data,
+      const json &candidate_region_data);
+
+    /* ---- calculate uncertainty colors -----
+     * for merged results (see "fhv --merge"), finds components whose 95%
+     * confidence interval spans more than one color bin. Returns json of the
+     * form [section][metric] = [lower bound color, upper bound color]. Empty
+     * if region_data has no statistics or nothing is uncertain.
+     */
+    static json
+    calculate_uncertainty_colors(
+      const json &region_data,
+      const std::string &color_scale);
+
+    static rgb_color calculate_difference_color(
+      const double &difference);
+
+    /* ---- draw diagram difference ----
+     * Draws the same overview as draw_diagram_overview, but colors each
+     * component by how much its saturation changed between two runs. The
+     * region should come from fhv::diff::matchRegions. Returns false like
+     * draw_diagram_overview.
+     */
+    static bool draw_diagram_difference(
+      const json &baseline_data,
+      const json &candidate_data,
+      std::string region_name,
+      std::string output_filename);
+
+    /* ---- draw cluster overview ----
+     * For jobs merged with "fhv --merge-ranks". Draws one column per node
+     * (plus one for the whole job) with a box per memory level and FLOP/s
+     * type, colored by that node's saturation, followed by the ranks that
+     * differ the most from the others. Drawn with context like
+     * draw_diagram, and returns false if the file could not be written.
+     */
+    static bool draw_cluster_overview(
+      render_context &context,
+      const json &job_data,
+      std::string region_name,
+      std::string output_filename);
+
     /* ======== Helper functions: general ======== 
      * These may be used elsewhere but are intended for internal use. They
      * include things like clamping and scaling values that are applied before
@@ -113,6 +178,18 @@ class saturation_diagram {
       const std::string &scale_name,
       const double &t);
 
+    // same as above for a scale that was already looked up
+    static rgb_color discrete_color(
+      const std::vector<rgb_color> &scale,
+      const double &t);
+
+    /* ---- color scale lut ----
+     * the bins of a discrete color scale, or nullptr if there is no scale
+     * with that name
+     */
+    static const std::vector<rgb_color> *color_scale_lut(
+      const std::string &scale_name);
+
     /* ----- CLAMP ----- 
      * taken from: https://en.cppreference.com/w/cpp/algorithm/clamp
      */
@@ -131,6 +208,19 @@ class saturation_diagram {
      */
     static double scale(const double value);
 
+    /* ---- signed scale ----
+     * applies "scale" to the magnitude of a difference in saturation and maps
+     * the result to [0.0, 1.0], so that -1.0 -> 0.0, 0.0 -> 0.5 and 
+     * 1.0 -> 1.0. Intended for diverging color scales.
+     */
+    static double signed_scale(const double value);
+
+    /* ---- describe processor ----
+     * builds the human-readable processor description shown under the title
+     * of a diagram from the "processor" section of the info json
+     */
+    static std::string describe_processor(const json &proc_info);
+
 
     /* ======== Helper functions: cairo ======== 
      *
@@ -151,13 +241,22 @@ class saturation_diagram {
       PangoAlignment alignment = PangoAlignment::PANGO_ALIGN_LEFT,
       int height = -1);
 
-    /* used by pango_cairo_draw_text */
+    /* used by pango_cairo_draw_text
+     *
+     * layouts that are reused for several diagrams (see render_context)
+     * should be drawn with update_layout = false. Updating them to match cr
+     * would throw away their cached size every time they are drawn rotated.
+     */
     static void pango_cairo_draw_layout(
       cairo_t * cr,
       double x,
       double y,
       PangoLayout *layout,
-      bool vertical = false);
+      bool vertical = false,
+      bool update_layout = true);
+
+    // height of a layout in cairo units
+    static double pango_layout_cairo_height(PangoLayout *layout);
     
     /* ---- draw text ----
      *
@@ -205,6 +304,31 @@ class saturation_diagram {
       unsigned width,
       unsigned height);
 
+    /* ---- draw legend ----
+     * draws a swatch of color_lut with its value labels and caption at x, y
+     * and returns the height taken
+     */
+    static double draw_legend(
+      diagram_canvas &canvas,
+      double x,
+      double y,
+      double width,
+      const std::vector<rgb_color> &color_lut,
+      legend_type legend);
+
+    // the caption draw_legend puts under the swatch
+    static std::string legend_caption(legend_type legend);
+
+    /* ---- legend height ----
+     * the height draw_legend takes on the canvas context creates for
+     * output_filename, for diagrams that are sized before they are drawn
+     */
+    static double legend_height(
+      render_context &context,
+      const std::string &output_filename,
+      double width,
+      legend_type legend);
+
     /* ---- draw component ----
      *
      * Font size will be adjusted to be approximately 1/3 the height of the
@@ -230,7 +354,22 @@ class saturation_diagram {
       std::string label,
       PangoFontDescription * font_desc,
       label_position position = label_position::INSIDE,
-      double stroke_width = stroke_thickness_normal);
+      double stroke_width = stroke_thickness_normal,
+      rgb_color upper_fill_color = NO_COLOR);
+
+    // same as above with a label that was already laid out, e.g. by
+    // render_context::component_label_layout. The layout is not modified.
+    static double cairo_draw_component(
+      cairo_t *cr,
+      double x,
+      double y,
+      double width,
+      double height,
+      rgb_color fill_color,
+      PangoLayout *label_layout,
+      label_position position = label_position::INSIDE,
+      double stroke_width = stroke_thickness_normal,
+      rgb_color upper_fill_color = NO_COLOR);
 
     static void cairo_draw_arrow(
       cairo_t *cr,
@@ -242,9 +381,62 @@ class saturation_diagram {
       direction arrow_direction,
       std::string label,
       PangoFontDescription * font_desc,
-      double stroke_width = stroke_thickness_normal);
+      double stroke_width = stroke_thickness_normal,
+      rgb_color upper_fill_color = NO_COLOR);
+
+    // the label is laid out like a component label in position INSIDE
+    static void cairo_draw_arrow(
+      cairo_t *cr,
+      double x,
+      double y,
+      double width,
+      double height,
+      rgb_color fill_color,
+      direction arrow_direction,
+      PangoLayout *label_layout,
+      double stroke_width = stroke_thickness_normal,
+      rgb_color upper_fill_color = NO_COLOR);
+
+    /* ---- fill split ----
+     * fills the current path with fill_color and preserves the path. If
+     * upper_fill_color is not NO_COLOR, the right half of the path is filled
+     * with upper_fill_color instead. Used to show uncertain components.
+     */
+    static void cairo_fill_split(
+      cairo_t *cr,
+      rgb_color fill_color,
+      rgb_color upper_fill_color = NO_COLOR);
 
   private:
+    /* ---- component color ----
+     * looks up the color of a component in the output of
+     * calculate_saturation_colors, returning WHITE if there is none. If the
+     * component is uncertain (see calculate_uncertainty_colors, stored under
+     * the "statistics" key), returns the lower bound color and sets
+     * upper_color to the upper bound color. Otherwise upper_color is set to
+     * NO_COLOR.
+     */
+    static rgb_color component_color(
+      json &region_colors,
+      const std::string &section,
+      const std::string &metric,
+      rgb_color &upper_color);
+
+    /* ---- draw diagram ----
+     * Does the actual drawing for draw_diagram_overview and
+     * draw_diagram_difference. region_colors should come from
+     * calculate_saturation_colors or calculate_difference_colors, and the
+     * context's color scale and legend should match how those colors were
+     * calculated. The context's backend does the drawing. Returns false if
+     * there are no machine stats or the file could not be written.
+     */
+    static bool draw_diagram(
+      render_context &context,
+      json region_colors,
+      std::string title,
+      std::string description,
+      legend_type legend,
+      std::string output_filename);
 };
 
 // COLOR SCALES
@@ -300,6 +492,21 @@ const std::vector<rgb_color> colorScale_YlGn = {
   rgb_color(0.0/255.0  ,  69.0/255.0  ,  41.0/255.0),
 };
 
+// diverging scale, used for differences between two runs. Low values are
+// red and high values are blue.
+const std::string colorScaleName_RdBu = "RdBu";
+const std::vector<rgb_color> colorScale_RdBu = {
+  rgb_color(178.0/255.0  ,  24.0/255.0  ,  43.0/255.0),
+  rgb_color(214.0/255.0  ,  96.0/255.0  ,  77.0/255.0),
+  rgb_color(244.0/255.0  ,  165.0/255.0  ,  130.0/255.0),
+  rgb_color(253.0/255.0  ,  219.0/255.0  ,  199.0/255.0),
+  rgb_color(247.0/255.0  ,  247.0/255.0  ,  247.0/255.0),
+  rgb_color(209.0/255.0  ,  229.0/255.0  ,  240.0/255.0),
+  rgb_color(146.0/255.0  ,  197.0/255.0  ,  222.0/255.0),
+  rgb_color(67.0/255.0  ,  147.0/255.0  ,  195.0/255.0),
+  rgb_color(33.0/255.0  ,  102.0/255.0  ,  172.0/255.0),
+};
+
 const std::string colorScaleName_Greys = "Greys";
 const std::vector<rgb_color> colorScale_Greys = {
   rgb_color(255.0/255.0  ,  255.0/255.0  ,  255.0/255.0),
@@ -0,0 +1,313 @@
+#include "scaling_chart.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+bool scaling_chart::draw_scaling_charts(
+  render_context &context,
+  const json &index,
+  std::string output_prefix)
+{
+  auto all_series = fhv::sweep::scalingSeries(index);
+  bool weak = index.value(fhv::sweep::sweep_scaling_key, "")
+    == fhv::sweep::scalingTypeToString(fhv::sweep::scaling_t::weak);
+  std::string scaling_name = weak ? "Weak" : "Strong";
+
+  // saturation metrics shown in the saturation charts, with short labels
+  const std::vector<std::pair<std::string, std::string>> saturation_metrics = {
+    {"RAM", fhv_mem_rw_saturation_metric_name},
+    {"L3 Cache", fhv_l3_rw_saturation_metric_name},
+    {"L2 Cache", fhv_l2_rw_saturation_metric_name},
+    {"SP FLOP/s", fhv_flops_sp_saturation_metric_name},
+    {"DP FLOP/s", fhv_flops_dp_saturation_metric_name},
+  };
+
+  // regions in the order they first appear
+  std::vector<std::string> region_names;
+  for (const auto &series : all_series)
+  {
+    if (std::find(region_names.begin(), region_names.end(),
+          series.region_name) == region_names.end())
+      region_names.push_back(series.region_name);
+  }
+
+  std::string description = fmt::format("{} scaling of \"{}\".",
+    scaling_name, index.value(fhv::sweep::sweep_command_key, ""));
+  if (weak)
+    description += " Sizes are per thread.";
+  description += " Each point is the mean of all repetitions. Speedup and "
+    "efficiency are relative to the smallest thread count measured.";
+
+  bool all_written = true;
+  auto report = [&](bool written, const std::string &filename) {
+    if (written)
+      std::cout << "Scaling chart saved to " << filename << std::endl;
+    else
+      all_written = false;
+  };
+
+  for (const auto &region_name : region_names)
+  {
+    std::vector<chart_series> speedup_lines;
+    std::vector<chart_series> efficiency_lines;
+    unsigned max_threads = 0, min_threads = 0;
+    unsigned series_num = 0;
+
+    for (const auto &series : all_series)
+    {
+      if (series.region_name != region_name) continue;
+
+      rgb_color color =
+        chartSeriesColors[series_num % chartSeriesColors.size()];
+      chart_series speedup = {series.label(), {}, color, false};
+      chart_series efficiency = {series.label(), {}, color, false};
+      std::vector<chart_series> saturation_lines;
+      for (size_t m = 0; m < saturation_metrics.size(); m++)
+        saturation_lines.push_back({saturation_metrics[m].first, {},
+          chartSeriesColors[m % chartSeriesColors.size()], false});
+
+      for (const auto &point : series.points)
+      {
+        if (min_threads == 0 || point.threads < min_threads)
+          min_threads = point.threads;
+        max_threads = std::max(max_threads, point.threads);
+
+        if (!std::isnan(point.speedup))
+        {
+          speedup.points.push_back({point.threads, point.speedup});
+          efficiency.points.push_back({point.threads, point.efficiency});
+        }
+
+        for (size_t m = 0; m < saturation_metrics.size(); m++)
+        {
+          auto saturation =
+            point.saturation.find(saturation_metrics[m].second);
+          if (saturation != point.saturation.end())
+            saturation_lines[m].points.push_back(
+              {point.threads, saturation->second});
+        }
+      }
+
+      speedup_lines.push_back(speedup);
+      efficiency_lines.push_back(efficiency);
+
+      // lines without any data would only clutter the legend
+      saturation_lines.erase(std::remove_if(saturation_lines.begin(),
+          saturation_lines.end(),
+          [](const chart_series &line) { return line.points.empty(); }),
+        saturation_lines.end());
+
+      std::string saturation_filename = fmt::format("{}_{}_saturation_{}.svg",
+        output_prefix, region_name, series_num);
+      report(draw_line_chart(context,
+        fmt::format("Saturation vs threads\n\"{}\", {}", region_name,
+          series.label()),
+        description, "Threads", "Saturation", saturation_lines, 1.0,
+        saturation_filename), saturation_filename);
+
+      series_num++;
+    }
+
+    // ideal scaling, relative to the smallest thread count like the data
+    chart_series ideal_speedup = {"ideal", {}, rgb_color(0, 0, 0), true};
+    chart_series ideal_efficiency = {"ideal", {}, rgb_color(0, 0, 0), true};
+    ideal_speedup.points.push_back({min_threads, min_threads});
+    ideal_speedup.points.push_back({max_threads, max_threads});
+    ideal_efficiency.points.push_back({min_threads, 1.0});
+    ideal_efficiency.points.push_back({max_threads, 1.0});
+    speedup_lines.push_back(ideal_speedup);
+    efficiency_lines.push_back(ideal_efficiency);
+
+    std::string speedup_filename =
+      fmt::format("{}_{}_speedup.svg", output_prefix, region_name);
+    report(draw_line_chart(context,
+      fmt::format("{} scaling: speedup\n\"{}\"", scaling_name, region_name),
+      description, "Threads", weak ? "Scaled speedup" : "Speedup",
+      speedup_lines, 0.0, speedup_filename), speedup_filename);
+
+    std::string efficiency_filename =
+      fmt::format("{}_{}_efficiency.svg", output_prefix, region_name);
+    report(draw_line_chart(context,
+      fmt::format("{} scaling: efficiency\n\"{}\"", scaling_name,
+        region_name),
+      description, "Threads", "Parallel efficiency", efficiency_lines, 0.0,
+      efficiency_filename), efficiency_filename);
+  }
+
+  return all_written;
+}
+
+bool scaling_chart::draw_line_chart(
+  render_context &context,
+  std::string title,
+  std::string description,
+  std::string x_label,
+  std::string y_label,
+  const std::vector<chart_series> &series,
+  double y_max,
+  std::string output_filename)
+{
+  /* ----- drawing constants ----- */
+  const diagram_geometry &geometry = context.geometry;
+  const double image_width = geometry.image_width;
+  const double margin_x = geometry.margin_x;
+  const double margin_y = geometry.margin_y;
+  const double small_internal_margin = geometry.small_internal_margin;
+  const double internal_margin = geometry.internal_margin;
+  const double content_width = geometry.content_width();
+
+  const double axis_label_width = 100;
+  const double plot_width = content_width - axis_label_width;
+  const double plot_height = 600;
+  const double tick_length = 10;
+  const double tick_label_width = 100;
+  const double legend_swatch_width = 60;
+  const double legend_label_width =
+    plot_width - legend_swatch_width - internal_margin;
+
+  const rgb_color black(0.0, 0.0, 0.0);
+
+  // --- axis ranges --- //
+  double x_min = 0.0, x_max = 0.0, y_top = y_max;
+  std::vector<double> x_ticks;
+  for (const auto &line : series)
+  {
+    for (const auto &point : line.points)
+    {
+      if (x_min == 0.0 || point.first < x_min) x_min = point.first;
+      x_max = std::max(x_max, point.first);
+      y_top = std::max(y_top, point.second * 1.1);
+      if (!line.dashed
+          && std::find(x_ticks.begin(), x_ticks.end(), point.first)
+            == x_ticks.end())
+        x_ticks.push_back(point.first);
+    }
+  }
+  if (x_min <= 0.0) x_min = 1.0;
+  if (x_max <= x_min) x_max = x_min * 2.0;
+  if (y_top <= 0.0) y_top = 1.0;
+
+  // --- text is measured to size the chart before it is drawn --- //
+  auto text_height = [&](const std::string &text, font_role font,
+      double width) {
+    return context.text_height(output_filename, text, font, width);
+  };
+
+  const double title_height = text_height(title, font_role::TITLE,
+    content_width);
+  const double description_height = text_height(description,
+    font_role::DESCRIPTION, content_width);
+  const double y_label_height = text_height(y_label, font_role::SMALL_LABEL,
+    content_width);
+  const double tick_labels_height = text_height("1", font_role::DESCRIPTION,
+    tick_label_width);
+  const double x_label_height = text_height(x_label, font_role::SMALL_LABEL,
+    plot_width);
+
+  std::vector<double> legend_heights;
+  double legend_height = 0.0;
+  for (const auto &line : series)
+  {
+    legend_heights.push_back(text_height(line.label, font_role::SMALL_LABEL,
+      legend_label_width) + small_internal_margin);
+    legend_height += legend_heights.back();
+  }
+
+  const double image_height = 2 * margin_y + title_height + internal_margin
+    + description_height + internal_margin + y_label_height
+    + internal_margin + plot_height + tick_length + tick_labels_height
+    + small_internal_margin + x_label_height + internal_margin
+    + legend_height;
+
+  fhv::utils::create_directories_for_file(output_filename);
+
+  auto canvas_ptr = context.create_canvas(output_filename, image_width,
+    image_height);
+  diagram_canvas &canvas = *canvas_ptr;
+
+  // --- title and description --- //
+  double y = margin_y;
+  canvas.text(margin_x, y, content_width, title, font_role::TITLE,
+    text_alignment::CENTER);
+  y += title_height + internal_margin;
+  canvas.text(margin_x, y, content_width, description,
+    font_role::DESCRIPTION);
+  y += description_height + internal_margin;
+
+  canvas.text(margin_x, y, content_width, y_label, font_role::SMALL_LABEL);
+  y += y_label_height + internal_margin;
+
+  // --- axes --- //
+  const double plot_x = margin_x + axis_label_width;
+  const double plot_y = y;
+
+  auto to_canvas_x = [&](double x) {
+    return plot_x + plot_width * (log2(x) - log2(x_min))
+      / (log2(x_max) - log2(x_min));
+  };
+  auto to_canvas_y = [&](double value) {
+    return plot_y + plot_height * (1.0 - value / y_top);
+  };
+
+  canvas.line({{plot_x, plot_y}, {plot_x, plot_y + plot_height},
+    {plot_x + plot_width, plot_y + plot_height}}, black, 2.0);
+
+  for (const auto &tick : x_ticks)
+  {
+    canvas.line({{to_canvas_x(tick), plot_y + plot_height},
+      {to_canvas_x(tick), plot_y + plot_height + tick_length}}, black, 2.0);
+    canvas.text(to_canvas_x(tick) - tick_label_width / 2,
+      plot_y + plot_height + tick_length, tick_label_width,
+      fmt::format("{:g}", tick), font_role::DESCRIPTION,
+      text_alignment::CENTER);
+  }
+
+  const unsigned num_y_ticks = 5;
+  for (unsigned i = 0; i <= num_y_ticks; i++)
+  {
+    double value = y_top * static_cast<double>(i) / num_y_ticks;
+    canvas.line({{plot_x, to_canvas_y(value)},
+      {plot_x - tick_length, to_canvas_y(value)}}, black, 2.0);
+    canvas.text(margin_x, to_canvas_y(value) - 10,
+      axis_label_width - 2 * tick_length, fmt::format("{:.3g}", value),
+      font_role::DESCRIPTION, text_alignment::RIGHT);
+  }
+
+  y = plot_y + plot_height + tick_length + tick_labels_height
+    + small_internal_margin;
+  canvas.text(plot_x, y, plot_width, x_label, font_role::SMALL_LABEL,
+    text_alignment::CENTER);
+  y += x_label_height + internal_margin;
+
+  // --- lines --- //
+  for (const auto &line : series)
+  {
+    if (line.points.empty()) continue;
+
+    std::vector<std::pair<double, double>> points;
+    for (const auto &point : line.points)
+      points.push_back({to_canvas_x(point.first), to_canvas_y(point.second)});
+    canvas.line(points, line.color, line.dashed ? 2.0 : 4.0, line.dashed);
+
+    if (!line.dashed)
+    {
+      for (const auto &point : points)
+        canvas.dot(point.first, point.second, 6.0, line.color);
+    }
+  }
+
+  // --- legend --- //
+  for (size_t s = 0; s < series.size(); s++)
+  {
+    const auto &line = series[s];
+    double swatch_y = y + (legend_heights[s] - small_internal_margin) / 2;
+    canvas.line({{plot_x, swatch_y}, {plot_x + legend_swatch_width, swatch_y}},
+      line.color, line.dashed ? 2.0 : 4.0, line.dashed);
+
+    canvas.text(plot_x + legend_swatch_width + internal_margin, y,
+      legend_label_width, line.label, font_role::SMALL_LABEL);
+    y += legend_heights[s];
+  }
+
+  return canvas.finish();
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <fmt/core.h>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+#include "parameter_sweep.hpp"
+#include "render_context.hpp"
+#include "saturation_diagram.hpp"
+
+using json = nlohmann::json;
+
+// one line in a chart. x values are thread counts.
+struct chart_series {
+  std::string label;
+  std::vector<std::pair<double, double>> points;
+  rgb_color color;
+  // dashed lines are used for ideal scaling
+  bool dashed;
+};
+
+class scaling_chart {
+  public:
+    /* ---- draw scaling charts ----
+     * draws every chart for a sweep index written by fhv::sweep::runSweep.
+     * For each region:
+     *  - <prefix>_<region>_speedup.svg: speedup vs threads, one line per size
+     *    and affinity, plus ideal scaling
+     *  - <prefix>_<region>_efficiency.svg: parallel efficiency vs threads
+     *  - <prefix>_<region>_saturation_<n>.svg: saturation of each memory
+     *    level and FLOP/s type vs threads, one chart per size and affinity,
+     *    numbered in the order of the speedup chart legend
+     *
+     * Charts are drawn with context, so the svg backend can be used. Returns
+     * false if a chart could not be written. The others are still drawn.
+     */
+    static bool draw_scaling_charts(
+      render_context &context,
+      const json &index,
+      std::string output_prefix);
+
+    /* ---- draw line chart ----
+     * draws a line chart with a logarithmic x axis (threads usually double
+     * from one run to the next) and a linear y axis starting at 0. The y axis
+     * goes up to y_max, or further if a value is larger.
+     *
+     * Returns false if the chart could not be written.
+     */
+    static bool draw_line_chart(
+      render_context &context,
+      std::string title,
+      std::string description,
+      std::string x_label,
+      std::string y_label,
+      const std::vector<chart_series> &series,
+      double y_max,
+      std::string output_filename);
+};
+
+// qualitative color scale (ColorBrewer "Dark2") used to tell lines apart
+const std::vector<rgb_color> chartSeriesColors = {
+  rgb_color(27.0/255.0  ,  158.0/255.0  ,  119.0/255.0),
+  rgb_color(217.0/255.0  ,  95.0/255.0  ,  2.0/255.0),
+  rgb_color(117.0/255.0  ,  112.0/255.0  ,  179.0/255.0),
+  rgb_color(231.0/255.0  ,  41.0/255.0  ,  138.0/255.0),
+  rgb_color(102.0/255.0  ,  166.0/255.0  ,  30.0/255.0),
+  rgb_color(230.0/255.0  ,  171.0/255.0  ,  2.0/255.0),
+  rgb_color(166.0/255.0  ,  118.0/255.0  ,  29.0/255.0),
+  rgb_color(102.0/255.0  ,  102.0/255.0  ,  102.0/255.0),
+};
@@ -0,0 +1,662 @@
+#include "svg_canvas.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fmt/core.h>
+#include <fstream>
+
+// ===== text metrics =====
+double svg_text_metrics::pixel_size(font_role font)
+{
+  return font_size(font) * 96.0 / 72.0;
+}
+
+double svg_text_metrics::char_width(char c, double pixel_size)
+{
+  // UTF-8 continuation bytes belong to the character before them
+  if ((c & 0xC0) == 0x80) return 0.0;
+
+  double em;
+  if (c == ' ' || c == '.' || c == ',' || c == ':' || c == ';' || c == '!'
+      || c == '|' || c == '\'')
+    em = 0.318;
+  else if (c == 'i' || c == 'j' || c == 'l' || c == 'I')
+    em = 0.278;
+  else if (c == 'f' || c == 't' || c == 'r' || c == '(' || c == ')'
+      || c == '[' || c == ']' || c == '/' || c == '-')
+    em = 0.38;
+  else if (c == 'm' || c == 'w' || c == 'M' || c == 'W' || c == '%'
+      || c == '@')
+    em = 0.9;
+  else if (c >= '0' && c <= '9')
+    em = 0.636;
+  else if (c >= 'A' && c <= 'Z')
+    em = 0.7;
+  else
+    em = 0.6;
+
+  return em * pixel_size;
+}
+
+double svg_text_metrics::tab_width(double pixel_size)
+{
+  return 8 * char_width(' ', pixel_size);
+}
+
+double svg_text_metrics::text_width(const std::string &text,
+  double pixel_size)
+{
+  double width = 0.0;
+  double tab = tab_width(pixel_size);
+
+  for (const auto &c : text)
+  {
+    if (c == '\t')
+      width = (std::floor(width / tab) + 1) * tab;
+    else
+      width += char_width(c, pixel_size);
+  }
+
+  return width;
+}
+
+double svg_text_metrics::ascent(double pixel_size)
+{
+  return 0.928 * pixel_size;
+}
+
+double svg_text_metrics::line_height(double pixel_size)
+{
+  return 1.164 * pixel_size;
+}
+
+double svg_text_metrics::line_spacing(font_role font)
+{
+  // pango_cairo_make_text_layout uses 0.3 of the font size in points
+  return 0.3 * font_size(font);
+}
+
+std::vector<std::string> svg_text_metrics::wrap_lines(
+  const std::string &text,
+  double width,
+  double pixel_size)
+{
+  std::vector<std::string> lines;
+
+  size_t start = 0;
+  while (true)
+  {
+    size_t end = text.find('\n', start);
+    std::string paragraph = text.substr(start,
+      end == std::string::npos ? std::string::npos : end - start);
+
+    if (width <= 0 || text_width(paragraph, pixel_size) <= width)
+    {
+      lines.push_back(paragraph);
+    }
+    else
+    {
+      std::string line;
+      size_t word_start = 0;
+      while (word_start <= paragraph.size())
+      {
+        size_t word_end = paragraph.find(' ', word_start);
+        if (word_end == std::string::npos) word_end = paragraph.size();
+        std::string word =
+          paragraph.substr(word_start, word_end - word_start);
+
+        std::string candidate = line.empty() ? word : line + " " + word;
+        if (!line.empty() && text_width(candidate, pixel_size) > width)
+        {
+          lines.push_back(line);
+          line = word;
+        }
+        else
+        {
+          line = candidate;
+        }
+
+        word_start = word_end + 1;
+      }
+      lines.push_back(line);
+    }
+
+    if (end == std::string::npos) break;
+    start = end + 1;
+  }
+
+  return lines;
+}
+
+double svg_text_metrics::text_height(
+  const std::string &text,
+  double width,
+  font_role font)
+{
+  double size = pixel_size(font);
+  double num_lines = wrap_lines(text, width, size).size();
+
+  return num_lines * line_height(size)
+    + (num_lines - 1) * line_spacing(font);
+}
+
+// ===== svg canvas =====
+svg_canvas::svg_canvas(
+  const std::string &output_filename,
+  double width,
+  double height)
+  : output_filename(output_filename),
+    num_clip_paths(0),
+    animation(nullptr),
+    finished(false),
+    written(false),
+    width(width),
+    height(height)
+{
+  // same size and units as cairo's SVG surface
+  document = fmt::format(
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"{0:g}pt\" "
+    "height=\"{1:g}pt\" viewBox=\"0 0 {0:g} {1:g}\" version=\"1.1\">\n",
+    width, height);
+}
+
+svg_canvas::svg_canvas(
+  svg_animation &animation,
+  double width,
+  double height)
+  : num_clip_paths(0),
+    animation(&animation),
+    finished(false),
+    written(false),
+    width(width),
+    height(height)
+{
+}
+
+svg_canvas::~svg_canvas()
+{
+  finish();
+}
+
+bool svg_canvas::finish()
+{
+  if (finished) return written;
+  finished = true;
+
+  // the animation reports its own write errors when it is closed
+  if (animation != nullptr)
+  {
+    animation->add_frame(width, height, fills, document);
+    written = animation->good();
+    return written;
+  }
+
+  document += "</svg>\n";
+
+  std::ofstream output(output_filename, std::ios::binary);
+  output << document;
+  output.flush();
+  written = output.good();
+  if (!written)
+    fmt::print(stderr, "ERROR: could not write {}\n", output_filename);
+  return written;
+}
+
+std::string &svg_canvas::fill_target()
+{
+  return animation != nullptr ? fills : document;
+}
+
+std::string svg_canvas::svg_color(const rgb_color &color)
+{
+  auto channel = [](double value) {
+    return static_cast<unsigned>(
+      std::round(std::min(1.0, std::max(0.0, value)) * 255.0));
+  };
+
+  return fmt::format("#{:02x}{:02x}{:02x}", channel(std::get<0>(color)),
+    channel(std::get<1>(color)), channel(std::get<2>(color)));
+}
+
+std::string svg_canvas::xml_escape(const std::string &text)
+{
+  std::string escaped;
+  escaped.reserve(text.size());
+
+  for (const auto &c : text)
+  {
+    if (c == '&') escaped += "&amp;";
+    else if (c == '<') escaped += "&lt;";
+    else if (c == '>') escaped += "&gt;";
+    else if (c == '"') escaped += "&quot;";
+    else escaped += c;
+  }
+
+  return escaped;
+}
+
+double svg_canvas::text(
+  double x,
+  double y,
+  double width,
+  const std::string &text,
+  font_role font,
+  text_alignment alignment,
+  bool vertical)
+{
+  using namespace svg_text_metrics;
+
+  const double size = pixel_size(font);
+  const double tab = tab_width(size);
+  auto lines = wrap_lines(text, width, size);
+
+  if (vertical)
+  {
+    // same as rotating cairo by -90 degrees at the bottom of the text box
+    document += fmt::format(
+      "<g transform=\"translate({:g} {:g}) rotate(-90)\">\n", x, y + width);
+    x = 0;
+    y = 0;
+  }
+
+  document += fmt::format(
+    "<text font-family=\"sans-serif\" font-size=\"{:g}\" "
+    "xml:space=\"preserve\">\n", size);
+
+  double line_y = y;
+  for (const auto &line : lines)
+  {
+    double line_x = x;
+    double line_width = text_width(line, size);
+    if (alignment == text_alignment::CENTER)
+      line_x += (width - line_width) / 2.0;
+    else if (alignment == text_alignment::RIGHT)
+      line_x += width - line_width;
+
+    // SVG has no tab stops, so each tab-separated part gets its own
+    // position
+    double cursor = 0.0;
+    size_t start = 0;
+    while (start <= line.size())
+    {
+      size_t end = line.find('\t', start);
+      std::string part = line.substr(start,
+        end == std::string::npos ? std::string::npos : end - start);
+
+      if (!part.empty())
+        document += fmt::format("<tspan x=\"{:g}\" y=\"{:g}\">{}</tspan>\n",
+          line_x + cursor, line_y + ascent(size), xml_escape(part));
+
+      cursor += text_width(part, size);
+      if (end == std::string::npos) break;
+      cursor = (std::floor(cursor / tab) + 1) * tab;
+      start = end + 1;
+    }
+
+    line_y += line_height(size) + line_spacing(font);
+  }
+
+  document += "</text>\n";
+  if (vertical)
+    document += "</g>\n";
+
+  return text_height(text, width, font);
+}
+
+double svg_canvas::label(
+  double x,
+  double y,
+  double width,
+  const std::string &text,
+  font_role font,
+  text_alignment alignment,
+  bool vertical)
+{
+  return this->text(x, y, width, text, font, alignment, vertical);
+}
+
+void svg_canvas::shape(
+  const polygon_t &points,
+  rgb_color fill_color,
+  rgb_color upper_fill_color,
+  double stroke_width)
+{
+  std::string point_list;
+  double x1 = points[0].first, x2 = x1;
+  double y1 = points[0].second, y2 = y1;
+  for (const auto &point : points)
+  {
+    point_list += fmt::format("{:g},{:g} ", point.first, point.second);
+    x1 = std::min(x1, point.first);
+    x2 = std::max(x2, point.first);
+    y1 = std::min(y1, point.second);
+    y2 = std::max(y2, point.second);
+  }
+
+  fill_target() += fmt::format("<polygon points=\"{}\" fill=\"{}\"/>\n",
+    point_list, svg_color(fill_color));
+
+  if (upper_fill_color != NO_COLOR)
+  {
+    // right half of the bounding box, clipped to the shape. Ids have to be
+    // unique across all frames of an animation.
+    std::string clip_id = animation != nullptr
+      ? fmt::format("frame{}clip{}", animation->num_frames_drawn(),
+        num_clip_paths++)
+      : fmt::format("clip{}", num_clip_paths++);
+    fill_target() += fmt::format(
+      "<clipPath id=\"{}\"><polygon points=\"{}\"/></clipPath>\n"
+      "<rect x=\"{:g}\" y=\"{:g}\" width=\"{:g}\" height=\"{:g}\" "
+      "fill=\"{}\" clip-path=\"url(#{})\"/>\n",
+      clip_id, point_list, (x1 + x2) / 2.0, y1, (x2 - x1) / 2.0, y2 - y1,
+      svg_color(upper_fill_color), clip_id);
+  }
+
+  document += fmt::format("<polygon points=\"{}\" fill=\"none\" "
+    "stroke=\"#000000\" stroke-width=\"{:g}\"/>\n", point_list,
+    stroke_width);
+}
+
+double svg_canvas::component(
+  double x,
+  double y,
+  double width,
+  double height,
+  rgb_color fill_color,
+  const std::string &label,
+  font_role font,
+  label_position position,
+  double stroke_width,
+  rgb_color upper_fill_color)
+{
+  // same padding as saturation_diagram::cairo_draw_component
+  const double PADDING_RATIO_LEFT = 1.0/6.0;
+  const double PADDING_RATIO_BOTTOM = 1.0/3.0;
+
+  auto rectangle = [](double x, double y, double width, double height) {
+    return polygon_t{{x, y}, {x + width, y}, {x + width, y + height},
+      {x, y + height}};
+  };
+
+  double text_height;
+
+  if (position == label_position::LEFT)
+  {
+    text_height = text(x, y, height, label, font, text_alignment::CENTER,
+      true);
+    text_height += text_height * PADDING_RATIO_LEFT;
+
+    shape(rectangle(x + text_height, y, width - text_height, height),
+      fill_color, upper_fill_color, stroke_width);
+
+    return text_height;
+  }
+  else if (position == label_position::BOTTOM)
+  {
+    text_height = svg_text_metrics::text_height(label, width, font);
+    text(x, y + height - text_height, width, label, font,
+      text_alignment::CENTER);
+    text_height += text_height * PADDING_RATIO_BOTTOM;
+
+    shape(rectangle(x, y, width, height - text_height), fill_color,
+      upper_fill_color, stroke_width);
+
+    return text_height;
+  }
+
+  shape(rectangle(x, y, width, height), fill_color, upper_fill_color,
+    stroke_width);
+
+  // text goes on top of the fill
+  if (!label.empty())
+  {
+    text_height = svg_text_metrics::text_height(label, width, font);
+    text(x, y + height/2 - text_height/2, width, label, font,
+      text_alignment::CENTER);
+  }
+
+  return 0;
+}
+
+void svg_canvas::arrow(
+  double x,
+  double y,
+  double width,
+  double height,
+  rgb_color fill_color,
+  direction arrow_direction,
+  const std::string &label,
+  font_role font,
+  double stroke_width,
+  rgb_color upper_fill_color)
+{
+  // same shape as saturation_diagram::cairo_draw_arrow: built pointing down
+  // from the origin, then rotated into place
+  const double arrowhead_width_ratio = 1.5;
+  const double arrowhead_height_ratio = 0.35;
+
+  bool sideways = arrow_direction == direction::LEFT
+    || arrow_direction == direction::RIGHT;
+  double arrow_width = sideways ? height : width;
+  double arrow_height = sideways ? width : height;
+  double arrowhead_width = arrow_width * arrowhead_width_ratio;
+  double ledge = (arrowhead_width - arrow_width) / 2;
+  double shaft_height = arrow_height * (1.0 - arrowhead_height_ratio);
+
+  const polygon_t down = {
+    {0, 0},
+    {arrow_width, 0},
+    {arrow_width, shaft_height},
+    {arrow_width + ledge, shaft_height},
+    {arrow_width / 2.0, arrow_height},
+    {-ledge, shaft_height},
+    {0, shaft_height},
+  };
+
+  polygon_t points;
+  for (const auto &point : down)
+  {
+    double u = point.first, v = point.second;
+    if (arrow_direction == direction::UP)
+      points.push_back({x + width - u, y + height - v});
+    else if (arrow_direction == direction::LEFT)
+      points.push_back({x + width - v, y + u});
+    else if (arrow_direction == direction::RIGHT)
+      points.push_back({x + v, y + height - u});
+    else
+      points.push_back({x + u, y + v});
+  }
+
+  shape(points, fill_color, upper_fill_color, stroke_width);
+
+  double text_height = svg_text_metrics::text_height(label, width, font);
+  text(x, y + height/2 - text_height/2, width, label, font,
+    text_alignment::CENTER);
+}
+
+void svg_canvas::swatch(
+  double x,
+  double y,
+  double width,
+  double height,
+  const std::vector<rgb_color> &colors)
+{
+  double step_size = width / static_cast<double>(colors.size());
+  for (size_t i = 0; i < colors.size(); i++)
+  {
+    document += fmt::format("<rect x=\"{:g}\" y=\"{:g}\" width=\"{:g}\" "
+      "height=\"{:g}\" fill=\"{}\"/>\n", x + i * step_size, y, step_size,
+      height, svg_color(colors[i]));
+  }
+}
+
+void svg_canvas::line(
+  const std::vector<std::pair<double, double>> &points,
+  rgb_color color,
+  double line_width,
+  bool dashed)
+{
+  if (points.empty()) return;
+
+  std::string point_list;
+  for (const auto &point : points)
+    point_list += fmt::format("{:g},{:g} ", point.first, point.second);
+
+  document += fmt::format("<polyline points=\"{}\" fill=\"none\" "
+    "stroke=\"{}\" stroke-width=\"{:g}\"{}/>\n", point_list,
+    svg_color(color), line_width, dashed
+      ? fmt::format(" stroke-dasharray=\"{:g} {:g}\"", dash_length, dash_gap)
+      : "");
+}
+
+void svg_canvas::dot(
+  double x,
+  double y,
+  double radius,
+  rgb_color color)
+{
+  document += fmt::format("<circle cx=\"{:g}\" cy=\"{:g}\" r=\"{:g}\" "
+    "fill=\"{}\"/>\n", x, y, radius, svg_color(color));
+}
+
+// ===== svg animation =====
+svg_animation::svg_animation(
+  const std::string &output_filename,
+  const std::vector<std::string> &frame_labels,
+  double frame_duration,
+  double caption_x,
+  double caption_y)
+  : output_filename(output_filename),
+    output(output_filename, std::ios::binary),
+    frame_labels(frame_labels),
+    frame_duration(frame_duration),
+    caption_x(caption_x),
+    caption_y(caption_y),
+    num_frames(0)
+{
+}
+
+svg_animation::~svg_animation()
+{
+  if (num_frames == 0) return;
+
+  // fewer frames than labels were drawn: the timing and captions written so
+  // far count frames that never came, which would show as a blank stretch
+  // of the loop. Both only get shorter with fewer frames, so they are
+  // rewritten in place and padded with spaces
+  if (num_frames < frame_labels.size())
+  {
+    for (size_t frame = 0; frame < num_frames; frame++)
+    {
+      rewrite(frame_timings[frame], timing(frame, num_frames));
+      rewrite(frame_captions[frame], caption(frame, num_frames));
+    }
+    output.seekp(0, std::ios::end);
+  }
+
+  // outlines and text go on top of the fills of every frame
+  output << overlay << "</svg>\n";
+  output.flush();
+  if (!output.good())
+    fmt::print(stderr, "ERROR: could not write {}\n", output_filename);
+}
+
+bool svg_animation::good() const
+{
+  return output.good();
+}
+
+void svg_animation::add_frame(
+  double width,
+  double height,
+  const std::string &fills,
+  const std::string &overlay)
+{
+  size_t total_frames = std::max(frame_labels.size(), num_frames + 1);
+
+  if (num_frames == 0)
+  {
+    output << fmt::format(
+      "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+      "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"{0:g}pt\" "
+      "height=\"{1:g}pt\" viewBox=\"0 0 {0:g} {1:g}\" version=\"1.1\">\n",
+      width, height);
+    this->overlay = overlay;
+  }
+
+  output << fmt::format("<g visibility=\"{}\">\n",
+    num_frames == 0 ? "visible" : "hidden");
+  frame_timings.push_back(write(timing(num_frames, total_frames)));
+
+  output << fills;
+
+  frame_captions.push_back(write(caption(num_frames, total_frames)));
+  output << "</g>\n";
+
+  num_frames++;
+}
+
+std::string svg_animation::timing(size_t frame, size_t total_frames) const
+{
+  if (total_frames <= 1) return "";
+
+  // each frame is visible from frame / total_frames to
+  // (frame + 1) / total_frames of the loop. Times have a fixed width so
+  // they never grow when the total is lowered
+  std::string values, key_times;
+  if (frame > 0)
+  {
+    values += "hidden;";
+    key_times += fmt::format("0;{:.6f};", static_cast<double>(frame)
+      / total_frames);
+  }
+  else
+  {
+    key_times += "0;";
+  }
+  values += "visible";
+  if (frame + 1 < total_frames)
+  {
+    values += ";hidden";
+    key_times += fmt::format("{:.6f};", static_cast<double>(frame + 1)
+      / total_frames);
+  }
+  key_times.pop_back();
+
+  return fmt::format("<animate attributeName=\"visibility\" "
+    "values=\"{}\" keyTimes=\"{}\" calcMode=\"discrete\" dur=\"{:.3f}s\" "
+    "repeatCount=\"indefinite\"/>\n", values, key_times,
+    frame_duration * total_frames);
+}
+
+std::string svg_animation::caption(size_t frame, size_t total_frames) const
+{
+  std::string caption = fmt::format("{}/{}", frame + 1, total_frames);
+  if (frame < frame_labels.size() && !frame_labels[frame].empty())
+    caption += "  " + frame_labels[frame];
+
+  double size = svg_text_metrics::pixel_size(font_role::DESCRIPTION);
+  return fmt::format("<text x=\"{:g}\" y=\"{:g}\" "
+    "font-family=\"sans-serif\" font-size=\"{:g}\">{}</text>\n",
+    caption_x, caption_y + svg_text_metrics::ascent(size), size,
+    svg_canvas::xml_escape(caption));
+}
+
+svg_animation::written_t svg_animation::write(const std::string &text)
+{
+  written_t written = {
+    .position = output.tellp(),
+    .size = text.size(),
+  };
+  output << text;
+  return written;
+}
+
+void svg_animation::rewrite(const written_t &written, const std::string &text)
+{
+  if (text.size() > written.size) return;
+
+  output.seekp(written.position);
+  output << text << std::string(written.size - text.size(), ' ');
+}
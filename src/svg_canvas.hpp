@@ -0,0 +1,240 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "diagram_canvas.hpp"
+
+// defined below
+class svg_animation;
+
+/* ---- svg canvas ----
+ * writes SVG elements directly instead of going through cairo and pango.
+ * Text is emitted as <text> elements, so it is not measured by a font
+ * library: line breaks and heights come from fixed metrics of a typical
+ * sans-serif font (see svg_text_metrics). Layout matches the cairo backend
+ * closely enough for diagrams, not to the pixel.
+ *
+ * The document is built in memory and written when the canvas is finished.
+ * A canvas made for an svg_animation draws one frame of it instead.
+ */
+class svg_canvas : public diagram_canvas {
+  public:
+    svg_canvas(
+      const std::string &output_filename,
+      double width,
+      double height);
+
+    // draws the next frame of animation instead of writing a file
+    svg_canvas(
+      svg_animation &animation,
+      double width,
+      double height);
+
+    ~svg_canvas();
+
+    bool finish() override;
+
+    double text(
+      double x,
+      double y,
+      double width,
+      const std::string &text,
+      font_role font,
+      text_alignment alignment = text_alignment::LEFT,
+      bool vertical = false) override;
+
+    // nothing to reuse without a layout engine, so this is the same as text
+    double label(
+      double x,
+      double y,
+      double width,
+      const std::string &text,
+      font_role font,
+      text_alignment alignment = text_alignment::LEFT,
+      bool vertical = false) override;
+
+    double component(
+      double x,
+      double y,
+      double width,
+      double height,
+      rgb_color fill_color,
+      const std::string &label,
+      font_role font,
+      label_position position = label_position::INSIDE,
+      double stroke_width = stroke_thickness_normal,
+      rgb_color upper_fill_color = NO_COLOR) override;
+
+    void arrow(
+      double x,
+      double y,
+      double width,
+      double height,
+      rgb_color fill_color,
+      direction arrow_direction,
+      const std::string &label,
+      font_role font,
+      double stroke_width = stroke_thickness_normal,
+      rgb_color upper_fill_color = NO_COLOR) override;
+
+    void swatch(
+      double x,
+      double y,
+      double width,
+      double height,
+      const std::vector<rgb_color> &colors) override;
+
+    void line(
+      const std::vector<std::pair<double, double>> &points,
+      rgb_color color,
+      double line_width,
+      bool dashed = false) override;
+
+    void dot(
+      double x,
+      double y,
+      double radius,
+      rgb_color color) override;
+
+    // "#rrggbb"
+    static std::string svg_color(const rgb_color &color);
+    // escapes characters that are special in XML
+    static std::string xml_escape(const std::string &text);
+
+  private:
+    typedef std::vector<std::pair<double, double>> polygon_t;
+
+    /* ---- shape ----
+     * fills a closed polygon, split in two colors like
+     * saturation_diagram::cairo_fill_split, and strokes it in black
+     */
+    void shape(
+      const polygon_t &points,
+      rgb_color fill_color,
+      rgb_color upper_fill_color,
+      double stroke_width);
+
+    // where fills are drawn: document, or fills for a frame of an animation
+    std::string &fill_target();
+
+    std::string output_filename;
+    std::string document;
+    unsigned num_clip_paths;
+
+    // nullptr unless this canvas draws a frame
+    svg_animation *animation;
+    std::string fills;
+    bool finished;
+    // what finish returned
+    bool written;
+    double width;
+    double height;
+};
+
+/* ---- svg animation ----
+ * a SMIL-animated SVG showing one diagram per frame, each for
+ * frame_duration seconds, looping. Every frame is a group holding only the
+ * fills of that frame; the outlines, text and legend of the first frame are
+ * drawn once, on top of all of them. Diagrams of later frames must therefore
+ * have the same layout as the first one, and only their colors change.
+ *
+ * Frames are written to the file as soon as they are drawn, so long
+ * animations never hold more than one frame in memory. If fewer frames than
+ * labels are drawn, the timing and captions are rewritten for the frames
+ * there are when the animation is closed. Viewers without SMIL show the
+ * first frame.
+ */
+class svg_animation {
+  public:
+    // frame_labels has one caption per frame, drawn at caption_x, caption_y
+    svg_animation(
+      const std::string &output_filename,
+      const std::vector<std::string> &frame_labels,
+      double frame_duration,
+      double caption_x,
+      double caption_y);
+
+    // writes the rest of the file
+    ~svg_animation();
+
+    svg_animation(const svg_animation &) = delete;
+    svg_animation &operator=(const svg_animation &) = delete;
+
+    // false if the file could not be created or written
+    bool good() const;
+
+    size_t num_frames_drawn() const { return num_frames; }
+
+    /* ---- add frame ----
+     * called by svg_canvas when a frame is finished. overlay is everything
+     * that is not a fill, and is only kept for the first frame.
+     */
+    void add_frame(
+      double width,
+      double height,
+      const std::string &fills,
+      const std::string &overlay);
+
+  private:
+    // where a part of a frame that depends on the number of frames went
+    struct written_t {
+      std::streampos position;
+      size_t size;
+    };
+
+    // the <animate> of frame, empty for a single frame
+    std::string timing(size_t frame, size_t total_frames) const;
+    // the caption of frame, "frame/total_frames  label"
+    std::string caption(size_t frame, size_t total_frames) const;
+
+    written_t write(const std::string &text);
+    // overwrites written with text, padded with spaces. Does nothing if text
+    // is longer than what was written.
+    void rewrite(const written_t &written, const std::string &text);
+
+    std::string output_filename;
+    std::ofstream output;
+    std::vector<std::string> frame_labels;
+    double frame_duration;
+    double caption_x;
+    double caption_y;
+
+    size_t num_frames;
+    std::string overlay;
+    std::vector<written_t> frame_timings;
+    std::vector<written_t> frame_captions;
+};
+
+/* ---- svg text metrics ----
+ * estimated size of text in a "Sans" font, in points, at the same 96 dpi
+ * pango uses, so sizes line up with the cairo backend. Widths use the
+ * advance widths of DejaVu Sans (the usual "Sans") for common character
+ * classes.
+ */
+namespace svg_text_metrics {
+  // font size in user units (points at 96 dpi)
+  double pixel_size(font_role font);
+  double char_width(char c, double pixel_size);
+  double text_width(const std::string &text, double pixel_size);
+  // distance from the top of a line to its baseline
+  double ascent(double pixel_size);
+  double line_height(double pixel_size);
+  // extra space between lines, like pango_cairo_make_text_layout's spacing
+  double line_spacing(font_role font);
+  // pango puts tab stops every 8 spaces
+  double tab_width(double pixel_size);
+
+  /* ---- wrap lines ----
+   * splits text at newlines and then at spaces so no line is wider than
+   * width. Words wider than width get a line of their own.
+   */
+  std::vector<std::string> wrap_lines(
+    const std::string &text,
+    double width,
+    double pixel_size);
+
+  // height of text wrapped to width
+  double text_height(const std::string &text, double width, font_role font);
+};
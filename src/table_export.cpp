@@ -0,0 +1,421 @@
+#include "table_export.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fmt/format.h>
+#include <iterator>
+#include <sys/stat.h>
+#include <unordered_set>
+
+#include "binary_results.hpp"
+#include "performance_monitor_defines.hpp"
+#include "result_filter.hpp"
+#include "types.hpp"
+#include "utils.hpp"
+
+// ===== helpers =====
+std::string fhv::table::resultTypeOfName(const std::string &name)
+{
+  bool has_underscore = false;
+  for (char c : name)
+  {
+    if (c == '_')
+      has_underscore = true;
+    else if (!(c >= 'A' && c <= 'Z') && !(c >= '0' && c <= '9') && c != ':')
+      return fhv::types::resultTypeToString(fhv::types::result_t::metric);
+  }
+
+  return fhv::types::resultTypeToString(has_underscore
+    ? fhv::types::result_t::event : fhv::types::result_t::metric);
+}
+
+std::string fhv::table::runIdOfFilename(const std::string &filename)
+{
+  size_t slash = filename.find_last_of('/');
+  std::string base = slash == std::string::npos ? filename
+    : filename.substr(slash + 1);
+  size_t dot = base.find_last_of('.');
+  return dot == std::string::npos || dot == 0 ? base : base.substr(0, dot);
+}
+
+// appends field to a CSV line, quoted if it has to be
+static void appendCsvField(std::string &line, const std::string &field)
+{
+  if (field.find_first_of(",\"\n\r") == std::string::npos) {
+    line += field;
+    return;
+  }
+
+  line += '"';
+  for (char c : field)
+  {
+    if (c == '"') line += '"';
+    line += c;
+  }
+  line += '"';
+}
+
+void fhv::table::CategoryColumn::add(const std::string &value)
+{
+  auto found = category_codes.find(value);
+  if (found == category_codes.end())
+  {
+    found = category_codes.emplace(value,
+      static_cast<int32_t>(categories.size())).first;
+    categories.push_back(value);
+  }
+
+  codes.push_back(found->second);
+}
+
+// ===== npy =====
+/* writes the header of a NumPy .npy file (format version 1.0) for a one
+ * dimensional array of num_values values of descr, e.g. "<i4"
+ */
+static void writeNpyHeader(FILE *file, const std::string &descr,
+  size_t num_values)
+{
+  std::string header = fmt::format("{{'descr': '{}', 'fortran_order': False, "
+    "'shape': ({},), }}", descr, num_values);
+
+  // magic, version and header length take 10 bytes. The data has to start
+  // at a multiple of 64, and the header ends with a newline
+  size_t total = 10 + header.size() + 1;
+  header.append((64 - total % 64) % 64, ' ');
+  header += '\n';
+
+  const char magic[] = {'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0};
+  uint16_t header_size = static_cast<uint16_t>(header.size());
+  std::fwrite(magic, 1, sizeof(magic), file);
+  std::fwrite(&header_size, sizeof(header_size), 1, file);
+  std::fwrite(header.data(), 1, header.size(), file);
+}
+
+template<typename T>
+static bool writeNpy(const std::string &filename, const std::string &descr,
+  const std::vector<T> &values)
+{
+  FILE *file = std::fopen(filename.c_str(), "wb");
+  if (file == nullptr) return false;
+
+  writeNpyHeader(file, descr, values.size());
+  std::fwrite(values.data(), sizeof(T), values.size(), file);
+  return std::fclose(file) == 0;
+}
+
+// UTF-8 to the UTF-32 code points of numpy's unicode strings. Invalid bytes
+// are kept as they are.
+static std::vector<uint32_t> codePoints(const std::string &text)
+{
+  std::vector<uint32_t> points;
+  for (size_t i = 0; i < text.size();)
+  {
+    unsigned char c = static_cast<unsigned char>(text[i]);
+    size_t length = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xe ? 3
+      : (c >> 3) == 0x1e ? 4 : 0;
+    if (length == 0 || i + length > text.size()) {
+      points.push_back(c);
+      i++;
+      continue;
+    }
+
+    uint32_t point = length == 1 ? c : c & (0x7f >> length);
+    for (size_t k = 1; k < length; k++)
+      point = (point << 6) | (static_cast<unsigned char>(text[i + k]) & 0x3f);
+    points.push_back(point);
+    i += length;
+  }
+
+  return points;
+}
+
+// writes strings as a fixed width unicode array ("<U<width>")
+static bool writeNpyStrings(const std::string &filename,
+  const std::vector<std::string> &strings)
+{
+  std::vector<std::vector<uint32_t>> points;
+  size_t width = 1;
+  for (const auto &text : strings)
+  {
+    points.push_back(codePoints(text));
+    width = std::max(width, points.back().size());
+  }
+
+  std::vector<uint32_t> values(width * strings.size(), 0);
+  for (size_t i = 0; i < points.size(); i++)
+    std::copy(points[i].begin(), points[i].end(), values.begin() + i * width);
+
+  FILE *file = std::fopen(filename.c_str(), "wb");
+  if (file == nullptr) return false;
+
+  writeNpyHeader(file, fmt::format("<U{}", width), strings.size());
+  std::fwrite(values.data(), sizeof(uint32_t), values.size(), file);
+  return std::fclose(file) == 0;
+}
+
+// ===== TableWriter =====
+fhv::table::TableWriter::TableWriter()
+  : csv_file(nullptr), csv_ok(true), num_rows(0)
+{
+}
+
+fhv::table::TableWriter::~TableWriter()
+{
+  if (csv_file != nullptr) std::fclose(csv_file);
+}
+
+bool fhv::table::TableWriter::open(
+  const std::string &csv_filename,
+  const std::string &columns_directory)
+{
+  this->csv_filename = csv_filename;
+  this->columns_directory = columns_directory;
+
+  if (!csv_filename.empty())
+  {
+    fhv::utils::create_directories_for_file(csv_filename);
+    csv_file = std::fopen(csv_filename.c_str(), "w");
+    if (csv_file == nullptr) {
+      fmt::print(stderr, "ERROR: could not create '{}'\n", csv_filename);
+      return false;
+    }
+
+    csv_buffer.reserve(csv_buffer_size + 1024);
+    for (size_t c = 0; c < table_columns.size(); c++)
+      csv_buffer += (c > 0 ? "," : "") + table_columns[c];
+    csv_buffer += '\n';
+  }
+
+  return true;
+}
+
+void fhv::table::TableWriter::addRow(
+  const std::string &run_id,
+  const std::string &region,
+  int32_t thread_num,
+  const std::string &group,
+  const std::string &type,
+  const std::string &metric,
+  const std::string &aggregation,
+  double value)
+{
+  num_rows++;
+
+  if (csv_file != nullptr)
+  {
+    appendCsvField(csv_buffer, run_id);
+    csv_buffer += ',';
+    appendCsvField(csv_buffer, region);
+    csv_buffer += ',';
+    if (thread_num >= 0)
+      fmt::format_to(std::back_inserter(csv_buffer), "{}", thread_num);
+    csv_buffer += ',';
+    appendCsvField(csv_buffer, group);
+    csv_buffer += ',';
+    appendCsvField(csv_buffer, type);
+    csv_buffer += ',';
+    appendCsvField(csv_buffer, metric);
+    csv_buffer += ',';
+    appendCsvField(csv_buffer, aggregation);
+    fmt::format_to(std::back_inserter(csv_buffer), ",{}\n", value);
+
+    if (csv_buffer.size() >= csv_buffer_size)
+    {
+      csv_ok = std::fwrite(csv_buffer.data(), 1, csv_buffer.size(), csv_file)
+        == csv_buffer.size() && csv_ok;
+      csv_buffer.clear();
+    }
+  }
+
+  if (!columns_directory.empty())
+  {
+    run_ids.add(run_id);
+    regions.add(region);
+    threads.push_back(thread_num);
+    groups.add(group);
+    types.add(type);
+    metrics.add(metric);
+    aggregations.add(aggregation);
+    values.push_back(value);
+  }
+}
+
+bool fhv::table::TableWriter::addResults(
+  const std::string &run_id,
+  const std::string &filename,
+  size_t &num_skipped)
+{
+  num_skipped = 0;
+
+  if (!fhv::binary::isBinaryResults(filename))
+  {
+    json results;
+    if (!fhv::binary::loadResults(filename, results)) return false;
+    addJsonResults(run_id, results, num_skipped);
+    return true;
+  }
+
+  // binary files know the group and type of every result, so their columns
+  // are read directly instead of through json
+  fhv::binary::MappedResults mapped;
+  if (!mapped.open(filename)) return false;
+
+  std::vector<std::string> strings(mapped.numStrings());
+  for (size_t i = 0; i < strings.size(); i++)
+    strings[i] = mapped.string(static_cast<uint32_t>(i));
+
+  const auto *region_column = mapped.regions();
+  const auto *thread_column = mapped.threads();
+  const auto *aggregation_column = mapped.aggregations();
+  const auto *group_column = mapped.groups();
+  const auto *type_column = mapped.resultTypes();
+  const auto *name_column = mapped.resultNames();
+  const auto *value_column = mapped.values();
+
+  const std::string no_aggregation;
+  for (size_t row = 0; row < mapped.numRows(); row++)
+  {
+    if (region_column[row] >= strings.size()
+        || group_column[row] >= strings.size()
+        || name_column[row] >= strings.size()) {
+      num_skipped++;
+      continue;
+    }
+
+    std::string aggregation = aggregation_column[row]
+        == fhv::binary::no_aggregation ? no_aggregation
+      : fhv::types::aggregationTypeToString(
+        static_cast<fhv::types::aggregation_t>(aggregation_column[row]));
+    addRow(run_id, strings[region_column[row]], thread_column[row],
+      strings[group_column[row]], fhv::types::resultTypeToString(
+        static_cast<fhv::types::result_t>(type_column[row])),
+      strings[name_column[row]], aggregation, value_column[row]);
+  }
+
+  return true;
+}
+
+void fhv::table::TableWriter::addJsonResults(
+  const std::string &run_id,
+  const json &results,
+  size_t &num_skipped)
+{
+  if (!results.contains(json_results_section)) return;
+
+  std::unordered_set<std::string> aggregations;
+  for (const auto &aggregation : {fhv::types::aggregation_t::sum,
+      fhv::types::aggregation_t::arithmetic_mean,
+      fhv::types::aggregation_t::geometric_mean,
+      fhv::types::aggregation_t::saturation})
+    aggregations.insert(fhv::types::aggregationTypeToString(aggregation));
+
+  // names repeat in every section, so their types are only worked out once
+  std::unordered_map<std::string, std::string> result_types;
+
+  for (const auto &region : results[json_results_section].items())
+  {
+    for (const auto &section : region.value().items())
+    {
+      int32_t thread_num = fhv::binary::no_thread;
+      std::string aggregation;
+
+      if (aggregations.count(section.key()))
+      {
+        aggregation = section.key();
+      }
+      else if (section.key().compare(0, json_thread_section_base.size(),
+          json_thread_section_base) == 0)
+      {
+        try {
+          thread_num = std::stoi(
+            section.key().substr(json_thread_section_base.size()));
+        }
+        catch (std::exception &e) {
+          num_skipped++;
+          continue;
+        }
+      }
+      else
+      {
+        num_skipped++;
+        continue;
+      }
+
+      std::string group, name;
+      for (const auto &result : section.value().items())
+      {
+        if (!result.value().is_number()) continue;
+
+        fhv::filter::splitJsonResultName(result.key(), group, name);
+
+        auto type = result_types.find(name);
+        if (type == result_types.end())
+          type = result_types.emplace(name, resultTypeOfName(name)).first;
+
+        addRow(run_id, region.key(), thread_num, group, type->second, name,
+          aggregation, result.value().get<double>());
+      }
+    }
+  }
+}
+
+bool fhv::table::TableWriter::writeColumns()
+{
+  fhv::utils::create_directories_for_file(columns_directory + "/"
+    + table_columns[0]);
+  struct stat directory_stat;
+  if (stat(columns_directory.c_str(), &directory_stat) != 0
+      || !S_ISDIR(directory_stat.st_mode)) {
+    fmt::print(stderr, "ERROR: could not create the directory '{}': {}\n",
+      columns_directory, std::strerror(errno));
+    return false;
+  }
+
+  auto path = [&](const std::string &column) {
+    return columns_directory + "/" + column + ".npy";
+  };
+
+  const std::vector<std::pair<std::string, const CategoryColumn *>>
+    category_columns = {
+      {table_columns[0], &run_ids},
+      {table_columns[1], &regions},
+      {table_columns[3], &groups},
+      {table_columns[4], &types},
+      {table_columns[5], &metrics},
+      {table_columns[6], &aggregations},
+    };
+
+  bool ok = writeNpy(path(table_columns[2]), "<i4", threads)
+    && writeNpy(path(table_columns[7]), "<f8", values);
+  for (const auto &column : category_columns)
+    ok = ok && writeNpy(path(column.first), "<i4", column.second->codes)
+      && writeNpyStrings(path(column.first + table_categories_suffix),
+        column.second->categories);
+
+  if (!ok)
+    fmt::print(stderr, "ERROR: could not write the columns to '{}'\n",
+      columns_directory);
+  return ok;
+}
+
+bool fhv::table::TableWriter::finish()
+{
+  bool ok = true;
+  if (csv_file != nullptr)
+  {
+    csv_ok = std::fwrite(csv_buffer.data(), 1, csv_buffer.size(), csv_file)
+      == csv_buffer.size() && csv_ok;
+    csv_buffer.clear();
+    csv_ok = std::fclose(csv_file) == 0 && csv_ok;
+    csv_file = nullptr;
+
+    if (!csv_ok)
+      fmt::print(stderr, "ERROR: could not write '{}'\n", csv_filename);
+    ok = csv_ok;
+  }
+
+  if (!columns_directory.empty()) ok = writeColumns() && ok;
+
+  return ok;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using json = nlohmann::json;
+
+/* ---- table export ----
+ * flattens results into one tidy table with a row per value:
+ *
+ *   run_id, region, thread, group, type, metric, aggregation, value
+ *
+ * thread is empty (-1 in columns) for aggregates and aggregation is empty
+ * for per-thread results. The table is written as CSV and/or as a directory
+ * of typed NumPy columns (.npy), which numpy and pandas load without parsing
+ * anything. String columns are stored as int32 codes into a
+ * "<column>_categories.npy" array of names, like a pandas Categorical.
+ *
+ * Rows are written as they are added: CSV text goes through a buffer that
+ * is flushed in large blocks, and columns grow in memory until finish().
+ */
+namespace fhv {
+  namespace table {
+    const std::vector<std::string> table_columns = {"run_id", "region",
+      "thread", "group", "type", "metric", "aggregation", "value"};
+    const std::string table_csv_extension = ".csv";
+    const std::string table_categories_suffix = "_categories";
+    // CSV text buffered before it is written
+    const size_t csv_buffer_size = 1 << 20;
+
+    // a string column, dictionary encoded
+    struct CategoryColumn {
+      std::vector<int32_t> codes;
+      std::vector<std::string> categories;
+      std::unordered_map<std::string, int32_t> category_codes;
+
+      void add(const std::string &value);
+    };
+
+    class TableWriter {
+      public:
+        TableWriter();
+        ~TableWriter();
+
+        TableWriter(const TableWriter &) = delete;
+        TableWriter &operator=(const TableWriter &) = delete;
+
+        // opens csv_filename and/or remembers columns_directory. Either may
+        // be empty. Prints an error and returns false if the CSV can't be
+        // created.
+        bool open(const std::string &csv_filename,
+          const std::string &columns_directory);
+
+        void addRow(
+          const std::string &run_id,
+          const std::string &region,
+          int32_t thread_num,
+          const std::string &group,
+          const std::string &type,
+          const std::string &metric,
+          const std::string &aggregation,
+          double value);
+
+        /* ---- add results ----
+         * every row of a results file: json, binary (which also knows the
+         * group and type of each result) or result stream. Sections that
+         * are neither a thread nor an aggregation are counted in
+         * num_skipped. Returns false if the file can't be loaded.
+         */
+        bool addResults(const std::string &run_id,
+          const std::string &filename, size_t &num_skipped);
+
+        // flushes the CSV and writes the columns. Returns false on errors.
+        bool finish();
+
+        size_t numRows() const { return num_rows; }
+
+      private:
+        void addJsonResults(const std::string &run_id, const json &results,
+          size_t &num_skipped);
+        bool writeColumns();
+
+        FILE *csv_file;
+        std::string csv_filename;
+        std::string csv_buffer;
+        bool csv_ok;
+
+        std::string columns_directory;
+        CategoryColumn run_ids, regions, groups, types, metrics, aggregations;
+        std::vector<int32_t> threads;
+        std::vector<double> values;
+
+        size_t num_rows;
+    };
+
+    /* ---- result type of name ----
+     * jsons don't say whether a result is an event or a metric. likwid event
+     * names are upper case identifiers with underscores (INSTR_RETIRED_ANY),
+     * metric names are not (CPI, "Runtime (RDTSC) [s]").
+     */
+    std::string resultTypeOfName(const std::string &name);
+
+    // base name of filename without its extension, used as its run id
+    std::string runIdOfFilename(const std::string &filename);
+  };
+};
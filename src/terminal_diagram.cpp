@@ -0,0 +1,384 @@
+#include "terminal_diagram.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fmt/core.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+// ===== terminal colors =====
+std::string terminalColorsToString(const terminal_colors &colors)
+{
+  if (colors == terminal_colors::truecolor)
+    return "truecolor";
+  else if (colors == terminal_colors::xterm256)
+    return "256";
+  else
+    return "unknown_terminal_colors";
+}
+
+bool terminalColorsFromString(const std::string &name,
+  terminal_colors &colors)
+{
+  for (const auto &candidate :
+      {terminal_colors::truecolor, terminal_colors::xterm256})
+  {
+    if (terminalColorsToString(candidate) == name)
+    {
+      colors = candidate;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+terminal_colors terminal_diagram::detect_colors()
+{
+  const char *colorterm = std::getenv("COLORTERM");
+  if (colorterm != nullptr)
+  {
+    std::string value(colorterm);
+    if (value == "truecolor" || value == "24bit")
+      return terminal_colors::truecolor;
+  }
+
+  return terminal_colors::xterm256;
+}
+
+unsigned terminal_diagram::terminal_width()
+{
+  struct winsize size;
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0)
+    return size.ws_col;
+
+  const char *columns = std::getenv("COLUMNS");
+  if (columns != nullptr)
+  {
+    try {
+      int value = std::stoi(columns);
+      if (value > 0) return static_cast<unsigned>(value);
+    }
+    catch (std::exception &e) {}
+  }
+
+  return 80;
+}
+
+// ===== escapes =====
+static int channel_255(double value)
+{
+  return static_cast<int>(std::round(std::min(std::max(value, 0.0), 1.0)
+    * 255.0));
+}
+
+unsigned terminal_diagram::xterm256_index(const rgb_color &color)
+{
+  const int cube_levels[] = {0, 95, 135, 175, 215, 255};
+  auto cube_step = [](int value) {
+    if (value < 48) return 0;
+    if (value < 115) return 1;
+    return (value - 35) / 40;
+  };
+
+  int r = channel_255(std::get<0>(color));
+  int g = channel_255(std::get<1>(color));
+  int b = channel_255(std::get<2>(color));
+
+  int cube_r = cube_step(r), cube_g = cube_step(g), cube_b = cube_step(b);
+  auto distance = [&](int x, int y, int z) {
+    return (x - r) * (x - r) + (y - g) * (y - g) + (z - b) * (z - b);
+  };
+  int cube_distance = distance(cube_levels[cube_r], cube_levels[cube_g],
+    cube_levels[cube_b]);
+
+  // the 24 grays from 8 to 238 are finer than the cube's grays
+  int average = (r + g + b) / 3;
+  int gray_step = average > 238 ? 23 : std::max(0, (average - 3) / 10);
+  int gray = 8 + 10 * gray_step;
+  int gray_distance = distance(gray, gray, gray);
+
+  if (gray_distance < cube_distance)
+    return 232 + gray_step;
+  return 16 + 36 * cube_r + 6 * cube_g + cube_b;
+}
+
+std::string terminal_diagram::color_escape(const rgb_color &color,
+  terminal_colors colors)
+{
+  double luminance = 0.299 * std::get<0>(color) + 0.587 * std::get<1>(color)
+    + 0.114 * std::get<2>(color);
+  std::string foreground = luminance > 0.5 ? "\x1b[30m" : "\x1b[97m";
+
+  if (colors == terminal_colors::truecolor)
+    return fmt::format("\x1b[48;2;{};{};{}m", channel_255(std::get<0>(color)),
+      channel_255(std::get<1>(color)), channel_255(std::get<2>(color)))
+      + foreground;
+
+  return fmt::format("\x1b[48;5;{}m", xterm256_index(color)) + foreground;
+}
+
+static const std::string reset_escape = "\x1b[0m";
+static const std::string bold_escape = "\x1b[1m";
+
+// ===== layout helpers =====
+size_t terminal_diagram::display_width(const std::string &text)
+{
+  // count every byte that doesn't continue a multi-byte character
+  return std::count_if(text.begin(), text.end(),
+    [](char c) { return (static_cast<unsigned char>(c) & 0xC0) != 0x80; });
+}
+
+// text centered in width columns, cut short if it doesn't fit
+static std::string center(const std::string &text, size_t width)
+{
+  std::string fitted = text;
+  while (terminal_diagram::display_width(fitted) > width)
+  {
+    // drop the last character, including its continuation bytes
+    size_t end = fitted.size() - 1;
+    while (end > 0 && (static_cast<unsigned char>(fitted[end]) & 0xC0) == 0x80)
+      end--;
+    fitted.erase(end);
+  }
+
+  size_t padding = width - terminal_diagram::display_width(fitted);
+  return std::string(padding / 2, ' ') + fitted
+    + std::string(padding - padding / 2, ' ');
+}
+
+static std::string repeat(const std::string &text, size_t count)
+{
+  std::string repeated;
+  for (size_t i = 0; i < count; i++) repeated += text;
+  return repeated;
+}
+
+// centered text on a colored background
+static std::string colored_cell(const std::string &text, size_t width,
+  const rgb_color &color, terminal_colors colors)
+{
+  return terminal_diagram::color_escape(color, colors) + center(text, width)
+    + reset_escape;
+}
+
+// "942 MB/s", "2.00 GB/s", ... (3 significant digits) from a value in
+// mega-units
+static std::string format_rate(double mega_value, const std::string &unit)
+{
+  std::string prefix = "M";
+  if (mega_value >= 1e6) {
+    mega_value /= 1e6;
+    prefix = "T";
+  }
+  else if (mega_value >= 1e3) {
+    mega_value /= 1e3;
+    prefix = "G";
+  }
+
+  int decimals = mega_value < 10 ? 2 : mega_value < 100 ? 1 : 0;
+  return fmt::format("{:.{}f} {}{}", mega_value, decimals, prefix, unit);
+}
+
+// ===== render =====
+std::string terminal_diagram::render(
+  const json &fhv_data,
+  const std::string &region_name,
+  const std::vector<rgb_color> &color_lut,
+  terminal_colors colors,
+  unsigned width)
+{
+  return render(fhv_data.value(json_info_section, json::object()),
+    fhv_data.at(json_results_section).at(region_name), region_name,
+    color_lut, colors, width);
+}
+
+std::string terminal_diagram::render(
+  const json &info,
+  const json &region_data,
+  const std::string &region_name,
+  const std::vector<rgb_color> &color_lut,
+  terminal_colors colors,
+  unsigned width)
+{
+  // narrower than this and the arrows overlap
+  width = std::max(width, 50u);
+  const size_t inner_width = width - 2;
+
+  const std::string saturation_section = fhv::types::aggregationTypeToString(
+    fhv::types::aggregation_t::saturation);
+  const std::string geometric_mean_section =
+    fhv::types::aggregationTypeToString(
+      fhv::types::aggregation_t::geometric_mean);
+  const std::string sum_section = fhv::types::aggregationTypeToString(
+    fhv::types::aggregation_t::sum);
+
+  auto value = [&](const std::string &section, const std::string &metric,
+      double &result) {
+    auto section_data = region_data.find(section);
+    if (section_data == region_data.end()) return false;
+    auto metric_data = section_data->find(metric);
+    if (metric_data == section_data->end() || !metric_data->is_number())
+      return false;
+    result = metric_data->get<double>();
+    return true;
+  };
+
+  // same colors as the diagram: white when the value wasn't measured
+  auto color_of = [&](const std::string &section, const std::string &metric) {
+    double saturation;
+    if (color_lut.size() != 9 || !value(section, metric, saturation))
+      return WHITE;
+    return saturation_diagram::calculate_single_color(saturation, color_lut);
+  };
+
+  // "<name>  <saturation>  <rate>" with whatever was measured
+  auto describe = [&](const std::string &name,
+      const std::string &saturation_metric, const std::string &rate_metric,
+      const std::string &unit) {
+    std::string text = name;
+    double saturation, rate;
+    if (value(saturation_section, saturation_metric, saturation))
+      text += fmt::format("  {:.2f}", saturation);
+    if (!rate_metric.empty() && value(sum_section, rate_metric, rate))
+      text += "  " + format_rate(rate, unit);
+    return text;
+  };
+
+  auto box = [&](const std::string &text, const rgb_color &color) {
+    return "┌" + repeat("─", inner_width) + "┐\n"
+      + "│" + colored_cell(text, inner_width, color, colors) + "│\n"
+      + "└" + repeat("─", inner_width) + "┘\n";
+  };
+
+  // load and store arrows at the same places as in the diagram: starting
+  // at 1/5 and 3/5 of the width, each 1/5 wide unless that's too narrow for
+  // the label
+  auto arrows = [&](const std::string &load_saturation,
+      const std::string &load_rate, const std::string &store_saturation,
+      const std::string &store_rate) {
+    size_t arrow_width = std::max(width / 5, 18u);
+    double rate;
+    std::string load_text = "▼ load", store_text = "▲ store";
+    if (value(sum_section, load_rate, rate))
+      load_text += " " + format_rate(rate, "B/s");
+    if (value(sum_section, store_rate, rate))
+      store_text += " " + format_rate(rate, "B/s");
+
+    return std::string(width / 5, ' ')
+      + colored_cell(load_text, arrow_width,
+        color_of(saturation_section, load_saturation), colors)
+      + std::string(3 * width / 5 - width / 5 - arrow_width, ' ')
+      + colored_cell(store_text, arrow_width,
+        color_of(saturation_section, store_saturation), colors)
+      + "\n";
+  };
+
+  std::string output;
+
+  // --- title and description --- //
+  output += bold_escape + fmt::format("Saturation diagram for region \"{}\"",
+    region_name) + reset_escape + "\n";
+
+  if (info.is_object())
+  {
+    std::string parameters = info.value(json_parameter_key, "");
+    if (!parameters.empty()) output += parameters + "\n";
+
+    if (info.contains(json_processor_section))
+    {
+      const json &processor = info[json_processor_section];
+      output += fmt::format("{}, {} of {} hardware threads in use\n",
+        processor.value(json_processor_name_key, "unknown processor"),
+        processor.value(json_processor_num_threads_in_use_key, 0),
+        processor.value(json_processor_num_hw_threads_key, 0));
+    }
+  }
+
+  // --- legend: each bin with the lowest saturation it holds --- //
+  if (color_lut.size() == 9)
+  {
+    output += "Saturation ";
+    for (size_t i = 0; i < color_lut.size(); i++)
+    {
+      double lowest = i == 0 ? 0.0
+        : std::pow(2.0, 7.0 * static_cast<double>(i) / 9.0 - 7.0);
+      output += colored_cell(fmt::format("{:.2g}", lowest), 6, color_lut[i],
+        colors);
+    }
+    output += "\n";
+  }
+  output += "\n";
+
+  // --- memory hierarchy --- //
+  output += box(describe("RAM", fhv_mem_rw_saturation_metric_name,
+      ram_bandwidth_metric_name, "B/s"),
+    color_of(saturation_section, fhv_mem_rw_saturation_metric_name));
+  output += arrows(fhv_mem_r_saturation_metric_name, ram_load_bandwidth_name,
+    fhv_mem_w_saturation_metric_name, ram_evict_bandwidth_name);
+
+  output += box(describe("L3 Cache", fhv_l3_rw_saturation_metric_name,
+      l3_bandwidth_metric_name, "B/s"),
+    color_of(saturation_section, fhv_l3_rw_saturation_metric_name));
+  output += arrows(fhv_l3_r_saturation_metric_name, l3_load_bandwidth_name,
+    fhv_l3_w_saturation_metric_name, l3_evict_bandwidth_name);
+
+  output += box(describe("L2 Cache", fhv_l2_rw_saturation_metric_name,
+      l2_bandwidth_metric_name, "B/s"),
+    color_of(saturation_section, fhv_l2_rw_saturation_metric_name));
+  output += arrows(fhv_l2_r_saturation_metric_name, l2_load_bandwidth_name,
+    fhv_l2_w_saturation_metric_name, l2_evict_bandwidth_name);
+
+  output += box("L1 Cache (not measured)", WHITE);
+
+  // --- core --- //
+  std::string core_title = "─ In-core performance ";
+  output += "┌" + core_title
+    + repeat("─", inner_width - display_width(core_title)) + "┐\n";
+
+  size_t sp_width = inner_width / 2;
+  output += "│"
+    + colored_cell(describe("SP FLOP/s", fhv_flops_sp_saturation_metric_name,
+        mflops_sp_metric_name, "FLOP/s"), sp_width,
+      color_of(saturation_section, fhv_flops_sp_saturation_metric_name),
+      colors)
+    + colored_cell(describe("DP FLOP/s", fhv_flops_dp_saturation_metric_name,
+        mflops_dp_metric_name, "FLOP/s"), inner_width - sp_width,
+      color_of(saturation_section, fhv_flops_dp_saturation_metric_name),
+      colors)
+    + "│\n";
+
+  // ports measured for this region, in order
+  std::vector<std::pair<unsigned, double>> ports;
+  for (unsigned port_num = 0; port_num < fhv_port_usage_metrics.size();
+      port_num++)
+  {
+    double usage;
+    if (value(geometric_mean_section, fhv_port_usage_metrics[port_num], usage))
+      ports.push_back({port_num, usage});
+  }
+
+  if (!ports.empty())
+  {
+    output += "│";
+    size_t port_width = inner_width / ports.size();
+    for (size_t i = 0; i < ports.size(); i++)
+    {
+      // the last port takes up the columns left over by rounding
+      size_t this_width = i + 1 == ports.size()
+        ? inner_width - port_width * (ports.size() - 1) : port_width;
+      rgb_color color = color_lut.size() == 9
+        ? saturation_diagram::calculate_single_color(ports[i].second,
+          color_lut)
+        : WHITE;
+      output += colored_cell(fmt::format("P{} {:.2f}", ports[i].first,
+        ports[i].second), this_width, color, colors);
+    }
+    output += "│\n";
+  }
+
+  output += "└" + repeat("─", inner_width) + "┘\n";
+
+  return output;
+}
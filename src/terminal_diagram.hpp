@@ -0,0 +1,69 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+#include "saturation_diagram.hpp"
+
+using json = nlohmann::json;
+
+/* ---- terminal colors ----
+ * how colors are written to the terminal:
+ *  - truecolor: 24-bit colors, exactly the colors of the color scale
+ *  - xterm256: the closest of the 256 xterm colors, for terminals (and tmux
+ *    or screen sessions) without 24-bit color
+ */
+enum class terminal_colors {
+  truecolor, xterm256
+};
+
+std::string terminalColorsToString(const terminal_colors &colors);
+// returns false if name is not "truecolor" or "256"
+bool terminalColorsFromString(const std::string &name,
+  terminal_colors &colors);
+
+class terminal_diagram {
+  public:
+    /* ---- render ----
+     * the same RAM -> L3 -> L2 -> L1 -> core layout as
+     * saturation_diagram::draw_diagram_overview, drawn with Unicode box
+     * characters and ANSI background colors from color_lut, width columns
+     * wide. Each component also shows its bandwidth or FLOP rate. Ports are
+     * the ones found in the region's results.
+     */
+    static std::string render(
+      const json &fhv_data,
+      const std::string &region_name,
+      const std::vector<rgb_color> &color_lut,
+      terminal_colors colors,
+      unsigned width);
+
+    // same as above for the info section and region_results[region_name]
+    // of a json, e.g. from fhv::summary
+    static std::string render(
+      const json &info,
+      const json &region_data,
+      const std::string &region_name,
+      const std::vector<rgb_color> &color_lut,
+      terminal_colors colors,
+      unsigned width);
+
+    // truecolor if $COLORTERM says the terminal supports it, xterm256
+    // otherwise
+    static terminal_colors detect_colors();
+
+    // columns of the terminal on stdout, or of $COLUMNS, or 80
+    static unsigned terminal_width();
+
+    // ANSI escape sequence that sets the background to color and the text to
+    // black or white, whichever is easier to read on it
+    static std::string color_escape(const rgb_color &color,
+      terminal_colors colors);
+
+    // closest color of the 6x6x6 cube and gray ramp of xterm's 256 colors
+    static unsigned xterm256_index(const rgb_color &color);
+
+    // columns taken by UTF-8 text, assuming one per code point
+    static size_t display_width(const std::string &text);
+};
@@ -0,0 +1,259 @@
+#include "trend_chart.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+bool trend_chart::draw_trend_charts(
+  render_context &context,
+  const std::vector<fhv::history::HistoryRun> &runs,
+  const fhv::history::trend_series_t &series,
+  std::string output_prefix)
+{
+  bool all_written = true;
+  unsigned chart_num = 0;
+
+  // series are sorted by region and setup, so each chart is a run of series
+  size_t first = 0;
+  while (first < series.size())
+  {
+    std::vector<const fhv::history::TrendSeries *> chart_series;
+    size_t last = first;
+    while (last < series.size()
+        && series[last].region_name == series[first].region_name
+        && series[last].host == series[first].host
+        && series[last].cpu == series[first].cpu
+        && series[last].parameters == series[first].parameters)
+      chart_series.push_back(&series[last++]);
+
+    if (first > 0 && series[first].region_name
+          != series[first - 1].region_name)
+      chart_num = 0;
+
+    std::string output_filename = fmt::format("{}_{}_trend_{}.svg",
+      output_prefix, series[first].region_name, chart_num);
+    if (draw_trend_chart(context,
+        fmt::format("Trend of \"{}\"", series[first].region_name),
+        fmt::format("Measured on {}. Runs are shown in the order they were "
+          "added to the history. Dashed lines mark step changes.",
+          series[first].setupLabel()),
+        runs, chart_series, output_filename))
+      std::cout << "Trend chart saved to " << output_filename << std::endl;
+    else
+      all_written = false;
+
+    chart_num++;
+    first = last;
+  }
+
+  return all_written;
+}
+
+bool trend_chart::draw_trend_chart(
+  render_context &context,
+  std::string title,
+  std::string description,
+  const std::vector<fhv::history::HistoryRun> &runs,
+  const std::vector<const fhv::history::TrendSeries *> &series,
+  std::string output_filename)
+{
+  /* ----- drawing constants ----- */
+  const diagram_geometry &geometry = context.geometry;
+  const double image_width = geometry.image_width;
+  const double margin_x = geometry.margin_x;
+  const double margin_y = geometry.margin_y;
+  const double small_internal_margin = geometry.small_internal_margin;
+  const double internal_margin = geometry.internal_margin;
+  const double content_width = geometry.content_width();
+
+  const double axis_label_width = 100;
+  const double plot_width = content_width - axis_label_width;
+  const double plot_height = 600;
+  const double tick_length = 10;
+  const double tick_label_width = 100;
+  const unsigned max_x_ticks = 10;
+  // beyond this many runs, points would only blur the lines
+  const size_t max_runs_with_points = 100;
+  const double legend_swatch_width = 60;
+  const double legend_label_width =
+    plot_width - legend_swatch_width - internal_margin;
+
+  const rgb_color black(0.0, 0.0, 0.0);
+
+  // --- x positions: the runs of any series, in order --- //
+  std::vector<size_t> chart_runs;
+  double y_top = 0.0;
+  for (const auto *line : series)
+  {
+    for (const auto &point : line->points)
+    {
+      chart_runs.push_back(point.run);
+      y_top = std::max(y_top, point.value * 1.1);
+    }
+  }
+  std::sort(chart_runs.begin(), chart_runs.end());
+  chart_runs.erase(std::unique(chart_runs.begin(), chart_runs.end()),
+    chart_runs.end());
+  if (y_top <= 0.0) y_top = 1.0;
+
+  auto position_of_run = [&](size_t run) {
+    return static_cast<double>(std::lower_bound(chart_runs.begin(),
+      chart_runs.end(), run) - chart_runs.begin());
+  };
+  const double x_max = std::max(1.0,
+    static_cast<double>(chart_runs.size()) - 1.0);
+
+  unsigned num_x_ticks = std::min<size_t>(max_x_ticks, chart_runs.size());
+  auto x_tick_position = [&](unsigned i) {
+    return num_x_ticks == 1 ? 0
+      : i * (chart_runs.size() - 1) / (num_x_ticks - 1);
+  };
+
+  std::string x_label = fmt::format("Run ({} runs)", chart_runs.size());
+  std::vector<std::string> legend_labels;
+  for (const auto *line : series)
+  {
+    std::string label = line->metric_name;
+    if (!line->steps.empty())
+      label += fmt::format(" ({} step change{})", line->steps.size(),
+        line->steps.size() == 1 ? "" : "s");
+    legend_labels.push_back(label);
+  }
+
+  // --- text is measured to size the chart before it is drawn --- //
+  auto text_height = [&](const std::string &text, font_role font,
+      double width) {
+    return context.text_height(output_filename, text, font, width);
+  };
+
+  const double title_height = text_height(title, font_role::TITLE,
+    content_width);
+  const double description_height = text_height(description,
+    font_role::DESCRIPTION, content_width);
+
+  // commits may wrap, so the axis label goes below the tallest of them
+  double tick_labels_height = 0.0;
+  for (unsigned i = 0; i < num_x_ticks; i++)
+    tick_labels_height = std::max(tick_labels_height, text_height(
+      runs[chart_runs[x_tick_position(i)]].label(), font_role::DESCRIPTION,
+      tick_label_width));
+  const double x_label_height = text_height(x_label, font_role::SMALL_LABEL,
+    plot_width);
+
+  std::vector<double> legend_heights;
+  double legend_height = 0.0;
+  for (const auto &label : legend_labels)
+  {
+    legend_heights.push_back(text_height(label, font_role::SMALL_LABEL,
+      legend_label_width) + small_internal_margin);
+    legend_height += legend_heights.back();
+  }
+
+  const double image_height = 2 * margin_y + title_height + internal_margin
+    + description_height + 2 * internal_margin + plot_height + tick_length
+    + tick_labels_height + small_internal_margin + x_label_height
+    + internal_margin + legend_height;
+
+  fhv::utils::create_directories_for_file(output_filename);
+
+  auto canvas_ptr = context.create_canvas(output_filename, image_width,
+    image_height);
+  diagram_canvas &canvas = *canvas_ptr;
+
+  // --- title and description --- //
+  double y = margin_y;
+  canvas.text(margin_x, y, content_width, title, font_role::TITLE,
+    text_alignment::CENTER);
+  y += title_height + internal_margin;
+  canvas.text(margin_x, y, content_width, description,
+    font_role::DESCRIPTION);
+  y += description_height + 2 * internal_margin;
+
+  // --- axes --- //
+  const double plot_x = margin_x + axis_label_width;
+  const double plot_y = y;
+
+  auto to_canvas_x = [&](double position) {
+    return plot_x + plot_width * position / x_max;
+  };
+  auto to_canvas_y = [&](double value) {
+    return plot_y + plot_height * (1.0 - value / y_top);
+  };
+
+  canvas.line({{plot_x, plot_y}, {plot_x, plot_y + plot_height},
+    {plot_x + plot_width, plot_y + plot_height}}, black, 2.0);
+
+  for (unsigned i = 0; i < num_x_ticks; i++)
+  {
+    size_t position = x_tick_position(i);
+    double x = to_canvas_x(static_cast<double>(position));
+    canvas.line({{x, plot_y + plot_height},
+      {x, plot_y + plot_height + tick_length}}, black, 2.0);
+    canvas.text(x - tick_label_width / 2, plot_y + plot_height + tick_length,
+      tick_label_width, runs[chart_runs[position]].label(),
+      font_role::DESCRIPTION, text_alignment::CENTER);
+  }
+
+  const unsigned num_y_ticks = 5;
+  for (unsigned i = 0; i <= num_y_ticks; i++)
+  {
+    double value = y_top * static_cast<double>(i) / num_y_ticks;
+    canvas.line({{plot_x, to_canvas_y(value)},
+      {plot_x - tick_length, to_canvas_y(value)}}, black, 2.0);
+    canvas.text(margin_x, to_canvas_y(value) - 10,
+      axis_label_width - 2 * tick_length, fmt::format("{:.3g}", value),
+      font_role::DESCRIPTION, text_alignment::RIGHT);
+  }
+
+  y = plot_y + plot_height + tick_length + tick_labels_height
+    + small_internal_margin;
+  canvas.text(plot_x, y, plot_width, x_label, font_role::SMALL_LABEL,
+    text_alignment::CENTER);
+  y += x_label_height + internal_margin;
+
+  // --- lines and step changes --- //
+  for (size_t s = 0; s < series.size(); s++)
+  {
+    const auto &points = series[s]->points;
+    if (points.empty()) continue;
+
+    rgb_color color = chartSeriesColors[s % chartSeriesColors.size()];
+
+    std::vector<std::pair<double, double>> line;
+    for (const auto &point : points)
+      line.push_back({to_canvas_x(position_of_run(point.run)),
+        to_canvas_y(point.value)});
+    canvas.line(line, color, 2.0);
+
+    if (chart_runs.size() <= max_runs_with_points)
+    {
+      for (const auto &point : line)
+        canvas.dot(point.first, point.second, 4.0, color);
+    }
+
+    for (const auto &step : series[s]->steps)
+    {
+      double x = to_canvas_x(position_of_run(points[step.point].run));
+      canvas.line({{x, plot_y}, {x, plot_y + plot_height}}, color, 1.5,
+        true);
+      canvas.text(x + 4, plot_y + 4 + 16 * static_cast<double>(s),
+        tick_label_width,
+        fmt::format("{:+.1f}%", step.relative_change * 100.0),
+        font_role::DESCRIPTION);
+    }
+  }
+
+  // --- legend --- //
+  for (size_t s = 0; s < series.size(); s++)
+  {
+    rgb_color color = chartSeriesColors[s % chartSeriesColors.size()];
+    double swatch_y = y + (legend_heights[s] - small_internal_margin) / 2;
+    canvas.line({{plot_x, swatch_y}, {plot_x + legend_swatch_width, swatch_y}},
+      color, 4.0);
+
+    canvas.text(plot_x + legend_swatch_width + internal_margin, y,
+      legend_label_width, legend_labels[s], font_role::SMALL_LABEL);
+    y += legend_heights[s];
+  }
+
+  return canvas.finish();
+}
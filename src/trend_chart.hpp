@@ -0,0 +1,44 @@
+#pragma once
+
+#include <fmt/core.h>
+#include <string>
+#include <vector>
+
+#include "render_context.hpp"
+#include "result_history.hpp"
+#include "scaling_chart.hpp"
+
+class trend_chart {
+  public:
+    /* ---- draw trend charts ----
+     * draws a chart for each region and setup (host, cpu and parameters) of
+     * series loaded by fhv::history::loadHistory, to
+     * <prefix>_<region>_trend_<n>.svg, numbered in the order the setups are
+     * printed by fhv::history::printTrends. Charts are drawn with context,
+     * so the svg backend can be used.
+     *
+     * Returns false if a chart could not be written. The others are still
+     * drawn.
+     */
+    static bool draw_trend_charts(
+      render_context &context,
+      const std::vector<fhv::history::HistoryRun> &runs,
+      const fhv::history::trend_series_t &series,
+      std::string output_prefix);
+
+    /* ---- draw trend chart ----
+     * draws one line per series over the runs of all series, in the order
+     * they were added and evenly spaced, since runs may be months or minutes
+     * apart. Ticks are labeled with the commit of the run. A dashed vertical
+     * line marks where each step change starts, labeled with the change.
+     *
+     * Returns false if the chart could not be written.
+     */
+    static bool draw_trend_chart(
+      render_context &context,
+      std::string title,
+      std::string description,
+      const std::vector<fhv::history::HistoryRun> &runs,
+      const std::vector<const fhv::history::TrendSeries *> &series,
+      std::string output_filename);
+};
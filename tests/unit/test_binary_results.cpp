@@ -0,0 +1,140 @@
+#include <cstddef>
+#include <string>
+
+#include "binary_results.hpp"
+#include "performance_monitor_defines.hpp"
+#include "unit_test.hpp"
+
+/*
+ * writes a binary results file, maps it back and checks every column, then
+ * checks that files with the wrong header or cut short are refused instead
+ * of read out of bounds
+ */
+
+namespace {
+  const std::string region_name = "poly";
+  const std::string group_name = "MEM_DP";
+  const std::string event_name = "INSTR_RETIRED_ANY";
+
+  const int8_t sum = static_cast<int8_t>(fhv::types::aggregation_t::sum);
+
+  bool writeResults(const std::string &filename, const json &info)
+  {
+    fhv::binary::ResultsWriter writer;
+    writer.addRow(region_name, 0, fhv::binary::no_aggregation, group_name,
+      fhv::types::result_t::metric, ram_bandwidth_metric_name, 1000.0);
+    writer.addRow(region_name, 1, fhv::binary::no_aggregation, group_name,
+      fhv::types::result_t::metric, ram_bandwidth_metric_name, 1200.0);
+    writer.addRow(region_name, 0, fhv::binary::no_aggregation, group_name,
+      fhv::types::result_t::event, event_name, 5e9);
+    writer.addRow(region_name, fhv::binary::no_thread, sum, group_name,
+      fhv::types::result_t::metric, ram_bandwidth_metric_name, 2200.0);
+
+    return writer.write(filename, info);
+  }
+
+  void testRoundTrip(const std::string &filename, const json &info)
+  {
+    EXPECT(fhv::binary::isBinaryResults(filename));
+
+    fhv::binary::MappedResults mapped;
+    EXPECT(mapped.open(filename));
+    EXPECT(mapped.numRows() == 4);
+    if (mapped.numRows() != 4) return;
+
+    // columns keep the order rows were added in
+    EXPECT(mapped.string(mapped.regions()[0]) == region_name);
+    EXPECT(mapped.threads()[1] == 1);
+    EXPECT(mapped.aggregations()[0] == fhv::binary::no_aggregation);
+    EXPECT(mapped.string(mapped.groups()[0]) == group_name);
+    EXPECT(mapped.resultTypes()[2]
+      == static_cast<uint8_t>(fhv::types::result_t::event));
+    EXPECT(mapped.string(mapped.resultNames()[2]) == event_name);
+    EXPECT(mapped.values()[1] == 1200.0);
+
+    EXPECT(mapped.threads()[3] == fhv::binary::no_thread);
+    EXPECT(mapped.aggregations()[3] == sum);
+    EXPECT(mapped.values()[3] == 2200.0);
+
+    EXPECT(mapped.info() == info);
+
+    // the json only holds metrics, and leaves out threads if asked to
+    const std::string sum_section = fhv::types::aggregationTypeToString(
+      fhv::types::aggregation_t::sum);
+    const std::string thread_section = json_thread_section_base + "0";
+
+    json results = mapped.toJson();
+    const json &region = results[json_results_section][region_name];
+    EXPECT(results[json_info_section] == info);
+    EXPECT(region[sum_section][ram_bandwidth_metric_name] == 2200.0);
+    EXPECT(region[thread_section][ram_bandwidth_metric_name] == 1000.0);
+    EXPECT(!region[thread_section].contains(event_name));
+
+    json aggregates = mapped.toJson(false);
+    EXPECT(!aggregates[json_results_section][region_name].contains(
+      thread_section));
+  }
+
+  void testBadHeader(const std::string &directory, const std::string &file)
+  {
+    std::string bad_magic = file;
+    bad_magic[0] = 'X';
+    std::string bad_magic_filename = directory + "/bad_magic.fhvb";
+    unit_test::writeFile(bad_magic_filename, bad_magic);
+
+    fhv::binary::MappedResults mapped;
+    EXPECT(!fhv::binary::isBinaryResults(bad_magic_filename));
+    EXPECT(!mapped.open(bad_magic_filename));
+
+    // newer files may be laid out differently, so they are refused
+    std::string newer = file;
+    uint32_t version = fhv::binary::binary_results_version + 1;
+    newer.replace(offsetof(fhv::binary::BinaryHeader, version),
+      sizeof(version), reinterpret_cast<const char*>(&version),
+      sizeof(version));
+    std::string newer_filename = directory + "/newer.fhvb";
+    unit_test::writeFile(newer_filename, newer);
+
+    EXPECT(fhv::binary::isBinaryResults(newer_filename));
+    EXPECT(!mapped.open(newer_filename));
+  }
+
+  void testTruncated(const std::string &directory, const std::string &file)
+  {
+    fhv::binary::MappedResults mapped;
+    json results;
+
+    // the value column is last, so it no longer fits
+    std::string truncated_filename = directory + "/truncated.fhvb";
+    unit_test::writeFile(truncated_filename, file.substr(0, file.size() - 8));
+    EXPECT(fhv::binary::isBinaryResults(truncated_filename));
+    EXPECT(!mapped.open(truncated_filename));
+    EXPECT(!fhv::binary::loadResults(truncated_filename, results));
+
+    std::string header_only_filename = directory + "/header_only.fhvb";
+    unit_test::writeFile(header_only_filename,
+      file.substr(0, sizeof(fhv::binary::BinaryHeader) - 1));
+    EXPECT(!mapped.open(header_only_filename));
+  }
+}
+
+int main()
+{
+  std::string directory = unit_test::tempDirectory();
+  std::string filename = directory + "/results.fhvb";
+
+  json info;
+  info[json_num_ranks_key] = 1;
+  info[json_parameter_key] = "n=4000";
+
+  EXPECT(writeResults(filename, info));
+  testRoundTrip(filename, info);
+
+  std::string file = unit_test::readFile(filename);
+  EXPECT(file.size() > sizeof(fhv::binary::BinaryHeader));
+  testBadHeader(directory, file);
+  testTruncated(directory, file);
+
+  unit_test::removeDirectory(directory);
+  return unit_test::result("test_binary_results");
+}
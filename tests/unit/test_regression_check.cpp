@@ -0,0 +1,153 @@
+#include <string>
+#include <vector>
+
+#include "performance_monitor_defines.hpp"
+#include "regression_check.hpp"
+#include "unit_test.hpp"
+
+/*
+ * evaluates a thresholds file against results and baselines that pass, fail
+ * and lack a metric, and checks the exit codes of fhv --check for each
+ */
+
+namespace {
+  const std::string region_name = "poly";
+
+  const std::string sum_section = fhv::types::aggregationTypeToString(
+    fhv::types::aggregation_t::sum);
+
+  json makeResults(double ram_bandwidth, double mflops_dp)
+  {
+    json results;
+    results[json_info_section] = json::object();
+    json &sum = results[json_results_section][region_name][sum_section];
+    if (ram_bandwidth > 0.0) sum[ram_bandwidth_metric_name] = ram_bandwidth;
+    if (mflops_dp > 0.0) sum[mflops_dp_metric_name] = mflops_dp;
+    return results;
+  }
+
+  json makeThresholds()
+  {
+    json thresholds;
+    thresholds[fhv::check::thresholds_rules_key] = {
+      // two conditions make two rules
+      {
+        {fhv::check::thresholds_region_key, region_name},
+        {fhv::check::thresholds_metric_key, ram_bandwidth_metric_name},
+        {fhv::check::thresholds_min_key, 900.0},
+        {fhv::check::thresholds_min_ratio_key, 0.9},
+      },
+      {
+        {fhv::check::thresholds_region_key, "po*"},
+        {fhv::check::thresholds_metric_key, mflops_dp_metric_name},
+        {fhv::check::thresholds_tolerance_key, 0.1},
+      },
+    };
+    return thresholds;
+  }
+
+  // the number of results that didn't pass
+  size_t numFailed(const fhv::check::check_results_t &check_results)
+  {
+    size_t num_failed = 0;
+    for (const auto &check_result : check_results)
+      if (!check_result.passed) num_failed++;
+    return num_failed;
+  }
+
+  void testRules(const fhv::check::threshold_rules_t &rules)
+  {
+    EXPECT(rules.size() == 3);
+    if (rules.size() != 3) return;
+    EXPECT(rules[0].rule_type == fhv::check::rule_t::floor);
+    EXPECT(rules[1].rule_type == fhv::check::rule_t::ratio_to_baseline);
+    EXPECT(rules[2].rule_type == fhv::check::rule_t::noise_band);
+    EXPECT(rules[2].aggregation_name == sum_section);
+    EXPECT(rules[2].matchesRegion(region_name));
+
+    json results = makeResults(1000.0, 500.0);
+
+    // within 10% of the baseline and at least 90% of it
+    json passing = makeResults(1050.0, 520.0);
+    auto check_results = fhv::check::evaluateRules(rules, results, &passing);
+    EXPECT(check_results.size() == 3);
+    EXPECT(numFailed(check_results) == 0);
+
+    // 1000 is less than 90% of 1200, and 500 is more than 10% below 600
+    json failing = makeResults(1200.0, 600.0);
+    check_results = fhv::check::evaluateRules(rules, results, &failing);
+    EXPECT(numFailed(check_results) == 2);
+    EXPECT(check_results[0].passed);
+    EXPECT(!check_results[1].passed);
+    EXPECT(check_results[1].baseline_value == 1200.0);
+
+    // rules that need a baseline fail without one
+    json missing_baseline = makeResults(1050.0, 0.0);
+    check_results = fhv::check::evaluateRules(rules, results,
+      &missing_baseline);
+    EXPECT(numFailed(check_results) == 1);
+    EXPECT(!check_results[2].passed);
+    EXPECT(check_results[2].message == "no baseline value for this metric");
+
+    check_results = fhv::check::evaluateRules(rules, results, nullptr);
+    EXPECT(numFailed(check_results) == 2);
+
+    // as do all rules on a metric the results lack
+    json missing_metric = makeResults(0.0, 500.0);
+    check_results = fhv::check::evaluateRules(rules, missing_metric, &passing);
+    EXPECT(numFailed(check_results) == 2);
+    EXPECT(check_results[0].message == "metric missing from results");
+
+    // a rule that checks nothing is a failure, not a silent pass
+    json other_region;
+    other_region[json_results_section]["other"] =
+      makeResults(1000.0, 500.0)[json_results_section][region_name];
+    check_results = fhv::check::evaluateRules(rules, other_region, &passing);
+    EXPECT(numFailed(check_results) == 3);
+    EXPECT(check_results[0].message == "no region matches this rule");
+  }
+
+  void testExitCodes(const std::string &directory)
+  {
+    auto write = [&](const std::string &name, const json &j) {
+      std::string filename = directory + "/" + name;
+      unit_test::writeFile(filename, j.dump());
+      return filename;
+    };
+
+    std::string thresholds = write("thresholds.json", makeThresholds());
+    std::string results = write("results.json", makeResults(1000.0, 500.0));
+    std::string passing = write("passing.json", makeResults(1050.0, 520.0));
+    std::string failing = write("failing.json", makeResults(1200.0, 600.0));
+    std::string missing_metric = write("missing_metric.json",
+      makeResults(1050.0, 0.0));
+    std::string missing_file = directory + "/missing.json";
+
+    EXPECT(fhv::check::checkFiles({results}, thresholds, passing) == 0);
+    EXPECT(fhv::check::checkFiles({results}, thresholds, failing) == 1);
+    EXPECT(fhv::check::checkFiles({results}, thresholds, missing_metric)
+      == 1);
+
+    // files that can't be read win over violations
+    EXPECT(fhv::check::checkFiles({results, missing_file}, thresholds,
+      failing) == 2);
+    EXPECT(fhv::check::checkFiles({results}, thresholds, missing_file) == 2);
+    EXPECT(fhv::check::checkFiles({results}, missing_file, passing) == 2);
+  }
+}
+
+int main()
+{
+  std::string directory = unit_test::tempDirectory();
+
+  std::string thresholds_filename = directory + "/rules.json";
+  unit_test::writeFile(thresholds_filename, makeThresholds().dump());
+
+  fhv::check::threshold_rules_t rules;
+  EXPECT(fhv::check::loadThresholds(thresholds_filename, rules));
+  testRules(rules);
+  testExitCodes(directory);
+
+  unit_test::removeDirectory(directory);
+  return unit_test::result("test_regression_check");
+}
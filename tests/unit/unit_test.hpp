@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <fmt/core.h>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+
+/* ---- unit test ----
+ * the little the tests in this directory share. EXPECT prints every
+ * condition that doesn't hold with its line and keeps going, and a test's
+ * main returns unit_test::result(), so "make test" stops at the first test
+ * with a failure.
+ */
+namespace unit_test {
+  inline int &num_failures()
+  {
+    static int failures = 0;
+    return failures;
+  }
+
+  inline void expect(bool passed, const char *condition, const char *file,
+    int line)
+  {
+    if (passed) return;
+
+    fmt::print(stderr, "{}:{}: FAILED: {}\n", file, line, condition);
+    num_failures()++;
+  }
+
+  // prints a summary and returns the exit code of the test
+  inline int result(const std::string &test_name)
+  {
+    if (num_failures() == 0) {
+      fmt::print("{}: passed\n", test_name);
+      return 0;
+    }
+
+    fmt::print("{}: {} check(s) failed\n", test_name, num_failures());
+    return 1;
+  }
+
+  // a new, empty directory under TMPDIR (or /tmp), for the files of a test
+  inline std::string tempDirectory()
+  {
+    const char *tmpdir = std::getenv("TMPDIR");
+    std::string path = std::string(tmpdir != nullptr ? tmpdir : "/tmp")
+      + "/fhv_test_XXXXXX";
+    if (mkdtemp(&path[0]) == nullptr) {
+      fmt::print(stderr, "ERROR: could not create a temporary directory\n");
+      std::exit(2);
+    }
+    return path;
+  }
+
+  // removes a directory made by tempDirectory and the files in it
+  inline void removeDirectory(const std::string &path)
+  {
+    if (DIR *directory = opendir(path.c_str()))
+    {
+      while (dirent *entry = readdir(directory))
+      {
+        std::string name = entry->d_name;
+        if (name != "." && name != "..")
+          std::remove((path + "/" + name).c_str());
+      }
+      closedir(directory);
+    }
+    rmdir(path.c_str());
+  }
+
+  inline std::string readFile(const std::string &filename)
+  {
+    std::ifstream input(filename, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(input),
+      std::istreambuf_iterator<char>());
+  }
+
+  inline void writeFile(const std::string &filename, const std::string &data)
+  {
+    std::ofstream output(filename, std::ios::binary);
+    output << data;
+  }
+};
+
+#define EXPECT(condition) \
+  unit_test::expect((condition), #condition, __FILE__, __LINE__)